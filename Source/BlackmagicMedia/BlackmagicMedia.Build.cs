@@ -44,9 +44,14 @@ namespace UnrealBuildTool.Rules
 				new string[] {
 					"BlackmagicMedia/Private",
 					"BlackmagicMedia/Private/Blackmagic",
+					"BlackmagicMedia/Private/Broker",
 					"BlackmagicMedia/Private/Assets",
+					"BlackmagicMedia/Private/PixelTap",
 					"BlackmagicMedia/Private/Player",
+					"BlackmagicMedia/Private/Proxy",
+					"BlackmagicMedia/Private/Recording",
 					"BlackmagicMedia/Private/Shared",
+					"BlackmagicMedia/Private/SharedMemory",
 				});
 		}
 	}
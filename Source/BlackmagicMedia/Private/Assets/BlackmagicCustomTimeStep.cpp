@@ -3,6 +3,7 @@
 #include "BlackmagicCustomTimeStep.h"
 
 #include "Blackmagic.h"
+#include "BlackmagicMediaBroker.h"
 #include "BlackmagicMediaPrivate.h"
 
 #include "HAL/Event.h"
@@ -47,7 +48,7 @@ namespace BlackmagicCustomTimeStepHelpers
 			AddRef();
 
 			BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> SelfRef(this);
-			BlackmagicIdendifier = BlackmagicDesign::RegisterCallbackForChannel(ChannelInfo, InChannelInfo, SelfRef);
+			BlackmagicIdendifier = BlackmagicMediaBackend::RegisterCallbackForChannel(ChannelInfo, InChannelInfo, SelfRef);
 			State = BlackmagicIdendifier.IsValid() ? ECustomTimeStepSynchronizationState::Synchronizing : ECustomTimeStepSynchronizationState::Error;
 			return BlackmagicIdendifier.IsValid();
 		}
@@ -56,7 +57,7 @@ namespace BlackmagicCustomTimeStepHelpers
 		{
 			if (BlackmagicIdendifier.IsValid())
 			{
-				BlackmagicDesign::UnregisterCallbackForChannel(ChannelInfo, BlackmagicIdendifier);
+				BlackmagicMediaBackend::UnregisterCallbackForChannel(ChannelInfo, BlackmagicIdendifier);
 				BlackmagicIdendifier = BlackmagicDesign::FUniqueIdentifier();
 			}
 
@@ -0,0 +1,268 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaPresets.h"
+
+#include "BlackmagicDeviceProvider.h"
+#include "BlackmagicMediaPrivate.h"
+#include "BlackmagicMediaValidation.h"
+
+#include "HAL/CriticalSection.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace BlackmagicMediaPresetsHelpers
+{
+	/** A port of a preset, as validated */
+	struct FValidatedPort
+	{
+		FBlackmagicMediaPresetPort Port;
+		FMediaIOOutputConfiguration Configuration;
+		bool bIsValid = false;
+		FString FailureReason;
+	};
+
+	struct FValidatedPreset
+	{
+		FName Name;
+		TArray<FValidatedPort> Ports;
+	};
+
+	/** Filled once, the first time a preset is used */
+	static FCriticalSection PresetsLock;
+	static TArray<FValidatedPreset> ValidatedPresets;
+	static bool bPresetsValidated = false;
+
+	FValidatedPort ValidatePort(FName InPresetName, int32 InPortIndex, const FBlackmagicMediaPresetPort& InPort)
+	{
+		FValidatedPort Result;
+		Result.Port = InPort;
+
+		FMediaIOConfiguration& MediaConfiguration = Result.Configuration.MediaConfiguration;
+		MediaConfiguration.bIsInput = InPort.bIsInput;
+		MediaConfiguration.MediaConnection.Device.DeviceIdentifier = InPort.DeviceIndex;
+		MediaConfiguration.MediaConnection.Protocol = FBlackmagicDeviceProvider::GetProtocolName();
+		MediaConfiguration.MediaConnection.PortIdentifier = 0;
+		MediaConfiguration.MediaConnection.TransportType = InPort.bIsInput ? EMediaIOTransportType::SingleLink : InPort.TransportType;
+		MediaConfiguration.MediaConnection.QuadTransportType = InPort.QuadTransportType;
+		MediaConfiguration.MediaMode.DeviceModeIdentifier = InPort.VideoFormat;
+		Result.Configuration.OutputType = InPort.OutputType;
+		Result.Configuration.OutputReference = InPort.OutputReference;
+		Result.Configuration.KeyPortIdentifier = 0;
+
+		const FString PortName = FString::Printf(TEXT("%s[%d]"), *InPresetName.ToString(), InPortIndex);
+
+		// The name and the mode of the configuration come from the device
+		FBlackmagicDeviceCapabilities Capabilities;
+		if (FBlackmagicDeviceProvider::FindCachedDevice(InPort.DeviceIndex, Capabilities))
+		{
+			MediaConfiguration.MediaConnection.Device.DeviceName = Capabilities.Device.DeviceName;
+
+			const TArray<FBlackmagicDeviceMode>& Modes = InPort.bIsInput ? Capabilities.InputModes : Capabilities.OutputModes;
+			const FBlackmagicDeviceMode* Mode = Modes.FindByPredicate([&InPort](const FBlackmagicDeviceMode& Candidate) { return Candidate.Mode.DeviceModeIdentifier == InPort.VideoFormat; });
+			if (Mode)
+			{
+				MediaConfiguration.MediaMode = Mode->Mode;
+			}
+		}
+
+		if (InPort.bIsInput)
+		{
+			Result.bIsValid = FBlackmagicMediaValidation::ValidateInput(MediaConfiguration, PortName, Result.FailureReason);
+		}
+		else
+		{
+			Result.bIsValid = FBlackmagicMediaValidation::ValidateOutput(Result.Configuration, PortName, Result.FailureReason);
+			if (Result.bIsValid && InPort.OutputType == EMediaIOOutputType::FillAndKey && InPort.b10Bit)
+			{
+				Result.FailureReason = FString::Printf(TEXT("'%s', Blackmagic devices do not support 10bit key."), *PortName);
+				Result.bIsValid = false;
+			}
+		}
+
+		return Result;
+	}
+
+	/** Must be called under PresetsLock */
+	void ValidatePresets()
+	{
+		if (bPresetsValidated)
+		{
+			return;
+		}
+		bPresetsValidated = true;
+
+		ValidatedPresets.Reset();
+		for (const FBlackmagicMediaPreset& Preset : GetDefault<UBlackmagicMediaPresets>()->Presets)
+		{
+			if (Preset.Name.IsNone() || ValidatedPresets.ContainsByPredicate([&Preset](const FValidatedPreset& Other) { return Other.Name == Preset.Name; }))
+			{
+				UE_LOG(LogBlackmagicMedia, Warning, TEXT("The Blackmagic preset '%s' is ignored, its name is empty or already used."), *Preset.Name.ToString());
+				continue;
+			}
+
+			FValidatedPreset& ValidatedPreset = ValidatedPresets.AddDefaulted_GetRef();
+			ValidatedPreset.Name = Preset.Name;
+			for (int32 PortIndex = 0; PortIndex < Preset.Ports.Num(); ++PortIndex)
+			{
+				FValidatedPort& ValidatedPort = ValidatedPreset.Ports.Add_GetRef(ValidatePort(Preset.Name, PortIndex, Preset.Ports[PortIndex]));
+				if (!ValidatedPort.bIsValid)
+				{
+					UE_LOG(LogBlackmagicMedia, Warning, TEXT("%s"), *ValidatedPort.FailureReason);
+				}
+			}
+
+			UE_LOG(LogBlackmagicMedia, Log, TEXT("The Blackmagic preset '%s' has %d valid ports out of %d."), *Preset.Name.ToString()
+				, ValidatedPreset.Ports.FilterByPredicate([](const FValidatedPort& Port) { return Port.bIsValid; }).Num(), ValidatedPreset.Ports.Num());
+		}
+	}
+
+	bool IsSameConfiguration(const FMediaIOConfiguration& InA, const FMediaIOConfiguration& InB)
+	{
+		return InA.bIsInput == InB.bIsInput
+			&& InA.MediaConnection == InB.MediaConnection
+			&& InA.MediaMode.DeviceModeIdentifier == InB.MediaMode.DeviceModeIdentifier;
+	}
+
+	static FAutoConsoleCommand ReloadPresetsCommand(
+		TEXT("Blackmagic.ReloadPresets"),
+		TEXT("Read the Blackmagic presets from the ini and validate them again."),
+		FConsoleCommandDelegate::CreateStatic(&UBlackmagicMediaPresets::Reload)
+	);
+}
+
+
+/* FBlackmagicMediaPresetPort
+*****************************************************************************/
+
+FBlackmagicMediaPresetPort::FBlackmagicMediaPresetPort()
+	: DeviceIndex(1)
+	, bIsInput(false)
+	, VideoFormat(BlackmagicMediaOption::DefaultVideoFormat)
+	, b10Bit(false)
+	, TimecodeFormat(EMediaIOTimecodeFormat::None)
+	, OutputType(EMediaIOOutputType::Fill)
+	, OutputReference(EMediaIOReferenceType::FreeRun)
+	, TransportType(EMediaIOTransportType::SingleLink)
+	, QuadTransportType(EMediaIOQuadLinkTransportType::TwoSampleInterleave)
+{
+}
+
+
+/* UBlackmagicMediaPresets
+*****************************************************************************/
+
+TArray<FName> UBlackmagicMediaPresets::GetPresetNames()
+{
+	using namespace BlackmagicMediaPresetsHelpers;
+
+	FScopeLock Lock(&PresetsLock);
+	ValidatePresets();
+
+	TArray<FName> Results;
+	for (const FValidatedPreset& Preset : ValidatedPresets)
+	{
+		Results.Add(Preset.Name);
+	}
+	return Results;
+}
+
+
+int32 UBlackmagicMediaPresets::GetNumPorts(FName InPresetName)
+{
+	using namespace BlackmagicMediaPresetsHelpers;
+
+	FScopeLock Lock(&PresetsLock);
+	ValidatePresets();
+
+	const FValidatedPreset* Preset = ValidatedPresets.FindByPredicate([InPresetName](const FValidatedPreset& Candidate) { return Candidate.Name == InPresetName; });
+	return Preset ? Preset->Ports.Num() : 0;
+}
+
+
+bool UBlackmagicMediaPresets::GetPortConfiguration(FName InPresetName, int32 InPortIndex, FBlackmagicMediaPresetPort& OutPort, FMediaIOOutputConfiguration& OutConfiguration, FString& OutFailureReason)
+{
+	using namespace BlackmagicMediaPresetsHelpers;
+
+	FScopeLock Lock(&PresetsLock);
+	ValidatePresets();
+
+	const FValidatedPreset* Preset = ValidatedPresets.FindByPredicate([InPresetName](const FValidatedPreset& Candidate) { return Candidate.Name == InPresetName; });
+	if (Preset == nullptr)
+	{
+		OutFailureReason = FString::Printf(TEXT("The Blackmagic preset '%s' doesn't exist."), *InPresetName.ToString());
+		return false;
+	}
+
+	if (!Preset->Ports.IsValidIndex(InPortIndex))
+	{
+		OutFailureReason = FString::Printf(TEXT("The Blackmagic preset '%s' doesn't have a port %d."), *InPresetName.ToString(), InPortIndex);
+		return false;
+	}
+
+	const FValidatedPort& Port = Preset->Ports[InPortIndex];
+	if (!Port.bIsValid)
+	{
+		OutFailureReason = Port.FailureReason;
+		return false;
+	}
+
+	OutPort = Port.Port;
+	OutConfiguration = Port.Configuration;
+	return true;
+}
+
+
+bool UBlackmagicMediaPresets::IsValidatedConfiguration(const FMediaIOConfiguration& InConfiguration)
+{
+	using namespace BlackmagicMediaPresetsHelpers;
+
+	FScopeLock Lock(&PresetsLock);
+	for (const FValidatedPreset& Preset : ValidatedPresets)
+	{
+		for (const FValidatedPort& Port : Preset.Ports)
+		{
+			if (Port.bIsValid && IsSameConfiguration(Port.Configuration.MediaConfiguration, InConfiguration))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+bool UBlackmagicMediaPresets::IsValidatedConfiguration(const FMediaIOOutputConfiguration& InConfiguration)
+{
+	using namespace BlackmagicMediaPresetsHelpers;
+
+	FScopeLock Lock(&PresetsLock);
+	for (const FValidatedPreset& Preset : ValidatedPresets)
+	{
+		for (const FValidatedPort& Port : Preset.Ports)
+		{
+			if (Port.bIsValid
+				&& IsSameConfiguration(Port.Configuration.MediaConfiguration, InConfiguration.MediaConfiguration)
+				&& Port.Configuration.OutputType == InConfiguration.OutputType
+				&& Port.Configuration.OutputReference == InConfiguration.OutputReference)
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+void UBlackmagicMediaPresets::Reload()
+{
+	using namespace BlackmagicMediaPresetsHelpers;
+
+	FBlackmagicDeviceProvider::RequestScan();
+	FBlackmagicDeviceProvider::WaitForScan();
+	GetMutableDefault<UBlackmagicMediaPresets>()->ReloadConfig();
+
+	FScopeLock Lock(&PresetsLock);
+	bPresetsValidated = false;
+	ValidatePresets();
+}
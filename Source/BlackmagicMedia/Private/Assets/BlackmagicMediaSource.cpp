@@ -2,10 +2,13 @@
 
 #include "BlackmagicMediaSource.h"
 
-#include "Blackmagic.h"
+#include "BlackmagicMediaPresets.h"
 #include "BlackmagicMediaPrivate.h"
+#include "BlackmagicMediaValidation.h"
+#include "IBlackmagicMediaModule.h"
 
 #include "MediaIOCorePlayerBase.h"
+#include "Modules/ModuleManager.h"
 
 UBlackmagicMediaSource::UBlackmagicMediaSource()
 	: TimecodeFormat(EMediaIOTimecodeFormat::None)
@@ -16,12 +19,146 @@ UBlackmagicMediaSource::UBlackmagicMediaSource()
 	, ColorFormat(EBlackmagicMediaSourceColorFormat::YUV8)
 	, bIsSRGBInput(false)
 	, MaxNumVideoFrameBuffer(8)
+	, bCaptureRegionOfInterest(false)
+	, RegionOfInterestPosition(0, 0)
+	, RegionOfInterestSize(1920, 1080)
+	, DuplicateFrameDetection(EBlackmagicMediaDuplicateFrameDetection::Disabled)
+	, bExportToSharedMemory(false)
+	, SharedMemoryNumSlots(4)
+	, bGenerateProxies(false)
+	, ProxyFrameDivider(2)
 	, bLogDropFrame(false)
 	, bEncodeTimecodeInTexel(false)
 {
 	MediaConfiguration.bIsInput = true;
 }
 
+/*
+ * FBlackmagicMediaSourceSettings
+ */
+
+const TCHAR* const FBlackmagicMediaSourceSettings::TypeName = TEXT("BlackmagicMediaSourceSettings");
+
+FBlackmagicMediaSourceSettings FBlackmagicMediaSourceSettings::FromMediaOptions(const IMediaOptions& InOptions)
+{
+	FBlackmagicMediaSourceSettings Settings;
+	Settings.DeviceIndex = InOptions.GetMediaOption(BlackmagicMediaOption::DeviceIndex, (int64)0);
+	Settings.VideoFormat = InOptions.GetMediaOption(BlackmagicMediaOption::BlackmagicVideoFormat, (int64)BlackmagicMediaOption::DefaultVideoFormat);
+	Settings.VideoStandard = (EMediaIOStandardType)(InOptions.GetMediaOption(BlackmagicMediaOption::VideoStandard, (int64)EMediaIOStandardType::Progressive));
+	Settings.TimecodeFormat = (EMediaIOTimecodeFormat)(InOptions.GetMediaOption(BlackmagicMediaOption::TimecodeFormat, (int64)EMediaIOTimecodeFormat::None));
+	Settings.bCaptureAudio = InOptions.GetMediaOption(BlackmagicMediaOption::CaptureAudio, false);
+	Settings.AudioChannels = (EBlackmagicMediaAudioChannel)(InOptions.GetMediaOption(BlackmagicMediaOption::AudioChannelOption, (int64)EBlackmagicMediaAudioChannel::Stereo2));
+	Settings.bCaptureVideo = InOptions.GetMediaOption(BlackmagicMediaOption::CaptureVideo, true);
+	Settings.ColorFormat = (EBlackmagicMediaSourceColorFormat)(InOptions.GetMediaOption(BlackmagicMediaOption::ColorFormat, (int64)EBlackmagicMediaSourceColorFormat::YUV8));
+	Settings.bIsSRGBInput = InOptions.GetMediaOption(BlackmagicMediaOption::SRGBInput, true);
+	Settings.bCaptureRegionOfInterest = InOptions.GetMediaOption(BlackmagicMediaOption::CaptureRegionOfInterest, false);
+	Settings.RegionOfInterestPosition.X = InOptions.GetMediaOption(BlackmagicMediaOption::RegionOfInterestX, (int64)0);
+	Settings.RegionOfInterestPosition.Y = InOptions.GetMediaOption(BlackmagicMediaOption::RegionOfInterestY, (int64)0);
+	Settings.RegionOfInterestSize.X = InOptions.GetMediaOption(BlackmagicMediaOption::RegionOfInterestWidth, (int64)0);
+	Settings.RegionOfInterestSize.Y = InOptions.GetMediaOption(BlackmagicMediaOption::RegionOfInterestHeight, (int64)0);
+	Settings.bExportToSharedMemory = InOptions.GetMediaOption(BlackmagicMediaOption::ExportToSharedMemory, false);
+	Settings.SharedMemoryName = InOptions.GetMediaOption(BlackmagicMediaOption::SharedMemoryName, FString());
+	Settings.SharedMemoryNumSlots = InOptions.GetMediaOption(BlackmagicMediaOption::SharedMemoryNumSlots, (int64)4);
+	Settings.bGenerateProxies = InOptions.GetMediaOption(BlackmagicMediaOption::GenerateProxies, false);
+	Settings.ProxyFrameDivider = InOptions.GetMediaOption(BlackmagicMediaOption::ProxyFrameDivider, (int64)2);
+	Settings.MaxNumAudioFrameBuffer = InOptions.GetMediaOption(BlackmagicMediaOption::MaxAudioFrameBuffer, (int64)8);
+	Settings.MaxNumVideoFrameBuffer = InOptions.GetMediaOption(BlackmagicMediaOption::MaxVideoFrameBuffer, (int64)8);
+	Settings.DuplicateFrameDetection = (EBlackmagicMediaDuplicateFrameDetection)(InOptions.GetMediaOption(BlackmagicMediaOption::DuplicateFrameDetection, (int64)EBlackmagicMediaDuplicateFrameDetection::Disabled));
+	Settings.bLogDropFrame = InOptions.GetMediaOption(BlackmagicMediaOption::LogDropFrame, false);
+	Settings.bEncodeTimecodeInTexel = InOptions.GetMediaOption(BlackmagicMediaOption::EncodeTimecodeInTexel, false);
+	return Settings;
+}
+
+bool FBlackmagicMediaSourceSettings::RequiresReopen(const FBlackmagicMediaSourceSettings& InOther) const
+{
+	return DeviceIndex != InOther.DeviceIndex
+		|| VideoFormat != InOther.VideoFormat
+		|| VideoStandard != InOther.VideoStandard
+		|| TimecodeFormat != InOther.TimecodeFormat
+		|| bCaptureAudio != InOther.bCaptureAudio
+		|| AudioChannels != InOther.AudioChannels
+		|| bCaptureVideo != InOther.bCaptureVideo
+		|| ColorFormat != InOther.ColorFormat
+		|| bIsSRGBInput != InOther.bIsSRGBInput
+		|| bCaptureRegionOfInterest != InOther.bCaptureRegionOfInterest
+		|| RegionOfInterestPosition != InOther.RegionOfInterestPosition
+		|| RegionOfInterestSize != InOther.RegionOfInterestSize
+		|| bExportToSharedMemory != InOther.bExportToSharedMemory
+		|| SharedMemoryName != InOther.SharedMemoryName
+		|| SharedMemoryNumSlots != InOther.SharedMemoryNumSlots
+		|| bGenerateProxies != InOther.bGenerateProxies
+		|| ProxyFrameDivider != InOther.ProxyFrameDivider;
+}
+
+/*
+ * UBlackmagicMediaSource
+ */
+
+TSharedRef<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe> UBlackmagicMediaSource::GetSettings() const
+{
+	TSharedRef<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe> Settings = MakeShared<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>();
+	Settings->Source = FObjectKey(this);
+	Settings->DeviceIndex = MediaConfiguration.MediaConnection.Device.DeviceIdentifier;
+	Settings->VideoFormat = MediaConfiguration.MediaMode.DeviceModeIdentifier;
+	Settings->VideoStandard = MediaConfiguration.MediaMode.Standard;
+	Settings->TimecodeFormat = TimecodeFormat;
+	Settings->bCaptureAudio = bCaptureAudio;
+	Settings->AudioChannels = AudioChannels;
+	Settings->bCaptureVideo = bCaptureVideo;
+	Settings->ColorFormat = ColorFormat;
+	Settings->bIsSRGBInput = bIsSRGBInput;
+	Settings->bCaptureRegionOfInterest = bCaptureRegionOfInterest;
+	Settings->RegionOfInterestPosition = RegionOfInterestPosition;
+	Settings->RegionOfInterestSize = RegionOfInterestSize;
+	Settings->bExportToSharedMemory = bExportToSharedMemory;
+	Settings->SharedMemoryName = SharedMemoryName;
+	Settings->SharedMemoryNumSlots = SharedMemoryNumSlots;
+	Settings->bGenerateProxies = bGenerateProxies;
+	Settings->ProxyFrameDivider = ProxyFrameDivider;
+	Settings->MaxNumAudioFrameBuffer = MaxNumAudioFrameBuffer;
+	Settings->MaxNumVideoFrameBuffer = MaxNumVideoFrameBuffer;
+	Settings->DuplicateFrameDetection = DuplicateFrameDetection;
+	Settings->bLogDropFrame = bLogDropFrame;
+	Settings->bEncodeTimecodeInTexel = bEncodeTimecodeInTexel;
+	return Settings;
+}
+
+void UBlackmagicMediaSource::ApplyToRunningPlayers() const
+{
+	if (IBlackmagicMediaModule* MediaModule = FModuleManager::GetModulePtr<IBlackmagicMediaModule>(TEXT("BlackmagicMedia")))
+	{
+		MediaModule->ApplySourceSettings(GetSettings());
+	}
+}
+
+bool UBlackmagicMediaSource::ApplyPreset(FName PresetName, int32 PortIndex)
+{
+	FBlackmagicMediaPresetPort Port;
+	FMediaIOOutputConfiguration Configuration;
+	FString FailureReason;
+	if (!UBlackmagicMediaPresets::GetPortConfiguration(PresetName, PortIndex, Port, Configuration, FailureReason))
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("Can't apply the preset to the MediaSource '%s'. %s"), *GetName(), *FailureReason);
+		return false;
+	}
+
+	if (!Port.bIsInput)
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("Can't apply the preset to the MediaSource '%s'. The port %d of the preset '%s' is an output."), *GetName(), PortIndex, *PresetName.ToString());
+		return false;
+	}
+
+	MediaConfiguration = Configuration.MediaConfiguration;
+	TimecodeFormat = Port.TimecodeFormat;
+	ColorFormat = Port.b10Bit ? EBlackmagicMediaSourceColorFormat::YUV10 : EBlackmagicMediaSourceColorFormat::YUV8;
+	if (TimecodeFormat == EMediaIOTimecodeFormat::None)
+	{
+		bUseTimeSynchronization = false;
+		bEncodeTimecodeInTexel = false;
+	}
+	return true;
+}
+
 /*
  * IMediaOptions interface
  */
@@ -33,6 +170,9 @@ bool UBlackmagicMediaSource::GetMediaOption(const FName& Key, bool DefaultValue)
 	if (Key == BlackmagicMediaOption::LogDropFrame) { return bLogDropFrame; }
 	if (Key == BlackmagicMediaOption::EncodeTimecodeInTexel) { return bEncodeTimecodeInTexel; }
 	if (Key == BlackmagicMediaOption::SRGBInput) { return bIsSRGBInput; }
+	if (Key == BlackmagicMediaOption::ExportToSharedMemory) { return bExportToSharedMemory; }
+	if (Key == BlackmagicMediaOption::GenerateProxies) { return bGenerateProxies; }
+	if (Key == BlackmagicMediaOption::CaptureRegionOfInterest) { return bCaptureRegionOfInterest; }
 
 	return Super::GetMediaOption(Key, DefaultValue);
 }
@@ -49,8 +189,16 @@ int64 UBlackmagicMediaSource::GetMediaOption(const FName& Key, int64 DefaultValu
 	if (Key == BlackmagicMediaOption::AudioChannelOption) { return (int64)AudioChannels; }
 	if (Key == BlackmagicMediaOption::MaxAudioFrameBuffer) { return MaxNumAudioFrameBuffer; }
 	if (Key == BlackmagicMediaOption::BlackmagicVideoFormat) { return MediaConfiguration.MediaMode.DeviceModeIdentifier; }
+	if (Key == BlackmagicMediaOption::VideoStandard) { return (int64)MediaConfiguration.MediaMode.Standard; }
 	if (Key == BlackmagicMediaOption::ColorFormat) { return (int64)ColorFormat; }
 	if (Key == BlackmagicMediaOption::MaxVideoFrameBuffer) { return MaxNumVideoFrameBuffer; }
+	if (Key == BlackmagicMediaOption::SharedMemoryNumSlots) { return SharedMemoryNumSlots; }
+	if (Key == BlackmagicMediaOption::ProxyFrameDivider) { return ProxyFrameDivider; }
+	if (Key == BlackmagicMediaOption::RegionOfInterestX) { return RegionOfInterestPosition.X; }
+	if (Key == BlackmagicMediaOption::RegionOfInterestY) { return RegionOfInterestPosition.Y; }
+	if (Key == BlackmagicMediaOption::RegionOfInterestWidth) { return RegionOfInterestSize.X; }
+	if (Key == BlackmagicMediaOption::RegionOfInterestHeight) { return RegionOfInterestSize.Y; }
+	if (Key == BlackmagicMediaOption::DuplicateFrameDetection) { return (int64)DuplicateFrameDetection; }
 
 	return Super::GetMediaOption(Key, DefaultValue);
 }
@@ -61,16 +209,41 @@ FString UBlackmagicMediaSource::GetMediaOption(const FName& Key, const FString&
 	{
 		return MediaConfiguration.MediaMode.GetModeName().ToString();
 	}
+	if (Key == BlackmagicMediaOption::SharedMemoryName)
+	{
+		return SharedMemoryName;
+	}
+	if (Key == BlackmagicMediaOption::SettingsType)
+	{
+		return FBlackmagicMediaSourceSettings::TypeName;
+	}
+	return Super::GetMediaOption(Key, DefaultValue);
+}
+
+TSharedPtr<IMediaOptions::FDataContainer, ESPMode::ThreadSafe> UBlackmagicMediaSource::GetMediaOption(const FName& Key, const TSharedPtr<IMediaOptions::FDataContainer, ESPMode::ThreadSafe>& DefaultValue) const
+{
+	if (Key == BlackmagicMediaOption::Settings)
+	{
+		return GetSettings();
+	}
 	return Super::GetMediaOption(Key, DefaultValue);
 }
 
 bool UBlackmagicMediaSource::HasMediaOption(const FName& Key) const
 {
+	if (Key == BlackmagicMediaOption::Settings || Key == BlackmagicMediaOption::SettingsType)
+	{
+		return true;
+	}
+
 	if (   Key == BlackmagicMediaOption::CaptureAudio
 		|| Key == BlackmagicMediaOption::CaptureVideo
 		|| Key == BlackmagicMediaOption::LogDropFrame
 		|| Key == BlackmagicMediaOption::EncodeTimecodeInTexel
-		|| Key == BlackmagicMediaOption::SRGBInput)
+		|| Key == BlackmagicMediaOption::SRGBInput
+		|| Key == BlackmagicMediaOption::ExportToSharedMemory
+		|| Key == BlackmagicMediaOption::GenerateProxies
+		|| Key == BlackmagicMediaOption::CaptureRegionOfInterest)
 	{
 		return true;
 	}
@@ -80,8 +253,17 @@ bool UBlackmagicMediaSource::HasMediaOption(const FName& Key) const
 		|| Key == BlackmagicMediaOption::AudioChannelOption
 		|| Key == BlackmagicMediaOption::MaxAudioFrameBuffer
 		|| Key == BlackmagicMediaOption::BlackmagicVideoFormat
+		|| Key == BlackmagicMediaOption::VideoStandard
 		|| Key == BlackmagicMediaOption::ColorFormat
-		|| Key == BlackmagicMediaOption::MaxVideoFrameBuffer)
+		|| Key == BlackmagicMediaOption::MaxVideoFrameBuffer
+		|| Key == BlackmagicMediaOption::SharedMemoryNumSlots
+		|| Key == BlackmagicMediaOption::SharedMemoryName
+		|| Key == BlackmagicMediaOption::ProxyFrameDivider
+		|| Key == BlackmagicMediaOption::RegionOfInterestX
+		|| Key == BlackmagicMediaOption::RegionOfInterestY
+		|| Key == BlackmagicMediaOption::RegionOfInterestWidth
+		|| Key == BlackmagicMediaOption::RegionOfInterestHeight
+		|| Key == BlackmagicMediaOption::DuplicateFrameDetection)
 	{
 		return true;
 	}
@@ -116,42 +298,35 @@ bool UBlackmagicMediaSource::Validate() const
 		return false;
 	}
 
-	if (!FBlackmagic::IsInitialized())
-	{
-		UE_LOG(LogBlackmagicMedia, Warning, TEXT("Can't validate MediaSource '%s'. the Blackmagic library was not initialized."), *GetName());
-		return false;
-	}
-
-	if (!FBlackmagic::CanUseBlackmagicCard())
+	// The ports of the presets were validated when the presets were loaded
+	const bool bLiveValidation = FBlackmagicMediaValidation::IsLiveValidationEnabled();
+	if (bLiveValidation || !UBlackmagicMediaPresets::IsValidatedConfiguration(MediaConfiguration))
 	{
-		UE_LOG(LogBlackmagicMedia, Warning, TEXT("Can't validate MediaSource '%s' because Blackmagic card cannot be used. Are you in a Commandlet? You may override this behavior by launching with -ForceBlackmagicUsage"), *GetName());
-		return false;
-	}
-	
-	TUniquePtr<BlackmagicDesign::BlackmagicDeviceScanner> Scanner = MakeUnique<BlackmagicDesign::BlackmagicDeviceScanner>();
-	BlackmagicDesign::BlackmagicDeviceScanner::DeviceInfo DeviceInfo;
-	if (!Scanner->GetDeviceInfo(MediaConfiguration.MediaConnection.Device.DeviceIdentifier, DeviceInfo))
-	{
-		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The MediaSource '%s' use the device '%s' that doesn't exist on this machine."), *GetName(), *MediaConfiguration.MediaConnection.Device.DeviceName.ToString());
-		return false;
-	}
-
-	if (!DeviceInfo.bIsSupported)
-	{
-		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The MediaSource '%s' use the device '%s' that is not supported by the Blackmagic SDK."), *GetName(), *MediaConfiguration.MediaConnection.Device.DeviceName.ToString());
-		return false;
+		const bool bIsValid = bLiveValidation
+			? FBlackmagicMediaValidation::ValidateInputLive(MediaConfiguration, GetName(), FailureReason)
+			: FBlackmagicMediaValidation::ValidateInput(MediaConfiguration, GetName(), FailureReason);
+		if (!bIsValid)
+		{
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("%s"), *FailureReason);
+			return false;
+		}
 	}
 
-	if (!DeviceInfo.bCanDoCapture)
+	if (bUseTimeSynchronization && TimecodeFormat == EMediaIOTimecodeFormat::None)
 	{
-		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The MediaSource '%s' use the device '%s' that can't capture."), *GetName(), *MediaConfiguration.MediaConnection.Device.DeviceName.ToString());
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The MediaSource '%s' use time synchronization but doesn't enabled the timecode."), *GetName());
 		return false;
 	}
 
-	if (bUseTimeSynchronization && TimecodeFormat == EMediaIOTimecodeFormat::None)
+	if (bCaptureVideo && bCaptureRegionOfInterest)
 	{
-		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The MediaSource '%s' use time synchronization but doesn't enabled the timecode."), *GetName());
-		return false;
+		const FIntPoint& Resolution = MediaConfiguration.MediaMode.Resolution;
+		if (RegionOfInterestSize.X <= 0 || RegionOfInterestSize.Y <= 0 || RegionOfInterestPosition.X < 0 || RegionOfInterestPosition.Y < 0
+			|| RegionOfInterestPosition.X >= Resolution.X || RegionOfInterestPosition.Y >= Resolution.Y)
+		{
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("The MediaSource '%s' captures a region of interest that is outside of the %dx%d input."), *GetName(), Resolution.X, Resolution.Y);
+			return false;
+		}
 	}
 
 	return true;
@@ -190,5 +365,7 @@ void UBlackmagicMediaSource::PostEditChangeChainProperty(struct FPropertyChanged
 	}
 
 	Super::PostEditChangeChainProperty(InPropertyChangedEvent);
+
+	ApplyToRunningPlayers();
 }
 #endif //WITH_EDITOR
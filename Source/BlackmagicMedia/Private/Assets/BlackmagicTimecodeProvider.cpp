@@ -1,6 +1,7 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "BlackmagicTimecodeProvider.h"
+#include "BlackmagicMediaBroker.h"
 #include "BlackmagicMediaPrivate.h"
 #include "Blackmagic.h"
 
@@ -32,7 +33,7 @@ namespace BlackmagicTimecodeProviderHelpers
 			AddRef();
 
 			BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> SelfRef(this);
-			BlackmagicIdendifier = BlackmagicDesign::RegisterCallbackForChannel(ChannelInfo, InChannelInfo, SelfRef);
+			BlackmagicIdendifier = BlackmagicMediaBackend::RegisterCallbackForChannel(ChannelInfo, InChannelInfo, SelfRef);
 			State = BlackmagicIdendifier.IsValid() ? ETimecodeProviderSynchronizationState::Synchronizing : ETimecodeProviderSynchronizationState::Error;
 			return BlackmagicIdendifier.IsValid();
 		}
@@ -41,7 +42,7 @@ namespace BlackmagicTimecodeProviderHelpers
 		{
 			if (BlackmagicIdendifier.IsValid())
 			{
-				BlackmagicDesign::UnregisterCallbackForChannel(ChannelInfo, BlackmagicIdendifier);
+				BlackmagicMediaBackend::UnregisterCallbackForChannel(ChannelInfo, BlackmagicIdendifier);
 				BlackmagicIdendifier = BlackmagicDesign::FUniqueIdentifier();
 			}
 
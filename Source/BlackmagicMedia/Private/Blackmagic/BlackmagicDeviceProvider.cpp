@@ -7,6 +7,16 @@
 #include "BlackmagicMediaPrivate.h"
 #include "MediaIOCoreCommonDisplayMode.h"
 
+#include "Async/Async.h"
+#include "CoreGlobals.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Templates/Atomic.h"
+
 #define LOCTEXT_NAMESPACE "BlackmagicDeviceProvider"
 
 
@@ -68,6 +78,338 @@ namespace BlackmagicDeviceProvider
 		}
 		return true;
 	}
+
+	void ScanModes(int32 InDeviceIndex, bool bInOutput, TArray<FBlackmagicDeviceMode>& OutModes)
+	{
+		BlackmagicDesign::BlackmagicVideoFormats FrameFormats(InDeviceIndex, bInOutput);
+		const int32 NumSupportedFormat = FrameFormats.GetNumSupportedFormat();
+		OutModes.Reserve(NumSupportedFormat);
+		for (int32 Index = 0; Index < NumSupportedFormat; ++Index)
+		{
+			BlackmagicDesign::BlackmagicVideoFormats::VideoFormatDescriptor Descriptor = FrameFormats.GetSupportedFormat(Index);
+			if (!IsVideoFormatValid(Descriptor))
+			{
+				continue;
+			}
+
+			FBlackmagicDeviceMode& DeviceMode = OutModes.AddDefaulted_GetRef();
+			DeviceMode.Mode = ToMediaMode(Descriptor);
+			DeviceMode.bIs2K = Descriptor.bIs2K;
+			DeviceMode.bIs4K = Descriptor.bIs4K;
+		}
+	}
+
+	bool ScanDevice(const BlackmagicDesign::BlackmagicDeviceScanner& InDeviceScanner, int32 InDeviceIndex, FBlackmagicDeviceCapabilities& OutCapabilities)
+	{
+		BlackmagicDesign::BlackmagicDeviceScanner::DeviceInfo DeviceInfo;
+		if (!InDeviceScanner.GetDeviceInfo(InDeviceIndex, DeviceInfo))
+		{
+			return false;
+		}
+
+		BlackmagicDesign::BlackmagicDeviceScanner::FormatedTextType DeviceNameBuffer;
+		if (!InDeviceScanner.GetDeviceTextId(InDeviceIndex, DeviceNameBuffer))
+		{
+			return false;
+		}
+
+		OutCapabilities = FBlackmagicDeviceCapabilities();
+		OutCapabilities.Device.DeviceIdentifier = InDeviceIndex;
+		OutCapabilities.Device.DeviceName = FName(DeviceNameBuffer);
+		OutCapabilities.bIsSupported = DeviceInfo.bIsSupported;
+		OutCapabilities.bCanDoCapture = DeviceInfo.bCanDoCapture;
+		OutCapabilities.bCanDoPlayback = DeviceInfo.bCanDoPlayback;
+		OutCapabilities.bCanDoDualLink = DeviceInfo.bCanDoDualLink;
+		OutCapabilities.bCanDoQuadLink = DeviceInfo.bCanDoQuadLink;
+		OutCapabilities.bCanDoQuadSquareLink = DeviceInfo.bCanDoQuadSquareLink;
+		OutCapabilities.bHasGenlockReferenceInput = DeviceInfo.bHasGenlockReferenceInput;
+		OutCapabilities.bSupportExternalKeying = DeviceInfo.bSupportExternalKeying;
+		OutCapabilities.NumberOfSubDevices = FMath::Max<int32>(DeviceInfo.NumberOfSubDevices, 1);
+		OutCapabilities.SubDeviceIndex = DeviceInfo.SubDeviceIndex;
+		OutCapabilities.DeviceGroupId = DeviceInfo.DeviceGroupId;
+
+		if (DeviceInfo.bIsSupported)
+		{
+			if (DeviceInfo.bCanDoCapture)
+			{
+				ScanModes(InDeviceIndex, false, OutCapabilities.InputModes);
+			}
+			if (DeviceInfo.bCanDoPlayback)
+			{
+				ScanModes(InDeviceIndex, true, OutCapabilities.OutputModes);
+			}
+		}
+
+		return true;
+	}
+
+	/** Everything the provider tells about the hardware, queried at once. Null when the library can't be used. */
+	TSharedPtr<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe> ScanDevices()
+	{
+		if (!FBlackmagic::IsInitialized() || !FBlackmagic::CanUseBlackmagicCard())
+		{
+			return nullptr;
+		}
+
+		TSharedRef<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe> Devices = MakeShared<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe>();
+
+		BlackmagicDesign::BlackmagicDeviceScanner DeviceScanner;
+		const int32 NumDevices = DeviceScanner.GetNumDevices();
+		for (int32 DeviceIndex = 1; DeviceIndex <= NumDevices; ++DeviceIndex)
+		{
+			FBlackmagicDeviceCapabilities Capabilities;
+			if (ScanDevice(DeviceScanner, DeviceIndex, Capabilities))
+			{
+				Devices->Add(MoveTemp(Capabilities));
+			}
+		}
+
+		return Devices;
+	}
+
+	/**
+	 * The last scan is saved, so the sources and outputs can be validated without a card or a driver.
+	 * The file can be copied from a machine with the devices to the machines that only validate.
+	 */
+	static const int32 SavedDevicesVersion = 1;
+
+	FString GetSavedDevicesFilename()
+	{
+		return FPaths::ProjectSavedDir() / TEXT("Blackmagic") / TEXT("DeviceCapabilities.bin");
+	}
+
+	void Serialize(FArchive& Ar, FMediaIOMode& InOutMode)
+	{
+		uint8 Standard = (uint8)InOutMode.Standard;
+		Ar << InOutMode.Resolution << Standard << InOutMode.FrameRate.Numerator << InOutMode.FrameRate.Denominator << InOutMode.DeviceModeIdentifier;
+		InOutMode.Standard = (EMediaIOStandardType)Standard;
+	}
+
+	void Serialize(FArchive& Ar, FBlackmagicDeviceCapabilities& InOutCapabilities)
+	{
+		Ar << InOutCapabilities.Device.DeviceName << InOutCapabilities.Device.DeviceIdentifier;
+		Ar << InOutCapabilities.bIsSupported << InOutCapabilities.bCanDoCapture << InOutCapabilities.bCanDoPlayback;
+		Ar << InOutCapabilities.bCanDoDualLink << InOutCapabilities.bCanDoQuadLink << InOutCapabilities.bCanDoQuadSquareLink;
+		Ar << InOutCapabilities.bHasGenlockReferenceInput << InOutCapabilities.bSupportExternalKeying;
+		Ar << InOutCapabilities.NumberOfSubDevices << InOutCapabilities.SubDeviceIndex << InOutCapabilities.DeviceGroupId;
+
+		for (TArray<FBlackmagicDeviceMode>* Modes : { &InOutCapabilities.InputModes, &InOutCapabilities.OutputModes })
+		{
+			int32 NumModes = Modes->Num();
+			Ar << NumModes;
+			if (Ar.IsLoading())
+			{
+				if (NumModes < 0 || NumModes > 1024)
+				{
+					Ar.SetError();
+					return;
+				}
+				Modes->SetNum(NumModes);
+			}
+
+			for (FBlackmagicDeviceMode& Mode : *Modes)
+			{
+				Serialize(Ar, Mode.Mode);
+				Ar << Mode.bIs2K << Mode.bIs4K;
+			}
+		}
+	}
+
+	void SaveDevices(const TArray<FBlackmagicDeviceCapabilities>& InDevices)
+	{
+		TArray<uint8> Buffer;
+		FMemoryWriter Writer(Buffer);
+		int32 Version = SavedDevicesVersion;
+		int32 NumDevices = InDevices.Num();
+		Writer << Version << NumDevices;
+		for (FBlackmagicDeviceCapabilities Capabilities : InDevices)
+		{
+			Serialize(Writer, Capabilities);
+		}
+
+		if (!FFileHelper::SaveArrayToFile(Buffer, *GetSavedDevicesFilename()))
+		{
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("The Blackmagic devices could not be saved to '%s'."), *GetSavedDevicesFilename());
+		}
+	}
+
+	TSharedRef<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe> LoadDevices()
+	{
+		TSharedRef<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe> Devices = MakeShared<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe>();
+
+		TArray<uint8> Buffer;
+		if (!FFileHelper::LoadFileToArray(Buffer, *GetSavedDevicesFilename(), FILEREAD_Silent))
+		{
+			return Devices;
+		}
+
+		FMemoryReader Reader(Buffer);
+		int32 Version = 0;
+		int32 NumDevices = 0;
+		Reader << Version << NumDevices;
+		if (Reader.IsError() || Version != SavedDevicesVersion || NumDevices < 0 || NumDevices > 256)
+		{
+			return Devices;
+		}
+
+		Devices->SetNum(NumDevices);
+		for (FBlackmagicDeviceCapabilities& Capabilities : *Devices)
+		{
+			Serialize(Reader, Capabilities);
+		}
+
+		if (Reader.IsError())
+		{
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("The saved Blackmagic devices '%s' are corrupted."), *GetSavedDevicesFilename());
+			Devices->Reset();
+		}
+		return Devices;
+	}
+
+	/** Devices plugged after the module started are listed once asked, the lists never scan by themselves */
+	static FAutoConsoleCommand ScanDevicesCommand(
+		TEXT("Blackmagic.ScanDevices"),
+		TEXT("Scan the Blackmagic devices again, in the background."),
+		FConsoleCommandDelegate::CreateStatic(&FBlackmagicDeviceProvider::RequestScan));
+
+	/** Result of the last scan, or of the saved one when the library can't be used */
+	static FCriticalSection CacheLock;
+	static TSharedPtr<const TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe> CachedDevices;
+
+	/** The running scan and the load of the saved one. Only those tasks write the cache, they never wait for ScanLock. */
+	static FCriticalSection ScanLock;
+	static TFuture<void> ScanResult;
+	static TFuture<void> LoadResult;
+	static TAtomic<bool> bIsScanning(false);
+	static TAtomic<bool> bHasScanned(false);
+
+	const FBlackmagicDeviceCapabilities* FindDevice(const TArray<FBlackmagicDeviceCapabilities>& InDevices, int32 InDeviceIdentifier)
+	{
+		return InDevices.FindByPredicate([InDeviceIdentifier](const FBlackmagicDeviceCapabilities& Capabilities) { return Capabilities.Device.DeviceIdentifier == InDeviceIdentifier; });
+	}
+}
+
+
+FBlackmagicDeviceCapabilitiesListRef FBlackmagicDeviceProvider::GetCachedDevices()
+{
+	using namespace BlackmagicDeviceProvider;
+
+	static const FBlackmagicDeviceCapabilitiesListRef NoDevices = MakeShared<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe>();
+
+	FScopeLock Lock(&CacheLock);
+	return CachedDevices.IsValid() ? CachedDevices.ToSharedRef() : NoDevices;
+}
+
+
+bool FBlackmagicDeviceProvider::FindCachedDevice(int32 InDeviceIdentifier, FBlackmagicDeviceCapabilities& OutCapabilities)
+{
+	FBlackmagicDeviceCapabilitiesListRef Devices = GetCachedDevices();
+	const FBlackmagicDeviceCapabilities* Capabilities = BlackmagicDeviceProvider::FindDevice(*Devices, InDeviceIdentifier);
+	if (Capabilities == nullptr)
+	{
+		return false;
+	}
+
+	OutCapabilities = *Capabilities;
+	return true;
+}
+
+
+bool FBlackmagicDeviceProvider::ScanDevice(int32 InDeviceIdentifier, FBlackmagicDeviceCapabilities& OutCapabilities)
+{
+	if (!FBlackmagic::IsInitialized() || !FBlackmagic::CanUseBlackmagicCard())
+	{
+		return false;
+	}
+
+	BlackmagicDesign::BlackmagicDeviceScanner DeviceScanner;
+	return BlackmagicDeviceProvider::ScanDevice(DeviceScanner, InDeviceIdentifier, OutCapabilities);
+}
+
+
+void FBlackmagicDeviceProvider::RequestScan()
+{
+	using namespace BlackmagicDeviceProvider;
+
+	bool bExpected = false;
+	if (!bIsScanning.CompareExchange(bExpected, true))
+	{
+		return;
+	}
+
+	FScopeLock Lock(&ScanLock);
+	if (!LoadResult.IsValid())
+	{
+		// Until the first scan, and without a card or a driver. Loaded in the background, a scan that completes first is kept.
+		LoadResult = Async(EAsyncExecution::ThreadPool, []()
+		{
+			TSharedRef<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe> Devices = LoadDevices();
+
+			FScopeLock Lock(&CacheLock);
+			if (!CachedDevices.IsValid())
+			{
+				CachedDevices = Devices;
+			}
+		});
+	}
+
+	ScanResult = Async(EAsyncExecution::ThreadPool, []()
+	{
+		TSharedPtr<TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe> Devices = ScanDevices();
+		if (Devices.IsValid())
+		{
+			SaveDevices(*Devices);
+
+			FScopeLock Lock(&CacheLock);
+			CachedDevices = Devices;
+		}
+		bHasScanned = true;
+		bIsScanning = false;
+	});
+}
+
+
+void FBlackmagicDeviceProvider::WaitForScan()
+{
+	FScopeLock Lock(&BlackmagicDeviceProvider::ScanLock);
+	if (BlackmagicDeviceProvider::LoadResult.IsValid())
+	{
+		BlackmagicDeviceProvider::LoadResult.Wait();
+	}
+	if (BlackmagicDeviceProvider::ScanResult.IsValid())
+	{
+		BlackmagicDeviceProvider::ScanResult.Wait();
+	}
+}
+
+
+void FBlackmagicDeviceProvider::WaitForDevices()
+{
+	using namespace BlackmagicDeviceProvider;
+
+	FScopeLock Lock(&ScanLock);
+	if (LoadResult.IsValid())
+	{
+		LoadResult.Wait();
+	}
+
+	// A game validates its outputs as soon as it starts, against the devices of this machine
+	if (!GIsEditor && !bHasScanned && ScanResult.IsValid())
+	{
+		ScanResult.Wait();
+	}
+}
+
+
+bool FBlackmagicDeviceProvider::IsScanning()
+{
+	return BlackmagicDeviceProvider::bIsScanning;
+}
+
+
+bool FBlackmagicDeviceProvider::HasScanned()
+{
+	return BlackmagicDeviceProvider::bHasScanned;
 }
 
 
@@ -103,106 +445,82 @@ TArray<FMediaIOConfiguration> FBlackmagicDeviceProvider::GetConfigurations() con
 
 TArray<FMediaIOConfiguration> FBlackmagicDeviceProvider::GetConfigurations(bool bAllowInput, bool bAllowOutput) const
 {
-	const int32 MaxNumberOfChannel = 8;
-
 	TArray<FMediaIOConfiguration> Results;
-	if (!FBlackmagic::IsInitialized() || !FBlackmagic::CanUseBlackmagicCard())
-	{
-		return Results;
-	}
 
-	BlackmagicDesign::BlackmagicDeviceScanner DeviceScanner;
-	int32 NumDevices = DeviceScanner.GetNumDevices();
-	for (int32 DeviceIndex = 1; DeviceIndex <= NumDevices; ++DeviceIndex)
+	FBlackmagicDeviceCapabilitiesListRef Devices = GetCachedDevices();
+	for (const FBlackmagicDeviceCapabilities& Capabilities : *Devices)
 	{
-		BlackmagicDesign::BlackmagicDeviceScanner::FormatedTextType DeviceNameBuffer;
-		if (DeviceScanner.GetDeviceTextId(DeviceIndex, DeviceNameBuffer))
+		if (!Capabilities.bIsSupported)
 		{
-			BlackmagicDesign::BlackmagicDeviceScanner::DeviceInfo DeviceInfo;
-			if (DeviceScanner.GetDeviceInfo(DeviceIndex, DeviceInfo))
-			{
-				if (!DeviceInfo.bIsSupported)
-				{
-					continue;
-				}
+			continue;
+		}
 
-				if (bAllowInput && !DeviceInfo.bCanDoCapture)
-				{
-					continue;
-				}
+		if (bAllowInput && !Capabilities.bCanDoCapture)
+		{
+			continue;
+		}
 
-				if (bAllowOutput && !DeviceInfo.bCanDoPlayback)
-				{
-					continue;
-				}
+		if (bAllowOutput && !Capabilities.bCanDoPlayback)
+		{
+			continue;
+		}
 
-				FMediaIOConfiguration MediaConfiguration;
-				MediaConfiguration.MediaConnection.Device.DeviceIdentifier = DeviceIndex;
-				MediaConfiguration.MediaConnection.Device.DeviceName = FName(DeviceNameBuffer);
-				MediaConfiguration.MediaConnection.Protocol = FBlackmagicDeviceProvider::GetProtocolName();
-				MediaConfiguration.MediaConnection.PortIdentifier = 0;
+		FMediaIOConfiguration MediaConfiguration;
+		MediaConfiguration.MediaConnection.Device = Capabilities.Device;
+		MediaConfiguration.MediaConnection.Protocol = FBlackmagicDeviceProvider::GetProtocolName();
+		MediaConfiguration.MediaConnection.PortIdentifier = 0;
 
-				auto BuildList = [&](bool bIsInput)
-				{
-					MediaConfiguration.bIsInput = bIsInput;
+		auto BuildList = [&](bool bIsInput)
+		{
+			MediaConfiguration.bIsInput = bIsInput;
+
+			for (const FBlackmagicDeviceMode& DeviceMode : bIsInput ? Capabilities.InputModes : Capabilities.OutputModes)
+			{
+				MediaConfiguration.MediaMode = DeviceMode.Mode;
 
-					BlackmagicDesign::BlackmagicVideoFormats FrameFormats(DeviceIndex, !bIsInput);
-					const int32 NumSupportedFormat = FrameFormats.GetNumSupportedFormat();
-					for (int32 FormatIndex = 0; FormatIndex < NumSupportedFormat; ++FormatIndex)
+				MediaConfiguration.MediaConnection.TransportType = EMediaIOTransportType::SingleLink;
+				MediaConfiguration.MediaConnection.QuadTransportType = EMediaIOQuadLinkTransportType::TwoSampleInterleave;
+				Results.Add(MediaConfiguration);
+
+				// The SDK doesn't say so but all devices that can do Dual|QuadLink can do SingleLink 12G.
+				//The card auto detect it in input. We need to tell it in output.
+				if (!MediaConfiguration.bIsInput)
+				{
+					if (DeviceMode.bIs2K)
 					{
-						BlackmagicDesign::BlackmagicVideoFormats::VideoFormatDescriptor Descriptor = FrameFormats.GetSupportedFormat(FormatIndex);
-						if (!BlackmagicDeviceProvider::IsVideoFormatValid(Descriptor))
+						if (Capabilities.bCanDoDualLink)
 						{
-							continue;
+							MediaConfiguration.MediaConnection.TransportType = EMediaIOTransportType::DualLink;
+							Results.Add(MediaConfiguration);
 						}
-
-						MediaConfiguration.MediaMode = BlackmagicDeviceProvider::ToMediaMode(Descriptor);
-
-						MediaConfiguration.MediaConnection.TransportType = EMediaIOTransportType::SingleLink;
-						MediaConfiguration.MediaConnection.QuadTransportType = EMediaIOQuadLinkTransportType::TwoSampleInterleave;
-						Results.Add(MediaConfiguration);
-
-						// The SDK doesn't say so but all devices that can do Dual|QuadLink can do SingleLink 12G.
-						//The card auto detect it in input. We need to tell it in output.
-						if (!MediaConfiguration.bIsInput)
+					}
+					else if (DeviceMode.bIs4K)
+					{
+						if (Capabilities.bCanDoQuadLink)
 						{
-							if (Descriptor.bIs2K)
-							{
-								if (DeviceInfo.bCanDoDualLink)
-								{
-									MediaConfiguration.MediaConnection.TransportType = EMediaIOTransportType::DualLink;
-									Results.Add(MediaConfiguration);
-								}
-							}
-							else if (Descriptor.bIs4K)
+							MediaConfiguration.MediaConnection.TransportType = EMediaIOTransportType::QuadLink;
+							MediaConfiguration.MediaConnection.QuadTransportType = EMediaIOQuadLinkTransportType::TwoSampleInterleave;
+							Results.Add(MediaConfiguration);
+
+							if (Capabilities.bCanDoQuadSquareLink)
 							{
-								if (DeviceInfo.bCanDoQuadLink)
-								{
-									MediaConfiguration.MediaConnection.TransportType = EMediaIOTransportType::QuadLink;
-									MediaConfiguration.MediaConnection.QuadTransportType = EMediaIOQuadLinkTransportType::TwoSampleInterleave;
-									Results.Add(MediaConfiguration);
-
-									if (DeviceInfo.bCanDoQuadSquareLink)
-									{
-										MediaConfiguration.MediaConnection.QuadTransportType = EMediaIOQuadLinkTransportType::SquareDivision;
-										Results.Add(MediaConfiguration);
-									}
-								}
+								MediaConfiguration.MediaConnection.QuadTransportType = EMediaIOQuadLinkTransportType::SquareDivision;
+								Results.Add(MediaConfiguration);
 							}
 						}
 					}
-				};
-
-				if (bAllowInput)
-				{
-					BuildList(true);
-				}
-
-				if (bAllowOutput)
-				{
-					BuildList(false);
 				}
 			}
+		};
+
+		if (bAllowInput)
+		{
+			BuildList(true);
+		}
+
+		if (bAllowOutput)
+		{
+			BuildList(false);
 		}
 	}
 
@@ -221,11 +539,10 @@ TArray<FMediaIOOutputConfiguration> FBlackmagicDeviceProvider::GetOutputConfigur
 	TArray<FMediaIOOutputConfiguration> Results;
 
 	TArray<FMediaIOConfiguration> OutputConfigurations = GetConfigurations(false, true);
-	TArray<FMediaIOConnection> OtherConnections = GetConnections();
+	FBlackmagicDeviceCapabilitiesListRef Devices = GetCachedDevices();
 
 	Results.Reset(OutputConfigurations.Num() * 4);
 
-	BlackmagicDesign::BlackmagicDeviceScanner DeviceScanner;
 	int32 LastDeviceIdentifier = INDEX_NONE;
 	bool bCanDoKeyAndFill = false;
 	bool bCanDoExternal = false;
@@ -251,14 +568,14 @@ TArray<FMediaIOOutputConfiguration> FBlackmagicDeviceProvider::GetOutputConfigur
 		// Update the Device Info
 		if (OutputConfiguration.MediaConnection.Device.DeviceIdentifier != LastDeviceIdentifier)
 		{
-			BlackmagicDesign::BlackmagicDeviceScanner::DeviceInfo DeviceInfo;
-			if (!DeviceScanner.GetDeviceInfo(OutputConfiguration.MediaConnection.Device.DeviceIdentifier, DeviceInfo))
+			const FBlackmagicDeviceCapabilities* Capabilities = BlackmagicDeviceProvider::FindDevice(*Devices, OutputConfiguration.MediaConnection.Device.DeviceIdentifier);
+			if (Capabilities == nullptr)
 			{
 				continue;
 			}
 
-			bCanDoKeyAndFill = DeviceInfo.bSupportExternalKeying;
-			bCanDoExternal = DeviceInfo.bHasGenlockReferenceInput;
+			bCanDoKeyAndFill = Capabilities->bSupportExternalKeying;
+			bCanDoExternal = Capabilities->bHasGenlockReferenceInput;
 			LastDeviceIdentifier = OutputConfiguration.MediaConnection.Device.DeviceIdentifier;
 		}
 
@@ -281,36 +598,14 @@ TArray<FMediaIOOutputConfiguration> FBlackmagicDeviceProvider::GetOutputConfigur
 TArray<FMediaIODevice> FBlackmagicDeviceProvider::GetDevices() const
 {
 	TArray<FMediaIODevice> Results;
-	if (!FBlackmagic::IsInitialized() || !FBlackmagic::CanUseBlackmagicCard())
-	{
-		return Results;
-	}
 
-	BlackmagicDesign::BlackmagicDeviceScanner DeviceScanner;
-	int32 NumDevices = DeviceScanner.GetNumDevices();
-	for (int32 DeviceIndex = 1; DeviceIndex <= NumDevices; ++DeviceIndex)
+	FBlackmagicDeviceCapabilitiesListRef Devices = GetCachedDevices();
+	for (const FBlackmagicDeviceCapabilities& Capabilities : *Devices)
 	{
-		BlackmagicDesign::BlackmagicDeviceScanner::DeviceInfo DeviceInfo;
-		if (!DeviceScanner.GetDeviceInfo(DeviceIndex, DeviceInfo))
+		if (Capabilities.bIsSupported)
 		{
-			continue;
+			Results.Add(Capabilities.Device);
 		}
-
-		if (!DeviceInfo.bIsSupported)
-		{
-			continue;
-		}
-
-		TCHAR DeviceNameBuffer[BlackmagicDesign::BlackmagicDeviceScanner::FormatedTextSize];
-		if (!DeviceScanner.GetDeviceTextId(DeviceIndex, DeviceNameBuffer))
-		{
-			continue;
-		}
-
-		FMediaIODevice Device;
-		Device.DeviceIdentifier = DeviceIndex;
-		Device.DeviceName = DeviceNameBuffer;
-		Results.Add(Device);
 	}
 
 	return MoveTemp(Results);
@@ -320,39 +615,23 @@ TArray<FMediaIODevice> FBlackmagicDeviceProvider::GetDevices() const
 TArray<FMediaIOMode> FBlackmagicDeviceProvider::GetModes(const FMediaIODevice& InDevice, bool bInOutput) const
 {
 	TArray<FMediaIOMode> Results;
-	if (!FBlackmagic::IsInitialized() || !InDevice.IsValid() || !FBlackmagic::CanUseBlackmagicCard())
-	{
-		return Results;
-	}
-
-	BlackmagicDesign::BlackmagicDeviceScanner DeviceScanner;
-	BlackmagicDesign::BlackmagicDeviceScanner::DeviceInfo DeviceInfo;
-	if (!DeviceScanner.GetDeviceInfo(InDevice.DeviceIdentifier, DeviceInfo))
+	if (!InDevice.IsValid())
 	{
 		return Results;
 	}
 
-	if (!DeviceInfo.bIsSupported)
+	FBlackmagicDeviceCapabilitiesListRef Devices = GetCachedDevices();
+	const FBlackmagicDeviceCapabilities* Capabilities = BlackmagicDeviceProvider::FindDevice(*Devices, InDevice.DeviceIdentifier);
+	if (Capabilities == nullptr)
 	{
 		return Results;
 	}
 
-	if (bInOutput && !DeviceInfo.bCanDoPlayback || !bInOutput && !DeviceInfo.bCanDoCapture)
+	const TArray<FBlackmagicDeviceMode>& DeviceModes = bInOutput ? Capabilities->OutputModes : Capabilities->InputModes;
+	Results.Reserve(DeviceModes.Num());
+	for (const FBlackmagicDeviceMode& DeviceMode : DeviceModes)
 	{
-		return Results;
-	}
-
-	BlackmagicDesign::BlackmagicVideoFormats FrameFormats(InDevice.DeviceIdentifier, bInOutput);
-	const int32 NumSupportedFormat = FrameFormats.GetNumSupportedFormat();
-	Results.Reserve(NumSupportedFormat);
-	for (int32 Index = 0; Index < NumSupportedFormat; ++Index)
-	{
-		BlackmagicDesign::BlackmagicVideoFormats::VideoFormatDescriptor Descriptor = FrameFormats.GetSupportedFormat(Index);
-		if (!BlackmagicDeviceProvider::IsVideoFormatValid(Descriptor))
-		{
-			continue;
-		}
-		Results.Add(BlackmagicDeviceProvider::ToMediaMode(Descriptor));
+		Results.Add(DeviceMode.Mode);
 	}
 
 	return Results;
@@ -0,0 +1,84 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaChannelTasks.h"
+
+#include "Async/Async.h"
+#include "Containers/Queue.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace BlackmagicMediaChannelTasksHelpers
+{
+	struct FPendingTask
+	{
+		TUniqueFunction<void()> Task;
+		TPromise<void> Promise;
+	};
+
+	FCriticalSection TasksLock;
+
+	/** Tasks that wait for the drain task, protected by TasksLock */
+	TQueue<FPendingTask> PendingTasks;
+
+	/** A single task of the thread pool runs the pending tasks, the others don't hold a worker while they wait */
+	bool bIsDraining = false;
+
+	/** Completion of the last enqueued task */
+	TSharedFuture<void> LastTask;
+
+	void Drain()
+	{
+		for (;;)
+		{
+			FPendingTask PendingTask;
+			{
+				FScopeLock Lock(&TasksLock);
+				if (!PendingTasks.Dequeue(PendingTask))
+				{
+					bIsDraining = false;
+					return;
+				}
+			}
+
+			PendingTask.Task();
+			PendingTask.Promise.SetValue();
+		}
+	}
+}
+
+TSharedFuture<void> FBlackmagicMediaChannelTasks::Enqueue(TUniqueFunction<void()> InTask)
+{
+	using namespace BlackmagicMediaChannelTasksHelpers;
+
+	FScopeLock Lock(&TasksLock);
+
+	FPendingTask PendingTask;
+	PendingTask.Task = MoveTemp(InTask);
+	LastTask = PendingTask.Promise.GetFuture().Share();
+	PendingTasks.Enqueue(MoveTemp(PendingTask));
+
+	if (!bIsDraining)
+	{
+		bIsDraining = true;
+		Async<void>(EAsyncExecution::ThreadPool, &Drain);
+	}
+
+	return LastTask;
+}
+
+void FBlackmagicMediaChannelTasks::Flush()
+{
+	using namespace BlackmagicMediaChannelTasksHelpers;
+
+	TSharedFuture<void> LastEnqueuedTask;
+	{
+		FScopeLock Lock(&TasksLock);
+		LastEnqueuedTask = LastTask;
+	}
+
+	if (LastEnqueuedTask.IsValid())
+	{
+		LastEnqueuedTask.Wait();
+	}
+}
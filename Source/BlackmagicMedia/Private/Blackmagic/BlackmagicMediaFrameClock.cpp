@@ -0,0 +1,126 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaFrameClock.h"
+
+
+namespace BlackmagicMediaFrameClockHelpers
+{
+	/** Frames needed before the slope is measured instead of using the nominal frame interval */
+	static const int32 MinNumPointsForSlope = 16;
+
+	/** Drift accepted between the device and host clocks. Crystals are in the tens of ppm, more is a wrong fit. */
+	static const double MaxDrift = 0.001;
+
+	/** Difference between the elapsed time and the elapsed frames, in frames, that restarts the estimation */
+	static const double MaxGapError = 2.0;
+
+	/** Weight of a new frame in the average delay */
+	static const double DelaySmoothing = 0.05;
+}
+
+FBlackmagicMediaFrameClock::FBlackmagicMediaFrameClock()
+{
+	Reset(1.0 / 30.0);
+}
+
+void FBlackmagicMediaFrameClock::Reset(double InFrameInterval)
+{
+	FrameInterval = InFrameInterval;
+	OriginFrame = 0;
+	OriginTime = 0.0;
+	LastFrame = 0;
+	LastTime = 0.0;
+	FirstPoint = 0;
+	NumPoints = 0;
+	Slope = InFrameInterval;
+	Offset = 0.0;
+	AverageDelay = 0.0;
+}
+
+double FBlackmagicMediaFrameClock::Correlate(int64 InFrameNumber, double InHostTime)
+{
+	using namespace BlackmagicMediaFrameClockHelpers;
+
+	if (NumPoints > 0)
+	{
+		const int64 ElapsedFrames = InFrameNumber - LastFrame;
+		const double GapError = FMath::Abs((InHostTime - LastTime) - ElapsedFrames * FrameInterval) / FrameInterval;
+		if (ElapsedFrames <= 0 || GapError > MaxGapError + ElapsedFrames * MaxDrift)
+		{
+			Reset(FrameInterval);
+		}
+	}
+
+	if (NumPoints == 0)
+	{
+		OriginFrame = InFrameNumber;
+		OriginTime = InHostTime;
+	}
+
+	FPoint& Point = Points[(FirstPoint + NumPoints) % MaxNumPoints];
+	if (NumPoints < MaxNumPoints)
+	{
+		++NumPoints;
+	}
+	else
+	{
+		FirstPoint = (FirstPoint + 1) % MaxNumPoints;
+	}
+	Point.Frame = double(InFrameNumber - OriginFrame);
+	Point.Time = InHostTime - OriginTime;
+
+	LastFrame = InFrameNumber;
+	LastTime = InHostTime;
+
+	Fit();
+
+	const double Estimate = FMath::Min(Predict(InFrameNumber), InHostTime);
+	AverageDelay = NumPoints == 1 ? 0.0 : FMath::Lerp(AverageDelay, InHostTime - Estimate, DelaySmoothing);
+	return Estimate;
+}
+
+double FBlackmagicMediaFrameClock::Predict(int64 InFrameNumber) const
+{
+	return OriginTime + Offset + Slope * double(InFrameNumber - OriginFrame);
+}
+
+void FBlackmagicMediaFrameClock::Fit()
+{
+	using namespace BlackmagicMediaFrameClockHelpers;
+
+	// The slope goes through the earliest arrivals of the older and of the newer half of the frames, the arrivals that waited
+	// the least. A least squares fit would follow the delays of the callbacks, which are not symmetric.
+	Slope = FrameInterval;
+	if (NumPoints >= MinNumPointsForSlope)
+	{
+		const int32 HalfNumPoints = NumPoints / 2;
+		int32 EarliestIndex[2] = { 0, HalfNumPoints };
+		double EarliestResidual[2] = { TNumericLimits<double>::Max(), TNumericLimits<double>::Max() };
+		for (int32 Index = 0; Index < NumPoints; ++Index)
+		{
+			const FPoint& Point = Points[(FirstPoint + Index) % MaxNumPoints];
+			const int32 Half = Index < HalfNumPoints ? 0 : 1;
+			const double Residual = Point.Time - FrameInterval * Point.Frame;
+			if (Residual < EarliestResidual[Half])
+			{
+				EarliestResidual[Half] = Residual;
+				EarliestIndex[Half] = Index;
+			}
+		}
+
+		const FPoint& Older = Points[(FirstPoint + EarliestIndex[0]) % MaxNumPoints];
+		const FPoint& Newer = Points[(FirstPoint + EarliestIndex[1]) % MaxNumPoints];
+		if (Newer.Frame > Older.Frame)
+		{
+			Slope = FMath::Clamp((Newer.Time - Older.Time) / (Newer.Frame - Older.Frame), FrameInterval * (1.0 - MaxDrift), FrameInterval * (1.0 + MaxDrift));
+		}
+	}
+
+	// The earliest arrival is the one closest to the device time
+	Offset = TNumericLimits<double>::Max();
+	for (int32 Index = 0; Index < NumPoints; ++Index)
+	{
+		const FPoint& Point = Points[(FirstPoint + Index) % MaxNumPoints];
+		Offset = FMath::Min(Offset, Point.Time - Slope * Point.Frame);
+	}
+}
@@ -0,0 +1,500 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaJobs.h"
+
+#include "BlackmagicMediaPrivate.h"
+
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+#include "Stats/Stats2.h"
+#include "Templates/Atomic.h"
+
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Blackmagic Jobs Busy time (ms)"), STAT_Blackmagic_Jobs_BusyTime, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic Jobs Deadline misses"), STAT_Blackmagic_Jobs_DeadlineMisses, STATGROUP_Media);
+
+
+namespace BlackmagicMediaJobsHelpers
+{
+	static TAutoConsoleVariable<int32> CVarNumWorkers(
+		TEXT("Blackmagic.Jobs.NumWorkers"),
+		0,
+		TEXT("Number of workers of the Blackmagic jobs, read when the workers start.\n")
+		TEXT("0: One per core, less the game and rendering threads (default)"),
+		ECVF_Default);
+
+	static const int32 NumPriorities = (int32)EBlackmagicJobPriority::Num;
+
+	struct FJob
+	{
+		TUniqueFunction<void()> Function;
+		TPromise<void> Promise;
+		FName Stage;
+		double Deadline = 0.0;
+		double LaunchTime = 0.0;
+	};
+	using FJobPtr = TUniquePtr<FJob>;
+
+	struct FStageStats
+	{
+		int64 NumJobs = 0;
+		int64 NumDeadlineMisses = 0;
+		double BusyTime = 0.0;
+		double MaxWaitTime = 0.0;
+
+		void Merge(const FStageStats& InOther)
+		{
+			NumJobs += InOther.NumJobs;
+			NumDeadlineMisses += InOther.NumDeadlineMisses;
+			BusyTime += InOther.BusyTime;
+			MaxWaitTime = FMath::Max(MaxWaitTime, InOther.MaxWaitTime);
+		}
+	};
+
+	/** Statistics of the jobs run by a worker. Its lock is only shared with Blackmagic.Jobs.Stats, the workers don't contend on it. */
+	struct FWorkerStats
+	{
+		FCriticalSection Lock;
+		TMap<FName, FStageStats> StageStats;
+		double BusyTime = 0.0;
+	};
+
+	/** Index of the worker of this thread, the jobs it launches go to its own queues */
+	static thread_local int32 CurrentWorkerIndex = INDEX_NONE;
+
+	class FJobSystem;
+
+	class FWorker : public FRunnable
+	{
+	public:
+		FWorker(FJobSystem& InOwner, int32 InIndex)
+			: bIsIdle(false)
+			, Owner(InOwner)
+			, Index(InIndex)
+			, NumQueuedJobs(0)
+			, WakeUpEvent(FPlatformProcess::GetSynchEventFromPool(false))
+			, Thread(nullptr)
+			, bStopRequested(false)
+		{
+		}
+
+		virtual ~FWorker()
+		{
+			Shutdown();
+			FPlatformProcess::ReturnSynchEventToPool(WakeUpEvent);
+		}
+
+		void Start()
+		{
+			Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("BlackmagicJobs%d"), Index), 0, TPri_AboveNormal);
+		}
+
+		void Shutdown()
+		{
+			if (Thread)
+			{
+				Thread->Kill(true);
+				delete Thread;
+				Thread = nullptr;
+			}
+		}
+
+		/** Queue a job after the jobs of its priority with an earlier deadline. */
+		void Push(FJobPtr&& InJob, EBlackmagicJobPriority InPriority)
+		{
+			FScopeLock Lock(&QueueLock);
+			TArray<FJobPtr>& Queue = Queues[(int32)InPriority];
+			const double Deadline = InJob->Deadline > 0.0 ? InJob->Deadline : TNumericLimits<double>::Max();
+			int32 Position = Queue.Num();
+			while (Position > 0 && Queue[Position - 1]->Deadline > Deadline)
+			{
+				--Position;
+			}
+			Queue.Insert(MoveTemp(InJob), Position);
+			++NumQueuedJobs;
+		}
+
+		/** The most urgent job of a priority. Called by this worker and by the workers that steal from it. */
+		FJobPtr Pop(int32 InPriority)
+		{
+			if (NumQueuedJobs == 0)
+			{
+				return FJobPtr();
+			}
+
+			FScopeLock Lock(&QueueLock);
+			TArray<FJobPtr>& Queue = Queues[InPriority];
+			if (Queue.Num() == 0)
+			{
+				return FJobPtr();
+			}
+
+			FJobPtr Job = MoveTemp(Queue[0]);
+			Queue.RemoveAt(0, 1, false);
+			--NumQueuedJobs;
+			return Job;
+		}
+
+		void WakeUp()
+		{
+			WakeUpEvent->Trigger();
+		}
+
+		/** Set while the worker waits for a job. Cleared by the thread that wakes it up, so no other thread counts on it. */
+		TAtomic<bool> bIsIdle;
+
+	private:
+		//~ FRunnable interface
+		virtual uint32 Run() override;
+
+		virtual void Stop() override
+		{
+			bStopRequested = true;
+			WakeUpEvent->Trigger();
+		}
+
+	private:
+		FJobSystem& Owner;
+		int32 Index;
+
+		FCriticalSection QueueLock;
+		TArray<FJobPtr> Queues[NumPriorities];
+		TAtomic<int32> NumQueuedJobs;
+
+		FEvent* WakeUpEvent;
+		FRunnableThread* Thread;
+		TAtomic<bool> bStopRequested;
+	};
+
+	class FJobSystem
+	{
+	public:
+		explicit FJobSystem(int32 InNumWorkers)
+			: NextWorkerIndex(0)
+			, StatsStartTime(FPlatformTime::Seconds())
+		{
+			for (int32 Index = 0; Index < InNumWorkers; ++Index)
+			{
+				Workers.Add(MakeUnique<FWorker>(*this, Index));
+				WorkerStats.Add(MakeUnique<FWorkerStats>());
+			}
+			for (const TUniquePtr<FWorker>& Worker : Workers)
+			{
+				Worker->Start();
+			}
+			UE_LOG(LogBlackmagicMedia, Log, TEXT("Started %d Blackmagic job workers."), Workers.Num());
+		}
+
+		int32 GetNumWorkers() const
+		{
+			return Workers.Num();
+		}
+
+		void Launch(FJobPtr&& InJob, EBlackmagicJobPriority InPriority)
+		{
+			// A worker keeps its jobs, the others steal them when they have nothing to do
+			const int32 TargetIndex = CurrentWorkerIndex != INDEX_NONE ? CurrentWorkerIndex : int32(NextWorkerIndex++ % uint32(Workers.Num()));
+			Workers[TargetIndex]->Push(MoveTemp(InJob), InPriority);
+
+			if (Workers[TargetIndex]->bIsIdle.Exchange(false))
+			{
+				Workers[TargetIndex]->WakeUp();
+				return;
+			}
+
+			for (const TUniquePtr<FWorker>& Worker : Workers)
+			{
+				if (Worker->bIsIdle.Exchange(false))
+				{
+					Worker->WakeUp();
+					return;
+				}
+			}
+		}
+
+		/** The most urgent job of any worker. The queues of the worker come first within a priority. */
+		FJobPtr FindJob(int32 InWorkerIndex)
+		{
+			const int32 NumWorkers = Workers.Num();
+			for (int32 Priority = 0; Priority < NumPriorities; ++Priority)
+			{
+				for (int32 Offset = 0; Offset < NumWorkers; ++Offset)
+				{
+					FJobPtr Job = Workers[(InWorkerIndex + Offset) % NumWorkers]->Pop(Priority);
+					if (Job.IsValid())
+					{
+						return Job;
+					}
+				}
+			}
+			return FJobPtr();
+		}
+
+		/** Run a job and count it in the statistics of the worker that ran it */
+		void Execute(FJob& InJob, int32 InWorkerIndex)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			InJob.Function();
+			const double EndTime = FPlatformTime::Seconds();
+
+			// The stats system merges the counters of the threads itself
+			INC_FLOAT_STAT_BY(STAT_Blackmagic_Jobs_BusyTime, 1000.0 * (EndTime - StartTime));
+
+			const bool bIsLate = InJob.Deadline > 0.0 && EndTime > InJob.Deadline;
+			if (bIsLate)
+			{
+				INC_DWORD_STAT(STAT_Blackmagic_Jobs_DeadlineMisses);
+			}
+
+			{
+				FWorkerStats& Stats = *WorkerStats[InWorkerIndex];
+				FScopeLock Lock(&Stats.Lock);
+				FStageStats& Stage = Stats.StageStats.FindOrAdd(InJob.Stage);
+				++Stage.NumJobs;
+				Stage.NumDeadlineMisses += bIsLate ? 1 : 0;
+				Stage.BusyTime += EndTime - StartTime;
+				Stage.MaxWaitTime = FMath::Max(Stage.MaxWaitTime, StartTime - InJob.LaunchTime);
+				Stats.BusyTime += EndTime - StartTime;
+			}
+
+			InJob.Promise.SetValue();
+		}
+
+		/** Merge the statistics of the workers and log every stage since the last call. */
+		void LogStats()
+		{
+			TMap<FName, FStageStats> StageStats;
+			double TotalBusyTime = 0.0;
+			for (const TUniquePtr<FWorkerStats>& Stats : WorkerStats)
+			{
+				FScopeLock Lock(&Stats->Lock);
+				for (const TPair<FName, FStageStats>& Pair : Stats->StageStats)
+				{
+					StageStats.FindOrAdd(Pair.Key).Merge(Pair.Value);
+				}
+				TotalBusyTime += Stats->BusyTime;
+				Stats->StageStats.Reset();
+				Stats->BusyTime = 0.0;
+			}
+
+			const double EndTime = FPlatformTime::Seconds();
+			const double Elapsed = FMath::Max(EndTime - StatsStartTime, SMALL_NUMBER);
+			const double Capacity = Elapsed * Workers.Num();
+			StatsStartTime = EndTime;
+
+			UE_LOG(LogBlackmagicMedia, Display, TEXT("Blackmagic jobs: %d workers, %.1f%% used over %.1f seconds."), Workers.Num(), 100.0 * TotalBusyTime / Capacity, Elapsed);
+			for (const TPair<FName, FStageStats>& Pair : StageStats)
+			{
+				const FStageStats& Stats = Pair.Value;
+				UE_LOG(LogBlackmagicMedia, Display, TEXT("  %s: %lld jobs, %.1f%% of the workers, %.2f ms per job, %.2f ms max wait, %lld deadline misses")
+					, *Pair.Key.ToString(), Stats.NumJobs, 100.0 * Stats.BusyTime / Capacity, Stats.NumJobs > 0 ? 1000.0 * Stats.BusyTime / Stats.NumJobs : 0.0
+					, 1000.0 * Stats.MaxWaitTime, Stats.NumDeadlineMisses);
+			}
+
+		}
+
+		/** Stop the workers and run the jobs they left, their completions may be waited on. */
+		void Stop()
+		{
+			for (const TUniquePtr<FWorker>& Worker : Workers)
+			{
+				Worker->Shutdown();
+			}
+
+			for (FJobPtr Job = FindJob(0); Job.IsValid(); Job = FindJob(0))
+			{
+				Execute(*Job, 0);
+			}
+		}
+
+	private:
+		TArray<TUniquePtr<FWorker>> Workers;
+		TAtomic<uint32> NextWorkerIndex;
+
+		/** One per worker, merged by LogStats */
+		TArray<TUniquePtr<FWorkerStats>> WorkerStats;
+
+		/** Only used by LogStats, called under JobSystemLock */
+		double StatsStartTime;
+	};
+
+	uint32 FWorker::Run()
+	{
+		CurrentWorkerIndex = Index;
+
+		while (!bStopRequested)
+		{
+			FJobPtr Job = Owner.FindJob(Index);
+			if (!Job.IsValid())
+			{
+				// Idle before the last look, a job launched after it wakes the worker up
+				bIsIdle = true;
+				Job = Owner.FindJob(Index);
+				if (!Job.IsValid())
+				{
+					WakeUpEvent->Wait();
+					bIsIdle = false;
+					continue;
+				}
+				bIsIdle = false;
+			}
+
+			Owner.Execute(*Job, Index);
+		}
+
+		CurrentWorkerIndex = INDEX_NONE;
+		return 0;
+	}
+
+	static FCriticalSection JobSystemLock;
+	static TUniquePtr<FJobSystem> JobSystem;
+	static bool bIsShutDown = false;
+
+	/** The job system, started the first time it is used. nullptr once it is shut down. */
+	FJobSystem* GetJobSystem()
+	{
+		FScopeLock Lock(&JobSystemLock);
+		if (!JobSystem.IsValid() && !bIsShutDown)
+		{
+			const int32 NumWorkers = CVarNumWorkers.GetValueOnAnyThread() > 0 ? CVarNumWorkers.GetValueOnAnyThread() : FMath::Max(FPlatformMisc::NumberOfCores() - 2, 1);
+			JobSystem = MakeUnique<FJobSystem>(NumWorkers);
+		}
+		return JobSystem.Get();
+	}
+
+	static FAutoConsoleCommand LogStatsCommand(
+		TEXT("Blackmagic.Jobs.Stats"),
+		TEXT("Log the use of the Blackmagic job workers per stage since the last call, and the jobs that missed their deadline."),
+		FConsoleCommandDelegate::CreateLambda([]()
+		{
+			FScopeLock Lock(&JobSystemLock);
+			if (JobSystem.IsValid())
+			{
+				JobSystem->LogStats();
+			}
+		})
+	);
+}
+
+
+TFuture<void> FBlackmagicMediaJobs::Launch(EBlackmagicJobPriority InPriority, FName InStage, TUniqueFunction<void()> InJob, double InDeadline)
+{
+	using namespace BlackmagicMediaJobsHelpers;
+
+	FJobPtr Job = MakeUnique<FJob>();
+	Job->Function = MoveTemp(InJob);
+	Job->Stage = InStage;
+	Job->Deadline = InDeadline;
+	Job->LaunchTime = FPlatformTime::Seconds();
+	TFuture<void> Result = Job->Promise.GetFuture();
+
+	FJobSystem* System = GetJobSystem();
+	if (System)
+	{
+		System->Launch(MoveTemp(Job), InPriority);
+	}
+	else
+	{
+		Job->Function();
+		Job->Promise.SetValue();
+	}
+
+	return Result;
+}
+
+
+void FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority InPriority, FName InStage, int32 InNum, TFunctionRef<void(int32)> InBody)
+{
+	using namespace BlackmagicMediaJobsHelpers;
+
+	FJobSystem* System = InNum > 1 ? GetJobSystem() : nullptr;
+	if (System == nullptr)
+	{
+		for (int32 Index = 0; Index < InNum; ++Index)
+		{
+			InBody(Index);
+		}
+		return;
+	}
+
+	// The helpers that start after the last index is taken have nothing to do, they can outlive the call
+	struct FContext
+	{
+		FContext(int32 InNumIndices, TFunctionRef<void(int32)>& InBodyRef)
+			: NextIndex(0)
+			, NumDone(0)
+			, NumIndices(InNumIndices)
+			, Body(&InBodyRef)
+			, DoneEvent(FPlatformProcess::GetSynchEventFromPool(false))
+		{
+		}
+
+		~FContext()
+		{
+			FPlatformProcess::ReturnSynchEventToPool(DoneEvent);
+		}
+
+		void Work()
+		{
+			for (int32 Index = NextIndex++; Index < NumIndices; Index = NextIndex++)
+			{
+				// The caller waits for every index, the body is alive while an index runs
+				(*Body)(Index);
+				if (++NumDone == NumIndices)
+				{
+					DoneEvent->Trigger();
+				}
+			}
+		}
+
+		TAtomic<int32> NextIndex;
+		TAtomic<int32> NumDone;
+		int32 NumIndices;
+		TFunctionRef<void(int32)>* Body;
+		FEvent* DoneEvent;
+	};
+
+	TSharedRef<FContext, ESPMode::ThreadSafe> Context = MakeShared<FContext, ESPMode::ThreadSafe>(InNum, InBody);
+	const int32 NumHelpers = FMath::Min(InNum - 1, System->GetNumWorkers());
+	for (int32 Helper = 0; Helper < NumHelpers; ++Helper)
+	{
+		Launch(InPriority, InStage, [Context]() { Context->Work(); });
+	}
+
+	Context->Work();
+	while (Context->NumDone < InNum)
+	{
+		Context->DoneEvent->Wait();
+	}
+}
+
+
+int32 FBlackmagicMediaJobs::GetNumWorkers()
+{
+	BlackmagicMediaJobsHelpers::FJobSystem* System = BlackmagicMediaJobsHelpers::GetJobSystem();
+	return System ? System->GetNumWorkers() : 0;
+}
+
+
+void FBlackmagicMediaJobs::Shutdown()
+{
+	using namespace BlackmagicMediaJobsHelpers;
+
+	TUniquePtr<FJobSystem> StoppedSystem;
+	{
+		FScopeLock Lock(&JobSystemLock);
+		bIsShutDown = true;
+		StoppedSystem = MoveTemp(JobSystem);
+	}
+
+	if (StoppedSystem.IsValid())
+	{
+		StoppedSystem->Stop();
+	}
+}
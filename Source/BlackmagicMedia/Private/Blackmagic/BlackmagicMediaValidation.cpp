@@ -0,0 +1,178 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaValidation.h"
+
+#include "Blackmagic.h"
+#include "BlackmagicDeviceProvider.h"
+#include "BlackmagicMediaPrivate.h"
+
+#include "HAL/IConsoleManager.h"
+
+
+namespace BlackmagicMediaValidationHelpers
+{
+	static TAutoConsoleVariable<int32> CVarLiveValidation(
+		TEXT("Blackmagic.LiveValidation"),
+		0,
+		TEXT("Validate the Blackmagic media sources and outputs against the devices instead of the devices found by the last scan.\n")
+		TEXT("1: Query the device every time a source or an output is validated"),
+		ECVF_Default);
+
+	FString GetAssetDescription(bool bIsInput, const FString& InName)
+	{
+		return FString::Printf(TEXT("The %s '%s'"), bIsInput ? TEXT("MediaSource") : TEXT("MediaOutput"), *InName);
+	}
+
+	bool CanUseLibrary(bool bIsInput, const FString& InName, FString& OutFailureReason)
+	{
+		if (!FBlackmagic::IsInitialized())
+		{
+			OutFailureReason = FString::Printf(TEXT("Can't validate %s '%s'. The Blackmagic library was not initialized."), bIsInput ? TEXT("MediaSource") : TEXT("MediaOutput"), *InName);
+			return false;
+		}
+
+		if (!FBlackmagic::CanUseBlackmagicCard())
+		{
+			OutFailureReason = FString::Printf(TEXT("Can't validate %s '%s' because Blackmagic card cannot be used. Are you in a Commandlet? You may override this behavior by launching with -ForceBlackmagicUsage."), bIsInput ? TEXT("MediaSource") : TEXT("MediaOutput"), *InName);
+			return false;
+		}
+
+		return true;
+	}
+
+	/** Only the live validation needs the library, the cached devices are saved from the last scan of the machine */
+	bool FindCapabilities(const FMediaIOConfiguration& InConfiguration, bool bInLive, const FString& InName, FBlackmagicDeviceCapabilities& OutCapabilities, FString& OutFailureReason)
+	{
+		if (bInLive && !CanUseLibrary(InConfiguration.bIsInput, InName, OutFailureReason))
+		{
+			return false;
+		}
+
+		if (!bInLive)
+		{
+			FBlackmagicDeviceProvider::WaitForDevices();
+		}
+
+		const int32 DeviceIdentifier = InConfiguration.MediaConnection.Device.DeviceIdentifier;
+		const bool bFound = bInLive ? FBlackmagicDeviceProvider::ScanDevice(DeviceIdentifier, OutCapabilities) : FBlackmagicDeviceProvider::FindCachedDevice(DeviceIdentifier, OutCapabilities);
+		if (!bFound)
+		{
+			OutFailureReason = FString::Printf(TEXT("%s use the device '%s' that doesn't exist on this machine."), *GetAssetDescription(InConfiguration.bIsInput, InName), *InConfiguration.MediaConnection.Device.DeviceName.ToString());
+			return false;
+		}
+
+		return true;
+	}
+
+	bool ValidateOutput(const FBlackmagicDeviceCapabilities& InCapabilities, const FMediaIOOutputConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason)
+	{
+		if (!FBlackmagicMediaValidation::ValidateCapabilities(InCapabilities, InConfiguration.MediaConfiguration, InName, OutFailureReason))
+		{
+			return false;
+		}
+
+		const FString DeviceName = InConfiguration.MediaConfiguration.MediaConnection.Device.DeviceName.ToString();
+		if (InConfiguration.OutputType == EMediaIOOutputType::FillAndKey && !InCapabilities.bSupportExternalKeying)
+		{
+			OutFailureReason = FString::Printf(TEXT("%s use the device '%s' that can't output a key."), *GetAssetDescription(false, InName), *DeviceName);
+			return false;
+		}
+
+		if (InConfiguration.OutputReference == EMediaIOReferenceType::External && !InCapabilities.bHasGenlockReferenceInput)
+		{
+			OutFailureReason = FString::Printf(TEXT("%s use the device '%s' that doesn't have a reference input."), *GetAssetDescription(false, InName), *DeviceName);
+			return false;
+		}
+
+		return true;
+	}
+}
+
+
+bool FBlackmagicMediaValidation::ValidateInput(const FMediaIOConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason)
+{
+	FBlackmagicDeviceCapabilities Capabilities;
+	return BlackmagicMediaValidationHelpers::FindCapabilities(InConfiguration, false, InName, Capabilities, OutFailureReason)
+		&& ValidateCapabilities(Capabilities, InConfiguration, InName, OutFailureReason);
+}
+
+
+bool FBlackmagicMediaValidation::ValidateOutput(const FMediaIOOutputConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason)
+{
+	FBlackmagicDeviceCapabilities Capabilities;
+	return BlackmagicMediaValidationHelpers::FindCapabilities(InConfiguration.MediaConfiguration, false, InName, Capabilities, OutFailureReason)
+		&& BlackmagicMediaValidationHelpers::ValidateOutput(Capabilities, InConfiguration, InName, OutFailureReason);
+}
+
+
+bool FBlackmagicMediaValidation::ValidateInputLive(const FMediaIOConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason)
+{
+	FBlackmagicDeviceCapabilities Capabilities;
+	return BlackmagicMediaValidationHelpers::FindCapabilities(InConfiguration, true, InName, Capabilities, OutFailureReason)
+		&& ValidateCapabilities(Capabilities, InConfiguration, InName, OutFailureReason);
+}
+
+
+bool FBlackmagicMediaValidation::ValidateOutputLive(const FMediaIOOutputConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason)
+{
+	FBlackmagicDeviceCapabilities Capabilities;
+	return BlackmagicMediaValidationHelpers::FindCapabilities(InConfiguration.MediaConfiguration, true, InName, Capabilities, OutFailureReason)
+		&& BlackmagicMediaValidationHelpers::ValidateOutput(Capabilities, InConfiguration, InName, OutFailureReason);
+}
+
+
+bool FBlackmagicMediaValidation::IsLiveValidationEnabled()
+{
+	return BlackmagicMediaValidationHelpers::CVarLiveValidation.GetValueOnAnyThread() != 0;
+}
+
+
+bool FBlackmagicMediaValidation::ValidateCapabilities(const FBlackmagicDeviceCapabilities& InCapabilities, const FMediaIOConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason)
+{
+	using namespace BlackmagicMediaValidationHelpers;
+
+	const FString DeviceName = InConfiguration.MediaConnection.Device.DeviceName.ToString();
+	if (!InCapabilities.bIsSupported)
+	{
+		OutFailureReason = FString::Printf(TEXT("%s use the device '%s' that is not supported by the Blackmagic SDK."), *GetAssetDescription(InConfiguration.bIsInput, InName), *DeviceName);
+		return false;
+	}
+
+	if (InConfiguration.bIsInput && !InCapabilities.bCanDoCapture)
+	{
+		OutFailureReason = FString::Printf(TEXT("%s use the device '%s' that can't capture."), *GetAssetDescription(true, InName), *DeviceName);
+		return false;
+	}
+
+	if (!InConfiguration.bIsInput && !InCapabilities.bCanDoPlayback)
+	{
+		OutFailureReason = FString::Printf(TEXT("%s use the device '%s' that can't do playback."), *GetAssetDescription(false, InName), *DeviceName);
+		return false;
+	}
+
+	const TArray<FBlackmagicDeviceMode>& Modes = InConfiguration.bIsInput ? InCapabilities.InputModes : InCapabilities.OutputModes;
+	const int32 ModeIdentifier = InConfiguration.MediaMode.DeviceModeIdentifier;
+	const FBlackmagicDeviceMode* Mode = Modes.FindByPredicate([ModeIdentifier](const FBlackmagicDeviceMode& Candidate) { return Candidate.Mode.DeviceModeIdentifier == ModeIdentifier; });
+	if (Mode == nullptr)
+	{
+		OutFailureReason = FString::Printf(TEXT("%s use the mode '%s' that the device '%s' doesn't support."), *GetAssetDescription(InConfiguration.bIsInput, InName), *InConfiguration.MediaMode.GetModeName().ToString(), *DeviceName);
+		return false;
+	}
+
+	// Inputs detect the link themselves
+	if (!InConfiguration.bIsInput)
+	{
+		const EMediaIOTransportType TransportType = InConfiguration.MediaConnection.TransportType;
+		const bool bCanDoTransport = TransportType == EMediaIOTransportType::SingleLink
+			|| (TransportType == EMediaIOTransportType::DualLink && Mode->bIs2K && InCapabilities.bCanDoDualLink)
+			|| (TransportType == EMediaIOTransportType::QuadLink && Mode->bIs4K && InCapabilities.bCanDoQuadLink
+				&& (InConfiguration.MediaConnection.QuadTransportType != EMediaIOQuadLinkTransportType::SquareDivision || InCapabilities.bCanDoQuadSquareLink));
+		if (!bCanDoTransport)
+		{
+			OutFailureReason = FString::Printf(TEXT("%s use a link that the device '%s' can't do in the mode '%s'."), *GetAssetDescription(false, InName), *DeviceName, *InConfiguration.MediaMode.GetModeName().ToString());
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -4,8 +4,12 @@
 
 #include "Blackmagic/Blackmagic.h"
 #include "BlackmagicDeviceProvider.h"
+#include "BlackmagicMediaChannelTasks.h"
+#include "BlackmagicMediaJobs.h"
+#include "BlackmagicMediaBroker.h"
 #include "BlackmagicMediaPrivate.h"
 #include "BlackmagicMediaPlayer.h"
+#include "BlackmagicMediaRecordingQueue.h"
 
 #include "IMediaIOCoreModule.h"
 #include "Modules/ModuleManager.h"
@@ -37,13 +41,24 @@ public:
 
 	virtual bool CanBeUsed() const override { return FBlackmagic::CanUseBlackmagicCard(); }
 
+	virtual int32 ApplySourceSettings(const TSharedRef<const FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>& InSettings) override
+	{
+		return FBlackmagicMediaPlayer::ApplySettings(InSettings);
+	}
+
 public:
 
 	//~ IModuleInterface interface
 	virtual void StartupModule() override
 	{
 		// initialize
-		if (!FBlackmagic::Initialize())
+		const bool bIsInitialized = FBlackmagic::Initialize();
+
+		// The devices are listed from the cache, fill it before the first details panel opens. Without the library, only the saved scan is loaded.
+		// Nothing waits here: the first validation waits for the devices, the lists never scan nor wait.
+		FBlackmagicDeviceProvider::RequestScan();
+
+		if (!bIsInitialized)
 		{
 			UE_LOG(LogBlackmagicMedia, Error, TEXT("Failed to initialize Blackmagic"));
 			return;
@@ -51,15 +66,26 @@ public:
 
 		
 		IMediaIOCoreModule::Get().RegisterDeviceProvider(&DeviceProvider);
+
+		BlackmagicMediaBroker::StartHostFromCommandLine();
 	}
 
 	virtual void ShutdownModule() override
 	{
+		// The warm channels may be opened through the broker, they are closed before it stops
+		FBlackmagicMediaPlayer::ReleaseWarmChannels();
+		FBlackmagicMediaChannelTasks::Flush();
+		BlackmagicMediaBackend::Shutdown();
+		BlackmagicMediaBroker::StopHost();
+		FBlackmagicRecordingQueue::Shutdown();
+		FBlackmagicMediaJobs::Shutdown();
+
 		if (IMediaIOCoreModule::IsAvailable())
 		{
 			IMediaIOCoreModule::Get().UnregisterDeviceProvider(&DeviceProvider);
 		}
 
+		FBlackmagicDeviceProvider::WaitForScan();
 		FBlackmagic::Shutdown();
 	}
 
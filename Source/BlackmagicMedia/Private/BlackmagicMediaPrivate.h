@@ -16,11 +16,25 @@ namespace BlackmagicMediaOption
 	static const FName MaxAudioFrameBuffer("MaxAudioFrameBuffer");
 	static const FName CaptureVideo("CaptureVideo");
 	static const FName BlackmagicVideoFormat("BlackmagicVideoFormat");
+	static const FName VideoStandard("VideoStandard");
 	static const FName ColorFormat("ColorFormat");
 	static const FName MaxVideoFrameBuffer("MaxVideoFrameBuffer");
 	static const FName LogDropFrame("LogDropFrame");
 	static const FName EncodeTimecodeInTexel("EncodeTimecodeInTexel");
 	static const FName SRGBInput("sRGBInput");
+	static const FName ExportToSharedMemory("ExportToSharedMemory");
+	static const FName SharedMemoryName("SharedMemoryName");
+	static const FName SharedMemoryNumSlots("SharedMemoryNumSlots");
+	static const FName GenerateProxies("GenerateProxies");
+	static const FName ProxyFrameDivider("ProxyFrameDivider");
+	static const FName CaptureRegionOfInterest("CaptureRegionOfInterest");
+	static const FName RegionOfInterestX("RegionOfInterestX");
+	static const FName RegionOfInterestY("RegionOfInterestY");
+	static const FName RegionOfInterestWidth("RegionOfInterestWidth");
+	static const FName RegionOfInterestHeight("RegionOfInterestHeight");
+	static const FName DuplicateFrameDetection("DuplicateFrameDetection");
+	static const FName Settings("BlackmagicSettings");
+	static const FName SettingsType("BlackmagicSettingsType");
 
 	static const BlackmagicDesign::FBlackmagicVideoFormat DefaultVideoFormat = 0x48703330; //1080p 30fps
 
@@ -0,0 +1,1096 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaBroker.h"
+
+#include "Blackmagic.h"
+#include "BlackmagicMediaPrivate.h"
+#include "BlackmagicSimulatedDevice.h"
+
+#include "HAL/Event.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/CommandLine.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace BlackmagicMediaBrokerHelpers
+{
+	/** Read a value written by another process. The barrier orders the following reads after it. */
+	template<typename T>
+	FORCEINLINE T ReadShared(const volatile T* InValue)
+	{
+		const T Value = *InValue;
+		FPlatformMisc::MemoryBarrier();
+		return Value;
+	}
+
+	FORCEINLINE int64 GetHeartbeatTimeoutCycles()
+	{
+		return int64(BlackmagicMediaBroker::HeartbeatTimeout / FPlatformTime::GetSecondsPerCycle64());
+	}
+
+	FORCEINLINE bool IsHeartbeatAlive(const volatile int64* InHeartbeat)
+	{
+		return int64(FPlatformTime::Cycles64()) - ReadShared(InHeartbeat) < GetHeartbeatTimeoutCycles();
+	}
+
+	FPlatformMemory::FSharedMemoryRegion* MapControlBlock(int32 InDeviceIndex, bool bInCreate)
+	{
+		return FPlatformMemory::MapNamedSharedMemoryRegion(BlackmagicMediaBroker::GetControlName(InDeviceIndex), bInCreate, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, sizeof(FBlackmagicBrokerControlBlock));
+	}
+
+	bool FindVideoFormat(int32 InDeviceIndex, BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::BlackmagicVideoFormats::VideoFormatDescriptor& OutDescriptor)
+	{
+		BlackmagicDesign::BlackmagicVideoFormats VideoFormats(InDeviceIndex, false);
+		for (int32 Index = 0; Index < VideoFormats.GetNumSupportedFormat(); ++Index)
+		{
+			BlackmagicDesign::BlackmagicVideoFormats::VideoFormatDescriptor Descriptor = VideoFormats.GetSupportedFormat(Index);
+			if (Descriptor.bIsValid && Descriptor.VideoFormatIndex == InDisplayMode)
+			{
+				OutDescriptor = Descriptor;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/** The broker hosted by this process */
+	FCriticalSection HostLock;
+	TUniquePtr<FBlackmagicBrokerHost> Host;
+
+	static TAutoConsoleVariable<int32> CVarBrokerClient(
+		TEXT("Blackmagic.Broker.Client"),
+		1,
+		TEXT("0: Always open the input devices in the Blackmagic library.\n")
+		TEXT("1: Subscribe to the broker of another process when one serves the device. (default)"),
+		ECVF_Default);
+}
+
+/* BlackmagicMediaBroker
+*****************************************************************************/
+
+namespace BlackmagicMediaBroker
+{
+	FString GetFrameRingName(int32 InDeviceIndex)
+	{
+		return FString::Printf(TEXT("Blackmagic_Broker_%d"), InDeviceIndex);
+	}
+
+	FString GetControlName(int32 InDeviceIndex)
+	{
+		return FString::Printf(TEXT("Blackmagic_Broker_%d_Control"), InDeviceIndex);
+	}
+
+	FString GetSignalName(int32 InDeviceIndex, int32 InSubscriberIndex)
+	{
+		return FString::Printf(TEXT("Blackmagic_Broker_%d_Signal_%d"), InDeviceIndex, InSubscriberIndex);
+	}
+
+	bool IsBrokerAvailable(int32 InDeviceIndex)
+	{
+		FPlatformMemory::FSharedMemoryRegion* Region = BlackmagicMediaBrokerHelpers::MapControlBlock(InDeviceIndex, false);
+		if (Region == nullptr)
+		{
+			return false;
+		}
+
+		const FBlackmagicBrokerControlBlock* ControlBlock = reinterpret_cast<const FBlackmagicBrokerControlBlock*>(Region->GetAddress());
+		const bool bIsAvailable = ControlBlock->Magic == ControlMagic
+			&& ControlBlock->Version == ControlVersion
+			&& ControlBlock->HostProcessId != FPlatformProcess::GetCurrentProcessId()
+			&& BlackmagicMediaBrokerHelpers::IsHeartbeatAlive(&ControlBlock->HostHeartbeat);
+
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		return bIsAvailable;
+	}
+
+	bool IsHostingDevice(int32 InDeviceIndex)
+	{
+		FScopeLock Lock(&BlackmagicMediaBrokerHelpers::HostLock);
+		return BlackmagicMediaBrokerHelpers::Host.IsValid() && BlackmagicMediaBrokerHelpers::Host->GetDeviceIndex() == InDeviceIndex;
+	}
+
+	bool StartHost(int32 InDeviceIndex, BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat, BlackmagicDesign::ETimecodeFormat InTimecodeFormat)
+	{
+		StopHost();
+
+		if (!FBlackmagic::IsInitialized() || !FBlackmagic::CanUseBlackmagicCard())
+		{
+			UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't start the broker of device '%d'. The Blackmagic library can't be used in this process."), InDeviceIndex);
+			return false;
+		}
+
+		if (IsBrokerAvailable(InDeviceIndex))
+		{
+			UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't start the broker of device '%d'. Another process already hosts it."), InDeviceIndex);
+			return false;
+		}
+
+		TUniquePtr<FBlackmagicBrokerHost> NewHost = MakeUnique<FBlackmagicBrokerHost>(InDeviceIndex);
+		if (!NewHost->OpenDevice(InDisplayMode, InPixelFormat, InTimecodeFormat))
+		{
+			return false;
+		}
+
+		FScopeLock Lock(&BlackmagicMediaBrokerHelpers::HostLock);
+		BlackmagicMediaBrokerHelpers::Host = MoveTemp(NewHost);
+		return true;
+	}
+
+	bool StartSimulatedHost(int32 InDeviceIndex, uint32 InWidth, uint32 InHeight, const FFrameRate& InFrameRate, BlackmagicDesign::EPixelFormat InPixelFormat)
+	{
+		StopHost();
+
+		if (IsBrokerAvailable(InDeviceIndex))
+		{
+			UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't start the simulated broker of device '%d'. Another process already hosts it."), InDeviceIndex);
+			return false;
+		}
+
+		TUniquePtr<FBlackmagicBrokerHost> NewHost = MakeUnique<FBlackmagicBrokerHost>(InDeviceIndex);
+		if (!NewHost->OpenSimulatedDevice(InWidth, InHeight, InFrameRate, InPixelFormat))
+		{
+			return false;
+		}
+
+		FScopeLock Lock(&BlackmagicMediaBrokerHelpers::HostLock);
+		BlackmagicMediaBrokerHelpers::Host = MoveTemp(NewHost);
+		return true;
+	}
+
+	void StopHost()
+	{
+		TUniquePtr<FBlackmagicBrokerHost> OldHost;
+		{
+			FScopeLock Lock(&BlackmagicMediaBrokerHelpers::HostLock);
+			OldHost = MoveTemp(BlackmagicMediaBrokerHelpers::Host);
+		}
+		OldHost.Reset();
+	}
+
+	void StartHostFromCommandLine()
+	{
+		int32 DeviceIndex = INDEX_NONE;
+		if (!FParse::Value(FCommandLine::Get(), TEXT("BlackmagicBroker="), DeviceIndex))
+		{
+			return;
+		}
+
+		const BlackmagicDesign::EPixelFormat PixelFormat = FParse::Param(FCommandLine::Get(), TEXT("BlackmagicBroker10Bit")) ? BlackmagicDesign::EPixelFormat::pf_10Bits : BlackmagicDesign::EPixelFormat::pf_8Bits;
+		if (FParse::Param(FCommandLine::Get(), TEXT("BlackmagicBrokerSimulated")))
+		{
+			StartSimulatedHost(DeviceIndex, 1920, 1080, FFrameRate(30, 1), PixelFormat);
+			return;
+		}
+
+		BlackmagicDesign::FBlackmagicVideoFormat DisplayMode = BlackmagicMediaOption::DefaultVideoFormat;
+		FString DisplayModeString;
+		if (FParse::Value(FCommandLine::Get(), TEXT("BlackmagicBrokerMode="), DisplayModeString))
+		{
+			DisplayMode = FCString::Strtoi(*DisplayModeString, nullptr, 0);
+		}
+
+		StartHost(DeviceIndex, DisplayMode, PixelFormat, BlackmagicDesign::ETimecodeFormat::TCF_LTC);
+	}
+}
+
+/* FBlackmagicBrokerInputCallback
+*****************************************************************************/
+
+/** Receive the frames of the device from the Blackmagic library for the host */
+class FBlackmagicBrokerInputCallback : public BlackmagicDesign::IInputEventCallback
+{
+public:
+	FBlackmagicBrokerInputCallback(FBlackmagicBrokerHost* InHost)
+		: RefCounter(0)
+		, Host(InHost)
+	{
+	}
+
+	/** No event is forwarded once it returns */
+	void ClearHost()
+	{
+		FScopeLock Lock(&CallbackLock);
+		Host = nullptr;
+	}
+
+	virtual void AddRef() override
+	{
+		++RefCounter;
+	}
+
+	virtual void Release() override
+	{
+		--RefCounter;
+		if (RefCounter == 0)
+		{
+			delete this;
+		}
+	}
+
+private:
+	virtual void OnInitializationCompleted(bool bSuccess) override
+	{
+		if (!bSuccess)
+		{
+			UE_LOG(LogBlackmagicMedia, Error, TEXT("The broker couldn't open its device."));
+		}
+	}
+
+	virtual void OnShutdownCompleted() override
+	{
+	}
+
+	virtual void OnFrameReceived(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo) override
+	{
+		FScopeLock Lock(&CallbackLock);
+		if (Host)
+		{
+			Host->OnFrameReceived(InFrameInfo);
+		}
+	}
+
+	virtual void OnFrameFormatChanged(const BlackmagicDesign::FFormatInfo& NewFormat) override
+	{
+		FScopeLock Lock(&CallbackLock);
+		if (Host)
+		{
+			Host->OnFormatChanged(NewFormat);
+		}
+	}
+
+	virtual void OnInterlacedOddFieldEvent() override
+	{
+		FScopeLock Lock(&CallbackLock);
+		if (Host)
+		{
+			Host->OnOddField();
+		}
+	}
+
+private:
+	TAtomic<int32> RefCounter;
+	FCriticalSection CallbackLock;
+	FBlackmagicBrokerHost* Host;
+};
+
+/* FBlackmagicBrokerHeartbeat
+*****************************************************************************/
+
+/**
+ * Update the heartbeat of the host on its own thread. A hitch of the game thread, a level load or a garbage collection,
+ * must not make the subscribers believe the host is gone.
+ */
+class FBlackmagicBrokerHeartbeat : public FRunnable
+{
+public:
+	explicit FBlackmagicBrokerHeartbeat(volatile int64* InHeartbeat)
+		: Heartbeat(InHeartbeat)
+		, WakeUpEvent(FPlatformProcess::GetSynchEventFromPool(false))
+		, Thread(nullptr)
+		, bStopRequested(false)
+	{
+		Thread = FRunnableThread::Create(this, TEXT("BlackmagicBrokerHeartbeat"), 0, TPri_AboveNormal);
+	}
+
+	virtual ~FBlackmagicBrokerHeartbeat()
+	{
+		if (Thread)
+		{
+			Thread->Kill(true);
+			delete Thread;
+			Thread = nullptr;
+		}
+		FPlatformProcess::ReturnSynchEventToPool(WakeUpEvent);
+	}
+
+private:
+	//~ FRunnable interface
+	virtual uint32 Run() override
+	{
+		// Well within BlackmagicMediaBroker::HeartbeatTimeout
+		const uint32 IntervalMilliseconds = 250;
+		while (!bStopRequested)
+		{
+			FPlatformAtomics::InterlockedExchange(Heartbeat, (int64)FPlatformTime::Cycles64());
+			WakeUpEvent->Wait(IntervalMilliseconds);
+		}
+		return 0;
+	}
+
+	virtual void Stop() override
+	{
+		bStopRequested = true;
+		WakeUpEvent->Trigger();
+	}
+
+private:
+	volatile int64* Heartbeat;
+	FEvent* WakeUpEvent;
+	FRunnableThread* Thread;
+	TAtomic<bool> bStopRequested;
+};
+
+/* FBlackmagicBrokerHost
+*****************************************************************************/
+
+FBlackmagicBrokerHost::FBlackmagicBrokerHost(int32 InDeviceIndex)
+	: DeviceIndex(InDeviceIndex)
+	, ControlRegion(nullptr)
+	, ControlBlock(nullptr)
+	, InputCallback(nullptr)
+	, bHasWarnedFrameTooLarge(false)
+{
+	FMemory::Memzero(Signals);
+	FMemory::Memzero(SignalProcessIds);
+	FMemory::Memzero(SignalGenerations);
+}
+
+FBlackmagicBrokerHost::~FBlackmagicBrokerHost()
+{
+	// Stopped before the control block is unmapped
+	Heartbeat.Reset();
+
+	if (SimulatedDevice.IsValid())
+	{
+		SimulatedDevice->Shutdown();
+		SimulatedDevice.Reset();
+	}
+
+	if (InputCallback)
+	{
+		if (InputIdentifier.IsValid())
+		{
+			BlackmagicDesign::FChannelInfo ChannelInfo;
+			ChannelInfo.DeviceIndex = DeviceIndex;
+			BlackmagicDesign::UnregisterCallbackForChannel(ChannelInfo, InputIdentifier);
+		}
+		InputCallback->ClearHost();
+		InputCallback->Release();
+		InputCallback = nullptr;
+	}
+
+	for (int32 Index = 0; Index < BlackmagicMediaBroker::MaxSubscribers; ++Index)
+	{
+		if (Signals[Index])
+		{
+			FPlatformProcess::DeleteInterprocessSynchObject(Signals[Index]);
+			Signals[Index] = nullptr;
+		}
+	}
+
+	Writer.Close();
+
+	if (ControlRegion)
+	{
+		// Subscribers see a stale heartbeat and report the loss of the input
+		FPlatformAtomics::InterlockedExchange(&ControlBlock->HostHeartbeat, 0);
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(ControlRegion);
+		ControlRegion = nullptr;
+		ControlBlock = nullptr;
+	}
+
+	UE_LOG(LogBlackmagicMedia, Log, TEXT("Stopped the broker of device '%d'."), DeviceIndex);
+}
+
+bool FBlackmagicBrokerHost::OpenDevice(BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat, BlackmagicDesign::ETimecodeFormat InTimecodeFormat)
+{
+	BlackmagicDesign::BlackmagicVideoFormats::VideoFormatDescriptor Descriptor;
+	if (!BlackmagicMediaBrokerHelpers::FindVideoFormat(DeviceIndex, InDisplayMode, Descriptor))
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't start the broker. The device '%d' doesn't support the display mode '0x%08x'."), DeviceIndex, InDisplayMode);
+		return false;
+	}
+
+	if (!CreateControlBlock(FFrameRate(Descriptor.FrameRateNumerator, Descriptor.FrameRateDenominator), InDisplayMode, InPixelFormat, false))
+	{
+		return false;
+	}
+
+	const BlackmagicDesign::EFieldDominance FieldDominance = Descriptor.bIsInterlacedStandard ? BlackmagicDesign::EFieldDominance::Interlaced
+		: Descriptor.bIsPsfStandard ? BlackmagicDesign::EFieldDominance::ProgressiveSegmentedFrame
+		: BlackmagicDesign::EFieldDominance::Progressive;
+	ControlBlock->FieldDominance = (uint32)FieldDominance;
+
+	BlackmagicDesign::FInputChannelOptions ChannelOptions;
+	ChannelOptions.FormatInfo.FrameRateNumerator = Descriptor.FrameRateNumerator;
+	ChannelOptions.FormatInfo.FrameRateDenominator = Descriptor.FrameRateDenominator;
+	ChannelOptions.FormatInfo.Width = Descriptor.ResolutionWidth;
+	ChannelOptions.FormatInfo.Height = Descriptor.ResolutionHeight;
+	ChannelOptions.FormatInfo.FieldDominance = FieldDominance;
+	ChannelOptions.FormatInfo.DisplayMode = InDisplayMode;
+	ChannelOptions.bReadVideo = true;
+	ChannelOptions.PixelFormat = InPixelFormat;
+	ChannelOptions.TimecodeFormat = InTimecodeFormat;
+	ChannelOptions.bReadAudio = false;
+
+	BlackmagicDesign::FChannelInfo ChannelInfo;
+	ChannelInfo.DeviceIndex = DeviceIndex;
+
+	InputCallback = new FBlackmagicBrokerInputCallback(this);
+	InputCallback->AddRef();
+
+	BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> CallbackRef(InputCallback);
+	InputIdentifier = BlackmagicDesign::RegisterCallbackForChannel(ChannelInfo, ChannelOptions, CallbackRef);
+	if (!InputIdentifier.IsValid())
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't start the broker. The device '%d' couldn't be opened."), DeviceIndex);
+		return false;
+	}
+
+	UE_LOG(LogBlackmagicMedia, Log, TEXT("Started the broker of device '%d' (%dx%d %s)."), DeviceIndex, Descriptor.ResolutionWidth, Descriptor.ResolutionHeight, *FrameRate.ToPrettyText().ToString());
+	return true;
+}
+
+bool FBlackmagicBrokerHost::OpenSimulatedDevice(uint32 InWidth, uint32 InHeight, const FFrameRate& InFrameRate, BlackmagicDesign::EPixelFormat InPixelFormat)
+{
+	if (!CreateControlBlock(InFrameRate, 0, InPixelFormat, true))
+	{
+		return false;
+	}
+
+	SimulatedDevice = MakeUnique<FBlackmagicSimulatedDevice>(InWidth, InHeight, InFrameRate, InPixelFormat, [this](const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo)
+	{
+		OnFrameReceived(InFrameInfo);
+	});
+	SimulatedDevice->Start();
+
+	UE_LOG(LogBlackmagicMedia, Log, TEXT("Started the simulated broker of device '%d' (%dx%d %s)."), DeviceIndex, SimulatedDevice->GetWidth(), SimulatedDevice->GetHeight(), *FrameRate.ToPrettyText().ToString());
+	return true;
+}
+
+bool FBlackmagicBrokerHost::CreateControlBlock(const FFrameRate& InFrameRate, BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat, bool bInIsSimulated)
+{
+	ControlRegion = BlackmagicMediaBrokerHelpers::MapControlBlock(DeviceIndex, true);
+	if (ControlRegion == nullptr)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't create the shared memory region '%s'."), *BlackmagicMediaBroker::GetControlName(DeviceIndex));
+		return false;
+	}
+
+	FrameRate = InFrameRate;
+	ControlBlock = reinterpret_cast<FBlackmagicBrokerControlBlock*>(ControlRegion->GetAddress());
+
+	// Keep the subscribers of a previous host, they reconnect to this one
+	FBlackmagicBrokerControlBlock::FSubscriber Subscribers[BlackmagicMediaBroker::MaxSubscribers];
+	const bool bHadSubscribers = ControlBlock->Magic == BlackmagicMediaBroker::ControlMagic && ControlBlock->Version == BlackmagicMediaBroker::ControlVersion;
+	if (bHadSubscribers)
+	{
+		FMemory::Memcpy(Subscribers, (const void*)ControlBlock->Subscribers, sizeof(Subscribers));
+	}
+
+	FMemory::Memzero(ControlBlock, sizeof(FBlackmagicBrokerControlBlock));
+	ControlBlock->Magic = BlackmagicMediaBroker::ControlMagic;
+	ControlBlock->Version = BlackmagicMediaBroker::ControlVersion;
+	ControlBlock->HostProcessId = FPlatformProcess::GetCurrentProcessId();
+	ControlBlock->DeviceIndex = DeviceIndex;
+	ControlBlock->FrameRateNumerator = InFrameRate.Numerator;
+	ControlBlock->FrameRateDenominator = InFrameRate.Denominator;
+	ControlBlock->DisplayMode = InDisplayMode;
+	ControlBlock->PixelFormat = (uint32)InPixelFormat;
+	ControlBlock->FieldDominance = (uint32)BlackmagicDesign::EFieldDominance::Progressive;
+	ControlBlock->bIsSimulated = bInIsSimulated ? 1 : 0;
+	if (bHadSubscribers)
+	{
+		FMemory::Memcpy((void*)ControlBlock->Subscribers, Subscribers, sizeof(Subscribers));
+	}
+	FPlatformMisc::MemoryBarrier();
+	FPlatformAtomics::InterlockedExchange(&ControlBlock->HostHeartbeat, (int64)FPlatformTime::Cycles64());
+
+	// The heartbeat is also updated by the frames, the thread covers the time without input
+	Heartbeat = MakeUnique<FBlackmagicBrokerHeartbeat>(&ControlBlock->HostHeartbeat);
+	return true;
+}
+
+void FBlackmagicBrokerHost::OnFrameReceived(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo)
+{
+	const bool bHasVideo = InFrameInfo.bHasInputSource && InFrameInfo.VideoBuffer != nullptr;
+	if (bHasVideo)
+	{
+		const uint64 VideoSize = uint64(InFrameInfo.VideoPitch) * InFrameInfo.VideoHeight;
+		if (!Writer.IsOpen())
+		{
+			// The ring is sized for the first frame; a format change stops the subscribers anyway
+			Writer.Open(BlackmagicMediaBroker::GetFrameRingName(DeviceIndex), BlackmagicMediaBroker::NumSlots, VideoSize);
+		}
+
+		if (VideoSize <= Writer.GetSlotCapacity())
+		{
+			BlackmagicDesign::FTimecode FrameTimecode = InFrameInfo.Timecode;
+
+			FBlackmagicSharedFrame Frame;
+			Frame.FrameNumber = InFrameInfo.FrameNumber;
+			if (InFrameInfo.bHaveTimecode)
+			{
+				Frame.Timecode = FTimecode(FrameTimecode.Hours, FrameTimecode.Minutes, FrameTimecode.Seconds, FrameTimecode.Frames, FrameTimecode.bIsDropFrame);
+			}
+			Frame.PixelFormat = InFrameInfo.PixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? EBlackmagicRecordingPixelFormat::UYVY : EBlackmagicRecordingPixelFormat::V210;
+			Frame.Width = InFrameInfo.VideoWidth;
+			Frame.Height = InFrameInfo.VideoHeight;
+			Frame.Pitch = InFrameInfo.VideoPitch;
+			Frame.FrameRate = FrameRate;
+			Frame.bIsInterlaced = InFrameInfo.FieldDominance == BlackmagicDesign::EFieldDominance::Interlaced;
+			Frame.VideoBuffer = reinterpret_cast<const uint8*>(InFrameInfo.VideoBuffer);
+			Frame.VideoSize = VideoSize;
+			Writer.Publish(Frame);
+		}
+		else if (!bHasWarnedFrameTooLarge)
+		{
+			bHasWarnedFrameTooLarge = true;
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("The broker of device '%d' received a frame larger than its shared memory ring. The frame is not forwarded."), DeviceIndex);
+		}
+	}
+
+	FPlatformAtomics::InterlockedExchange(&ControlBlock->bHasInputSource, bHasVideo ? 1 : 0);
+	FPlatformAtomics::InterlockedIncrement(&ControlBlock->NumFrames);
+	FPlatformAtomics::InterlockedExchange(&ControlBlock->HostHeartbeat, (int64)FPlatformTime::Cycles64());
+	SignalSubscribers();
+}
+
+void FBlackmagicBrokerHost::OnOddField()
+{
+	FPlatformAtomics::InterlockedIncrement(&ControlBlock->NumOddFields);
+	SignalSubscribers();
+}
+
+void FBlackmagicBrokerHost::OnFormatChanged(const BlackmagicDesign::FFormatInfo& InFormat)
+{
+	ControlBlock->FrameRateNumerator = InFormat.FrameRateNumerator;
+	ControlBlock->FrameRateDenominator = InFormat.FrameRateDenominator;
+	ControlBlock->DisplayMode = InFormat.DisplayMode;
+	ControlBlock->FieldDominance = (uint32)InFormat.FieldDominance;
+	FPlatformMisc::MemoryBarrier();
+	FPlatformAtomics::InterlockedIncrement(&ControlBlock->NumFormatChanges);
+	SignalSubscribers();
+
+	UE_LOG(LogBlackmagicMedia, Warning, TEXT("The video format of the broker of device '%d' changed."), DeviceIndex);
+}
+
+void FBlackmagicBrokerHost::SignalSubscribers()
+{
+	FScopeLock Lock(&SignalLock);
+
+	for (int32 Index = 0; Index < BlackmagicMediaBroker::MaxSubscribers; ++Index)
+	{
+		FBlackmagicBrokerControlBlock::FSubscriber& Subscriber = ControlBlock->Subscribers[Index];
+		const int32 ProcessId = BlackmagicMediaBrokerHelpers::ReadShared(&Subscriber.ProcessId);
+		const int32 Generation = BlackmagicMediaBrokerHelpers::ReadShared(&Subscriber.Generation);
+		if (ProcessId != SignalProcessIds[Index] || Generation != SignalGenerations[Index])
+		{
+			if (Signals[Index])
+			{
+				FPlatformProcess::DeleteInterprocessSynchObject(Signals[Index]);
+				Signals[Index] = nullptr;
+			}
+
+			// The subscriber creates its semaphore before claiming the slot
+			SignalProcessIds[Index] = ProcessId;
+			SignalGenerations[Index] = Generation;
+			if (ProcessId != 0)
+			{
+				Signals[Index] = FPlatformProcess::NewInterprocessSynchObject(BlackmagicMediaBroker::GetSignalName(DeviceIndex, Index), false, BlackmagicMediaBroker::SignalMaxCount);
+			}
+		}
+
+		// A subscriber that stopped draining its semaphore would saturate it
+		if (Signals[Index] && BlackmagicMediaBrokerHelpers::IsHeartbeatAlive(&Subscriber.Heartbeat))
+		{
+			Signals[Index]->Unlock();
+		}
+	}
+}
+
+/* FBlackmagicBrokerClient
+*****************************************************************************/
+
+FBlackmagicBrokerClient::FBlackmagicBrokerClient(int32 InDeviceIndex, const BlackmagicDesign::FInputChannelOptions& InChannelOptions, BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> InCallback)
+	: DeviceIndex(InDeviceIndex)
+	, ChannelOptions(InChannelOptions)
+	, Callback(MoveTemp(InCallback))
+	, ControlRegion(nullptr)
+	, ControlBlock(nullptr)
+	, Signal(nullptr)
+	, SubscriberIndex(INDEX_NONE)
+	, LastNumOddFields(0)
+	, LastNumFormatChanges(0)
+	, bHasInputSource(false)
+	, Thread(nullptr)
+	, bStopRequested(false)
+	, bHasStopped(false)
+{
+}
+
+FBlackmagicBrokerClient::~FBlackmagicBrokerClient()
+{
+	Shutdown();
+}
+
+bool FBlackmagicBrokerClient::Start()
+{
+	ControlRegion = BlackmagicMediaBrokerHelpers::MapControlBlock(DeviceIndex, false);
+	if (ControlRegion == nullptr)
+	{
+		return false;
+	}
+
+	ControlBlock = reinterpret_cast<FBlackmagicBrokerControlBlock*>(ControlRegion->GetAddress());
+	if (ControlBlock->Magic != BlackmagicMediaBroker::ControlMagic || ControlBlock->Version != BlackmagicMediaBroker::ControlVersion || !ClaimSlot())
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't subscribe to the broker of device '%d'."), DeviceIndex);
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(ControlRegion);
+		ControlRegion = nullptr;
+		ControlBlock = nullptr;
+		return false;
+	}
+
+	bStopRequested = false;
+	bHasStopped = false;
+	Thread = FRunnableThread::Create(this, TEXT("BlackmagicBrokerClient"), 0, TPri_TimeCritical);
+	return true;
+}
+
+void FBlackmagicBrokerClient::RequestStop()
+{
+	bStopRequested = true;
+}
+
+void FBlackmagicBrokerClient::Shutdown()
+{
+	if (Thread)
+	{
+		// Run reports the shutdown itself
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+
+	ReleaseSlot();
+	Reader.Close();
+
+	if (ControlRegion)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(ControlRegion);
+		ControlRegion = nullptr;
+		ControlBlock = nullptr;
+	}
+}
+
+bool FBlackmagicBrokerClient::ClaimSlot()
+{
+	const int32 ProcessId = FPlatformProcess::GetCurrentProcessId();
+	for (int32 Index = 0; Index < BlackmagicMediaBroker::MaxSubscribers; ++Index)
+	{
+		FBlackmagicBrokerControlBlock::FSubscriber& Subscriber = ControlBlock->Subscribers[Index];
+		const int32 Owner = BlackmagicMediaBrokerHelpers::ReadShared(&Subscriber.ProcessId);
+		if (Owner != 0 && BlackmagicMediaBrokerHelpers::IsHeartbeatAlive(&Subscriber.Heartbeat))
+		{
+			continue;
+		}
+
+		// Create the semaphore first, the host opens it as soon as the slot is claimed
+		FSemaphore* NewSignal = FPlatformProcess::NewInterprocessSynchObject(BlackmagicMediaBroker::GetSignalName(DeviceIndex, Index), true, BlackmagicMediaBroker::SignalMaxCount);
+		if (NewSignal == nullptr)
+		{
+			continue;
+		}
+
+		FPlatformAtomics::InterlockedExchange(&Subscriber.Heartbeat, (int64)FPlatformTime::Cycles64());
+		FPlatformAtomics::InterlockedIncrement(&Subscriber.Generation);
+		if (FPlatformAtomics::InterlockedCompareExchange(&Subscriber.ProcessId, ProcessId, Owner) == Owner)
+		{
+			Signal = NewSignal;
+			SubscriberIndex = Index;
+
+			// The semaphore may be created with its maximum count
+			while (Signal->TryLock(0))
+			{
+			}
+			return true;
+		}
+
+		FPlatformProcess::DeleteInterprocessSynchObject(NewSignal);
+	}
+
+	return false;
+}
+
+void FBlackmagicBrokerClient::ReleaseSlot()
+{
+	if (SubscriberIndex != INDEX_NONE)
+	{
+		FPlatformAtomics::InterlockedExchange(&ControlBlock->Subscribers[SubscriberIndex].ProcessId, 0);
+		SubscriberIndex = INDEX_NONE;
+	}
+
+	if (Signal)
+	{
+		FPlatformProcess::DeleteInterprocessSynchObject(Signal);
+		Signal = nullptr;
+	}
+}
+
+bool FBlackmagicBrokerClient::IsHostAlive() const
+{
+	return BlackmagicMediaBrokerHelpers::IsHeartbeatAlive(&ControlBlock->HostHeartbeat);
+}
+
+bool FBlackmagicBrokerClient::IsFormatCompatible() const
+{
+	if (ChannelOptions.bReadVideo && (uint32)ChannelOptions.PixelFormat != ControlBlock->PixelFormat)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("The broker of device '%d' doesn't provide the requested pixel format."), DeviceIndex);
+		return false;
+	}
+
+	// A simulated device provides its frames whatever the requested mode
+	if (ControlBlock->bIsSimulated == 0 && ChannelOptions.FormatInfo.DisplayMode != ControlBlock->DisplayMode)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("The broker of device '%d' provides the display mode '0x%08x', not '0x%08x'."), DeviceIndex, ControlBlock->DisplayMode, ChannelOptions.FormatInfo.DisplayMode);
+		return false;
+	}
+
+	return true;
+}
+
+uint32 FBlackmagicBrokerClient::Run()
+{
+	const uint64 WaitNanoseconds = 100 * 1000 * 1000;
+	bool bIsInitialized = false;
+
+	while (!bStopRequested)
+	{
+		if (Signal->TryLock(WaitNanoseconds))
+		{
+			// Edges are coalesced, only the latest state is delivered
+			while (Signal->TryLock(0))
+			{
+			}
+		}
+
+		if (bStopRequested)
+		{
+			break;
+		}
+
+		FPlatformAtomics::InterlockedExchange(&ControlBlock->Subscribers[SubscriberIndex].Heartbeat, (int64)FPlatformTime::Cycles64());
+
+		if (!IsHostAlive())
+		{
+			// The host died before the subscription started, the channel can't be opened
+			if (!bIsInitialized)
+			{
+				UE_LOG(LogBlackmagicMedia, Error, TEXT("The broker of device '%d' is not responding."), DeviceIndex);
+				Callback->OnInitializationCompleted(false);
+				break;
+			}
+
+			if (bHasInputSource)
+			{
+				UE_LOG(LogBlackmagicMedia, Warning, TEXT("The broker of device '%d' stopped responding."), DeviceIndex);
+				DeliverNoInputSource();
+			}
+			continue;
+		}
+
+		if (!bIsInitialized)
+		{
+			bIsInitialized = true;
+			LastNumOddFields = BlackmagicMediaBrokerHelpers::ReadShared(&ControlBlock->NumOddFields);
+			LastNumFormatChanges = BlackmagicMediaBrokerHelpers::ReadShared(&ControlBlock->NumFormatChanges);
+
+			const bool bSuccess = IsFormatCompatible();
+			Callback->OnInitializationCompleted(bSuccess);
+			if (!bSuccess)
+			{
+				break;
+			}
+		}
+
+		const int64 NumFormatChanges = BlackmagicMediaBrokerHelpers::ReadShared(&ControlBlock->NumFormatChanges);
+		if (NumFormatChanges != LastNumFormatChanges)
+		{
+			LastNumFormatChanges = NumFormatChanges;
+
+			BlackmagicDesign::FFormatInfo FormatInfo;
+			FormatInfo.FrameRateNumerator = ControlBlock->FrameRateNumerator;
+			FormatInfo.FrameRateDenominator = ControlBlock->FrameRateDenominator;
+			FormatInfo.Width = 0;
+			FormatInfo.Height = 0;
+			FormatInfo.FieldDominance = (BlackmagicDesign::EFieldDominance)ControlBlock->FieldDominance;
+			FormatInfo.DisplayMode = ControlBlock->DisplayMode;
+			Callback->OnFrameFormatChanged(FormatInfo);
+		}
+
+		DeliverLatestFrame();
+
+		const int64 NumOddFields = BlackmagicMediaBrokerHelpers::ReadShared(&ControlBlock->NumOddFields);
+		if (NumOddFields != LastNumOddFields)
+		{
+			LastNumOddFields = NumOddFields;
+			Callback->OnInterlacedOddFieldEvent();
+		}
+	}
+
+	// A failed subscription is only shut down once its owner unregisters it
+	while (!bStopRequested)
+	{
+		FPlatformProcess::Sleep(0.01f);
+	}
+
+	Callback->OnShutdownCompleted();
+	ReleaseSlot();
+	bHasStopped = true;
+	return 0;
+}
+
+void FBlackmagicBrokerClient::DeliverLatestFrame()
+{
+	if (BlackmagicMediaBrokerHelpers::ReadShared(&ControlBlock->bHasInputSource) == 0)
+	{
+		if (bHasInputSource)
+		{
+			DeliverNoInputSource();
+		}
+		return;
+	}
+
+	if (!Reader.IsOpen() && !Reader.Open(BlackmagicMediaBroker::GetFrameRingName(DeviceIndex)))
+	{
+		return;
+	}
+
+	// Without video only the timecode is needed, it is read in place
+	FBlackmagicSharedFrame Frame;
+	if (ChannelOptions.bReadVideo)
+	{
+		if (!Reader.CopyLatest(Frame, FrameBuffer))
+		{
+			return;
+		}
+	}
+	else
+	{
+		int64 Sequence = 0;
+		if (!Reader.AcquireLatest(Frame, Sequence) || !Reader.IsStillValid(Sequence))
+		{
+			return;
+		}
+	}
+
+	BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo FrameInfo;
+	FrameInfo.bHasInputSource = true;
+	FrameInfo.FrameNumber = Frame.FrameNumber;
+	FrameInfo.bHaveTimecode = Frame.Timecode.IsSet() && ChannelOptions.TimecodeFormat != BlackmagicDesign::ETimecodeFormat::TCF_None;
+	if (FrameInfo.bHaveTimecode)
+	{
+		FrameInfo.Timecode.Hours = Frame.Timecode->Hours;
+		FrameInfo.Timecode.Minutes = Frame.Timecode->Minutes;
+		FrameInfo.Timecode.Seconds = Frame.Timecode->Seconds;
+		FrameInfo.Timecode.Frames = Frame.Timecode->Frames;
+		FrameInfo.Timecode.bIsDropFrame = Frame.Timecode->bDropFrameFormat;
+	}
+	if (ChannelOptions.bReadVideo)
+	{
+		FrameInfo.VideoBuffer = FrameBuffer.GetData();
+		FrameInfo.VideoWidth = Frame.Width;
+		FrameInfo.VideoHeight = Frame.Height;
+		FrameInfo.VideoPitch = Frame.Pitch;
+		FrameInfo.PixelFormat = Frame.PixelFormat == EBlackmagicRecordingPixelFormat::UYVY ? BlackmagicDesign::EPixelFormat::pf_8Bits : BlackmagicDesign::EPixelFormat::pf_10Bits;
+		FrameInfo.FieldDominance = Frame.bIsInterlaced ? BlackmagicDesign::EFieldDominance::Interlaced : (BlackmagicDesign::EFieldDominance)ControlBlock->FieldDominance;
+	}
+	else
+	{
+		FrameInfo.VideoBuffer = nullptr;
+	}
+	FrameInfo.AudioBuffer = nullptr;
+	FrameInfo.AudioBufferSize = 0;
+
+	bHasInputSource = true;
+	Callback->OnFrameReceived(FrameInfo);
+}
+
+void FBlackmagicBrokerClient::DeliverNoInputSource()
+{
+	bHasInputSource = false;
+
+	BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo FrameInfo;
+	FrameInfo.bHasInputSource = false;
+	FrameInfo.VideoBuffer = nullptr;
+	FrameInfo.AudioBuffer = nullptr;
+	Callback->OnFrameReceived(FrameInfo);
+}
+
+/* BlackmagicMediaBackend
+*****************************************************************************/
+
+namespace BlackmagicMediaBackendHelpers
+{
+	struct FBrokerRegistration
+	{
+		BlackmagicDesign::FUniqueIdentifier Identifier;
+		TUniquePtr<FBlackmagicBrokerClient> Client;
+	};
+
+	FCriticalSection RegistrationLock;
+	TArray<FBrokerRegistration> Registrations;
+
+	/** Unregistered clients whose thread may still run, deleted once it ended. Protected by RegistrationLock. */
+	TArray<TUniquePtr<FBlackmagicBrokerClient>> StoppingClients;
+
+	/** Delete the clients whose thread ended, it doesn't wait for them. Called under RegistrationLock. */
+	void DeleteStoppedClients()
+	{
+		StoppingClients.RemoveAll([](const TUniquePtr<FBlackmagicBrokerClient>& InClient) { return InClient->HasStopped(); });
+	}
+
+	/** Far from the identifiers of the library so both can't be mistaken */
+	int32 NextIdentifier = 1 << 24;
+}
+
+namespace BlackmagicMediaBackend
+{
+	BlackmagicDesign::FUniqueIdentifier RegisterCallbackForChannel(const BlackmagicDesign::FChannelInfo& InChannelInfo, const BlackmagicDesign::FInputChannelOptions& InChannelOptions, BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> InCallback)
+	{
+		const bool bUseBroker = BlackmagicMediaBrokerHelpers::CVarBrokerClient.GetValueOnAnyThread() != 0
+			&& !BlackmagicMediaBroker::IsHostingDevice(InChannelInfo.DeviceIndex)
+			&& BlackmagicMediaBroker::IsBrokerAvailable(InChannelInfo.DeviceIndex);
+
+		if (!bUseBroker)
+		{
+			return BlackmagicDesign::RegisterCallbackForChannel(InChannelInfo, InChannelOptions, InCallback);
+		}
+
+		TUniquePtr<FBlackmagicBrokerClient> Client = MakeUnique<FBlackmagicBrokerClient>(InChannelInfo.DeviceIndex, InChannelOptions, InCallback);
+		if (!Client->Start())
+		{
+			// Every slot of the broker may be used, the device may still be free in the library
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("The input of device '%d' is opened in the Blackmagic library instead of the broker of another process."), InChannelInfo.DeviceIndex);
+			return BlackmagicDesign::RegisterCallbackForChannel(InChannelInfo, InChannelOptions, InCallback);
+		}
+
+		UE_LOG(LogBlackmagicMedia, Log, TEXT("The input of device '%d' is provided by the broker of another process."), InChannelInfo.DeviceIndex);
+
+		FScopeLock Lock(&BlackmagicMediaBackendHelpers::RegistrationLock);
+		BlackmagicMediaBackendHelpers::DeleteStoppedClients();
+		BlackmagicMediaBackendHelpers::FBrokerRegistration& Registration = BlackmagicMediaBackendHelpers::Registrations.AddDefaulted_GetRef();
+		Registration.Identifier = BlackmagicDesign::FUniqueIdentifier(BlackmagicMediaBackendHelpers::NextIdentifier++);
+		Registration.Client = MoveTemp(Client);
+		return Registration.Identifier;
+	}
+
+	void UnregisterCallbackForChannel(const BlackmagicDesign::FChannelInfo& InChannelInfo, BlackmagicDesign::FUniqueIdentifier InIdentifier)
+	{
+		bool bIsBrokerChannel = false;
+		{
+			FScopeLock Lock(&BlackmagicMediaBackendHelpers::RegistrationLock);
+			BlackmagicMediaBackendHelpers::DeleteStoppedClients();
+
+			const int32 Index = BlackmagicMediaBackendHelpers::Registrations.IndexOfByPredicate([&](const BlackmagicMediaBackendHelpers::FBrokerRegistration& Registration) { return Registration.Identifier == InIdentifier; });
+			if (Index != INDEX_NONE)
+			{
+				// The client thread may be blocked in the callback on a lock the caller holds, joining it here would never return.
+				// The callback holds its own reference, it outlives the thread.
+				TUniquePtr<FBlackmagicBrokerClient> Client = MoveTemp(BlackmagicMediaBackendHelpers::Registrations[Index].Client);
+				BlackmagicMediaBackendHelpers::Registrations.RemoveAtSwap(Index);
+				Client->RequestStop();
+				BlackmagicMediaBackendHelpers::StoppingClients.Add(MoveTemp(Client));
+				bIsBrokerChannel = true;
+			}
+		}
+
+		if (!bIsBrokerChannel)
+		{
+			BlackmagicDesign::UnregisterCallbackForChannel(InChannelInfo, InIdentifier);
+		}
+	}
+
+	void Shutdown()
+	{
+		TArray<TUniquePtr<FBlackmagicBrokerClient>> Clients;
+		{
+			FScopeLock Lock(&BlackmagicMediaBackendHelpers::RegistrationLock);
+			Clients = MoveTemp(BlackmagicMediaBackendHelpers::StoppingClients);
+			for (BlackmagicMediaBackendHelpers::FBrokerRegistration& Registration : BlackmagicMediaBackendHelpers::Registrations)
+			{
+				Registration.Client->RequestStop();
+				Clients.Add(MoveTemp(Registration.Client));
+			}
+			BlackmagicMediaBackendHelpers::Registrations.Reset();
+		}
+
+		// Deleting a client waits for its thread
+		Clients.Reset();
+	}
+}
+
+/* Console commands
+*****************************************************************************/
+
+namespace BlackmagicMediaBrokerHelpers
+{
+	BlackmagicDesign::EPixelFormat ParsePixelFormat(const TArray<FString>& InArgs, int32 InIndex)
+	{
+		return (InArgs.IsValidIndex(InIndex) && FCString::Atoi(*InArgs[InIndex]) == 10) ? BlackmagicDesign::EPixelFormat::pf_10Bits : BlackmagicDesign::EPixelFormat::pf_8Bits;
+	}
+
+	void StartHostCommand(const TArray<FString>& InArgs)
+	{
+		if (InArgs.Num() < 2)
+		{
+			UE_LOG(LogBlackmagicMedia, Display, TEXT("Usage: Blackmagic.Broker.Start <DeviceIndex> <DisplayMode> [8|10] [LTC|VITC|None]"));
+			return;
+		}
+
+		BlackmagicDesign::ETimecodeFormat TimecodeFormat = BlackmagicDesign::ETimecodeFormat::TCF_LTC;
+		if (InArgs.IsValidIndex(3))
+		{
+			TimecodeFormat = InArgs[3] == TEXT("VITC") ? BlackmagicDesign::ETimecodeFormat::TCF_VITC1
+				: InArgs[3] == TEXT("None") ? BlackmagicDesign::ETimecodeFormat::TCF_None
+				: BlackmagicDesign::ETimecodeFormat::TCF_LTC;
+		}
+
+		BlackmagicMediaBroker::StartHost(FCString::Atoi(*InArgs[0]), FCString::Strtoi(*InArgs[1], nullptr, 0), ParsePixelFormat(InArgs, 2), TimecodeFormat);
+	}
+
+	void StartSimulatedHostCommand(const TArray<FString>& InArgs)
+	{
+		if (InArgs.Num() < 1)
+		{
+			UE_LOG(LogBlackmagicMedia, Display, TEXT("Usage: Blackmagic.Broker.StartSimulated <DeviceIndex> [Width=1920] [Height=1080] [FrameRate=30] [8|10]"));
+			return;
+		}
+
+		const uint32 Width = InArgs.IsValidIndex(1) ? FCString::Atoi(*InArgs[1]) : 1920;
+		const uint32 Height = InArgs.IsValidIndex(2) ? FCString::Atoi(*InArgs[2]) : 1080;
+
+		FFrameRate FrameRate(30, 1);
+		if (InArgs.IsValidIndex(3))
+		{
+			// 29.97 is given as 30000/1001
+			TryParseString(FrameRate, *InArgs[3]);
+		}
+
+		BlackmagicMediaBroker::StartSimulatedHost(FCString::Atoi(*InArgs[0]), Width, Height, FrameRate, ParsePixelFormat(InArgs, 4));
+	}
+}
+
+static FAutoConsoleCommand BlackmagicBrokerStartCmd(
+	TEXT("Blackmagic.Broker.Start"),
+	TEXT("Open a device and share its input with the other processes. Arguments: <DeviceIndex> <DisplayMode> [8|10] [LTC|VITC|None]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaBrokerHelpers::StartHostCommand)
+	);
+
+static FAutoConsoleCommand BlackmagicBrokerStartSimulatedCmd(
+	TEXT("Blackmagic.Broker.StartSimulated"),
+	TEXT("Share a simulated input with the other processes. Arguments: <DeviceIndex> [Width=1920] [Height=1080] [FrameRate=30] [8|10]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaBrokerHelpers::StartSimulatedHostCommand)
+	);
+
+static FAutoConsoleCommand BlackmagicBrokerStopCmd(
+	TEXT("Blackmagic.Broker.Stop"),
+	TEXT("Stop the broker hosted by this process."),
+	FConsoleCommandDelegate::CreateStatic(&BlackmagicMediaBroker::StopHost)
+	);
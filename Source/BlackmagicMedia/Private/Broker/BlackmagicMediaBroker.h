@@ -0,0 +1,221 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicLib.h"
+#include "BlackmagicMediaSharedFrame.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/Runnable.h"
+#include "Templates/Atomic.h"
+
+class FBlackmagicBrokerHeartbeat;
+class FBlackmagicBrokerInputCallback;
+class FBlackmagicSimulatedDevice;
+class FRunnableThread;
+class FSemaphore;
+
+/**
+ * Device broker. A single process (the host) owns a device through the Blackmagic library and
+ * fans its frames out to the other processes of the machine (the subscribers).
+ *
+ * Per device:
+ *   [Blackmagic_Broker_<Device>]			shared frame ring with the video and the timecode of every frame
+ *   [Blackmagic_Broker_<Device>_Control]	FBlackmagicBrokerControlBlock, format, heartbeats and sync edges
+ *   [Blackmagic_Broker_<Device>_Signal_<N>]	interprocess semaphore of the subscriber N, released on every sync edge
+ *
+ * A subscriber claims a slot of the control block, creates its semaphore and waits on it.
+ * The host never waits on a subscriber: signals are coalesced and a slow subscriber only gets the latest frame.
+ */
+namespace BlackmagicMediaBroker
+{
+	static const uint32 ControlMagic = BlackmagicMediaRecording::MakeFourCC('B', 'M', 'B', 'K');
+	/** Version 2 counts the claims of the subscriber slots */
+	static const uint32 ControlVersion = 2;
+	static const int32 MaxSubscribers = 16;
+	static const uint32 NumSlots = 4;
+
+	/** Signals are counted up to that value. The subscriber drains the count every time it wakes up. */
+	static const uint32 SignalMaxCount = 64;
+
+	/** A host or a subscriber that didn't update its heartbeat for that long is considered gone */
+	static const double HeartbeatTimeout = 2.0;
+
+	FString GetFrameRingName(int32 InDeviceIndex);
+	FString GetControlName(int32 InDeviceIndex);
+	FString GetSignalName(int32 InDeviceIndex, int32 InSubscriberIndex);
+
+	/** @return true if another process hosts a live broker for the device */
+	bool IsBrokerAvailable(int32 InDeviceIndex);
+
+	/** @return true if this process hosts the broker of the device */
+	bool IsHostingDevice(int32 InDeviceIndex);
+
+	bool StartHost(int32 InDeviceIndex, BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat, BlackmagicDesign::ETimecodeFormat InTimecodeFormat);
+	bool StartSimulatedHost(int32 InDeviceIndex, uint32 InWidth, uint32 InHeight, const FFrameRate& InFrameRate, BlackmagicDesign::EPixelFormat InPixelFormat);
+	void StopHost();
+
+	/** Start the host requested with -BlackmagicBroker=<Device> [-BlackmagicBrokerMode=<DisplayMode>] [-BlackmagicBrokerSimulated] */
+	void StartHostFromCommandLine();
+}
+
+struct FBlackmagicBrokerControlBlock
+{
+	struct FSubscriber
+	{
+		/** 0 when the slot is free */
+		volatile int32 ProcessId;
+
+		/** Incremented by every claim, so the host opens the new semaphore of a process that claims the same slot again */
+		volatile int32 Generation;
+		volatile int64 Heartbeat;
+	};
+
+	uint32 Magic;
+	uint32 Version;
+	uint32 HostProcessId;
+	int32 DeviceIndex;
+
+	/** FPlatformTime::Cycles64 of the last update of the host */
+	volatile int64 HostHeartbeat;
+
+	/** Number of frames and odd fields received by the host */
+	volatile int64 NumFrames;
+	volatile int64 NumOddFields;
+	volatile int64 NumFormatChanges;
+	volatile int32 bHasInputSource;
+
+	uint32 FrameRateNumerator;
+	uint32 FrameRateDenominator;
+	int32 DisplayMode;
+	uint32 PixelFormat;
+	uint32 FieldDominance;
+	uint32 bIsSimulated;
+	uint32 Reserved;
+
+	FSubscriber Subscribers[BlackmagicMediaBroker::MaxSubscribers];
+};
+static_assert(sizeof(FBlackmagicBrokerControlBlock) % 8 == 0, "The broker control block is shared with other processes.");
+
+/**
+ * Owner of the device in the host process. Frames come from the Blackmagic library or from a simulated device.
+ */
+class FBlackmagicBrokerHost
+{
+public:
+	FBlackmagicBrokerHost(int32 InDeviceIndex);
+	~FBlackmagicBrokerHost();
+
+	bool OpenDevice(BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat, BlackmagicDesign::ETimecodeFormat InTimecodeFormat);
+	bool OpenSimulatedDevice(uint32 InWidth, uint32 InHeight, const FFrameRate& InFrameRate, BlackmagicDesign::EPixelFormat InPixelFormat);
+
+	int32 GetDeviceIndex() const { return DeviceIndex; }
+
+	/** Called on the device thread */
+	void OnFrameReceived(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo);
+	void OnOddField();
+	void OnFormatChanged(const BlackmagicDesign::FFormatInfo& InFormat);
+
+private:
+	bool CreateControlBlock(const FFrameRate& InFrameRate, BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat, bool bInIsSimulated);
+	void SignalSubscribers();
+
+private:
+	int32 DeviceIndex;
+	FFrameRate FrameRate;
+
+	FPlatformMemory::FSharedMemoryRegion* ControlRegion;
+	FBlackmagicBrokerControlBlock* ControlBlock;
+	FBlackmagicSharedFrameWriter Writer;
+
+	/** Semaphore of each subscriber slot, opened for the process that owns the slot */
+	FCriticalSection SignalLock;
+	FSemaphore* Signals[BlackmagicMediaBroker::MaxSubscribers];
+	int32 SignalProcessIds[BlackmagicMediaBroker::MaxSubscribers];
+	int32 SignalGenerations[BlackmagicMediaBroker::MaxSubscribers];
+
+	FBlackmagicBrokerInputCallback* InputCallback;
+	BlackmagicDesign::FUniqueIdentifier InputIdentifier;
+	TUniquePtr<FBlackmagicSimulatedDevice> SimulatedDevice;
+
+	/** Keeps the host alive for the subscribers when there's no input, whatever the game thread is doing */
+	TUniquePtr<FBlackmagicBrokerHeartbeat> Heartbeat;
+	bool bHasWarnedFrameTooLarge;
+};
+
+/**
+ * Subscriber side of a broker. Behaves like a channel registered in the Blackmagic library:
+ * the callback receives OnInitializationCompleted, OnFrameReceived, OnInterlacedOddFieldEvent and OnShutdownCompleted
+ * on a thread of the subscriber. Audio is not forwarded.
+ */
+class FBlackmagicBrokerClient : public FRunnable
+{
+public:
+	FBlackmagicBrokerClient(int32 InDeviceIndex, const BlackmagicDesign::FInputChannelOptions& InChannelOptions, BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> InCallback);
+	virtual ~FBlackmagicBrokerClient();
+
+	/** Claim a subscriber slot and start the delivery thread. */
+	bool Start();
+
+	/** Stop the delivery thread and release the subscriber slot. Waits for the thread, never call it while the callback may be blocked. */
+	void Shutdown();
+
+	/**
+	 * Ask the delivery thread to stop, without waiting for it. The callback may still receive the event it is delivering.
+	 * The thread reports OnShutdownCompleted and releases the slot before it ends.
+	 */
+	void RequestStop();
+
+	/** Whether the delivery thread ended, the client can then be deleted without waiting */
+	bool HasStopped() const { return bHasStopped; }
+
+private:
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override { bStopRequested = true; }
+
+	bool ClaimSlot();
+	void ReleaseSlot();
+	bool IsHostAlive() const;
+	bool IsFormatCompatible() const;
+	void DeliverLatestFrame();
+	void DeliverNoInputSource();
+
+private:
+	int32 DeviceIndex;
+	BlackmagicDesign::FInputChannelOptions ChannelOptions;
+	BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> Callback;
+
+	FPlatformMemory::FSharedMemoryRegion* ControlRegion;
+	FBlackmagicBrokerControlBlock* ControlBlock;
+	FBlackmagicSharedFrameReader Reader;
+	FSemaphore* Signal;
+	int32 SubscriberIndex;
+
+	/** The frame is copied out of the ring so the host can't overwrite it while the callback uses it */
+	TArray<uint8> FrameBuffer;
+	int64 LastNumOddFields;
+	int64 LastNumFormatChanges;
+	bool bHasInputSource;
+
+	FRunnableThread* Thread;
+	TAtomic<bool> bStopRequested;
+	TAtomic<bool> bHasStopped;
+};
+
+/**
+ * Input channels of the plugin go through here. A device served by a broker of another process is opened
+ * as a subscriber of that broker, any other device is opened in the Blackmagic library.
+ */
+namespace BlackmagicMediaBackend
+{
+	BlackmagicDesign::FUniqueIdentifier RegisterCallbackForChannel(const BlackmagicDesign::FChannelInfo& InChannelInfo, const BlackmagicDesign::FInputChannelOptions& InChannelOptions, BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> InCallback);
+	/**
+	 * A channel of a broker is stopped without waiting for its thread: the owner may hold the lock its callback waits for.
+	 * The callback must ignore the events that arrive after this call, as it keeps a reference until the thread ends.
+	 */
+	void UnregisterCallbackForChannel(const BlackmagicDesign::FChannelInfo& InChannelInfo, BlackmagicDesign::FUniqueIdentifier InIdentifier);
+
+	/** Wait for the threads of the unregistered broker channels. Called when the module shuts down, no lock is held. */
+	void Shutdown();
+}
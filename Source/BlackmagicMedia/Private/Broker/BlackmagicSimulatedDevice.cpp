@@ -0,0 +1,190 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicSimulatedDevice.h"
+
+#include "BlackmagicMediaPrivate.h"
+
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/Timecode.h"
+
+
+namespace BlackmagicSimulatedDeviceHelpers
+{
+	/** 75% color bars, Rec. 709 video range Y Cb Cr */
+	static const uint8 Bars[8][3] =
+	{
+		{ 180, 128, 128 },	// White
+		{ 168, 44, 136 },	// Yellow
+		{ 145, 147, 44 },	// Cyan
+		{ 133, 63, 52 },	// Green
+		{ 63, 193, 204 },	// Magenta
+		{ 51, 109, 212 },	// Red
+		{ 28, 212, 120 },	// Blue
+		{ 16, 128, 128 },	// Black
+	};
+
+	static const uint8 MovingBar[3] = { 235, 128, 128 };
+
+	/** Pixels are moved in groups of 6 so the bar stays aligned on v210 blocks */
+	static const uint32 PixelAlignment = 6;
+
+	uint32 GetPitch(uint32 InWidth, BlackmagicDesign::EPixelFormat InPixelFormat)
+	{
+		return InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? InWidth * 2 : Align(FMath::DivideAndRoundUp<uint32>(InWidth, 6) * 16, 128);
+	}
+
+	uint32 GetByteOffset(uint32 InPixel, BlackmagicDesign::EPixelFormat InPixelFormat)
+	{
+		return InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? InPixel * 2 : (InPixel / 6) * 16;
+	}
+
+	/** Pack a line of Cb Y Cr Y components, given as 8 bits values */
+	void PackLine(const TArray<uint8>& InComponents, BlackmagicDesign::EPixelFormat InPixelFormat, uint8* OutLine)
+	{
+		if (InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits)
+		{
+			FMemory::Memcpy(OutLine, InComponents.GetData(), InComponents.Num());
+			return;
+		}
+
+		uint32* Words = reinterpret_cast<uint32*>(OutLine);
+		for (int32 Index = 0; Index + 2 < InComponents.Num(); Index += 3)
+		{
+			*Words++ = (uint32(InComponents[Index]) << 2) | (uint32(InComponents[Index + 1]) << 12) | (uint32(InComponents[Index + 2]) << 22);
+		}
+	}
+
+	void BuildLine(uint32 InWidth, BlackmagicDesign::EPixelFormat InPixelFormat, TFunctionRef<const uint8*(uint32)> InColorForPixel, uint8* OutLine)
+	{
+		// v210 lines are made of blocks of 6 pixels
+		const uint32 NumPixels = InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? InWidth : FMath::DivideAndRoundUp<uint32>(InWidth, 6) * 6;
+
+		TArray<uint8> Components;
+		Components.SetNumUninitialized(NumPixels * 2);
+		for (uint32 Pixel = 0; Pixel < NumPixels; Pixel += 2)
+		{
+			const uint8* Color = InColorForPixel(FMath::Min(Pixel, InWidth - 1));
+			Components[Pixel * 2 + 0] = Color[1];
+			Components[Pixel * 2 + 1] = Color[0];
+			Components[Pixel * 2 + 2] = Color[2];
+			Components[Pixel * 2 + 3] = Color[0];
+		}
+		PackLine(Components, InPixelFormat, OutLine);
+	}
+}
+
+FBlackmagicSimulatedDevice::FBlackmagicSimulatedDevice(uint32 InWidth, uint32 InHeight, const FFrameRate& InFrameRate, BlackmagicDesign::EPixelFormat InPixelFormat, FOnFrame InOnFrame)
+	: Width(FMath::Max<uint32>(InWidth, BlackmagicSimulatedDeviceHelpers::PixelAlignment))
+	, Height(FMath::Max<uint32>(InHeight, 1))
+	, FrameRate(InFrameRate)
+	, PixelFormat(InPixelFormat)
+	, OnFrame(MoveTemp(InOnFrame))
+	, Thread(nullptr)
+	, bStopRequested(false)
+{
+	using namespace BlackmagicSimulatedDeviceHelpers;
+
+	Pitch = GetPitch(Width, PixelFormat);
+	Background.SetNumZeroed(Pitch * Height);
+	Buffer.SetNumZeroed(Pitch * Height);
+
+	BuildLine(Width, PixelFormat, [this](uint32 Pixel) { return Bars[Pixel * 8 / Width]; }, Background.GetData());
+	for (uint32 Line = 1; Line < Height; ++Line)
+	{
+		FMemory::Memcpy(Background.GetData() + Line * Pitch, Background.GetData(), Pitch);
+	}
+}
+
+FBlackmagicSimulatedDevice::~FBlackmagicSimulatedDevice()
+{
+	Shutdown();
+}
+
+void FBlackmagicSimulatedDevice::Start()
+{
+	if (Thread == nullptr)
+	{
+		bStopRequested = false;
+		Thread = FRunnableThread::Create(this, TEXT("BlackmagicSimulatedDevice"), 0, TPri_TimeCritical);
+	}
+}
+
+void FBlackmagicSimulatedDevice::Shutdown()
+{
+	if (Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+uint32 FBlackmagicSimulatedDevice::Run()
+{
+	const double FrameInterval = FrameRate.AsInterval();
+	const double StartTime = FPlatformTime::Seconds();
+
+	for (int64 FrameNumber = 0; !bStopRequested; ++FrameNumber)
+	{
+		const double FrameTime = StartTime + FrameNumber * FrameInterval;
+		const double TimeToWait = FrameTime - FPlatformTime::Seconds();
+		if (TimeToWait > 0.0)
+		{
+			FPlatformProcess::Sleep(TimeToWait);
+		}
+
+		RenderFrame(FrameNumber);
+
+		const FTimecode Timecode = FTimecode::FromFrameNumber(FFrameNumber(int32(FrameNumber)), FrameRate, false);
+
+		BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo FrameInfo;
+		FrameInfo.bHasInputSource = true;
+		FrameInfo.FrameNumber = FrameNumber;
+		FrameInfo.bHaveTimecode = true;
+		FrameInfo.Timecode.Hours = Timecode.Hours;
+		FrameInfo.Timecode.Minutes = Timecode.Minutes;
+		FrameInfo.Timecode.Seconds = Timecode.Seconds;
+		FrameInfo.Timecode.Frames = Timecode.Frames;
+		FrameInfo.Timecode.bIsDropFrame = false;
+		FrameInfo.VideoBuffer = Buffer.GetData();
+		FrameInfo.VideoWidth = Width;
+		FrameInfo.VideoHeight = Height;
+		FrameInfo.VideoPitch = Pitch;
+		FrameInfo.PixelFormat = PixelFormat;
+		FrameInfo.FieldDominance = BlackmagicDesign::EFieldDominance::Progressive;
+		FrameInfo.AudioBuffer = nullptr;
+		FrameInfo.AudioBufferSize = 0;
+		FrameInfo.NumberOfAudioChannel = 0;
+		FrameInfo.AudioRate = 0;
+
+		OnFrame(FrameInfo);
+	}
+
+	return 0;
+}
+
+void FBlackmagicSimulatedDevice::RenderFrame(int64 InFrameNumber)
+{
+	using namespace BlackmagicSimulatedDeviceHelpers;
+
+	FMemory::Memcpy(Buffer.GetData(), Background.GetData(), Buffer.Num());
+
+	// A bar crossing the picture in 4 seconds makes frame drops and tearing visible
+	const uint32 NumPositions = Width / PixelAlignment;
+	const uint32 BarWidth = FMath::Max<uint32>(NumPositions / 32, 1) * PixelAlignment;
+	const uint32 Step = FMath::Max<uint32>(uint32(NumPositions / (FrameRate.AsDecimal() * 4.0)), 1);
+	const uint32 BarStart = ((InFrameNumber * Step) % NumPositions) * PixelAlignment;
+	const uint32 BarEnd = FMath::Min(BarStart + BarWidth, Width);
+
+	uint8* FirstLine = Buffer.GetData();
+	BuildLine(Width, PixelFormat, [&](uint32 Pixel) { return (Pixel >= BarStart && Pixel < BarEnd) ? MovingBar : Bars[Pixel * 8 / Width]; }, FirstLine);
+
+	const uint32 ByteStart = GetByteOffset(BarStart, PixelFormat);
+	const uint32 ByteEnd = FMath::Min(GetByteOffset(FMath::DivideAndRoundUp(BarEnd, PixelAlignment) * PixelAlignment, PixelFormat), Pitch);
+	for (uint32 Line = 1; Line < Height; ++Line)
+	{
+		FMemory::Memcpy(FirstLine + Line * Pitch + ByteStart, FirstLine + ByteStart, ByteEnd - ByteStart);
+	}
+}
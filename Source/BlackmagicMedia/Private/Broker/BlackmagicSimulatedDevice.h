@@ -0,0 +1,58 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicLib.h"
+#include "HAL/Runnable.h"
+#include "Misc/FrameRate.h"
+#include "Templates/Atomic.h"
+#include "Templates/Function.h"
+
+class FRunnableThread;
+
+/**
+ * Generate input frames without hardware: color bars with a moving bar and a running timecode, paced at the frame rate.
+ * Frames are given to the callback on the device thread, like the Blackmagic library does.
+ */
+class FBlackmagicSimulatedDevice : public FRunnable
+{
+public:
+	using FOnFrame = TFunction<void(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo&)>;
+
+	FBlackmagicSimulatedDevice(uint32 InWidth, uint32 InHeight, const FFrameRate& InFrameRate, BlackmagicDesign::EPixelFormat InPixelFormat, FOnFrame InOnFrame);
+	virtual ~FBlackmagicSimulatedDevice();
+
+	/** Start the device thread. */
+	void Start();
+
+	/** Stop the device thread. No frame is delivered once it returns. */
+	void Shutdown();
+
+	uint32 GetWidth() const { return Width; }
+	uint32 GetHeight() const { return Height; }
+	uint32 GetPitch() const { return Pitch; }
+	const FFrameRate& GetFrameRate() const { return FrameRate; }
+
+private:
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override { bStopRequested = true; }
+
+	void RenderFrame(int64 InFrameNumber);
+
+private:
+	uint32 Width;
+	uint32 Height;
+	uint32 Pitch;
+	FFrameRate FrameRate;
+	BlackmagicDesign::EPixelFormat PixelFormat;
+	FOnFrame OnFrame;
+
+	/** Bars are rendered once, the moving bar is drawn over a copy every frame */
+	TArray<uint8> Background;
+	TArray<uint8> Buffer;
+
+	FRunnableThread* Thread;
+	TAtomic<bool> bStopRequested;
+};
@@ -0,0 +1,531 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaPixelTap.h"
+
+#include "BlackmagicMediaPlayer.h"
+#include "BlackmagicMediaPrivate.h"
+
+#include "Async/Async.h"
+#include "BlackmagicMediaJobs.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "MediaIOCoreTextureSampleBase.h"
+#include "Misc/ScopeLock.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+#include <emmintrin.h>
+#endif
+
+
+namespace BlackmagicMediaPixelTapHelpers
+{
+	/** Lines of the converted frame produced by a task */
+	static const uint32 LinesPerTask = 32;
+
+	/** Converted frames allocated before falling back to a new frame per conversion */
+	static const int32 MaxPooledFrames = 8;
+
+	/** Stage of the Blackmagic jobs */
+	static const FName JobStage(TEXT("PixelTap"));
+
+	uint32 GetBytesPerPixel(EBlackmagicPixelTapFormat InFormat)
+	{
+		switch (InFormat)
+		{
+		case EBlackmagicPixelTapFormat::Gray8: return 1;
+		case EBlackmagicPixelTapFormat::RGB8: return 3;
+		case EBlackmagicPixelTapFormat::UYVY: return 2;
+		}
+		return 0;
+	}
+
+	/** Unpack v210 blocks of 6 pixels (16 bytes) to UYVY (12 bytes), keeping the 8 most significant bits of the components. */
+	void UnpackLineV210(const uint8* InLine, uint8* OutLine, uint32 InNumBlocks)
+	{
+		for (uint32 Block = 0; Block < InNumBlocks; ++Block)
+		{
+			const uint32* Words = reinterpret_cast<const uint32*>(InLine + Block * 16);
+			uint8* Output = OutLine + Block * 12;
+			for (int32 Word = 0; Word < 4; ++Word)
+			{
+				Output[Word * 3 + 0] = uint8(Words[Word] >> 2);
+				Output[Word * 3 + 1] = uint8(Words[Word] >> 12);
+				Output[Word * 3 + 2] = uint8(Words[Word] >> 22);
+			}
+		}
+	}
+
+	/** Pick the nearest input macro pixel for every output macro pixel. */
+	void ResampleLine(const uint8* InLine, const TArray<uint32>& InColumns, uint8* OutLine)
+	{
+		const uint32* Source = reinterpret_cast<const uint32*>(InLine);
+		uint32* Destination = reinterpret_cast<uint32*>(OutLine);
+		for (int32 MacroPixel = 0; MacroPixel < InColumns.Num(); ++MacroPixel)
+		{
+			Destination[MacroPixel] = Source[InColumns[MacroPixel]];
+		}
+	}
+
+	void ConvertLineToGray(const uint8* InLine, uint8* OutLine, uint32 InNumPixels)
+	{
+		uint32 Pixel = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+		for (; Pixel + 16 <= InNumPixels; Pixel += 16)
+		{
+			const __m128i Pixels0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InLine + Pixel * 2));
+			const __m128i Pixels1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InLine + Pixel * 2 + 16));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(OutLine + Pixel), _mm_packus_epi16(_mm_srli_epi16(Pixels0, 8), _mm_srli_epi16(Pixels1, 8)));
+		}
+#endif
+
+		for (; Pixel < InNumPixels; ++Pixel)
+		{
+			OutLine[Pixel] = InLine[Pixel * 2 + 1];
+		}
+	}
+
+	/** Rec. 709 video range to full range RGB, with the coefficients of FBlackmagicMediaProxyFrame::ConvertToBGRA. */
+	void ConvertLineToRGB(const uint8* InLine, uint8* OutLine, uint32 InNumPixels)
+	{
+		uint32 Pixel = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+		// 16 bits fixed point with 6 fractional bits. Luma is scaled by 128 and chroma by 256 before the high multiplications,
+		// the blue coefficient doesn't fit in 16 bits and is applied twice.
+		const __m128i LowByteMask = _mm_set1_epi16(0x00FF);
+		const __m128i LumaOffset = _mm_set1_epi16(16);
+		const __m128i ChromaOffset = _mm_set1_epi16(128);
+		const __m128i LumaScale = _mm_set1_epi16(int16(298 * 128));
+		const __m128i RedScale = _mm_set1_epi16(459 * 64);
+		const __m128i GreenBlueScale = _mm_set1_epi16(55 * 64);
+		const __m128i GreenRedScale = _mm_set1_epi16(136 * 64);
+		const __m128i BlueScale = _mm_set1_epi16(541 * 32);
+		const __m128i Rounding = _mm_set1_epi16(32);
+
+		for (; Pixel + 8 <= InNumPixels; Pixel += 8)
+		{
+			const __m128i Pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InLine + Pixel * 2));
+			const __m128i Luma = _mm_mulhi_epu16(_mm_slli_epi16(_mm_subs_epu16(_mm_srli_epi16(Pixels, 8), LumaOffset), 7), LumaScale);
+			const __m128i Chroma = _mm_slli_epi16(_mm_sub_epi16(_mm_and_si128(Pixels, LowByteMask), ChromaOffset), 8);
+
+			// Cb0 Cb0 Cb1 Cb1 ... and Cr0 Cr0 Cr1 Cr1 ..., one value per pixel
+			const __m128i Blue = _mm_shufflehi_epi16(_mm_shufflelo_epi16(Chroma, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+			const __m128i Red = _mm_shufflehi_epi16(_mm_shufflelo_epi16(Chroma, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+
+			const __m128i BlueTerm = _mm_mulhi_epi16(Blue, BlueScale);
+			const __m128i R = _mm_adds_epi16(Luma, _mm_mulhi_epi16(Red, RedScale));
+			const __m128i G = _mm_subs_epi16(_mm_subs_epi16(Luma, _mm_mulhi_epi16(Blue, GreenBlueScale)), _mm_mulhi_epi16(Red, GreenRedScale));
+			const __m128i B = _mm_adds_epi16(Luma, _mm_adds_epi16(BlueTerm, BlueTerm));
+
+			const __m128i Zero = _mm_setzero_si128();
+			uint8 Components[3][16];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Components[0]), _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(R, Rounding), 6), Zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Components[1]), _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(G, Rounding), 6), Zero));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Components[2]), _mm_packus_epi16(_mm_srai_epi16(_mm_adds_epi16(B, Rounding), 6), Zero));
+
+			uint8* Output = OutLine + Pixel * 3;
+			for (int32 Index = 0; Index < 8; ++Index)
+			{
+				Output[Index * 3 + 0] = Components[0][Index];
+				Output[Index * 3 + 1] = Components[1][Index];
+				Output[Index * 3 + 2] = Components[2][Index];
+			}
+		}
+#endif
+
+		for (; Pixel < InNumPixels; ++Pixel)
+		{
+			const uint8* MacroPixel = InLine + (Pixel / 2) * 4;
+			const int32 Luma = 298 * FMath::Max(int32(MacroPixel[(Pixel & 1) ? 3 : 1]) - 16, 0) + 128;
+			const int32 Blue = int32(MacroPixel[0]) - 128;
+			const int32 Red = int32(MacroPixel[2]) - 128;
+			OutLine[Pixel * 3 + 0] = (uint8)FMath::Clamp((Luma + 459 * Red) >> 8, 0, 255);
+			OutLine[Pixel * 3 + 1] = (uint8)FMath::Clamp((Luma - 55 * Blue - 136 * Red) >> 8, 0, 255);
+			OutLine[Pixel * 3 + 2] = (uint8)FMath::Clamp((Luma + 541 * Blue) >> 8, 0, 255);
+		}
+	}
+
+	/**
+	 * A consumer of the frames of an input.
+	 * PendingFrame is replaced by every new frame, so a slow consumer only sees the latest one.
+	 */
+	struct FSubscription
+	{
+		int32 Id;
+		FBlackmagicPixelTapRequest Request;
+		FOnBlackmagicPixelTapFrame Delegate;
+
+		FCriticalSection PendingLock;
+		FBlackmagicPixelTapFramePtr PendingFrame;
+		bool bIsDelivering = false;
+		int32 NumSkippedFrames = 0;
+
+		/** Held while the delegate runs, so Unsubscribe can wait for it */
+		FCriticalSection DeliveryLock;
+		TAtomic<bool> bIsActive;
+	};
+
+	using FSubscriptionPtr = TSharedPtr<FSubscription, ESPMode::ThreadSafe>;
+
+	/** Subscriptions of this process, for every input */
+	FCriticalSection RegistryLock;
+	TArray<FSubscriptionPtr> Subscriptions;
+	int32 NextSubscriptionId = 1;
+
+	void Deliver(const FSubscriptionPtr& InSubscription, const FBlackmagicPixelTapFramePtr& InFrame)
+	{
+		{
+			FScopeLock Lock(&InSubscription->PendingLock);
+			if (InSubscription->PendingFrame.IsValid())
+			{
+				++InSubscription->NumSkippedFrames;
+			}
+			InSubscription->PendingFrame = InFrame;
+			if (InSubscription->bIsDelivering)
+			{
+				return;
+			}
+			InSubscription->bIsDelivering = true;
+		}
+
+		Async<void>(EAsyncExecution::ThreadPool, [InSubscription]()
+		{
+			for (;;)
+			{
+				FBlackmagicPixelTapFramePtr Frame;
+				{
+					FScopeLock Lock(&InSubscription->PendingLock);
+					Frame = MoveTemp(InSubscription->PendingFrame);
+					InSubscription->PendingFrame.Reset();
+					if (!Frame.IsValid())
+					{
+						InSubscription->bIsDelivering = false;
+						return;
+					}
+				}
+
+				FScopeLock Lock(&InSubscription->DeliveryLock);
+				if (InSubscription->bIsActive)
+				{
+					InSubscription->Delegate.ExecuteIfBound(Frame);
+				}
+			}
+		});
+	}
+}
+
+/* FBlackmagicMediaPixelTap subscriptions
+*****************************************************************************/
+
+int32 FBlackmagicMediaPixelTap::Subscribe(const FBlackmagicPixelTapRequest& InRequest, const FOnBlackmagicPixelTapFrame& InDelegate)
+{
+	using namespace BlackmagicMediaPixelTapHelpers;
+
+	FSubscriptionPtr Subscription = MakeShared<FSubscription, ESPMode::ThreadSafe>();
+	Subscription->Request = InRequest;
+	Subscription->Delegate = InDelegate;
+	Subscription->bIsActive = true;
+
+	{
+		FScopeLock Lock(&RegistryLock);
+		Subscription->Id = NextSubscriptionId++;
+		Subscriptions.Add(Subscription);
+	}
+
+	// Outside of the registry lock, the players submit their frames while holding theirs
+	FBlackmagicMediaPlayer::OnPixelTapSubscribersChanged(InRequest.DeviceIndex);
+	return Subscription->Id;
+}
+
+void FBlackmagicMediaPixelTap::Unsubscribe(int32 InSubscriptionId)
+{
+	using namespace BlackmagicMediaPixelTapHelpers;
+
+	FSubscriptionPtr Subscription;
+	{
+		FScopeLock Lock(&RegistryLock);
+		const int32 Index = Subscriptions.IndexOfByPredicate([InSubscriptionId](const FSubscriptionPtr& Other) { return Other->Id == InSubscriptionId; });
+		if (Index == INDEX_NONE)
+		{
+			return;
+		}
+		Subscription = Subscriptions[Index];
+		Subscriptions.RemoveAtSwap(Index);
+	}
+
+	FBlackmagicMediaPlayer::OnPixelTapSubscribersChanged(Subscription->Request.DeviceIndex);
+
+	Subscription->bIsActive = false;
+	{
+		FScopeLock Lock(&Subscription->PendingLock);
+		Subscription->PendingFrame.Reset();
+		if (Subscription->NumSkippedFrames > 0)
+		{
+			UE_LOG(LogBlackmagicMedia, Verbose, TEXT("Pixel tap subscriber %d of input %d skipped %d frames."), InSubscriptionId, Subscription->Request.DeviceIndex, Subscription->NumSkippedFrames);
+		}
+	}
+
+	// Wait for a delegate that is running
+	FScopeLock Lock(&Subscription->DeliveryLock);
+}
+
+/* FBlackmagicMediaPixelTap conversion
+*****************************************************************************/
+
+bool FBlackmagicMediaPixelTap::Convert(const uint8* InBuffer, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, uint32 InPitch, EBlackmagicPixelTapFormat InFormat, FIntPoint InResolution, FBlackmagicPixelTapFrame& OutFrame)
+{
+	using namespace BlackmagicMediaPixelTapHelpers;
+
+	if (InPixelFormat != EBlackmagicRecordingPixelFormat::UYVY && InPixelFormat != EBlackmagicRecordingPixelFormat::V210)
+	{
+		return false;
+	}
+
+	const bool bIsV210 = InPixelFormat == EBlackmagicRecordingPixelFormat::V210;
+	const uint32 NumInputMacroPixels = InWidth / 2;
+	uint32 Width = InResolution.X > 0 ? InResolution.X : InWidth;
+	const uint32 Height = InResolution.Y > 0 ? InResolution.Y : InHeight;
+	if (InFormat == EBlackmagicPixelTapFormat::UYVY)
+	{
+		Width &= ~1;
+	}
+	if (NumInputMacroPixels == 0 || InHeight == 0 || Width == 0 || Height == 0)
+	{
+		return false;
+	}
+
+	const uint32 BytesPerPixel = GetBytesPerPixel(InFormat);
+	OutFrame.Format = InFormat;
+	OutFrame.Width = Width;
+	OutFrame.Height = Height;
+	OutFrame.Pitch = Width * BytesPerPixel;
+
+	// Keep the allocation of the previous frame
+	OutFrame.Buffer.SetNumUninitialized(OutFrame.Pitch * Height, false);
+
+	// Lines are first brought to UYVY at the output width, then converted
+	const uint32 NumOutputMacroPixels = FMath::DivideAndRoundUp<uint32>(Width, 2);
+	const bool bIsResampled = NumOutputMacroPixels != NumInputMacroPixels;
+	TArray<uint32> Columns;
+	if (bIsResampled)
+	{
+		Columns.SetNumUninitialized(NumOutputMacroPixels);
+		for (uint32 MacroPixel = 0; MacroPixel < NumOutputMacroPixels; ++MacroPixel)
+		{
+			Columns[MacroPixel] = (MacroPixel * 2 + 1) * NumInputMacroPixels / (NumOutputMacroPixels * 2);
+		}
+	}
+
+	const uint32 NumV210Blocks = FMath::DivideAndRoundUp<uint32>(InWidth, 6);
+	const int32 NumTasks = FMath::DivideAndRoundUp(Height, LinesPerTask);
+	FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Analysis, JobStage, NumTasks, [&](int32 TaskIndex)
+	{
+		TArray<uint8> UnpackedLine;
+		TArray<uint8> ResampledLine;
+		if (bIsV210)
+		{
+			UnpackedLine.SetNumUninitialized(NumV210Blocks * 12);
+		}
+		if (bIsResampled)
+		{
+			ResampledLine.SetNumUninitialized(NumOutputMacroPixels * 4);
+		}
+
+		const uint32 FirstLine = TaskIndex * LinesPerTask;
+		const uint32 LastLine = FMath::Min(FirstLine + LinesPerTask, Height);
+		for (uint32 Line = FirstLine; Line < LastLine; ++Line)
+		{
+			const uint8* Source = InBuffer + uint64((Line * 2 + 1) * uint64(InHeight) / (Height * 2)) * InPitch;
+			if (bIsV210)
+			{
+				UnpackLineV210(Source, UnpackedLine.GetData(), NumV210Blocks);
+				Source = UnpackedLine.GetData();
+			}
+			if (bIsResampled)
+			{
+				ResampleLine(Source, Columns, ResampledLine.GetData());
+				Source = ResampledLine.GetData();
+			}
+
+			uint8* Destination = OutFrame.Buffer.GetData() + Line * OutFrame.Pitch;
+			switch (InFormat)
+			{
+			case EBlackmagicPixelTapFormat::Gray8:
+				ConvertLineToGray(Source, Destination, Width);
+				break;
+			case EBlackmagicPixelTapFormat::RGB8:
+				ConvertLineToRGB(Source, Destination, Width);
+				break;
+			case EBlackmagicPixelTapFormat::UYVY:
+				FMemory::Memcpy(Destination, Source, Width * 2);
+				break;
+			}
+		}
+	});
+
+	return true;
+}
+
+/* FBlackmagicMediaPixelTap
+*****************************************************************************/
+
+FBlackmagicMediaPixelTap::FBlackmagicMediaPixelTap(int32 InDeviceIndex)
+	: DeviceIndex(InDeviceIndex)
+	, NumSkippedFrames(0)
+	, bIsWorkerBusy(false)
+{
+}
+
+FBlackmagicMediaPixelTap::~FBlackmagicMediaPixelTap()
+{
+	if (WorkerResult.IsValid())
+	{
+		WorkerResult.Wait();
+	}
+
+	if (NumSkippedFrames > 0)
+	{
+		UE_LOG(LogBlackmagicMedia, Verbose, TEXT("Pixel tap of input %d skipped %d frames while converting."), DeviceIndex, NumSkippedFrames);
+	}
+}
+
+void FBlackmagicMediaPixelTap::Submit(const TSharedRef<FMediaIOCoreTextureSampleBase, ESPMode::ThreadSafe>& InSample, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, int64 InFrameNumber)
+{
+	using namespace BlackmagicMediaPixelTapHelpers;
+
+	TArray<FSubscriptionPtr, TInlineAllocator<8>> Subscribers;
+	{
+		FScopeLock Lock(&RegistryLock);
+		for (const FSubscriptionPtr& Subscription : Subscriptions)
+		{
+			if (Subscription->Request.DeviceIndex == DeviceIndex)
+			{
+				Subscribers.Add(Subscription);
+			}
+		}
+	}
+
+	if (Subscribers.Num() == 0)
+	{
+		return;
+	}
+
+	if (bIsWorkerBusy)
+	{
+		++NumSkippedFrames;
+		return;
+	}
+
+	bIsWorkerBusy = true;
+	WorkerResult = FBlackmagicMediaJobs::Launch(EBlackmagicJobPriority::Analysis, JobStage, [this, InSample, Subscribers, InPixelFormat, InWidth, InHeight, InFrameNumber]()
+	{
+		const TOptional<FTimecode> Timecode = InSample->GetTimecode();
+
+		// One conversion per format and resolution, shared by the subscribers that asked for it
+		TArray<FBlackmagicPixelTapFramePtr, TInlineAllocator<8>> Frames;
+		TArray<const FBlackmagicPixelTapRequest*, TInlineAllocator<8>> FrameRequests;
+		for (const FSubscriptionPtr& Subscription : Subscribers)
+		{
+			const FBlackmagicPixelTapRequest& Request = Subscription->Request;
+			int32 FrameIndex = FrameRequests.IndexOfByPredicate([&Request](const FBlackmagicPixelTapRequest* Other) { return Other->Format == Request.Format && Other->Resolution == Request.Resolution; });
+			if (FrameIndex == INDEX_NONE)
+			{
+				TSharedPtr<FBlackmagicPixelTapFrame, ESPMode::ThreadSafe> Frame = AcquireFrame();
+				Frame->FrameNumber = InFrameNumber;
+				Frame->Timecode = Timecode;
+				if (!Convert(reinterpret_cast<const uint8*>(InSample->GetBuffer()), InPixelFormat, InWidth, InHeight, InSample->GetStride(), Request.Format, Request.Resolution, *Frame))
+				{
+					Frame.Reset();
+				}
+
+				FrameIndex = Frames.Add(Frame);
+				FrameRequests.Add(&Request);
+			}
+
+			if (Frames[FrameIndex].IsValid())
+			{
+				Deliver(Subscription, Frames[FrameIndex]);
+			}
+		}
+
+		bIsWorkerBusy = false;
+	});
+}
+
+bool FBlackmagicMediaPixelTap::HasSubscribers() const
+{
+	using namespace BlackmagicMediaPixelTapHelpers;
+
+	FScopeLock Lock(&RegistryLock);
+	return Subscriptions.ContainsByPredicate([this](const FSubscriptionPtr& Subscription) { return Subscription->Request.DeviceIndex == DeviceIndex; });
+}
+
+TSharedPtr<FBlackmagicPixelTapFrame, ESPMode::ThreadSafe> FBlackmagicMediaPixelTap::AcquireFrame()
+{
+	for (const TSharedPtr<FBlackmagicPixelTapFrame, ESPMode::ThreadSafe>& Frame : FramePool)
+	{
+		if (Frame.IsUnique())
+		{
+			return Frame;
+		}
+	}
+
+	TSharedPtr<FBlackmagicPixelTapFrame, ESPMode::ThreadSafe> NewFrame = MakeShared<FBlackmagicPixelTapFrame, ESPMode::ThreadSafe>();
+	if (FramePool.Num() < BlackmagicMediaPixelTapHelpers::MaxPooledFrames)
+	{
+		FramePool.Add(NewFrame);
+	}
+	return NewFrame;
+}
+
+/* Benchmark
+*****************************************************************************/
+
+namespace BlackmagicMediaPixelTapHelpers
+{
+	void RunBenchmark(const TArray<FString>& Args)
+	{
+		const uint32 Width = Args.IsValidIndex(0) ? FCString::Atoi(*Args[0]) : 3840;
+		const uint32 Height = Args.IsValidIndex(1) ? FCString::Atoi(*Args[1]) : 2160;
+		const bool bIsV210 = Args.IsValidIndex(2) && FCString::Atoi(*Args[2]) == 10;
+		const int32 NumIterations = Args.IsValidIndex(3) ? FMath::Max(FCString::Atoi(*Args[3]), 1) : 60;
+
+		const uint32 Pitch = bIsV210 ? Align(FMath::DivideAndRoundUp<uint32>(Width, 6) * 16, 128) : Width * 2;
+		TArray<uint8> Buffer;
+		Buffer.SetNumUninitialized(Pitch * Height);
+		FRandomStream Random(0);
+		for (uint8& Value : Buffer)
+		{
+			Value = (uint8)Random.RandHelper(256);
+		}
+
+		const EBlackmagicRecordingPixelFormat PixelFormat = bIsV210 ? EBlackmagicRecordingPixelFormat::V210 : EBlackmagicRecordingPixelFormat::UYVY;
+		const TCHAR* FormatNames[] = { TEXT("Gray8"), TEXT("RGB8"), TEXT("UYVY") };
+		for (const EBlackmagicPixelTapFormat Format : { EBlackmagicPixelTapFormat::Gray8, EBlackmagicPixelTapFormat::RGB8, EBlackmagicPixelTapFormat::UYVY })
+		{
+			for (const FIntPoint Resolution : { FIntPoint::ZeroValue, FIntPoint(640, 360) })
+			{
+				FBlackmagicPixelTapFrame Frame;
+				FBlackmagicMediaPixelTap::Convert(Buffer.GetData(), PixelFormat, Width, Height, Pitch, Format, Resolution, Frame);
+
+				const double StartTime = FPlatformTime::Seconds();
+				for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+				{
+					FBlackmagicMediaPixelTap::Convert(Buffer.GetData(), PixelFormat, Width, Height, Pitch, Format, Resolution, Frame);
+				}
+				const double Milliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumIterations;
+
+				UE_LOG(LogBlackmagicMedia, Display, TEXT("Pixel tap of %dx%d %s to %dx%d %s: %.3f ms per frame."),
+					Width, Height, bIsV210 ? TEXT("v210") : TEXT("UYVY"), Frame.Width, Frame.Height, FormatNames[(int32)Format], Milliseconds);
+			}
+		}
+	}
+}
+
+static FAutoConsoleCommand BlackmagicBenchmarkPixelTapCmd(
+	TEXT("Blackmagic.BenchmarkPixelTap"),
+	TEXT("Benchmark the conversions of the CPU pixel tap. Arguments: [Width=3840] [Height=2160] [BitDepth=8] [Iterations=60]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaPixelTapHelpers::RunBenchmark)
+	);
@@ -0,0 +1,335 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaCardIngest.h"
+
+#include "BlackmagicDeviceProvider.h"
+#include "BlackmagicMediaJobs.h"
+#include "BlackmagicMediaPrivate.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformMemory.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+#include "Stats/Stats2.h"
+
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic CardIngest Arena frames used"), STAT_Blackmagic_CardIngest_ArenaFramesUsed, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic CardIngest Frames copied outside the arena"), STAT_Blackmagic_CardIngest_FallbackFrames, STATGROUP_Media);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Blackmagic CardIngest Copy (ms)"), STAT_Blackmagic_CardIngest_Copy, STATGROUP_Media);
+
+
+namespace BlackmagicMediaCardIngestHelpers
+{
+	static TAutoConsoleVariable<int32> CVarFramesPerPort(
+		TEXT("Blackmagic.CardIngest.FramesPerPort"),
+		8,
+		TEXT("Frames of every sub-device of a card in the arena shared by the Blackmagic inputs of the card. Read when the first input of the card is opened.\n")
+		TEXT("0: Every input copies its frames in its own samples"),
+		ECVF_Default);
+
+	/** Blocks start on a page, so the copies of two ports never share a cache line */
+	static const uint32 BlockAlignment = 64 * 1024;
+
+	/** Frames smaller than two stripes are copied by the callback alone */
+	static const uint32 MinStripeSize = 1024 * 1024;
+
+	/** Stage of the Blackmagic jobs */
+	static const FName JobStage(TEXT("CardIngest"));
+
+	/** Ingest of the cards with an opened input, by device group */
+	static FCriticalSection CardsLock;
+	static TMap<uint32, TWeakPtr<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>> Cards;
+
+	/** Size of the frames of a mode, as given by the library */
+	uint32 GetFrameSize(const FIntPoint& InResolution, BlackmagicDesign::EPixelFormat InPixelFormat)
+	{
+		// v210 packs 48 pixels in 128 bytes, and the lines are padded to a group of 48 pixels
+		const uint32 Pitch = InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? InResolution.X * 2 : FMath::DivideAndRoundUp<uint32>(InResolution.X, 48) * 128;
+		return Pitch * InResolution.Y;
+	}
+
+	static FAutoConsoleCommand LogStatsCommand(
+		TEXT("Blackmagic.CardIngest.Stats"),
+		TEXT("Log the frames received by every input of the cards with several sub-devices, and the use of the arena of the cards, since the last call."),
+		FConsoleCommandDelegate::CreateStatic(&FBlackmagicMediaCardIngest::LogStats)
+		);
+}
+
+
+/* FBlackmagicMediaFrameArena
+*****************************************************************************/
+
+FBlackmagicMediaFrameArena::FBlackmagicMediaFrameArena(uint32 InBlockSize, int32 InNumBlocks)
+	: Memory(nullptr)
+	, MemorySize(SIZE_T(InBlockSize) * InNumBlocks)
+	, BlockSize(InBlockSize)
+	, NumBlocks(0)
+	, NumUsedBlocks(0)
+{
+	// From the OS, the arena is large and lives as long as the inputs
+	Memory = MemorySize > 0 ? static_cast<uint8*>(FPlatformMemory::BinnedAllocFromOS(MemorySize)) : nullptr;
+	if (Memory != nullptr)
+	{
+		NumBlocks = InNumBlocks;
+		for (int32 Index = 0; Index < NumBlocks; ++Index)
+		{
+			FreeBlocks.Push(Memory + SIZE_T(Index) * BlockSize);
+		}
+	}
+}
+
+FBlackmagicMediaFrameArena::~FBlackmagicMediaFrameArena()
+{
+	// The samples hold the arena, every block is free
+	while (FreeBlocks.Pop() != nullptr)
+	{
+	}
+
+	if (Memory != nullptr)
+	{
+		FPlatformMemory::BinnedFreeToOS(Memory, MemorySize);
+	}
+}
+
+uint8* FBlackmagicMediaFrameArena::Acquire()
+{
+	uint8* Block = FreeBlocks.Pop();
+	if (Block != nullptr)
+	{
+		++NumUsedBlocks;
+		INC_DWORD_STAT(STAT_Blackmagic_CardIngest_ArenaFramesUsed);
+	}
+	return Block;
+}
+
+void FBlackmagicMediaFrameArena::Release(uint8* InBlock)
+{
+	check(InBlock >= Memory && InBlock < Memory + MemorySize);
+
+	--NumUsedBlocks;
+	DEC_DWORD_STAT(STAT_Blackmagic_CardIngest_ArenaFramesUsed);
+	FreeBlocks.Push(InBlock);
+}
+
+
+/* FBlackmagicMediaCardIngest::FPort
+*****************************************************************************/
+
+FBlackmagicMediaCardIngest::FPort::FPort(const TSharedRef<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>& InCard, const TSharedRef<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe>& InArena, int32 InDeviceIndex, int32 InSubDeviceIndex)
+	: Card(InCard)
+	, Arena(InArena)
+	, DeviceIndex(InDeviceIndex)
+	, SubDeviceIndex(InSubDeviceIndex)
+	, NumArenaFrames(0)
+	, NumFallbackFrames(0)
+	, NumLateFrames(0)
+	, NumDroppedFrames(0)
+	, NumCopiedBytes(0)
+	, CopyCycles(0)
+{
+}
+
+FBlackmagicMediaCardIngest::FPort::~FPort()
+{
+	Card->RemovePort(this);
+}
+
+uint8* FBlackmagicMediaCardIngest::FPort::CopyFrame(const uint8* InBuffer, uint32 InSize)
+{
+	using namespace BlackmagicMediaCardIngestHelpers;
+
+	uint8* Block = InSize <= Arena->GetBlockSize() ? Arena->Acquire() : nullptr;
+	if (Block == nullptr)
+	{
+		++NumFallbackFrames;
+		INC_DWORD_STAT(STAT_Blackmagic_CardIngest_FallbackFrames);
+		return nullptr;
+	}
+
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	// The callback takes a stripe, so the copy never waits for a worker to be free
+	const int32 NumStripes = FMath::Clamp<int32>(InSize / MinStripeSize, 1, FMath::Max(FBlackmagicMediaJobs::GetNumWorkers(), 1) + 1);
+	if (NumStripes > 1)
+	{
+		FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Input, JobStage, NumStripes, [Block, InBuffer, InSize, NumStripes](int32 StripeIndex)
+		{
+			const uint32 Begin = uint32(uint64(InSize) * StripeIndex / NumStripes);
+			const uint32 End = uint32(uint64(InSize) * (StripeIndex + 1) / NumStripes);
+			FMemory::Memcpy(Block + Begin, InBuffer + Begin, End - Begin);
+		});
+	}
+	else
+	{
+		FMemory::Memcpy(Block, InBuffer, InSize);
+	}
+
+	const uint64 ElapsedCycles = FPlatformTime::Cycles64() - StartCycles;
+	SET_FLOAT_STAT(STAT_Blackmagic_CardIngest_Copy, FPlatformTime::ToMilliseconds64(ElapsedCycles));
+
+	CopyCycles += ElapsedCycles;
+	NumCopiedBytes += InSize;
+	++NumArenaFrames;
+	return Block;
+}
+
+
+/* FBlackmagicMediaCardIngest
+*****************************************************************************/
+
+FBlackmagicMediaCardIngest::FBlackmagicMediaCardIngest(uint32 InDeviceGroupId, int32 InNumberOfSubDevices)
+	: DeviceGroupId(InDeviceGroupId)
+	, NumberOfSubDevices(InNumberOfSubDevices)
+	, StatsStartTime(FPlatformTime::Seconds())
+{
+}
+
+TSharedPtr<FBlackmagicMediaCardIngest::FPort, ESPMode::ThreadSafe> FBlackmagicMediaCardIngest::OpenPort(int32 InDeviceIndex, BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat)
+{
+	using namespace BlackmagicMediaCardIngestHelpers;
+
+	const int32 FramesPerPort = CVarFramesPerPort.GetValueOnAnyThread();
+	if (FramesPerPort <= 0)
+	{
+		return nullptr;
+	}
+
+	FBlackmagicDeviceCapabilities Capabilities;
+	if (!FBlackmagicDeviceProvider::FindCachedDevice(InDeviceIndex, Capabilities) || Capabilities.NumberOfSubDevices < 2)
+	{
+		return nullptr;
+	}
+
+	const FBlackmagicDeviceMode* DeviceMode = Capabilities.InputModes.FindByPredicate([InDisplayMode](const FBlackmagicDeviceMode& InMode) { return InMode.Mode.DeviceModeIdentifier == InDisplayMode; });
+	if (DeviceMode == nullptr)
+	{
+		return nullptr;
+	}
+
+	TSharedPtr<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe> Card;
+	{
+		FScopeLock Lock(&CardsLock);
+		Card = Cards.FindRef(Capabilities.DeviceGroupId).Pin();
+		if (!Card.IsValid())
+		{
+			Card = MakeShared<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>(Capabilities.DeviceGroupId, Capabilities.NumberOfSubDevices);
+			Cards.Add(Capabilities.DeviceGroupId, Card);
+		}
+	}
+
+	const uint32 FrameSize = GetFrameSize(DeviceMode->Mode.Resolution, InPixelFormat);
+	return Card->AddPort(Card.ToSharedRef(), InDeviceIndex, Capabilities.SubDeviceIndex, FrameSize, FramesPerPort);
+}
+
+TSharedPtr<FBlackmagicMediaCardIngest::FPort, ESPMode::ThreadSafe> FBlackmagicMediaCardIngest::AddPort(const TSharedRef<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>& InCard, int32 InDeviceIndex, int32 InSubDeviceIndex, uint32 InFrameSize, int32 InFramesPerPort)
+{
+	using namespace BlackmagicMediaCardIngestHelpers;
+
+	FScopeLock Lock(&PortsLock);
+
+	if (!Arena.IsValid())
+	{
+		const uint32 BlockSize = Align(InFrameSize, BlockAlignment);
+		const int32 NumBlocks = NumberOfSubDevices * InFramesPerPort;
+		TSharedRef<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe> NewArena = MakeShared<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe>(BlockSize, NumBlocks);
+		if (NewArena->GetNumBlocks() == 0)
+		{
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("Can't allocate the %.1f MB of the frame arena of the Blackmagic card of input %d. Its inputs copy their frames on their own."), double(BlockSize) * NumBlocks / (1024.0 * 1024.0), InDeviceIndex);
+			return nullptr;
+		}
+
+		Arena = NewArena;
+		UE_LOG(LogBlackmagicMedia, Log, TEXT("Allocated %d frames of %.1f MB for the %d inputs of the Blackmagic card of input %d."), NumBlocks, BlockSize / (1024.0 * 1024.0), NumberOfSubDevices, InDeviceIndex);
+	}
+	else if (InFrameSize > Arena->GetBlockSize())
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The frames of input %d don't fit in the arena of its card, made for the frames of the first input opened. They are copied outside of it."), InDeviceIndex);
+	}
+
+	TSharedRef<FPort, ESPMode::ThreadSafe> Port = MakeShared<FPort, ESPMode::ThreadSafe>(InCard, Arena.ToSharedRef(), InDeviceIndex, InSubDeviceIndex);
+	Ports.Add(&Port.Get());
+	return Port;
+}
+
+void FBlackmagicMediaCardIngest::RemovePort(FPort* InPort)
+{
+	FScopeLock Lock(&PortsLock);
+	Ports.RemoveSingleSwap(InPort);
+}
+
+void FBlackmagicMediaCardIngest::LogStats()
+{
+	using namespace BlackmagicMediaCardIngestHelpers;
+
+	TArray<TSharedPtr<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>> OpenedCards;
+	{
+		FScopeLock Lock(&CardsLock);
+		for (auto It = Cards.CreateIterator(); It; ++It)
+		{
+			TSharedPtr<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe> Card = It.Value().Pin();
+			if (Card.IsValid())
+			{
+				OpenedCards.Add(Card);
+			}
+			else
+			{
+				It.RemoveCurrent();
+			}
+		}
+	}
+
+	if (OpenedCards.Num() == 0)
+	{
+		UE_LOG(LogBlackmagicMedia, Display, TEXT("No input is opened on a Blackmagic card with several sub-devices."));
+	}
+
+	for (const TSharedPtr<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>& Card : OpenedCards)
+	{
+		Card->LogPortStats();
+	}
+}
+
+void FBlackmagicMediaCardIngest::LogPortStats()
+{
+	FScopeLock Lock(&PortsLock);
+
+	const double CurrentTime = FPlatformTime::Seconds();
+	const double Elapsed = FMath::Max(CurrentTime - StatsStartTime, SMALL_NUMBER);
+	StatsStartTime = CurrentTime;
+
+	UE_LOG(LogBlackmagicMedia, Display, TEXT("Blackmagic card %08x: %d of %d inputs opened, %d of %d arena frames of %.1f MB used, over %.1f seconds.")
+		, DeviceGroupId, Ports.Num(), NumberOfSubDevices, Arena.IsValid() ? Arena->GetNumUsedBlocks() : 0, Arena.IsValid() ? Arena->GetNumBlocks() : 0
+		, Arena.IsValid() ? Arena->GetBlockSize() / (1024.0 * 1024.0) : 0.0, Elapsed);
+
+	int64 TotalArenaFrames = 0;
+	int64 TotalFallbackFrames = 0;
+	int64 TotalLateFrames = 0;
+	int64 TotalDroppedFrames = 0;
+	int64 TotalCopiedBytes = 0;
+	uint64 TotalCopyCycles = 0;
+
+	for (FPort* Port : Ports)
+	{
+		const int64 NumArenaFrames = Port->NumArenaFrames.Exchange(0);
+		const int64 NumFallbackFrames = Port->NumFallbackFrames.Exchange(0);
+		const int64 NumLateFrames = Port->NumLateFrames.Exchange(0);
+		const int64 NumDroppedFrames = Port->NumDroppedFrames.Exchange(0);
+		const int64 NumCopiedBytes = Port->NumCopiedBytes.Exchange(0);
+		const uint64 CopyCycles = Port->CopyCycles.Exchange(0);
+
+		UE_LOG(LogBlackmagicMedia, Display, TEXT("  Input %d (sub-device %d): %lld frames in the arena, %lld outside, %lld late, %lld dropped, %.2f ms per copy, %.0f MB/s")
+			, Port->DeviceIndex, Port->SubDeviceIndex, NumArenaFrames, NumFallbackFrames, NumLateFrames, NumDroppedFrames
+			, NumArenaFrames > 0 ? FPlatformTime::ToMilliseconds64(CopyCycles) / NumArenaFrames : 0.0, NumCopiedBytes / (1024.0 * 1024.0) / Elapsed);
+
+		TotalArenaFrames += NumArenaFrames;
+		TotalFallbackFrames += NumFallbackFrames;
+		TotalLateFrames += NumLateFrames;
+		TotalDroppedFrames += NumDroppedFrames;
+		TotalCopiedBytes += NumCopiedBytes;
+		TotalCopyCycles += CopyCycles;
+	}
+
+	UE_LOG(LogBlackmagicMedia, Display, TEXT("  Card: %lld frames in the arena, %lld outside, %lld late, %lld dropped, %.2f ms per copy, %.0f MB/s")
+		, TotalArenaFrames, TotalFallbackFrames, TotalLateFrames, TotalDroppedFrames
+		, TotalArenaFrames > 0 ? FPlatformTime::ToMilliseconds64(TotalCopyCycles) / TotalArenaFrames : 0.0, TotalCopiedBytes / (1024.0 * 1024.0) / Elapsed);
+}
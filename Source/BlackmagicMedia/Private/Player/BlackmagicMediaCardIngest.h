@@ -0,0 +1,128 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicLib.h"
+#include "Containers/LockFreeList.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/Atomic.h"
+
+/**
+ * Frame buffers allocated once, from the OS, for all the inputs of a card.
+ * Blocks are taken and given back without a lock and without the allocator of the engine, so the inputs of a card
+ * don't contend with each other, or with the game, when they copy their frames.
+ */
+class FBlackmagicMediaFrameArena
+{
+public:
+	FBlackmagicMediaFrameArena(uint32 InBlockSize, int32 InNumBlocks);
+	~FBlackmagicMediaFrameArena();
+
+	FBlackmagicMediaFrameArena(const FBlackmagicMediaFrameArena&) = delete;
+	FBlackmagicMediaFrameArena& operator=(const FBlackmagicMediaFrameArena&) = delete;
+
+	/** @return A free block of GetBlockSize bytes, nullptr when they are all used */
+	uint8* Acquire();
+
+	/** Give back a block returned by Acquire. Can be called from any thread. */
+	void Release(uint8* InBlock);
+
+	uint32 GetBlockSize() const { return BlockSize; }
+	int32 GetNumBlocks() const { return NumBlocks; }
+	int32 GetNumUsedBlocks() const { return NumUsedBlocks; }
+
+private:
+	uint8* Memory;
+	SIZE_T MemorySize;
+	uint32 BlockSize;
+	int32 NumBlocks;
+
+	TLockFreePointerListUnordered<uint8, PLATFORM_CACHE_LINE_SIZE> FreeBlocks;
+	TAtomic<int32> NumUsedBlocks;
+};
+
+/**
+ * Ingest shared by the inputs opened on the sub-devices of a card.
+ * The library opens a channel, with its own callback, per sub-device. The players of the sub-devices keep their channel and
+ * their sample queue, and join the ingest of their card as a port. The ports of a card share:
+ *   - one frame arena, sized for Blackmagic.CardIngest.FramesPerPort frames of every sub-device of the card,
+ *   - the Blackmagic job workers, which copy the large frames in stripes with the callback thread,
+ *   - statistics, per port and for the card, reported by Blackmagic.CardIngest.Stats.
+ * A frame that doesn't fit in a block, or that arrives when every block is used, is copied by the sample as before.
+ */
+class FBlackmagicMediaCardIngest
+{
+public:
+	/** Input of a card. Holds the ingest of the card while the input is opened. */
+	class FPort
+	{
+	public:
+		FPort(const TSharedRef<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>& InCard, const TSharedRef<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe>& InArena, int32 InDeviceIndex, int32 InSubDeviceIndex);
+		~FPort();
+
+		FPort(const FPort&) = delete;
+		FPort& operator=(const FPort&) = delete;
+
+		/**
+		 * Copy a frame in a block of the arena of the card. Called from the callback of the input.
+		 * @return The block, to give back to GetArena() once the frame is not used. nullptr when the frame has to be copied elsewhere.
+		 */
+		uint8* CopyFrame(const uint8* InBuffer, uint32 InSize);
+
+		/** Frames of the input not given to the player */
+		void AddLateFrame() { ++NumLateFrames; }
+		void AddDroppedFrame() { ++NumDroppedFrames; }
+
+		const TSharedRef<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe>& GetArena() const { return Arena; }
+		int32 GetDeviceIndex() const { return DeviceIndex; }
+
+	private:
+		friend FBlackmagicMediaCardIngest;
+
+		TSharedRef<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe> Card;
+		TSharedRef<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe> Arena;
+		int32 DeviceIndex;
+		int32 SubDeviceIndex;
+
+		TAtomic<int64> NumArenaFrames;
+		TAtomic<int64> NumFallbackFrames;
+		TAtomic<int64> NumLateFrames;
+		TAtomic<int64> NumDroppedFrames;
+		TAtomic<int64> NumCopiedBytes;
+		TAtomic<uint64> CopyCycles;
+	};
+
+public:
+	/**
+	 * Join the ingest of the card of a device, created with its first port.
+	 * @return Invalid when the device is not the sub-device of a card, or when Blackmagic.CardIngest.FramesPerPort is 0
+	 */
+	static TSharedPtr<FPort, ESPMode::ThreadSafe> OpenPort(int32 InDeviceIndex, BlackmagicDesign::FBlackmagicVideoFormat InDisplayMode, BlackmagicDesign::EPixelFormat InPixelFormat);
+
+	/** Log the statistics of the ports of every card, and start counting again */
+	static void LogStats();
+
+public:
+	FBlackmagicMediaCardIngest(uint32 InDeviceGroupId, int32 InNumberOfSubDevices);
+
+private:
+	/**
+	 * Add a port, and create the arena for the frames of the first port. The ports that follow need frames of that size or smaller.
+	 * @return Invalid when the arena can't be allocated
+	 */
+	TSharedPtr<FPort, ESPMode::ThreadSafe> AddPort(const TSharedRef<FBlackmagicMediaCardIngest, ESPMode::ThreadSafe>& InCard, int32 InDeviceIndex, int32 InSubDeviceIndex, uint32 InFrameSize, int32 InFramesPerPort);
+	void RemovePort(FPort* InPort);
+	void LogPortStats();
+
+private:
+	uint32 DeviceGroupId;
+	int32 NumberOfSubDevices;
+
+	FCriticalSection PortsLock;
+
+	/** Created with the first port, never resized: the samples of the ports hold its blocks */
+	TSharedPtr<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe> Arena;
+	TArray<FPort*> Ports;
+	double StatsStartTime;
+};
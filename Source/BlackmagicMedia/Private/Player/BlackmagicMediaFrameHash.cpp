@@ -0,0 +1,258 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaFrameHash.h"
+
+#include "BlackmagicMediaPrivate.h"
+
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+#include <emmintrin.h>
+#endif
+
+
+namespace BlackmagicMediaFrameHashHelpers
+{
+	static const uint64 Keys[4] = { 0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull, 0x1f67b3b7a4a44072ull };
+	static const uint32 Prime32 = 0x9E3779B1u;
+	static const uint64 Prime64_2 = 0xC2B2AE3D27D4EB4Full;
+	static const uint64 Prime64_3 = 0x165667B19E3779F9ull;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+	struct FState
+	{
+		__m128i Accumulator0;
+		__m128i Accumulator1;
+	};
+
+	FORCEINLINE void Reset(FState& OutState)
+	{
+		OutState.Accumulator0 = _mm_setzero_si128();
+		OutState.Accumulator1 = _mm_setzero_si128();
+	}
+
+	/** Accumulator += lo32(Data ^ Key) * hi32(Data ^ Key) + swapped Data, for both 64 bits lanes */
+	FORCEINLINE __m128i Accumulate(__m128i InAccumulator, __m128i InData, __m128i InKey)
+	{
+		const __m128i DataKey = _mm_xor_si128(InData, InKey);
+		const __m128i Product = _mm_mul_epu32(DataKey, _mm_shuffle_epi32(DataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+		const __m128i Swapped = _mm_shuffle_epi32(InData, _MM_SHUFFLE(1, 0, 3, 2));
+		return _mm_add_epi64(Product, _mm_add_epi64(InAccumulator, Swapped));
+	}
+
+	/** Accumulator = (Accumulator ^ (Accumulator >> 47) ^ Key) * Prime32, for both 64 bits lanes */
+	FORCEINLINE __m128i Scramble(__m128i InAccumulator, __m128i InKey)
+	{
+		const __m128i Mixed = _mm_xor_si128(_mm_xor_si128(InAccumulator, _mm_srli_epi64(InAccumulator, 47)), InKey);
+		const __m128i Prime = _mm_set1_epi32(Prime32);
+		const __m128i Low = _mm_mul_epu32(Mixed, Prime);
+		const __m128i High = _mm_mul_epu32(_mm_srli_epi64(Mixed, 32), Prime);
+		return _mm_add_epi64(Low, _mm_slli_epi64(High, 32));
+	}
+
+	/** Hash NumBlocks blocks of 16 bytes, Stride bytes apart */
+	FORCEINLINE void HashBlocks(FState& InOutState, const uint8* InData, uint32 InNumBlocks, uint32 InStride)
+	{
+		const __m128i Key0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Keys));
+		const __m128i Key1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Keys + 2));
+
+		uint32 Block = 0;
+		for (; Block + 2 <= InNumBlocks; Block += 2)
+		{
+			InOutState.Accumulator0 = Accumulate(InOutState.Accumulator0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(InData)), Key0);
+			InOutState.Accumulator1 = Accumulate(InOutState.Accumulator1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(InData + InStride)), Key1);
+			InData += InStride * 2;
+		}
+		if (Block < InNumBlocks)
+		{
+			InOutState.Accumulator0 = Accumulate(InOutState.Accumulator0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(InData)), Key0);
+		}
+	}
+
+	FORCEINLINE void EndLine(FState& InOutState)
+	{
+		InOutState.Accumulator0 = Scramble(InOutState.Accumulator0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(Keys + 1)));
+		InOutState.Accumulator1 = Scramble(InOutState.Accumulator1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(Keys + 2)));
+	}
+
+	FORCEINLINE void GetLanes(const FState& InState, uint64 OutLanes[4])
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutLanes), InState.Accumulator0);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(OutLanes + 2), InState.Accumulator1);
+	}
+#else
+	struct FState
+	{
+		uint64 Lanes[4];
+	};
+
+	FORCEINLINE void Reset(FState& OutState)
+	{
+		FMemory::Memzero(OutState.Lanes);
+	}
+
+	FORCEINLINE void Accumulate(uint64* InOutAccumulator, const uint8* InData, const uint64* InKey)
+	{
+		uint64 Data[2];
+		FMemory::Memcpy(Data, InData, sizeof(Data));
+		for (int32 Lane = 0; Lane < 2; ++Lane)
+		{
+			const uint64 DataKey = Data[Lane] ^ InKey[Lane];
+			InOutAccumulator[Lane] += (DataKey & 0xFFFFFFFF) * (DataKey >> 32) + Data[1 - Lane];
+		}
+	}
+
+	FORCEINLINE void Scramble(uint64* InOutAccumulator, const uint64* InKey)
+	{
+		for (int32 Lane = 0; Lane < 2; ++Lane)
+		{
+			InOutAccumulator[Lane] = (InOutAccumulator[Lane] ^ (InOutAccumulator[Lane] >> 47) ^ InKey[Lane]) * Prime32;
+		}
+	}
+
+	FORCEINLINE void HashBlocks(FState& InOutState, const uint8* InData, uint32 InNumBlocks, uint32 InStride)
+	{
+		for (uint32 Block = 0; Block < InNumBlocks; ++Block)
+		{
+			const bool bIsOdd = (Block & 1) != 0;
+			Accumulate(InOutState.Lanes + (bIsOdd ? 2 : 0), InData, Keys + (bIsOdd ? 2 : 0));
+			InData += InStride;
+		}
+	}
+
+	FORCEINLINE void EndLine(FState& InOutState)
+	{
+		Scramble(InOutState.Lanes, Keys + 1);
+		Scramble(InOutState.Lanes + 2, Keys + 2);
+	}
+
+	FORCEINLINE void GetLanes(const FState& InState, uint64 OutLanes[4])
+	{
+		FMemory::Memcpy(OutLanes, InState.Lanes, sizeof(InState.Lanes));
+	}
+#endif
+
+	/** The last bytes of a line are hashed as a block padded with zeros */
+	FORCEINLINE void HashTail(FState& InOutState, const uint8* InData, uint32 InSize)
+	{
+		if (InSize > 0)
+		{
+			uint8 Block[16] = { 0 };
+			FMemory::Memcpy(Block, InData, InSize);
+			HashBlocks(InOutState, Block, 1, 16);
+		}
+	}
+
+	uint64 Finalize(const FState& InState, uint64 InSize)
+	{
+		uint64 Lanes[4];
+		GetLanes(InState, Lanes);
+
+		uint64 Hash = InSize * Prime64_3;
+		for (uint64 Lane : Lanes)
+		{
+			Hash = (Hash ^ Lane) * Prime64_2;
+			Hash = (Hash << 31) | (Hash >> 33);
+		}
+
+		Hash ^= Hash >> 33;
+		Hash *= Prime64_2;
+		Hash ^= Hash >> 29;
+		Hash *= Prime64_3;
+		Hash ^= Hash >> 32;
+		return Hash;
+	}
+}
+
+uint64 BlackmagicMediaFrameHash::HashFrame(const uint8* InBuffer, uint32 InPitch, uint32 InLineSize, uint32 InHeight, bool bInSparse)
+{
+	using namespace BlackmagicMediaFrameHashHelpers;
+
+	FState State;
+	Reset(State);
+
+	if (InBuffer == nullptr || InLineSize == 0 || InHeight == 0)
+	{
+		return Finalize(State, 0);
+	}
+
+	const uint32 NumBlocks = InLineSize / 16;
+	if (!bInSparse)
+	{
+		for (uint32 Line = 0; Line < InHeight; ++Line)
+		{
+			const uint8* LineData = InBuffer + uint64(Line) * InPitch;
+			HashBlocks(State, LineData, NumBlocks, 16);
+			HashTail(State, LineData + NumBlocks * 16, InLineSize - NumBlocks * 16);
+			EndLine(State);
+		}
+		return Finalize(State, uint64(InLineSize) * InHeight);
+	}
+
+	// Blocks in the middle of the cells of the grid. Lines of a small frame are all hashed.
+	const uint32 NumRows = FMath::Min(InHeight, SparseGridSize);
+	const uint32 NumColumns = FMath::Min(NumBlocks, SparseGridSize);
+	for (uint32 Row = 0; Row < NumRows; ++Row)
+	{
+		const uint8* LineData = InBuffer + uint64((Row * 2 + 1) * InHeight / (NumRows * 2)) * InPitch;
+		if (NumColumns == NumBlocks)
+		{
+			HashBlocks(State, LineData, NumBlocks, 16);
+		}
+		else
+		{
+			for (uint32 Column = 0; Column < NumColumns; ++Column)
+			{
+				const uint32 Block = (Column * 2 + 1) * NumBlocks / (NumColumns * 2);
+				HashBlocks(State, LineData + Block * 16, 1, 16);
+			}
+		}
+		EndLine(State);
+	}
+	return Finalize(State, uint64(InLineSize) * InHeight);
+}
+
+/* Benchmark
+*****************************************************************************/
+
+namespace BlackmagicMediaFrameHashHelpers
+{
+	void RunBenchmark(const TArray<FString>& Args)
+	{
+		const uint32 Width = Args.IsValidIndex(0) ? FCString::Atoi(*Args[0]) : 3840;
+		const uint32 Height = Args.IsValidIndex(1) ? FCString::Atoi(*Args[1]) : 2160;
+		const int32 NumIterations = Args.IsValidIndex(2) ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 60;
+
+		const uint32 Pitch = Width * 2;
+		TArray<uint8> Buffer;
+		Buffer.SetNumUninitialized(Pitch * Height);
+		FRandomStream Random(0);
+		for (uint8& Value : Buffer)
+		{
+			Value = (uint8)Random.RandHelper(256);
+		}
+
+		for (const bool bIsSparse : { false, true })
+		{
+			uint64 Hash = BlackmagicMediaFrameHash::HashFrame(Buffer.GetData(), Pitch, Pitch, Height, bIsSparse);
+
+			const double StartTime = FPlatformTime::Seconds();
+			for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+			{
+				Hash ^= BlackmagicMediaFrameHash::HashFrame(Buffer.GetData(), Pitch, Pitch, Height, bIsSparse);
+			}
+			const double Milliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumIterations;
+
+			UE_LOG(LogBlackmagicMedia, Display, TEXT("%s hash of %dx%d UYVY: %.3f ms per frame (%.2f GB/s) [%016llx]."),
+				bIsSparse ? TEXT("Sparse") : TEXT("Full"), Width, Height, Milliseconds, (Pitch * Height) / (Milliseconds * 1.0e6), Hash);
+		}
+	}
+}
+
+static FAutoConsoleCommand BlackmagicBenchmarkFrameHashCmd(
+	TEXT("Blackmagic.BenchmarkFrameHash"),
+	TEXT("Benchmark the duplicate frame detection hash. Arguments: [Width=3840] [Height=2160] [Iterations=60]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaFrameHashHelpers::RunBenchmark)
+	);
@@ -0,0 +1,22 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Fast non cryptographic hash of video frames, used to find frames that a source sends again.
+ * Blocks of 16 bytes are mixed in two 128 bits accumulators (multiply and add, with SSE2) and the accumulators are
+ * scrambled at the end of every line, so moved lines change the hash.
+ */
+namespace BlackmagicMediaFrameHash
+{
+	/** Lines and blocks of 16 bytes per line hashed by a sparse hash */
+	static const uint32 SparseGridSize = 64;
+
+	/**
+	 * @param InLineSize	Size in bytes of the pixels of a line, the padding up to the pitch is ignored
+	 * @param bInSparse		Only hash a grid of SparseGridSize x SparseGridSize blocks. Changes between the blocks are missed.
+	 */
+	uint64 HashFrame(const uint8* InBuffer, uint32 InPitch, uint32 InLineSize, uint32 InHeight, bool bInSparse);
+}
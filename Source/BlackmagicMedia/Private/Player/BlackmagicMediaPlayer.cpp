@@ -3,11 +3,22 @@
 #include "BlackmagicMediaPlayer.h"
 
 #include "Blackmagic.h"
+#include "BlackmagicMediaBroker.h"
+#include "BlackmagicMediaChannelTasks.h"
+#include "BlackmagicMediaFrameClock.h"
+#include "BlackmagicMediaFrameHash.h"
+#include "BlackmagicMediaPixelTap.h"
 #include "BlackmagicMediaPrivate.h"
+#include "BlackmagicMediaProxy.h"
+#include "BlackmagicMediaRecording.h"
+#include "BlackmagicMediaRecordingQueue.h"
+#include "BlackmagicMediaSharedFrame.h"
 #include "BlackmagicMediaSource.h"
 
 #include "HAL/CriticalSection.h"
+#include "HAL/IConsoleManager.h"
 #include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
 #include "Misc/ScopeLock.h"
 #include "Templates/Atomic.h"
 
@@ -19,7 +30,10 @@
 #include "MediaIOCoreSamples.h"
 
 #include "Engine/GameEngine.h"
+#include "Containers/Ticker.h"
 #include "Misc/App.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
 #include "Slate/SceneViewport.h"
 #include "Stats/Stats2.h"
 
@@ -29,76 +43,548 @@
 #define LOCTEXT_NAMESPACE "BlackmagicMediaPlayer"
 
 DECLARE_CYCLE_STAT(TEXT("Blackmagic MediaPlayer Process received frame"), STAT_Blackmagic_MediaPlayer_ProcessReceivedFrame, STATGROUP_Media);
-
-
-bool bBlackmagicWriteOutputRawDataCmdEnable = false;
-static FAutoConsoleCommand BlackmagicWriteOutputRawDataCmd(
-	TEXT("Blackmagic.WriteOutputRawData"),
-	TEXT("Write Blackmagic raw output buffer to file."),
-	FConsoleCommandDelegate::CreateLambda([]() { bBlackmagicWriteOutputRawDataCmdEnable = true;	})
-	);
+DECLARE_CYCLE_STAT(TEXT("Blackmagic MediaPlayer Hash received frame"), STAT_Blackmagic_MediaPlayer_HashReceivedFrame, STATGROUP_Media);
+DECLARE_CYCLE_STAT(TEXT("Blackmagic MediaPlayer Publish batch"), STAT_Blackmagic_MediaPlayer_PublishBatch, STATGROUP_Media);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Blackmagic MediaPlayer Callback delay (ms)"), STAT_Blackmagic_MediaPlayer_CallbackDelay, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic MediaPlayer Unique frames"), STAT_Blackmagic_MediaPlayer_UniqueFrames, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic MediaPlayer Duplicate frames"), STAT_Blackmagic_MediaPlayer_DuplicateFrames, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic MediaPlayer Late frames"), STAT_Blackmagic_MediaPlayer_LateFrames, STATGROUP_Media);
+
+
+static TAutoConsoleVariable<float> CVarBlackmagicInputBatchMaxAge(
+	TEXT("Blackmagic.InputBatchMaxAge"),
+	0.f,
+	TEXT("Milliseconds the samples of the Blackmagic inputs can wait to be given to their player together with the samples of the next frames.\n")
+	TEXT("The batch is also given at the start of every engine frame. Used when the input is opened.\n")
+	TEXT("Only the queuing of the samples in the player is deferred: every frame is still locked, checked and copied in a pooled sample when received.\n")
+	TEXT("0: Every sample is given when its frame is received (default)"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarBlackmagicInputBatchMaxFrames(
+	TEXT("Blackmagic.InputBatchMaxFrames"),
+	4,
+	TEXT("Number of input frames after which a batch of samples is given to the player, see Blackmagic.InputBatchMaxAge."),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarBlackmagicInputFrameClock(
+	TEXT("Blackmagic.InputFrameClock"),
+	1,
+	TEXT("Time of the samples of the Blackmagic inputs. Used when the input is opened.\n")
+	TEXT("0: When the frame is received by the callback\n")
+	TEXT("1: When the device captured the frame, estimated from its frame counter without the delay of the callback (default)"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarBlackmagicInputLateFrameTolerance(
+	TEXT("Blackmagic.InputLateFrameTolerance"),
+	2,
+	TEXT("Number of frames before the time its player evaluates, the engine timecode minus the delay of the source, a time synchronized Blackmagic input keeps. Used when the input is opened.\n")
+	TEXT("Older frames can't be evaluated anymore: they are discarded when received, before they are copied, and are the first removed from the queue.\n")
+	TEXT("-1: Keep every frame until the queue is full"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarBlackmagicRecordInputCompression(
+	TEXT("Blackmagic.RecordInput.Compression"),
+	1,
+	TEXT("Compression of the frames recorded with Blackmagic.RecordInput.\n")
+	TEXT("0: Raw frame buffers\n")
+	TEXT("1: Lossless (default)"),
+	ECVF_Default);
+
+static TAutoConsoleVariable<int32> CVarBlackmagicRecordInputMaxPendingFrames(
+	TEXT("Blackmagic.RecordInput.MaxPendingFrames"),
+	8,
+	TEXT("Number of frames recorded with Blackmagic.RecordInput that can wait to be written. Frames received when they are all waiting are not recorded."),
+	ECVF_Default);
 
 namespace BlackmagicMediaPlayerHelpers
 {
 	static const int32 ToleratedExtraMaxBufferCount = 2;
 
+	/** Opened players of this process, to give them the new settings of their source and the requests of the console commands */
+	static FCriticalSection PlayersLock;
+	static TArray<FBlackmagicMediaPlayer*> Players;
+
+	/** Timecode burned in the frames. Only when the input has a timecode. */
+	bool IsEncodingTimecodeInTexel(const FBlackmagicMediaSourceSettings& InSettings)
+	{
+		return InSettings.TimecodeFormat != EMediaIOTimecodeFormat::None && InSettings.bEncodeTimecodeInTexel;
+	}
+
+	/** A burned timecode makes every frame unique */
+	EBlackmagicMediaDuplicateFrameDetection GetDuplicateFrameDetection(const FBlackmagicMediaSourceSettings& InSettings)
+	{
+		return InSettings.bCaptureVideo && !IsEncodingTimecodeInTexel(InSettings) ? InSettings.DuplicateFrameDetection : EBlackmagicMediaDuplicateFrameDetection::Disabled;
+	}
+
+	/** Part of an input frame given to the video samples */
+	struct FVideoRegion
+	{
+		uint8* Buffer;
+		uint32 Pitch;
+		uint32 Width;
+		uint32 Height;
+	};
+
+	/**
+	 * Clamp the region of interest to the frame and move its left edge to the start of a macro pixel: 2 pixels in UYVY, 6 pixels (16 bytes) in v210.
+	 * Interlaced frames keep an even number of lines so both fields have the same size.
+	 */
+	FIntRect AlignRegionOfInterest(const FIntRect& InRegion, uint32 InWidth, uint32 InHeight, BlackmagicDesign::EPixelFormat InPixelFormat, bool bInIsInterlaced)
+	{
+		const int32 PixelAlignment = InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? 2 : 6;
+
+		FIntRect Region;
+		Region.Min.X = (FMath::Clamp<int32>(InRegion.Min.X, 0, InWidth) / PixelAlignment) * PixelAlignment;
+		Region.Min.Y = FMath::Clamp<int32>(InRegion.Min.Y, 0, InHeight);
+		Region.Max.X = FMath::Clamp<int32>(InRegion.Max.X, Region.Min.X, InWidth);
+		Region.Max.Y = FMath::Clamp<int32>(InRegion.Max.Y, Region.Min.Y, InHeight);
+
+		if (PixelAlignment == 2)
+		{
+			Region.Max.X = FMath::Min<int32>(Align(Region.Max.X, 2), InWidth & ~1);
+		}
+
+		if (bInIsInterlaced)
+		{
+			Region.Min.Y &= ~1;
+			Region.Max.Y = Region.Min.Y + (Region.Max.Y - Region.Min.Y) / 2 * 2;
+		}
+
+		return Region;
+	}
+
+	/** Size in bytes of Width pixels. A v210 line ending in the middle of a block of 6 pixels gets the whole block. */
+	uint32 GetLineSize(uint32 InWidth, BlackmagicDesign::EPixelFormat InPixelFormat)
+	{
+		return InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? InWidth * 2 : FMath::DivideAndRoundUp<uint32>(InWidth, 6) * 16;
+	}
+
+	/** Offset in bytes of the top left corner of the region in the input frame. The region is aligned. */
+	const uint8* GetRegionStart(const uint8* InBuffer, uint32 InPitch, const FIntRect& InRegion, BlackmagicDesign::EPixelFormat InPixelFormat)
+	{
+		const uint32 ByteOffset = InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? InRegion.Min.X * 2 : (InRegion.Min.X / 6) * 16;
+		return InBuffer + uint64(InRegion.Min.Y) * InPitch + ByteOffset;
+	}
+
+	/** Copy the lines of the region in a compact buffer. v210 lines are padded to 128 bytes, like the lines of the device. */
+	void CopyRegion(const uint8* InBuffer, uint32 InPitch, const FIntRect& InRegion, BlackmagicDesign::EPixelFormat InPixelFormat, TArray<uint8>& OutBuffer, FVideoRegion& OutRegion)
+	{
+		const uint32 Width = InRegion.Width();
+		const uint32 Height = InRegion.Height();
+		const uint32 LineSize = GetLineSize(Width, InPixelFormat);
+		const uint32 Pitch = InPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? LineSize : Align(LineSize, 128);
+
+		OutBuffer.SetNumUninitialized(Pitch * Height, false);
+		const uint8* Source = GetRegionStart(InBuffer, InPitch, InRegion, InPixelFormat);
+		for (uint32 Line = 0; Line < Height; ++Line)
+		{
+			FMemory::Memcpy(OutBuffer.GetData() + Line * Pitch, Source + uint64(Line) * InPitch, LineSize);
+		}
+
+		OutRegion.Buffer = OutBuffer.GetData();
+		OutRegion.Pitch = Pitch;
+		OutRegion.Width = Width;
+		OutRegion.Height = Height;
+	}
+
+	/** How the timecode of the input frames is used */
+	enum class ETimecodeMode : uint8
+	{
+		None,
+		Read,
+		/** Read and burned in the progressive frames */
+		Burn,
+	};
+
+	/** What the frames of a pixel format have in common */
+	template<BlackmagicDesign::EPixelFormat PixelFormat>
+	struct TPixelFormatTraits;
+
+	template<>
+	struct TPixelFormatTraits<BlackmagicDesign::EPixelFormat::pf_8Bits>
+	{
+		static const EMediaTextureSampleFormat SampleFormat = EMediaTextureSampleFormat::CharUYVY;
+		static const EMediaIOCoreEncodePixelFormat EncodePixelFormat = EMediaIOCoreEncodePixelFormat::CharUYVY;
+		static const EBlackmagicRecordingPixelFormat RecordingPixelFormat = EBlackmagicRecordingPixelFormat::UYVY;
+	};
+
+	template<>
+	struct TPixelFormatTraits<BlackmagicDesign::EPixelFormat::pf_10Bits>
+	{
+		static const EMediaTextureSampleFormat SampleFormat = EMediaTextureSampleFormat::YUVv210;
+		static const EMediaIOCoreEncodePixelFormat EncodePixelFormat = EMediaIOCoreEncodePixelFormat::YUVv210;
+		static const EBlackmagicRecordingPixelFormat RecordingPixelFormat = EBlackmagicRecordingPixelFormat::V210;
+	};
+
+	/** Optional work on the frames of an input. Resolved when it changes, not checked for every frame. */
+	enum class EInputStages : uint8
+	{
+		None = 0,
+		/** Blackmagic.RecordInput */
+		Record = 1 << 0,
+		/** Shared memory export */
+		Export = 1 << 1,
+		Proxy = 1 << 2,
+		/** Only while the pixel tap of the input has subscribers */
+		PixelTap = 1 << 3,
+		RegionOfInterest = 1 << 4,
+		DuplicateDetection = 1 << 5,
+		/** Blackmagic.WriteOutputRawData */
+		RawDump = 1 << 6,
+	};
+	ENUM_CLASS_FLAGS(EInputStages);
+
+	/** Event sink of the player used by the ingest benchmark */
+	class FBenchmarkEventSink : public IMediaEventSink
+	{
+	public:
+		virtual void ReceiveMediaEvent(EMediaEvent Event) override {}
+	};
+
 	class FBlackmagicMediaPlayerEventCallback : public BlackmagicDesign::IInputEventCallback
 	{
+		using FProcessFrameFunction = void (FBlackmagicMediaPlayerEventCallback::*)(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo&);
+
 	public:
 		FBlackmagicMediaPlayerEventCallback(FBlackmagicMediaPlayer* InMediaPlayer, const BlackmagicDesign::FChannelInfo& InChannelInfo)
 			: RefCounter(0)
 			, ChannelInfo(InChannelInfo)
+			, bIsChannelRequested(false)
 			, MediaPlayer(InMediaPlayer)
 			, MediaState(EMediaState::Closed)
 			, PrevousTimespan(FTimespan::Zero())
-			, bEncodeTimecodeInTexel(false)
+			, ProcessFrameFunction(nullptr)
+			, InputPixelFormat(BlackmagicDesign::EPixelFormat::pf_8Bits)
+			, bIsInterlacedInput(false)
+			, TimecodeMode(ETimecodeMode::None)
+			, bReadAudio(false)
+			, Stages(EInputStages::None)
+			, TimecodeFrameLimit(0)
+			, FrameInterval(FTimespan::Zero())
+			, bIsDropFrameTimecode(false)
+			, bUseFrameClock(false)
+			, bIsRawDumpRequested(false)
 			, LastBitsPerSample(0)
 			, LastNumChannels(0)
 			, LastSampleRate(0)
 			, AudioFrameDropCount(0)
 			, MetadataFrameDropCount(0)
 			, VideoFrameDropCount(0)
+			, LateVideoFrameDropCount(0)
+			, LateFrameTolerance(-1)
+			, LateFrameTicks(TNumericLimits<int64>::Lowest())
+			, WindowEndTicks(TNumericLimits<int64>::Max())
+			, EvaluationTime(FTimespan::Zero())
 			, LastHasFrameTime(0.0)
 			, bReceivedValidFrame(false)
-			, bIsTimecodeExpected(false)
 			, bHasWarnedMissingTimecode(false)
 			, bIsSRGBInput(false)
+			, DisplayMode(0)
+			, NumFramesToRecord(0)
+			, ExportNumSlots(0)
+			, DuplicateFrameDetection(EBlackmagicMediaDuplicateFrameDetection::Disabled)
+			, LastFrameHash(0)
+			, NumUniqueFrames(0)
+			, NumDuplicateFrames(0)
+			, BatchMaxAge(0.0)
+			, BatchMaxFrames(1)
+			, NumBatchedFrames(0)
+			, BatchStartTime(0.0)
 		{
 		}
 
-		bool Initialize(const BlackmagicDesign::FInputChannelOptions& InChannelInfo, bool bInEncodeTimecodeInTexel, int32 InMaxNumAudioFrameBuffer, int32 InMaxNumVideoFrameBuffer, bool bInIsSRGBInput)
+		/**
+		 * Configure the callback for its player and open the channel on a background thread, unless the channel is still opened by a previous player.
+		 * The state goes to Playing once the device is initialized, or to Error.
+		 * @return Completion of the opening, invalid when the channel was already opened
+		 */
+		TSharedFuture<void> Initialize(FBlackmagicMediaPlayer* InMediaPlayer, const BlackmagicDesign::FInputChannelOptions& InChannelInfo, bool bInIsInterlaced, bool bInEncodeTimecodeInTexel, int32 InMaxNumAudioFrameBuffer, int32 InMaxNumVideoFrameBuffer, bool bInIsSRGBInput, const FString& InExportName, int32 InExportNumSlots, int32 InProxyFrameDivider, const FIntRect& InRegionOfInterest, EBlackmagicMediaDuplicateFrameDetection InDuplicateFrameDetection)
 		{
+			{
+				// A warm channel is still receiving frames
+				FScopeLock Lock(&CallbackLock);
+				MediaPlayer = InMediaPlayer;
+				Configure(InChannelInfo, bInIsInterlaced, bInEncodeTimecodeInTexel, InMaxNumAudioFrameBuffer, InMaxNumVideoFrameBuffer, bInIsSRGBInput, InExportName, InExportNumSlots, InProxyFrameDivider, InRegionOfInterest, InDuplicateFrameDetection);
+			}
+
+			if (bIsChannelRequested)
+			{
+				return TSharedFuture<void>();
+			}
+
 			AddRef();
+			bIsChannelRequested = true;
+			ChannelOptions = InChannelInfo;
+			MediaState = EMediaState::Preparing;
 
-			bEncodeTimecodeInTexel = bInEncodeTimecodeInTexel;
+			// The previews of the device close before the channel opens, the channel tasks run in order
+			FBlackmagicMediaProxyPreview::SuspendDevice(ChannelInfo.DeviceIndex);
+
+			// The reference keeps the callback alive until the channel is opened, even if the player is closed before
+			BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> SelfRef(this);
+			return FBlackmagicMediaChannelTasks::Enqueue([this, SelfRef, InChannelInfo]()
+			{
+				const BlackmagicDesign::FUniqueIdentifier Identifier = BlackmagicMediaBackend::RegisterCallbackForChannel(ChannelInfo, InChannelInfo, SelfRef);
+
+				FScopeLock Lock(&CallbackLock);
+				BlackmagicIdendifier = Identifier;
+				if (!Identifier.IsValid() && MediaState == EMediaState::Preparing)
+				{
+					MediaState = EMediaState::Error;
+				}
+			});
+		}
+
+		void Configure(const BlackmagicDesign::FInputChannelOptions& InChannelInfo, bool bInIsInterlaced, bool bInEncodeTimecodeInTexel, int32 InMaxNumAudioFrameBuffer, int32 InMaxNumVideoFrameBuffer, bool bInIsSRGBInput, const FString& InExportName, int32 InExportNumSlots, int32 InProxyFrameDivider, const FIntRect& InRegionOfInterest, EBlackmagicMediaDuplicateFrameDetection InDuplicateFrameDetection)
+		{
+			BatchMaxAge = FMath::Max(CVarBlackmagicInputBatchMaxAge.GetValueOnAnyThread(), 0.f) / 1000.0;
+			BatchMaxFrames = FMath::Max(CVarBlackmagicInputBatchMaxFrames.GetValueOnAnyThread(), 1);
+			bUseFrameClock = CVarBlackmagicInputFrameClock.GetValueOnAnyThread() != 0;
+			LateFrameTolerance = CVarBlackmagicInputLateFrameTolerance.GetValueOnAnyThread();
+			LateFrameTicks = TNumericLimits<int64>::Lowest();
+			WindowEndTicks = TNumericLimits<int64>::Max();
+
+			RegionOfInterest = InRegionOfInterest;
+			DuplicateFrameDetection = InDuplicateFrameDetection;
+			LastFrameHash = 0;
+			NumUniqueFrames = 0;
+			NumDuplicateFrames = 0;
+			AudioFrameDropCount = 0;
+			MetadataFrameDropCount = 0;
+			VideoFrameDropCount = 0;
+			LateVideoFrameDropCount = 0;
+			bHasWarnedMissingTimecode = false;
+
+			if (InProxyFrameDivider > 0)
+			{
+				ProxyGenerator = MakeUnique<FBlackmagicMediaProxyGenerator>(ChannelInfo.DeviceIndex, InProxyFrameDivider);
+			}
+
+			if (InChannelInfo.bReadVideo)
+			{
+				PixelTap = MakeUnique<FBlackmagicMediaPixelTap>(ChannelInfo.DeviceIndex);
+				CardPort = FBlackmagicMediaCardIngest::OpenPort(ChannelInfo.DeviceIndex, InChannelInfo.FormatInfo.DisplayMode, InChannelInfo.PixelFormat);
+			}
+
+			ExportName = InExportName;
+			ExportNumSlots = InExportNumSlots;
+			DisplayMode = InChannelInfo.FormatInfo.DisplayMode;
 			MaxNumAudioFrameBuffer = InMaxNumAudioFrameBuffer;
 			MaxNumVideoFrameBuffer = InMaxNumVideoFrameBuffer;
-			bIsTimecodeExpected = InChannelInfo.TimecodeFormat != BlackmagicDesign::ETimecodeFormat::TCF_None;
 			bIsSRGBInput = bInIsSRGBInput;
 
-			BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> SelfRef(this);
-			BlackmagicIdendifier = BlackmagicDesign::RegisterCallbackForChannel(ChannelInfo, InChannelInfo, SelfRef);
-			MediaState = BlackmagicIdendifier.IsValid() ? EMediaState::Preparing : EMediaState::Error;
-			return BlackmagicIdendifier.IsValid();
+			InputPixelFormat = InChannelInfo.PixelFormat;
+			bReadAudio = InChannelInfo.bReadAudio;
+			TimecodeMode = ETimecodeMode::None;
+			if (InChannelInfo.TimecodeFormat != BlackmagicDesign::ETimecodeFormat::TCF_None)
+			{
+				TimecodeMode = bInEncodeTimecodeInTexel ? ETimecodeMode::Burn : ETimecodeMode::Read;
+			}
+			SelectProcessFrame(bInIsInterlaced);
 		}
 
-		void Uninitialize()
+		/** Stop giving the frames to the player, the channel stays opened */
+		void Detach()
 		{
 			FScopeLock Lock(&CallbackLock);
-			MediaPlayer = nullptr;
+			DetachInternal();
+		}
+
+		/** Whether a player that opens the input with these options can use this channel */
+		bool CanReattach(const BlackmagicDesign::FChannelInfo& InChannelInfo, const BlackmagicDesign::FInputChannelOptions& InChannelOptions) const
+		{
+			// The device thread changes the state
+			FScopeLock Lock(&CallbackLock);
+			return MediaState == EMediaState::Playing
+				&& ChannelInfo.DeviceIndex == InChannelInfo.DeviceIndex
+				&& ChannelOptions.FormatInfo.DisplayMode == InChannelOptions.FormatInfo.DisplayMode
+				&& ChannelOptions.bReadVideo == InChannelOptions.bReadVideo
+				&& ChannelOptions.PixelFormat == InChannelOptions.PixelFormat
+				&& ChannelOptions.TimecodeFormat == InChannelOptions.TimecodeFormat
+				&& ChannelOptions.bReadAudio == InChannelOptions.bReadAudio
+				&& ChannelOptions.NumberOfAudioChannel == InChannelOptions.NumberOfAudioChannel
+				&& ChannelOptions.bUseTheDedicatedLTCInput == InChannelOptions.bUseTheDedicatedLTCInput
+				&& ChannelOptions.CallbackPriority == InChannelOptions.CallbackPriority;
+		}
+
+		int32 GetDeviceIndex() const { return ChannelInfo.DeviceIndex; }
 
-			if (BlackmagicIdendifier.IsValid())
+		/**
+		 * Stop giving the frames to the player now and close the channel on a background thread.
+		 * The callback is released once the channel is closed, the frames received until then are ignored.
+		 * @return Completion of the closing
+		 */
+		TSharedFuture<void> Uninitialize()
+		{
 			{
+				FScopeLock Lock(&CallbackLock);
+				DetachInternal();
 				MediaState = EMediaState::Stopped;
-				BlackmagicDesign::UnregisterCallbackForChannel(ChannelInfo, BlackmagicIdendifier);
-				BlackmagicIdendifier = BlackmagicDesign::FUniqueIdentifier();
 			}
 
-			Release();
+			// The task may release the callback before it returns
+			const int32 DeviceIndex = ChannelInfo.DeviceIndex;
+			const bool bWasChannelRequested = bIsChannelRequested;
+
+			// Enqueued after the opening, the identifier is known when it runs
+			TSharedFuture<void> Result = FBlackmagicMediaChannelTasks::Enqueue([this]()
+			{
+				BlackmagicDesign::FUniqueIdentifier Identifier;
+				{
+					FScopeLock Lock(&CallbackLock);
+					Identifier = BlackmagicIdendifier;
+					BlackmagicIdendifier = BlackmagicDesign::FUniqueIdentifier();
+				}
+
+				if (Identifier.IsValid())
+				{
+					BlackmagicMediaBackend::UnregisterCallbackForChannel(ChannelInfo, Identifier);
+				}
+
+				Release();
+			});
+
+			// Enqueued after the closing, the previews open the device once it is free
+			if (bWasChannelRequested)
+			{
+				FBlackmagicMediaProxyPreview::ResumeDevice(DeviceIndex);
+			}
+			return Result;
+		}
+
+		/** Take the settings of the source that don't require to reopen the input */
+		void ApplySettings(int32 InMaxNumAudioFrameBuffer, int32 InMaxNumVideoFrameBuffer, bool bInEncodeTimecodeInTexel, EBlackmagicMediaDuplicateFrameDetection InDuplicateFrameDetection)
+		{
+			FScopeLock Lock(&CallbackLock);
+
+			if (MediaPlayer == nullptr)
+			{
+				return;
+			}
+
+			MaxNumAudioFrameBuffer = InMaxNumAudioFrameBuffer;
+			MaxNumVideoFrameBuffer = InMaxNumVideoFrameBuffer;
+
+			if (DuplicateFrameDetection != InDuplicateFrameDetection)
+			{
+				DuplicateFrameDetection = InDuplicateFrameDetection;
+				LastSample.Reset();
+				UpdateStages();
+			}
+
+			if (TimecodeMode != ETimecodeMode::None)
+			{
+				const ETimecodeMode NewTimecodeMode = bInEncodeTimecodeInTexel ? ETimecodeMode::Burn : ETimecodeMode::Read;
+				if (NewTimecodeMode != TimecodeMode)
+				{
+					TimecodeMode = NewTimecodeMode;
+					SelectProcessFrame(bIsInterlacedInput);
+				}
+			}
 		}
 
 		EMediaState GetMediaState() const { return MediaState; }
 
+		/** Give the samples of the current batch to the player, so the frames received since the last engine frame can be used by this one */
+		void PublishBatch_GameThread()
+		{
+			FScopeLock Lock(&CallbackLock);
+			if (MediaPlayer != nullptr)
+			{
+				PublishBatch();
+			}
+		}
+
+		/** Record the next frames of the input, instead of the rest of the current recording */
+		void StartRecording(int32 InNumFrames)
+		{
+			FScopeLock Lock(&CallbackLock);
+			if (MediaPlayer == nullptr)
+			{
+				return;
+			}
+
+			if (Recorder.IsValid())
+			{
+				Recorder->Close();
+				Recorder.Reset();
+			}
+			NumFramesToRecord = InNumFrames;
+			UpdateStages();
+		}
+
+		/** Write the next frame of the input to a file */
+		void RequestRawDump()
+		{
+			FScopeLock Lock(&CallbackLock);
+			if (MediaPlayer != nullptr)
+			{
+				bIsRawDumpRequested = true;
+				UpdateStages();
+			}
+		}
+
+		/** The pixel tap stage depends on the subscribers of the input */
+		void OnPixelTapSubscribersChanged()
+		{
+			FScopeLock Lock(&CallbackLock);
+			if (MediaPlayer != nullptr)
+			{
+				UpdateStages();
+			}
+		}
+
+		/** Blackmagic.RecordInput */
+		static void RecordInputs(const TArray<FString>& Args)
+		{
+			const int32 NumFrames = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 1;
+
+			FScopeLock Lock(&PlayersLock);
+			for (FBlackmagicMediaPlayer* Player : Players)
+			{
+				Player->EventCallback->StartRecording(NumFrames);
+			}
+		}
+
+		/** Blackmagic.WriteOutputRawData */
+		static void DumpInputs()
+		{
+			FScopeLock Lock(&PlayersLock);
+			for (FBlackmagicMediaPlayer* Player : Players)
+			{
+				Player->EventCallback->RequestRawDump();
+			}
+		}
+
+	private:
+		void DetachInternal()
+		{
+			const bool bWasAttached = MediaPlayer != nullptr;
+			MediaPlayer = nullptr;
+			if (Recorder.IsValid())
+			{
+				Recorder->Close();
+				Recorder.Reset();
+			}
+			Exporter.Reset();
+			ProxyGenerator.Reset();
+			PixelTap.Reset();
+			LastSample.Reset();
+			NumFramesToRecord = 0;
+			bIsRawDumpRequested = false;
+			PendingVideoSamples.Reset();
+			CardPort.Reset();
+			PendingAudioSamples.Reset();
+			NumBatchedFrames = 0;
+
+			if (bWasAttached && DuplicateFrameDetection != EBlackmagicMediaDuplicateFrameDetection::Disabled)
+			{
+				UE_LOG(LogBlackmagicMedia, Log, TEXT("Input %d received %d unique and %d duplicate frames."), ChannelInfo.DeviceIndex, NumUniqueFrames, NumDuplicateFrames);
+			}
+		}
+
+	public:
+
 		void UpdateAudioTrackFormat(FMediaAudioTrackFormat& OutAudioTrackFormat)
 		{
 			OutAudioTrackFormat.BitsPerSample = LastBitsPerSample;
@@ -106,6 +592,26 @@ namespace BlackmagicMediaPlayerHelpers
 			OutAudioTrackFormat.SampleRate = LastSampleRate;
 		}
 
+		/**
+		 * Take the time the player evaluates this frame: the engine timecode minus the FrameDelay or TimeDelay of the source, as set by TickTimeManagement.
+		 * The frames older than it by more than Blackmagic.InputLateFrameTolerance won't be evaluated anymore, that time only goes forward.
+		 * Only for the time synchronized inputs with a timecode, the time of their samples is their timecode.
+		 */
+		void UpdateEvaluationTime_GameThread()
+		{
+			if (MediaPlayer->bUseTimeSynchronization && TimecodeMode != ETimecodeMode::None && LateFrameTolerance >= 0)
+			{
+				EvaluationTime = MediaPlayer->CurrentTime;
+				LateFrameTicks = EvaluationTime.GetTicks() - FrameInterval.GetTicks() * LateFrameTolerance;
+				WindowEndTicks = EvaluationTime.GetTicks() + FrameInterval.GetTicks();
+			}
+			else
+			{
+				LateFrameTicks = TNumericLimits<int64>::Lowest();
+				WindowEndTicks = TNumericLimits<int64>::Max();
+			}
+		}
+
 		void VerifyFrameDropCount_GameThread(const FString& InUrl)
 		{
 			//Audio buffer
@@ -116,10 +622,26 @@ namespace BlackmagicMediaPlayerHelpers
 			}
 
 			//Video buffer
-			int32 VideoOverflowCount = FMath::Max(MediaPlayer->Samples->NumVideoSamples() - MaxNumVideoFrameBuffer, 0);
-			for (int32 i = 0; i < VideoOverflowCount; ++i)
+			int32 LateVideoCount = 0;
+			int32 VideoOverflowCount = 0;
+			const FTimespan LateFrameTime = GetLateFrameTime();
+			if (LateFrameTime > FTimespan::MinValue())
 			{
-				MediaPlayer->Samples->PopVideo();
+				// The samples before the window won't be evaluated anymore.
+				// The queue only pops its oldest sample, the samples after the window are dropped by ProcessVideo as they arrive.
+				TSharedPtr<IMediaTextureSample, ESPMode::ThreadSafe> Sample;
+				while (MediaPlayer->Samples->FetchVideo(TRange<FTimespan>(FTimespan::MinValue(), LateFrameTime), Sample))
+				{
+					++LateVideoCount;
+				}
+			}
+			else
+			{
+				VideoOverflowCount = FMath::Max(MediaPlayer->Samples->NumVideoSamples() - MaxNumVideoFrameBuffer, 0);
+				for (int32 i = 0; i < VideoOverflowCount; ++i)
+				{
+					MediaPlayer->Samples->PopVideo();
+				}
 			}
 
 			if (MediaPlayer->bVerifyFrameDropCount)
@@ -135,231 +657,773 @@ namespace BlackmagicMediaPlayerHelpers
 				{
 					UE_LOG(LogBlackmagicMedia, Warning, TEXT("Lost %d video frames on input %s. Frame rate is either too slow or buffering capacity is too small."), VideoOverflowCount, *InUrl);
 				}
+
+				LateVideoCount += FPlatformAtomics::InterlockedExchange(&LateVideoFrameDropCount, 0);
+				if (LateVideoCount > 0)
+				{
+					UE_LOG(LogBlackmagicMedia, Warning, TEXT("Discarded %d video frames on input %s older than the evaluated time. The input is late, or its timecode is behind the engine's by more than the delay of the source."), LateVideoCount, *InUrl);
+				}
+			}
+		}
+
+		/**
+		 * Measure the work done per received frame for every instantiation of ProcessFrame without optional stages, with tiny frames so the copies don't hide it.
+		 * The frames go through OnFrameReceived like the frames of the device. The player is never opened, so the console commands and the settings updates don't reach it.
+		 */
+		static void RunBenchmark(const TArray<FString>& Args)
+		{
+			const int32 NumIterations = Args.IsValidIndex(0) ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+			const int32 NumFramesPerBatch = Args.IsValidIndex(1) ? FMath::Max(FCString::Atoi(*Args[1]), 0) : 0;
+
+			FBenchmarkEventSink EventSink;
+			FBlackmagicMediaPlayer Player(EventSink);
+			Player.VideoFrameRate = FFrameRate(30, 1);
+
+			BlackmagicDesign::FChannelInfo ChannelInfo;
+			ChannelInfo.DeviceIndex = 0;
+
+			const uint32 Width = 48;
+			const uint32 Height = 8;
+			TArray<uint8> VideoBuffer;
+			VideoBuffer.SetNumZeroed(128 * Height);
+			TArray<int32> AudioBuffer;
+			AudioBuffer.SetNumZeroed(2 * 1600);
+
+			for (int32 Variant = 0; Variant < 16; ++Variant)
+			{
+				const BlackmagicDesign::EPixelFormat PixelFormat = (Variant & 1) ? BlackmagicDesign::EPixelFormat::pf_10Bits : BlackmagicDesign::EPixelFormat::pf_8Bits;
+				const bool bIsInterlaced = (Variant & 2) != 0;
+				const bool bHasTimecode = (Variant & 4) != 0;
+				const bool bHasAudio = (Variant & 8) != 0;
+
+				FBlackmagicMediaPlayerEventCallback* Callback = new FBlackmagicMediaPlayerEventCallback(&Player, ChannelInfo);
+				Callback->AddRef();
+				Callback->MediaState = EMediaState::Playing;
+				Callback->MaxNumAudioFrameBuffer = 8;
+				Callback->MaxNumVideoFrameBuffer = 8;
+				Callback->InputPixelFormat = PixelFormat;
+				Callback->TimecodeMode = bHasTimecode ? ETimecodeMode::Read : ETimecodeMode::None;
+				Callback->bReadAudio = bHasAudio;
+				Callback->BatchMaxAge = NumFramesPerBatch > 0 ? 1.0 : 0.0;
+				Callback->BatchMaxFrames = FMath::Max(NumFramesPerBatch, 1);
+				Callback->SelectProcessFrame(bIsInterlaced);
+
+				BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo FrameInfo;
+				FrameInfo.bHasInputSource = true;
+				FrameInfo.bHaveTimecode = bHasTimecode;
+				FrameInfo.VideoBuffer = VideoBuffer.GetData();
+				FrameInfo.VideoWidth = Width;
+				FrameInfo.VideoHeight = Height;
+				FrameInfo.VideoPitch = PixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? Width * 2 : 128;
+				FrameInfo.PixelFormat = PixelFormat;
+				FrameInfo.FieldDominance = bIsInterlaced ? BlackmagicDesign::EFieldDominance::Interlaced : BlackmagicDesign::EFieldDominance::Progressive;
+				FrameInfo.AudioBuffer = bHasAudio ? AudioBuffer.GetData() : nullptr;
+				FrameInfo.AudioBufferSize = AudioBuffer.Num() * sizeof(int32);
+				FrameInfo.NumberOfAudioChannel = 2;
+				FrameInfo.AudioRate = 48000;
+
+				const double StartTime = FPlatformTime::Seconds();
+				for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+				{
+					FrameInfo.FrameNumber = Iteration;
+					FrameInfo.Timecode.Frames = Iteration % 29;
+					Callback->OnFrameReceived(FrameInfo);
+
+					while (Player.Samples->NumVideoSamples() > 0)
+					{
+						Player.Samples->PopVideo();
+					}
+					while (Player.Samples->NumAudioSamples() > 0)
+					{
+						Player.Samples->PopAudio();
+					}
+				}
+				const double Nanoseconds = (FPlatformTime::Seconds() - StartTime) * 1.0e9 / NumIterations;
+
+				UE_LOG(LogBlackmagicMedia, Display, TEXT("Ingest of %s %s frames, timecode %s, audio %s: %.1f ns per frame."),
+					PixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? TEXT("8bit") : TEXT("10bit"), bIsInterlaced ? TEXT("interlaced") : TEXT("progressive"),
+					bHasTimecode ? TEXT("on") : TEXT("off"), bHasAudio ? TEXT("on") : TEXT("off"), Nanoseconds);
+
+				Callback->MediaPlayer = nullptr;
+				Callback->Release();
+			}
+		}
+
+	private:
+		virtual void AddRef() override
+		{
+			++RefCounter;
+		}
+
+		virtual void Release() override
+		{
+			--RefCounter;
+			if (RefCounter == 0)
+			{
+				delete this;
+			}
+		}
+
+		virtual void OnInitializationCompleted(bool bSuccess) override
+		{
+			// The player may already be closed, the channel is about to be
+			if (MediaState == EMediaState::Preparing)
+			{
+				MediaState = bSuccess ? EMediaState::Playing : EMediaState::Error;
+			}
+		}
+
+		virtual void OnShutdownCompleted() override
+		{
+			MediaState = EMediaState::Closed;
+		}
+
+		virtual void OnFrameReceived(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo) override
+		{
+			SCOPE_CYCLE_COUNTER(STAT_Blackmagic_MediaPlayer_ProcessReceivedFrame);
+
+			FScopeLock Lock(&CallbackLock);
+
+			if (MediaPlayer == nullptr)
+			{
+				return;
+			}
+
+			if (!InFrameInfo.bHasInputSource && InFrameInfo.AudioBuffer == nullptr)
+			{
+				const double CurrentTime = FApp::GetCurrentTime();
+				const double TimeAllowedToConnect = 2.0;
+				if (LastHasFrameTime < 0.1)
+				{
+					LastHasFrameTime = CurrentTime;
+				}
+				if (bReceivedValidFrame || CurrentTime - LastHasFrameTime > TimeAllowedToConnect)
+				{
+					UE_LOG(LogBlackmagicMedia, Error, TEXT("There is no video input for '%s'."), *MediaPlayer->GetUrl());
+					MediaState = EMediaState::Error;
+				}
+				return;
+			}
+			bReceivedValidFrame = bReceivedValidFrame || InFrameInfo.bHasInputSource;
+
+			if (MediaState == EMediaState::Playing)
+			{
+				(this->*ProcessFrameFunction)(InFrameInfo);
+			}
+		}
+
+		/**
+		 * Choose the instantiation of ProcessFrame for the pixel format, the field mode, the timecode mode, the audio and the optional stages of the input,
+		 * and compute what the frames have in common.
+		 */
+		void SelectProcessFrame(bool bInIsInterlaced)
+		{
+			// The library gives a "linear" timecode even for frame rates greater than 30
+			const int32 FrameRate = FMath::RoundToInt(MediaPlayer->VideoFrameRate.AsDecimal());
+			TimecodeFrameLimit = bInIsInterlaced ? FrameRate - 1 : FrameRate;
+			FrameInterval = FTimespan::FromSeconds(MediaPlayer->VideoFrameRate.AsInterval());
+			bIsDropFrameTimecode = FTimecode::IsDropFormatTimecodeSupported(MediaPlayer->VideoFrameRate);
+			FrameClock.Reset(MediaPlayer->VideoFrameRate.AsInterval());
+			RawDumpFilename = FString::Printf(InputPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? TEXT("Blackmagic_Output_8_YUV_ch%d") : TEXT("Blackmagic_Output_10_YUV_ch%d"), ChannelInfo.DeviceIndex);
+			bIsInterlacedInput = bInIsInterlaced;
+			UpdateStages();
+		}
+
+		/**
+		 * Resolve the optional stages of the frames and choose the instantiation of ProcessFrame again.
+		 * Called under the lock whenever a stage is enabled or disabled, the frames only test the resolved stages.
+		 */
+		void UpdateStages()
+		{
+			Stages = EInputStages::None;
+			if (NumFramesToRecord > 0)
+			{
+				Stages |= EInputStages::Record;
+			}
+			if (!ExportName.IsEmpty())
+			{
+				Stages |= EInputStages::Export;
+			}
+			if (ProxyGenerator.IsValid())
+			{
+				Stages |= EInputStages::Proxy;
+			}
+			if (PixelTap.IsValid() && PixelTap->HasSubscribers())
+			{
+				Stages |= EInputStages::PixelTap;
+			}
+			if (!RegionOfInterest.IsEmpty())
+			{
+				Stages |= EInputStages::RegionOfInterest;
+			}
+			if (DuplicateFrameDetection != EBlackmagicMediaDuplicateFrameDetection::Disabled)
+			{
+				Stages |= EInputStages::DuplicateDetection;
+			}
+			if (bIsRawDumpRequested)
+			{
+				Stages |= EInputStages::RawDump;
+			}
+
+			// The timecode is only burned in progressive frames
+			const ETimecodeMode FieldTimecodeMode = (TimecodeMode == ETimecodeMode::Burn && bIsInterlacedInput) ? ETimecodeMode::Read : TimecodeMode;
+			if (InputPixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits)
+			{
+				ProcessFrameFunction = bIsInterlacedInput ? SelectTimecodeMode<BlackmagicDesign::EPixelFormat::pf_8Bits, true>(FieldTimecodeMode) : SelectTimecodeMode<BlackmagicDesign::EPixelFormat::pf_8Bits, false>(FieldTimecodeMode);
+			}
+			else
+			{
+				ProcessFrameFunction = bIsInterlacedInput ? SelectTimecodeMode<BlackmagicDesign::EPixelFormat::pf_10Bits, true>(FieldTimecodeMode) : SelectTimecodeMode<BlackmagicDesign::EPixelFormat::pf_10Bits, false>(FieldTimecodeMode);
+			}
+		}
+
+		bool HasStage(EInputStages InStage) const { return EnumHasAnyFlags(Stages, InStage); }
+
+		template<BlackmagicDesign::EPixelFormat PixelFormat, bool bIsInterlaced>
+		FProcessFrameFunction SelectTimecodeMode(ETimecodeMode InTimecodeMode) const
+		{
+			switch (InTimecodeMode)
+			{
+			case ETimecodeMode::Read:
+				return SelectAudio<PixelFormat, bIsInterlaced, ETimecodeMode::Read>();
+			case ETimecodeMode::Burn:
+				return SelectAudio<PixelFormat, bIsInterlaced, ETimecodeMode::Burn>();
+			case ETimecodeMode::None:
+			default:
+				return SelectAudio<PixelFormat, bIsInterlaced, ETimecodeMode::None>();
+			}
+		}
+
+		template<BlackmagicDesign::EPixelFormat PixelFormat, bool bIsInterlaced, ETimecodeMode FrameTimecodeMode>
+		FProcessFrameFunction SelectAudio() const
+		{
+			return bReadAudio ? SelectStages<PixelFormat, bIsInterlaced, FrameTimecodeMode, true>() : SelectStages<PixelFormat, bIsInterlaced, FrameTimecodeMode, false>();
+		}
+
+		template<BlackmagicDesign::EPixelFormat PixelFormat, bool bIsInterlaced, ETimecodeMode FrameTimecodeMode, bool bHasAudio>
+		FProcessFrameFunction SelectStages() const
+		{
+			return Stages != EInputStages::None ? &FBlackmagicMediaPlayerEventCallback::ProcessFrame<PixelFormat, bIsInterlaced, FrameTimecodeMode, bHasAudio, true> : &FBlackmagicMediaPlayerEventCallback::ProcessFrame<PixelFormat, bIsInterlaced, FrameTimecodeMode, bHasAudio, false>;
+		}
+
+		/**
+		 * Process a frame of a playing input. Everything that is the same for all the frames is a template parameter.
+		 * Without optional stages, none of them is tested.
+		 */
+		template<BlackmagicDesign::EPixelFormat PixelFormat, bool bIsInterlaced, ETimecodeMode FrameTimecodeMode, bool bHasAudio, bool bHasStages>
+		void ProcessFrame(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo)
+		{
+			if (InFrameInfo.VideoBuffer && (InFrameInfo.FieldDominance == BlackmagicDesign::EFieldDominance::Interlaced) != bIsInterlaced)
+			{
+				// The video standard of the source doesn't match the signal, follow the signal
+				UE_LOG(LogBlackmagicMedia, Warning, TEXT("Input '%s' receives %s frames, which doesn't match its configuration."), *MediaPlayer->GetUrl(), bIsInterlaced ? TEXT("progressive") : TEXT("interlaced"));
+				SelectProcessFrame(!bIsInterlaced);
+				(this->*ProcessFrameFunction)(InFrameInfo);
+				return;
+			}
+
+			double FrameSeconds = MediaPlayer->GetPlatformSeconds();
+			if (bUseFrameClock)
+			{
+				FrameSeconds = FrameClock.Correlate(InFrameInfo.FrameNumber, FrameSeconds);
+				SET_FLOAT_STAT(STAT_Blackmagic_MediaPlayer_CallbackDelay, FrameClock.GetAverageDelay() * 1000.0);
+			}
+
+			FTimespan DecodedTime = FTimespan::FromSeconds(FrameSeconds);
+			TOptional<FTimecode> DecodedTimecode;
+			if (FrameTimecodeMode != ETimecodeMode::None)
+			{
+				DecodeTimecode(InFrameInfo, DecodedTime, DecodedTimecode);
+			}
+
+			if (bHasStages && HasStage(EInputStages::Record))
+			{
+				RecordFrame(InFrameInfo, DecodedTimecode);
+			}
+			if (bHasStages && HasStage(EInputStages::Export))
+			{
+				ExportFrame(InFrameInfo, DecodedTimecode);
+			}
+
+			if (bHasAudio && InFrameInfo.AudioBuffer)
+			{
+				ProcessAudio(InFrameInfo, DecodedTime, DecodedTimecode);
+			}
+
+			if (InFrameInfo.VideoBuffer)
+			{
+				ProcessVideo<PixelFormat, bIsInterlaced, FrameTimecodeMode, bHasStages>(InFrameInfo, DecodedTime, DecodedTimecode);
+			}
+
+			EndBatchedFrame();
+		}
+
+		/** Queue a sample for the player, in the current batch when batching */
+		void AddVideo(const TSharedRef<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>& InSample)
+		{
+			if (BatchMaxAge > 0.0)
+			{
+				PendingVideoSamples.Add(InSample);
+			}
+			else
+			{
+				MediaPlayer->Samples->AddVideo(InSample);
+			}
+		}
+
+		void AddAudio(const TSharedRef<FMediaIOCoreAudioSampleBase, ESPMode::ThreadSafe>& InSample)
+		{
+			if (BatchMaxAge > 0.0)
+			{
+				PendingAudioSamples.Add(InSample);
+			}
+			else
+			{
+				MediaPlayer->Samples->AddAudio(InSample);
+			}
+		}
+
+		/** Samples given to the player and waiting in the batch */
+		int32 NumVideoSamples() const { return MediaPlayer->Samples->NumVideoSamples() + PendingVideoSamples.Num(); }
+		int32 NumAudioSamples() const { return MediaPlayer->Samples->NumAudioSamples() + PendingAudioSamples.Num(); }
+
+		/** Give the batch to the player once it has enough frames or its first frame is old enough */
+		void EndBatchedFrame()
+		{
+			if (BatchMaxAge <= 0.0)
+			{
+				return;
+			}
+
+			const double CurrentTime = FPlatformTime::Seconds();
+			if (NumBatchedFrames++ == 0)
+			{
+				BatchStartTime = CurrentTime;
+			}
+
+			if (NumBatchedFrames >= BatchMaxFrames || CurrentTime - BatchStartTime >= BatchMaxAge)
+			{
+				PublishBatch();
+			}
+		}
+
+		/** Time before which the frames won't be evaluated, MinValue when every frame is kept */
+		FTimespan GetLateFrameTime() const
+		{
+			const int64 Ticks = LateFrameTicks;
+			return Ticks == TNumericLimits<int64>::Lowest() ? FTimespan::MinValue() : FTimespan(Ticks);
+		}
+
+		/** Remove the video and audio samples of the batch that became too old while they waited */
+		void RemoveLateBatchedSamples()
+		{
+			const FTimespan LateFrameTime = GetLateFrameTime();
+			if (LateFrameTime > FTimespan::MinValue())
+			{
+				const int32 NumRemovedVideo = PendingVideoSamples.RemoveAll([LateFrameTime](const TSharedRef<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>& InSample) { return InSample->GetTime() < LateFrameTime; });
+				const int32 NumRemovedAudio = PendingAudioSamples.RemoveAll([LateFrameTime](const TSharedRef<FMediaIOCoreAudioSampleBase, ESPMode::ThreadSafe>& InSample) { return InSample->GetTime() < LateFrameTime; });
+				if (MediaPlayer->bVerifyFrameDropCount)
+				{
+					if (NumRemovedVideo > 0)
+					{
+						FPlatformAtomics::InterlockedAdd(&LateVideoFrameDropCount, NumRemovedVideo);
+					}
+					if (NumRemovedAudio > 0)
+					{
+						FPlatformAtomics::InterlockedAdd(&AudioFrameDropCount, NumRemovedAudio);
+					}
+				}
+			}
+		}
+
+		void PublishBatch()
+		{
+			SCOPE_CYCLE_COUNTER(STAT_Blackmagic_MediaPlayer_PublishBatch);
+
+			RemoveLateBatchedSamples();
+
+			for (const TSharedRef<FMediaIOCoreAudioSampleBase, ESPMode::ThreadSafe>& AudioSample : PendingAudioSamples)
+			{
+				MediaPlayer->Samples->AddAudio(AudioSample);
+			}
+			for (const TSharedRef<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>& TextureSample : PendingVideoSamples)
+			{
+				MediaPlayer->Samples->AddVideo(TextureSample);
+			}
+
+			PendingAudioSamples.Reset();
+			PendingVideoSamples.Reset();
+			NumBatchedFrames = 0;
+		}
+
+		void DecodeTimecode(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo, FTimespan& OutDecodedTime, TOptional<FTimecode>& OutDecodedTimecode)
+		{
+			if (InFrameInfo.bHaveTimecode)
+			{
+				if ((int32)InFrameInfo.Timecode.Frames >= TimecodeFrameLimit)
+				{
+					UE_LOG(LogBlackmagicMedia, Warning, TEXT("Input '%s' received an invalid Timecode frame number (%d) for the current frame rate (%s)."), *MediaPlayer->GetUrl(), InFrameInfo.Timecode.Frames, *MediaPlayer->VideoFrameRate.ToPrettyText().ToString());
+				}
+
+				OutDecodedTimecode = FTimecode(InFrameInfo.Timecode.Hours, InFrameInfo.Timecode.Minutes, InFrameInfo.Timecode.Seconds, InFrameInfo.Timecode.Frames, bIsDropFrameTimecode);
+
+				const FTimespan TimecodeDecodedTime = OutDecodedTimecode->ToTimespan(MediaPlayer->VideoFrameRate);
+				if (MediaPlayer->bUseTimeSynchronization)
+				{
+					OutDecodedTime = TimecodeDecodedTime;
+				}
+
+				PreviousTimecode = InFrameInfo.Timecode;
+				PrevousTimespan = TimecodeDecodedTime;
+
+				if (MediaPlayer->IsTimecodeLogEnabled())
+				{
+					UE_LOG(LogBlackmagicMedia, Log, TEXT("Input '%s' has timecode : %02d:%02d:%02d:%02d"), *MediaPlayer->GetUrl()
+						, InFrameInfo.Timecode.Hours, InFrameInfo.Timecode.Minutes, InFrameInfo.Timecode.Seconds, InFrameInfo.Timecode.Frames);
+				}
+			}
+			else if (!bHasWarnedMissingTimecode)
+			{
+				bHasWarnedMissingTimecode = true;
+				UE_LOG(LogBlackmagicMedia, Warning, TEXT("Input '%s' is expecting timecode but didn't receive any in the last frame. Is your source configured correctly?"), *MediaPlayer->GetUrl());
 			}
 		}
 
-	private:
-		virtual void AddRef() override
-		{
-			++RefCounter;
-		}
-
-		virtual void Release() override
+		void ProcessAudio(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo, FTimespan InDecodedTime, const TOptional<FTimecode>& InDecodedTimecode)
 		{
-			--RefCounter;
-			if (RefCounter == 0)
+			if (NumAudioSamples() >= MaxNumAudioFrameBuffer * BlackmagicMediaPlayerHelpers::ToleratedExtraMaxBufferCount)
 			{
-				delete this;
+				if (MediaPlayer->bVerifyFrameDropCount)
+				{
+					FPlatformAtomics::InterlockedIncrement(&AudioFrameDropCount);
+				}
+				return;
 			}
-		}
 
-		virtual void OnInitializationCompleted(bool bSuccess) override
-		{
-			MediaState = bSuccess ? EMediaState::Playing : EMediaState::Error;
-		}
+			auto AudioSamle = MediaPlayer->AudioSamplePool->AcquireShared();
+			if (AudioSamle->Initialize(reinterpret_cast<int32*>(InFrameInfo.AudioBuffer)
+				, InFrameInfo.AudioBufferSize / sizeof(int32)
+				, InFrameInfo.NumberOfAudioChannel
+				, InFrameInfo.AudioRate
+				, InDecodedTime
+				, InDecodedTimecode))
+			{
+				AddAudio(AudioSamle);
 
-		virtual void OnShutdownCompleted() override
-		{
-			MediaState = EMediaState::Closed;
+				LastBitsPerSample = sizeof(int32);
+				LastSampleRate = InFrameInfo.AudioRate;
+				LastNumChannels = InFrameInfo.NumberOfAudioChannel;
+			}
 		}
 
-		virtual void OnFrameReceived(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo) override
+		template<BlackmagicDesign::EPixelFormat PixelFormat, bool bIsInterlaced, ETimecodeMode FrameTimecodeMode, bool bHasStages>
+		void ProcessVideo(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo, FTimespan InDecodedTime, const TOptional<FTimecode>& InDecodedTimecode)
 		{
-			SCOPE_CYCLE_COUNTER(STAT_Blackmagic_MediaPlayer_ProcessReceivedFrame);
-
-			FScopeLock Lock(&CallbackLock);
+			using FTraits = BlackmagicMediaPlayerHelpers::TPixelFormatTraits<PixelFormat>;
 
-			if (MediaPlayer == nullptr)
+			// A frame the engine won't evaluate is not copied. Without a timecode, the time of the frame is not comparable to the engine's.
+			if (FrameTimecodeMode != ETimecodeMode::None && InDecodedTimecode.IsSet() && InDecodedTime < GetLateFrameTime())
 			{
+				if (MediaPlayer->bVerifyFrameDropCount)
+				{
+					FPlatformAtomics::InterlockedIncrement(&LateVideoFrameDropCount);
+				}
+				if (CardPort.IsValid())
+				{
+					CardPort->AddLateFrame();
+				}
+				INC_DWORD_STAT(STAT_Blackmagic_MediaPlayer_LateFrames);
 				return;
 			}
 
-			if (!InFrameInfo.bHasInputSource && InFrameInfo.AudioBuffer == nullptr)
+			// A frame after the window is the newest one: once the buffer is full, it is dropped rather than a frame the engine evaluates sooner
+			const bool bIsAfterWindow = FrameTimecodeMode != ETimecodeMode::None && InDecodedTimecode.IsSet() && InDecodedTime.GetTicks() >= WindowEndTicks;
+			const int32 MaxQueuedVideoSamples = bIsAfterWindow ? MaxNumVideoFrameBuffer : MaxNumVideoFrameBuffer * BlackmagicMediaPlayerHelpers::ToleratedExtraMaxBufferCount;
+
+			int32 NumQueuedVideoSamples = NumVideoSamples() + (bIsInterlaced ? 1 : 0);
+			if (NumQueuedVideoSamples >= MaxQueuedVideoSamples && PendingVideoSamples.Num() > 0)
 			{
-				const double CurrentTime = FApp::GetCurrentTime();
-				const double TimeAllowedToConnect = 2.0;
-				if (LastHasFrameTime < 0.1)
+				// The old samples of the batch make room for a frame the engine can still evaluate
+				RemoveLateBatchedSamples();
+				NumQueuedVideoSamples = NumVideoSamples() + (bIsInterlaced ? 1 : 0);
+			}
+
+			if (NumQueuedVideoSamples >= MaxQueuedVideoSamples)
+			{
+				if (MediaPlayer->bVerifyFrameDropCount)
 				{
-					LastHasFrameTime = CurrentTime;
+					FPlatformAtomics::InterlockedIncrement(&VideoFrameDropCount);
 				}
-				if (bReceivedValidFrame || CurrentTime - LastHasFrameTime > TimeAllowedToConnect)
+				if (CardPort.IsValid())
 				{
-					UE_LOG(LogBlackmagicMedia, Error, TEXT("There is no video input for '%s'."), *MediaPlayer->GetUrl());
-					MediaState = EMediaState::Error;
+					CardPort->AddDroppedFrame();
 				}
 				return;
 			}
-			bReceivedValidFrame = bReceivedValidFrame || InFrameInfo.bHasInputSource;
 
-			FTimespan DecodedTime = FTimespan::FromSeconds(MediaPlayer->GetPlatformSeconds());
-			FTimespan DecodedTimeF2 = DecodedTime + FTimespan::FromSeconds(MediaPlayer->VideoFrameRate.AsInterval());
-
-			if (MediaState == EMediaState::Playing)
+			// The samples only get the region of interest, the raw dump keeps the whole frame
+			FIntRect Region(0, 0, InFrameInfo.VideoWidth, InFrameInfo.VideoHeight);
+			if (bHasStages && HasStage(EInputStages::RegionOfInterest))
 			{
-				TOptional<FTimecode> DecodedTimecode;
-				TOptional<FTimecode> DecodedTimecodeF2;
-
-				if (InFrameInfo.bHaveTimecode)
+				const FIntRect AlignedRegion = BlackmagicMediaPlayerHelpers::AlignRegionOfInterest(RegionOfInterest, InFrameInfo.VideoWidth, InFrameInfo.VideoHeight, PixelFormat, bIsInterlaced);
+				if (!AlignedRegion.IsEmpty())
 				{
-					//We expect the timecode to be processed in the library. What we receive will be a "linear" timecode even for frame rates greater than 30.
-					const int32 FrameLimit = InFrameInfo.FieldDominance != BlackmagicDesign::EFieldDominance::Interlaced ? FMath::RoundToInt(MediaPlayer->VideoFrameRate.AsDecimal()) : FMath::RoundToInt(MediaPlayer->VideoFrameRate.AsDecimal()) - 1;
-					if ((int32)InFrameInfo.Timecode.Frames >= FrameLimit)
-					{
-						UE_LOG(LogBlackmagicMedia, Warning, TEXT("Input '%s' received an invalid Timecode frame number (%d) for the current frame rate (%s)."), *MediaPlayer->GetUrl(), InFrameInfo.Timecode.Frames, *MediaPlayer->VideoFrameRate.ToPrettyText().ToString());
-					}
+					Region = AlignedRegion;
+				}
+			}
 
-					DecodedTimecode = FTimecode(InFrameInfo.Timecode.Hours, InFrameInfo.Timecode.Minutes, InFrameInfo.Timecode.Seconds, InFrameInfo.Timecode.Frames, FTimecode::IsDropFormatTimecodeSupported(MediaPlayer->VideoFrameRate));
-					DecodedTimecodeF2 = DecodedTimecode;
-					++DecodedTimecodeF2->Frames;
+			if (bHasStages && HasStage(EInputStages::RawDump))
+			{
+				MediaIOCoreFileWriter::WriteRawFile(RawDumpFilename, reinterpret_cast<uint8*>(InFrameInfo.VideoBuffer), InFrameInfo.VideoPitch * InFrameInfo.VideoHeight);
+				bIsRawDumpRequested = false;
+				UpdateStages();
+			}
 
-					const FTimespan TimecodeDecodedTime = DecodedTimecode->ToTimespan(MediaPlayer->VideoFrameRate);
-					if (MediaPlayer->bUseTimeSynchronization)
-					{
-						DecodedTime = TimecodeDecodedTime;
-						DecodedTimeF2 = TimecodeDecodedTime + FTimespan::FromSeconds(MediaPlayer->VideoFrameRate.AsInterval());
-					}
+			if (!bIsInterlaced && bHasStages && HasStage(EInputStages::DuplicateDetection) && RepeatFrame(InFrameInfo, Region, InDecodedTime, InDecodedTimecode))
+			{
+				return;
+			}
 
-					PreviousTimecode = InFrameInfo.Timecode;
-					PrevousTimespan = TimecodeDecodedTime;
+			BlackmagicMediaPlayerHelpers::FVideoRegion Video = { reinterpret_cast<uint8*>(InFrameInfo.VideoBuffer), InFrameInfo.VideoPitch, InFrameInfo.VideoWidth, InFrameInfo.VideoHeight };
+			if (Region.Width() != InFrameInfo.VideoWidth || Region.Height() != InFrameInfo.VideoHeight)
+			{
+				BlackmagicMediaPlayerHelpers::CopyRegion(Video.Buffer, Video.Pitch, Region, PixelFormat, RegionBuffer, Video);
+			}
 
-					if (MediaPlayer->IsTimecodeLogEnabled())
-					{
-						UE_LOG(LogBlackmagicMedia, Log, TEXT("Input '%s' has timecode : %02d:%02d:%02d:%02d"), *MediaPlayer->GetUrl()
-							, InFrameInfo.Timecode.Hours, InFrameInfo.Timecode.Minutes, InFrameInfo.Timecode.Seconds, InFrameInfo.Timecode.Frames);
-					}
+			if (!bIsInterlaced)
+			{
+				if (FrameTimecodeMode == ETimecodeMode::Burn && InDecodedTimecode.IsSet())
+				{
+					FTimecode SetTimecode = InDecodedTimecode.GetValue();
+					FMediaIOCoreEncodeTime EncodeTime(FTraits::EncodePixelFormat, Video.Buffer, Video.Pitch, Video.Width, Video.Height);
+					EncodeTime.Render(SetTimecode.Hours, SetTimecode.Minutes, SetTimecode.Seconds, SetTimecode.Frames);
 				}
-				else if (!bHasWarnedMissingTimecode && bIsTimecodeExpected)
+
+				auto TextureSample = MediaPlayer->TextureSamplePool->AcquireShared();
+
+				// The inputs of a card with several sub-devices copy their frames in the arena of the card
+				uint8* ArenaBlock = CardPort.IsValid() ? CardPort->CopyFrame(Video.Buffer, Video.Pitch * Video.Height) : nullptr;
+				bool bIsInitialized = ArenaBlock != nullptr && TextureSample->InitializeFromArena(CardPort->GetArena(), ArenaBlock
+					, Video.Pitch
+					, Video.Width
+					, Video.Height
+					, FTraits::SampleFormat
+					, InDecodedTime
+					, MediaPlayer->VideoFrameRate
+					, InDecodedTimecode
+					, bIsSRGBInput);
+				if (ArenaBlock != nullptr && !bIsInitialized)
 				{
-					bHasWarnedMissingTimecode = true;
-					UE_LOG(LogBlackmagicMedia, Warning, TEXT("Input '%s' is expecting timecode but didn't receive any in the last frame. Is your source configured correctly?"), *MediaPlayer->GetUrl());
+					CardPort->GetArena()->Release(ArenaBlock);
 				}
 
-				if (InFrameInfo.AudioBuffer)
+				bIsInitialized = bIsInitialized || TextureSample->Initialize(Video.Buffer
+					, Video.Pitch * Video.Height
+					, Video.Pitch
+					, Video.Width
+					, Video.Height
+					, FTraits::SampleFormat
+					, InDecodedTime
+					, MediaPlayer->VideoFrameRate
+					, InDecodedTimecode
+					, bIsSRGBInput);
+				if (bIsInitialized)
 				{
-					if (MediaPlayer->Samples->NumAudioSamples() >= MaxNumAudioFrameBuffer * BlackmagicMediaPlayerHelpers::ToleratedExtraMaxBufferCount)
+					AddVideo(TextureSample);
+					if (bHasStages)
 					{
-						if (MediaPlayer->bVerifyFrameDropCount)
+						SubmitProxy(TextureSample, FTraits::RecordingPixelFormat, Video, false, InFrameInfo.FrameNumber);
+						SubmitPixelTap(TextureSample, FTraits::RecordingPixelFormat, Video.Width, Video.Height, InFrameInfo.FrameNumber);
+
+						if (HasStage(EInputStages::DuplicateDetection))
 						{
-							FPlatformAtomics::InterlockedIncrement(&AudioFrameDropCount);
+							LastSample = TextureSample;
 						}
 					}
-					else
+				}
+			}
+			else
+			{
+				auto TextureSampleEven = MediaPlayer->TextureSamplePool->AcquireShared();
+				if (TextureSampleEven->InitializeWithEvenOddLine(true
+					, Video.Buffer
+					, Video.Pitch * Video.Height
+					, Video.Pitch
+					, Video.Width
+					, Video.Height
+					, FTraits::SampleFormat
+					, InDecodedTime
+					, MediaPlayer->VideoFrameRate
+					, InDecodedTimecode
+					, bIsSRGBInput))
+				{
+					AddVideo(TextureSampleEven);
+					if (bHasStages)
 					{
-						auto AudioSamle = MediaPlayer->AudioSamplePool->AcquireShared();
-						if (AudioSamle->Initialize(reinterpret_cast<int32*>(InFrameInfo.AudioBuffer)
-							, InFrameInfo.AudioBufferSize / sizeof(int32)
-							, InFrameInfo.NumberOfAudioChannel
-							, InFrameInfo.AudioRate
-							, DecodedTime
-							, DecodedTimecode))
-						{
-							MediaPlayer->Samples->AddAudio(AudioSamle);
-
-							LastBitsPerSample = sizeof(int32);
-							LastSampleRate = InFrameInfo.AudioRate;
-							LastNumChannels = InFrameInfo.NumberOfAudioChannel;
-						}
+						SubmitProxy(TextureSampleEven, FTraits::RecordingPixelFormat, Video, true, InFrameInfo.FrameNumber);
+						SubmitPixelTap(TextureSampleEven, FTraits::RecordingPixelFormat, Video.Width, Video.Height / 2, InFrameInfo.FrameNumber);
 					}
 				}
 
-				if (InFrameInfo.VideoBuffer)
+				TOptional<FTimecode> DecodedTimecodeF2 = InDecodedTimecode;
+				if (DecodedTimecodeF2.IsSet())
 				{
-					const bool bIsProgressivePicture = InFrameInfo.FieldDominance != BlackmagicDesign::EFieldDominance::Interlaced;
-					const int32 NumVideoSamples = MediaPlayer->Samples->NumVideoSamples() + (!bIsProgressivePicture ? 1 : 0);
-					if (NumVideoSamples >= MaxNumVideoFrameBuffer * BlackmagicMediaPlayerHelpers::ToleratedExtraMaxBufferCount)
-					{
-						if (MediaPlayer->bVerifyFrameDropCount)
-						{
-							FPlatformAtomics::InterlockedIncrement(&VideoFrameDropCount);
-						}
-					}
-					else
-					{
-						EMediaTextureSampleFormat SampleFormat = EMediaTextureSampleFormat::CharBGRA;
-						EMediaIOCoreEncodePixelFormat EncodePixelFormat = EMediaIOCoreEncodePixelFormat::CharUYVY;
-						FString OutputFilename = "";
+					++DecodedTimecodeF2->Frames;
+				}
 
-						switch (InFrameInfo.PixelFormat)
-						{
-						case BlackmagicDesign::EPixelFormat::pf_8Bits:
-							SampleFormat = EMediaTextureSampleFormat::CharUYVY;
-							EncodePixelFormat = EMediaIOCoreEncodePixelFormat::CharUYVY;
-							OutputFilename = FString::Printf(TEXT("Blackmagic_Output_8_YUV_ch%d"), ChannelInfo.DeviceIndex);
-							break;
-						case BlackmagicDesign::EPixelFormat::pf_10Bits:
-							SampleFormat = EMediaTextureSampleFormat::YUVv210;
-							EncodePixelFormat = EMediaIOCoreEncodePixelFormat::YUVv210;
-							OutputFilename = FString::Printf(TEXT("Blackmagic_Output_10_YUV_ch%d"), ChannelInfo.DeviceIndex);
-							break;
-						}
+				auto TextureSampleOdd = MediaPlayer->TextureSamplePool->AcquireShared();
+				if (TextureSampleOdd->InitializeWithEvenOddLine(false
+					, Video.Buffer
+					, Video.Pitch * Video.Height
+					, Video.Pitch
+					, Video.Width
+					, Video.Height
+					, FTraits::SampleFormat
+					, InDecodedTime + FrameInterval
+					, MediaPlayer->VideoFrameRate
+					, DecodedTimecodeF2
+					, bIsSRGBInput))
+				{
+					AddVideo(TextureSampleOdd);
+				}
+			}
+		}
 
-						if (bBlackmagicWriteOutputRawDataCmdEnable)
-						{
-							MediaIOCoreFileWriter::WriteRawFile(OutputFilename, reinterpret_cast<uint8*>(InFrameInfo.VideoBuffer), InFrameInfo.VideoPitch * InFrameInfo.VideoHeight);
-							bBlackmagicWriteOutputRawDataCmdEnable = false;
-						}
+		/**
+		 * Hash the region of the progressive frame and, when it didn't change since the last frame, queue the last sample again at the new time.
+		 * @return true if the frame was a duplicate and doesn't need to be copied.
+		 */
+		bool RepeatFrame(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo, const FIntRect& InRegion, FTimespan InTime, const TOptional<FTimecode>& InTimecode)
+		{
+			uint64 FrameHash = 0;
+			{
+				SCOPE_CYCLE_COUNTER(STAT_Blackmagic_MediaPlayer_HashReceivedFrame);
+				const uint8* RegionStart = BlackmagicMediaPlayerHelpers::GetRegionStart(reinterpret_cast<const uint8*>(InFrameInfo.VideoBuffer), InFrameInfo.VideoPitch, InRegion, InFrameInfo.PixelFormat);
+				const uint32 LineSize = BlackmagicMediaPlayerHelpers::GetLineSize(InRegion.Width(), InFrameInfo.PixelFormat);
+				FrameHash = BlackmagicMediaFrameHash::HashFrame(RegionStart, InFrameInfo.VideoPitch, LineSize, InRegion.Height(), DuplicateFrameDetection == EBlackmagicMediaDuplicateFrameDetection::Sparse);
+			}
 
-						if (bIsProgressivePicture)
-						{
-							if (bEncodeTimecodeInTexel && DecodedTimecode.IsSet())
-							{
-								FTimecode SetTimecode = DecodedTimecode.GetValue();
-								FMediaIOCoreEncodeTime EncodeTime(EncodePixelFormat, InFrameInfo.VideoBuffer, InFrameInfo.VideoPitch, InFrameInfo.VideoWidth, InFrameInfo.VideoHeight);
-								EncodeTime.Render(SetTimecode.Hours, SetTimecode.Minutes, SetTimecode.Seconds, SetTimecode.Frames);
-							}
-
-							auto TextureSample = MediaPlayer->TextureSamplePool->AcquireShared();
-							if (TextureSample->Initialize(InFrameInfo.VideoBuffer
-								, InFrameInfo.VideoPitch * InFrameInfo.VideoHeight
-								, InFrameInfo.VideoPitch
-								, InFrameInfo.VideoWidth
-								, InFrameInfo.VideoHeight
-								, SampleFormat
-								, DecodedTime
-								, MediaPlayer->VideoFrameRate
-								, DecodedTimecode
-								, bIsSRGBInput))
-							{
-								MediaPlayer->Samples->AddVideo(TextureSample);
-							}
-						}
-						else
-						{
-							auto TextureSampleEven = MediaPlayer->TextureSamplePool->AcquireShared();
-							if (TextureSampleEven->InitializeWithEvenOddLine(true
-								, InFrameInfo.VideoBuffer
-								, InFrameInfo.VideoPitch * InFrameInfo.VideoHeight
-								, InFrameInfo.VideoPitch
-								, InFrameInfo.VideoWidth
-								, InFrameInfo.VideoHeight
-								, SampleFormat
-								, DecodedTime
-								, MediaPlayer->VideoFrameRate
-								, DecodedTimecode
-								, bIsSRGBInput))
-							{
-								MediaPlayer->Samples->AddVideo(TextureSampleEven);
-							}
-
-							auto TextureSampleOdd = MediaPlayer->TextureSamplePool->AcquireShared();
-							if (TextureSampleOdd->InitializeWithEvenOddLine(false
-								, InFrameInfo.VideoBuffer
-								, InFrameInfo.VideoPitch * InFrameInfo.VideoHeight
-								, InFrameInfo.VideoPitch
-								, InFrameInfo.VideoWidth
-								, InFrameInfo.VideoHeight
-								, SampleFormat
-								, DecodedTimeF2
-								, MediaPlayer->VideoFrameRate
-								, DecodedTimecodeF2
-								, bIsSRGBInput))
-							{
-								MediaPlayer->Samples->AddVideo(TextureSampleOdd);
-							}
-						}
-					}
+			const bool bIsDuplicate = LastSample.IsValid() && FrameHash == LastFrameHash;
+			LastFrameHash = FrameHash;
+
+			if (!bIsDuplicate)
+			{
+				// The new sample is kept once it is queued
+				LastSample.Reset();
+				++NumUniqueFrames;
+				INC_DWORD_STAT(STAT_Blackmagic_MediaPlayer_UniqueFrames);
+				return false;
+			}
+
+			auto TextureSample = MediaPlayer->TextureSamplePool->AcquireShared();
+			TextureSample->InitializeRepeat(LastSample.ToSharedRef(), InTime, InTimecode);
+			AddVideo(TextureSample);
+			SubmitPixelTap(TextureSample, InFrameInfo.PixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? EBlackmagicRecordingPixelFormat::UYVY : EBlackmagicRecordingPixelFormat::V210, InRegion.Width(), InRegion.Height(), InFrameInfo.FrameNumber);
+
+			++NumDuplicateFrames;
+			INC_DWORD_STAT(STAT_Blackmagic_MediaPlayer_DuplicateFrames);
+			return true;
+		}
+
+		/** Queue the raw frame for the recording requested with Blackmagic.RecordInput. The frame is written by the recording thread. */
+		void RecordFrame(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo, const TOptional<FTimecode>& InTimecode)
+		{
+			if (InFrameInfo.VideoBuffer == nullptr)
+			{
+				return;
+			}
+
+			if (!Recorder.IsValid())
+			{
+				FBlackmagicRecordingFileHeader Header;
+				Header.DisplayMode = DisplayMode;
+				Header.PixelFormat = InFrameInfo.PixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? EBlackmagicRecordingPixelFormat::UYVY : EBlackmagicRecordingPixelFormat::V210;
+				Header.Width = InFrameInfo.VideoWidth;
+				Header.Height = InFrameInfo.VideoHeight;
+				Header.Pitch = InFrameInfo.VideoPitch;
+				Header.FrameRateNumerator = MediaPlayer->VideoFrameRate.Numerator;
+				Header.FrameRateDenominator = MediaPlayer->VideoFrameRate.Denominator;
+				Header.bIsInterlaced = InFrameInfo.FieldDominance == BlackmagicDesign::EFieldDominance::Interlaced ? 1 : 0;
+				Header.NumberOfAudioChannels = InFrameInfo.AudioBuffer ? InFrameInfo.NumberOfAudioChannel : 0;
+				Header.AudioSampleRate = InFrameInfo.AudioBuffer ? InFrameInfo.AudioRate : 0;
+				Header.Codec = CVarBlackmagicRecordInputCompression.GetValueOnAnyThread() != 0 ? EBlackmagicRecordingCodec::Lossless : EBlackmagicRecordingCodec::None;
+
+				const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Blackmagic"), FString::Printf(TEXT("Blackmagic_Input_ch%d_%s%s"), ChannelInfo.DeviceIndex, *FDateTime::Now().ToString(), BlackmagicMediaRecording::FileExtension));
+				Recorder = FBlackmagicRecordingQueue::Open(Filename, Header, CVarBlackmagicRecordInputMaxPendingFrames.GetValueOnAnyThread());
+			}
+
+			FBlackmagicRecordingFrame Frame;
+			Frame.FrameNumber = InFrameInfo.FrameNumber;
+			Frame.Timecode = InTimecode;
+			Frame.VideoBuffer = InFrameInfo.VideoBuffer;
+			Frame.VideoSize = InFrameInfo.VideoPitch * InFrameInfo.VideoHeight;
+			Frame.AudioBuffer = InFrameInfo.AudioBuffer;
+			Frame.AudioSize = InFrameInfo.AudioBuffer ? InFrameInfo.AudioBufferSize : 0;
+
+			// A frame that is not recorded still counts, the recording covers the requested frames of the input
+			Recorder->Submit(Frame);
+
+			--NumFramesToRecord;
+			if (NumFramesToRecord <= 0)
+			{
+				Recorder->Close();
+				Recorder.Reset();
+				UpdateStages();
+			}
+		}
+
+		void SubmitProxy(const TSharedRef<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>& InSample, EBlackmagicRecordingPixelFormat InPixelFormat, const BlackmagicMediaPlayerHelpers::FVideoRegion& InVideo, bool bInIsField, int64 InFrameNumber)
+		{
+			if (HasStage(EInputStages::Proxy))
+			{
+				const uint32 Height = bInIsField ? InVideo.Height / 2 : InVideo.Height;
+				ProxyGenerator->Submit(InSample, InPixelFormat, InVideo.Width, Height, bInIsField, InFrameNumber);
+			}
+		}
+
+		/** Convert the sample for the CPU consumers of the input, on a worker. Interlaced inputs give their even field. */
+		void SubmitPixelTap(const TSharedRef<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>& InSample, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, int64 InFrameNumber)
+		{
+			if (HasStage(EInputStages::PixelTap))
+			{
+				PixelTap->Submit(InSample, InPixelFormat, InWidth, InHeight, InFrameNumber);
+			}
+		}
+
+		/** Publish the raw frame in the shared memory ring. */
+		void ExportFrame(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo, const TOptional<FTimecode>& InTimecode)
+		{
+			if (InFrameInfo.VideoBuffer == nullptr)
+			{
+				return;
+			}
+
+			const uint64 VideoSize = uint64(InFrameInfo.VideoPitch) * InFrameInfo.VideoHeight;
+			if (!Exporter.IsValid())
+			{
+				// The ring is sized for the first frame; a format change closes the input anyway
+				Exporter = MakeUnique<FBlackmagicSharedFrameWriter>();
+				if (!Exporter->Open(ExportName, ExportNumSlots, VideoSize))
+				{
+					ExportName.Reset();
+					Exporter.Reset();
+					UpdateStages();
+					return;
 				}
 			}
+
+			FBlackmagicSharedFrame Frame;
+			Frame.FrameNumber = InFrameInfo.FrameNumber;
+			Frame.Timecode = InTimecode;
+			Frame.PixelFormat = InFrameInfo.PixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? EBlackmagicRecordingPixelFormat::UYVY : EBlackmagicRecordingPixelFormat::V210;
+			Frame.Width = InFrameInfo.VideoWidth;
+			Frame.Height = InFrameInfo.VideoHeight;
+			Frame.Pitch = InFrameInfo.VideoPitch;
+			Frame.FrameRate = MediaPlayer->VideoFrameRate;
+			Frame.bIsInterlaced = InFrameInfo.FieldDominance == BlackmagicDesign::EFieldDominance::Interlaced;
+			Frame.VideoBuffer = reinterpret_cast<const uint8*>(InFrameInfo.VideoBuffer);
+			Frame.VideoSize = VideoSize;
+			Exporter->Publish(Frame);
 		}
 
 		virtual void OnFrameFormatChanged(const BlackmagicDesign::FFormatInfo& NewFormat) override
@@ -378,6 +1442,8 @@ namespace BlackmagicMediaPlayerHelpers
 
 		BlackmagicDesign::FUniqueIdentifier BlackmagicIdendifier;
 		BlackmagicDesign::FChannelInfo ChannelInfo;
+		BlackmagicDesign::FInputChannelOptions ChannelOptions;
+		bool bIsChannelRequested;
 
 		mutable FCriticalSection CallbackLock;
 		FBlackmagicMediaPlayer* MediaPlayer;
@@ -386,7 +1452,27 @@ namespace BlackmagicMediaPlayerHelpers
 
 		BlackmagicDesign::FTimecode PreviousTimecode;
 		FTimespan PrevousTimespan;
-		bool bEncodeTimecodeInTexel;
+
+		/** Instantiation of ProcessFrame for the input, and what it was chosen from */
+		FProcessFrameFunction ProcessFrameFunction;
+		BlackmagicDesign::EPixelFormat InputPixelFormat;
+		bool bIsInterlacedInput;
+		ETimecodeMode TimecodeMode;
+		bool bReadAudio;
+		EInputStages Stages;
+
+		/** Computed once for all the frames */
+		int32 TimecodeFrameLimit;
+		FTimespan FrameInterval;
+		bool bIsDropFrameTimecode;
+
+		/** Capture time of the frames, without the jitter of the callbacks */
+		FBlackmagicMediaFrameClock FrameClock;
+		bool bUseFrameClock;
+
+		/** Next frame written by Blackmagic.WriteOutputRawData */
+		FString RawDumpFilename;
+		bool bIsRawDumpRequested;
 
 		/** Number of audio bits per sample, audio channels and sample rate. */
 		uint32 LastBitsPerSample;
@@ -396,6 +1482,18 @@ namespace BlackmagicMediaPlayerHelpers
 		int32 AudioFrameDropCount;
 		int32 MetadataFrameDropCount;
 		int32 VideoFrameDropCount;
+		int32 LateVideoFrameDropCount;
+
+		/**
+		 * Frames older than LateFrameTicks are not evaluated by the engine anymore, Lowest when every frame is kept.
+		 * Written by the game thread every frame, read by the callback.
+		 */
+		int32 LateFrameTolerance;
+		TAtomic<int64> LateFrameTicks;
+
+		/** Frames at or after WindowEndTicks are evaluated after the next engine frame, Max when every frame is kept. Written by the game thread. */
+		TAtomic<int64> WindowEndTicks;
+		FTimespan EvaluationTime;
 
 		int32 MaxNumAudioFrameBuffer;
 		int32 MaxNumVideoFrameBuffer;
@@ -404,12 +1502,138 @@ namespace BlackmagicMediaPlayerHelpers
 		double LastHasFrameTime;
 		bool bReceivedValidFrame;
 
-		bool bIsTimecodeExpected;
 		bool bHasWarnedMissingTimecode;
 
 		/** Whether this input is in sRGB space and needs a to linear conversion */
 		bool bIsSRGBInput;
+
+		/** Recording requested with Blackmagic.RecordInput */
+		BlackmagicDesign::FBlackmagicVideoFormat DisplayMode;
+		int32 NumFramesToRecord;
+		TSharedPtr<FBlackmagicRecordingQueue, ESPMode::ThreadSafe> Recorder;
+
+		/** Shared memory export of the input frames */
+		FString ExportName;
+		int32 ExportNumSlots;
+		TUniquePtr<FBlackmagicSharedFrameWriter> Exporter;
+
+		/** Reduced versions of the input frames */
+		TUniquePtr<FBlackmagicMediaProxyGenerator> ProxyGenerator;
+
+		/** CPU frames for the subscribers of FBlackmagicMediaPixelTap */
+		TUniquePtr<FBlackmagicMediaPixelTap> PixelTap;
+
+		/** Ingest shared with the inputs of the other sub-devices of the card, when it has several */
+		TSharedPtr<FBlackmagicMediaCardIngest::FPort, ESPMode::ThreadSafe> CardPort;
+
+		/** Rectangle of the input copied in the video samples, empty for the whole frame */
+		FIntRect RegionOfInterest;
+		TArray<uint8> RegionBuffer;
+
+		/** Last progressive sample and the hash of its frame, to detect the frames sent again */
+		EBlackmagicMediaDuplicateFrameDetection DuplicateFrameDetection;
+		TSharedPtr<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe> LastSample;
+		uint64 LastFrameHash;
+		int32 NumUniqueFrames;
+		int32 NumDuplicateFrames;
+
+		/**
+		 * Samples of the last frames, given to the player together. See Blackmagic.InputBatchMaxAge.
+		 * Only the calls to the sample queue of the player are batched, the rest of the callback runs for every frame.
+		 */
+		double BatchMaxAge;
+		int32 BatchMaxFrames;
+		int32 NumBatchedFrames;
+		double BatchStartTime;
+		TArray<TSharedRef<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>> PendingVideoSamples;
+		TArray<TSharedRef<FMediaIOCoreAudioSampleBase, ESPMode::ThreadSafe>> PendingAudioSamples;
+	};
+}
+
+namespace BlackmagicMediaPlayerHelpers
+{
+	static TAutoConsoleVariable<float> CVarWarmChannelGracePeriod(
+		TEXT("Blackmagic.WarmChannelGracePeriod"),
+		0.f,
+		TEXT("Seconds the input channel of a closed Blackmagic player stays opened, with its samples, for a player that opens the same input again.\n")
+		TEXT("0: Close the channel with the player (default)"),
+		ECVF_Default);
+
+	/** Channel of a closed player, kept opened for a while so a player that opens the same input doesn't wait for the device */
+	struct FWarmChannel
+	{
+		FBlackmagicMediaPlayerEventCallback* EventCallback;
+		FBlackmagicMediaAudioSamplePool* AudioSamplePool;
+		FBlackmagicMediaTextureSamplePool* TextureSamplePool;
+		double ExpirationTime;
 	};
+
+	static FCriticalSection WarmChannelsLock;
+	static TArray<FWarmChannel> WarmChannels;
+	static FDelegateHandle WarmChannelsTickerHandle;
+
+	/** Close the warm channels that match */
+	void ReleaseWarmChannels(TFunctionRef<bool(const FWarmChannel&)> InPredicate)
+	{
+		TArray<FWarmChannel> ReleasedChannels;
+		{
+			FScopeLock Lock(&WarmChannelsLock);
+			for (int32 Index = WarmChannels.Num() - 1; Index >= 0; --Index)
+			{
+				if (InPredicate(WarmChannels[Index]))
+				{
+					ReleasedChannels.Add(WarmChannels[Index]);
+					WarmChannels.RemoveAtSwap(Index);
+				}
+			}
+		}
+
+		for (const FWarmChannel& WarmChannel : ReleasedChannels)
+		{
+			WarmChannel.EventCallback->Uninitialize();
+			delete WarmChannel.TextureSamplePool;
+			delete WarmChannel.AudioSamplePool;
+		}
+	}
+
+	bool TickWarmChannels(float InDeltaTime)
+	{
+		const double CurrentTime = FPlatformTime::Seconds();
+		ReleaseWarmChannels([CurrentTime](const FWarmChannel& InWarmChannel) { return InWarmChannel.ExpirationTime <= CurrentTime || InWarmChannel.EventCallback->GetMediaState() != EMediaState::Playing; });
+
+		FScopeLock Lock(&WarmChannelsLock);
+		if (WarmChannels.Num() == 0)
+		{
+			WarmChannelsTickerHandle.Reset();
+			return false;
+		}
+		return true;
+	}
+
+	void AddWarmChannel(const FWarmChannel& InWarmChannel)
+	{
+		FScopeLock Lock(&WarmChannelsLock);
+		WarmChannels.Add(InWarmChannel);
+		if (!WarmChannelsTickerHandle.IsValid())
+		{
+			WarmChannelsTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&TickWarmChannels), 0.25f);
+		}
+	}
+
+	/** Remove the first warm channel a player with these options can use */
+	bool TakeWarmChannel(const BlackmagicDesign::FChannelInfo& InChannelInfo, const BlackmagicDesign::FInputChannelOptions& InChannelOptions, FWarmChannel& OutWarmChannel)
+	{
+		FScopeLock Lock(&WarmChannelsLock);
+		const int32 Index = WarmChannels.IndexOfByPredicate([&](const FWarmChannel& InWarmChannel) { return InWarmChannel.EventCallback->CanReattach(InChannelInfo, InChannelOptions); });
+		if (Index == INDEX_NONE)
+		{
+			return false;
+		}
+
+		OutWarmChannel = WarmChannels[Index];
+		WarmChannels.RemoveAtSwap(Index);
+		return true;
+	}
 }
 
 /* FBlackmagicVideoPlayer structors
@@ -436,14 +1660,39 @@ FBlackmagicMediaPlayer::~FBlackmagicMediaPlayer()
 
 void FBlackmagicMediaPlayer::Close()
 {
+	{
+		FScopeLock Lock(&BlackmagicMediaPlayerHelpers::PlayersLock);
+		BlackmagicMediaPlayerHelpers::Players.RemoveSingleSwap(this);
+	}
+
 	if (EventCallback)
 	{
-		EventCallback->Uninitialize();
+		const float GracePeriod = BlackmagicMediaPlayerHelpers::CVarWarmChannelGracePeriod.GetValueOnAnyThread();
+		if (GracePeriod > 0.f && EventCallback->GetMediaState() == EMediaState::Playing)
+		{
+			// Keep the channel and the samples for the next player that opens the same input, this player gets new pools
+			EventCallback->Detach();
+
+			BlackmagicMediaPlayerHelpers::FWarmChannel WarmChannel;
+			WarmChannel.EventCallback = EventCallback;
+			WarmChannel.AudioSamplePool = AudioSamplePool;
+			WarmChannel.TextureSamplePool = TextureSamplePool;
+			WarmChannel.ExpirationTime = FPlatformTime::Seconds() + GracePeriod;
+			BlackmagicMediaPlayerHelpers::AddWarmChannel(WarmChannel);
+
+			AudioSamplePool = new FBlackmagicMediaAudioSamplePool;
+			TextureSamplePool = new FBlackmagicMediaTextureSamplePool;
+		}
+		else
+		{
+			ChannelOperation = EventCallback->Uninitialize();
+		}
 		EventCallback = nullptr;
 	}
 
 	AudioSamplePool->Reset();
 	TextureSamplePool->Reset();
+	Settings.Reset();
 
 	Super::Close();
 }
@@ -473,22 +1722,29 @@ bool FBlackmagicMediaPlayer::Open(const FString& Url, const IMediaOptions* Optio
 		return false;
 	}
 
-	BlackmagicDesign::FChannelInfo ChannelInfo;
-	ChannelInfo.DeviceIndex = Options->GetMediaOption(BlackmagicMediaOption::DeviceIndex, (int64)0);
+	// Sources of this plugin give all their options at once, the other media options are read one at a time.
+	// The data container has no type of its own: the options tell the type of their snapshot before it is cast.
+	TSharedPtr<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe> SourceSettings;
+	if (Options->GetMediaOption(BlackmagicMediaOption::SettingsType, FString()) == FBlackmagicMediaSourceSettings::TypeName)
+	{
+		SourceSettings = StaticCastSharedPtr<FBlackmagicMediaSourceSettings>(Options->GetMediaOption(BlackmagicMediaOption::Settings, TSharedPtr<IMediaOptions::FDataContainer, ESPMode::ThreadSafe>()));
+	}
+	if (!SourceSettings.IsValid() || SourceSettings->Version != FBlackmagicMediaSourceSettings::CurrentVersion)
+	{
+		SourceSettings = MakeShared<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>(FBlackmagicMediaSourceSettings::FromMediaOptions(*Options));
+	}
+	Settings = SourceSettings;
 
-	check(EventCallback == nullptr);
-	EventCallback = new BlackmagicMediaPlayerHelpers::FBlackmagicMediaPlayerEventCallback(this, ChannelInfo);
+	BlackmagicDesign::FChannelInfo ChannelInfo;
+	ChannelInfo.DeviceIndex = SourceSettings->DeviceIndex;
 
 	BlackmagicDesign::FInputChannelOptions ChannelOptions;
 	ChannelOptions.CallbackPriority = 10;
-	ChannelOptions.bReadVideo = Options->GetMediaOption(BlackmagicMediaOption::CaptureVideo, true);
-	ChannelOptions.FormatInfo.DisplayMode = Options->GetMediaOption(BlackmagicMediaOption::BlackmagicVideoFormat, (int64)BlackmagicMediaOption::DefaultVideoFormat);
-	EBlackmagicMediaSourceColorFormat ColorFormat = (EBlackmagicMediaSourceColorFormat)(Options->GetMediaOption(BlackmagicMediaOption::ColorFormat, (int64)EBlackmagicMediaSourceColorFormat::YUV8));
-	ChannelOptions.PixelFormat = ColorFormat == EBlackmagicMediaSourceColorFormat::YUV8 ? BlackmagicDesign::EPixelFormat::pf_8Bits : BlackmagicDesign::EPixelFormat::pf_10Bits;
-	const bool bIsSRGBInput = Options->GetMediaOption(BlackmagicMediaOption::SRGBInput, true);
+	ChannelOptions.bReadVideo = SourceSettings->bCaptureVideo;
+	ChannelOptions.FormatInfo.DisplayMode = SourceSettings->VideoFormat;
+	ChannelOptions.PixelFormat = SourceSettings->ColorFormat == EBlackmagicMediaSourceColorFormat::YUV8 ? BlackmagicDesign::EPixelFormat::pf_8Bits : BlackmagicDesign::EPixelFormat::pf_10Bits;
 
-	const EMediaIOTimecodeFormat TimecodeFormat = (EMediaIOTimecodeFormat)(Options->GetMediaOption(BlackmagicMediaOption::TimecodeFormat, (int64)EMediaIOTimecodeFormat::None));
-	switch (TimecodeFormat)
+	switch (SourceSettings->TimecodeFormat)
 	{
 	case EMediaIOTimecodeFormat::LTC:
 		ChannelOptions.TimecodeFormat = BlackmagicDesign::ETimecodeFormat::TCF_LTC;
@@ -504,24 +1760,61 @@ bool FBlackmagicMediaPlayer::Open(const FString& Url, const IMediaOptions* Optio
 
 	//Audio options
 	{
-		ChannelOptions.bReadAudio = Options->GetMediaOption(BlackmagicMediaOption::CaptureAudio, false);
-		const EBlackmagicMediaAudioChannel AudioChannelOption = (EBlackmagicMediaAudioChannel)(Options->GetMediaOption(BlackmagicMediaOption::AudioChannelOption, (int64)EBlackmagicMediaAudioChannel::Stereo2));
-		ChannelOptions.NumberOfAudioChannel = (AudioChannelOption == EBlackmagicMediaAudioChannel::Surround8) ? 8 : 2;
+		ChannelOptions.bReadAudio = SourceSettings->bCaptureAudio;
+		ChannelOptions.NumberOfAudioChannel = (SourceSettings->AudioChannels == EBlackmagicMediaAudioChannel::Surround8) ? 8 : 2;
 	}
 
-	bVerifyFrameDropCount = Options->GetMediaOption(BlackmagicMediaOption::LogDropFrame, false);
-	const bool bEncodeTimecodeInTexel = TimecodeFormat != EMediaIOTimecodeFormat::None && Options->GetMediaOption(BlackmagicMediaOption::EncodeTimecodeInTexel, false);
-	int32 MaxNumAudioFrameBuffer = Options->GetMediaOption(BlackmagicMediaOption::MaxAudioFrameBuffer, (int64)8);
-	int32 MaxNumVideoFrameBuffer = Options->GetMediaOption(BlackmagicMediaOption::MaxVideoFrameBuffer, (int64)8);
+	bVerifyFrameDropCount = SourceSettings->bLogDropFrame;
 
-	bool bSuccess = EventCallback->Initialize(ChannelOptions, bEncodeTimecodeInTexel, MaxNumAudioFrameBuffer, MaxNumVideoFrameBuffer, bIsSRGBInput);
+	FString ExportName;
+	if (ChannelOptions.bReadVideo && SourceSettings->bExportToSharedMemory)
+	{
+		ExportName = SourceSettings->SharedMemoryName;
+		if (ExportName.IsEmpty())
+		{
+			ExportName = FString::Printf(TEXT("Blackmagic_Input_%d"), ChannelInfo.DeviceIndex);
+		}
+	}
+	const int32 ProxyFrameDivider = ChannelOptions.bReadVideo && SourceSettings->bGenerateProxies ? FMath::Max(SourceSettings->ProxyFrameDivider, 1) : 0;
 
-	if (!bSuccess)
+	FIntRect RegionOfInterest;
+	if (ChannelOptions.bReadVideo && SourceSettings->bCaptureRegionOfInterest)
 	{
-		EventCallback->Uninitialize();
-		EventCallback = nullptr;
+		RegionOfInterest.Min = SourceSettings->RegionOfInterestPosition;
+		RegionOfInterest.Max = SourceSettings->RegionOfInterestPosition + SourceSettings->RegionOfInterestSize;
+	}
+
+	const bool bIsInterlaced = SourceSettings->VideoStandard == EMediaIOStandardType::Interlaced;
+
+	check(EventCallback == nullptr);
+	BlackmagicMediaPlayerHelpers::FWarmChannel WarmChannel;
+	if (BlackmagicMediaPlayerHelpers::TakeWarmChannel(ChannelInfo, ChannelOptions, WarmChannel))
+	{
+		// The channel of a closed player is still receiving frames, and its samples are already allocated
+		delete TextureSamplePool;
+		delete AudioSamplePool;
+		TextureSamplePool = WarmChannel.TextureSamplePool;
+		AudioSamplePool = WarmChannel.AudioSamplePool;
+		EventCallback = WarmChannel.EventCallback;
+		UE_LOG(LogBlackmagicMedia, Verbose, TEXT("'%s' reuses the opened channel of the input %d."), *Url, ChannelInfo.DeviceIndex);
+	}
+	else
+	{
+		// A warm channel of the device in another mode would compete with the new one
+		BlackmagicMediaPlayerHelpers::ReleaseWarmChannels([&ChannelInfo](const BlackmagicMediaPlayerHelpers::FWarmChannel& InWarmChannel) { return InWarmChannel.EventCallback->GetDeviceIndex() == ChannelInfo.DeviceIndex; });
+		EventCallback = new BlackmagicMediaPlayerHelpers::FBlackmagicMediaPlayerEventCallback(this, ChannelInfo);
+	}
+
+	// A channel that fails to open puts the player in error on the next tick
+	ChannelOperation = EventCallback->Initialize(this, ChannelOptions, bIsInterlaced, BlackmagicMediaPlayerHelpers::IsEncodingTimecodeInTexel(*SourceSettings), SourceSettings->MaxNumAudioFrameBuffer, SourceSettings->MaxNumVideoFrameBuffer
+		, SourceSettings->bIsSRGBInput, ExportName, SourceSettings->SharedMemoryNumSlots, ProxyFrameDivider, RegionOfInterest, BlackmagicMediaPlayerHelpers::GetDuplicateFrameDetection(*SourceSettings));
+
+	{
+		FScopeLock Lock(&BlackmagicMediaPlayerHelpers::PlayersLock);
+		BlackmagicMediaPlayerHelpers::Players.AddUnique(this);
 	}
-	return bSuccess;
+
+	return true;
 }
 
 
@@ -558,6 +1851,7 @@ void FBlackmagicMediaPlayer::TickFetch(FTimespan DeltaTime, FTimespan /*Timecode
 {
 	if (IsHardwareReady())
 	{
+		EventCallback->UpdateEvaluationTime_GameThread();
 		ProcessFrame();
 		VerifyFrameDropCount();
 	}
@@ -565,6 +1859,7 @@ void FBlackmagicMediaPlayer::TickFetch(FTimespan DeltaTime, FTimespan /*Timecode
 
 void FBlackmagicMediaPlayer::ProcessFrame()
 {
+	EventCallback->PublishBatch_GameThread();
 	EventCallback->UpdateAudioTrackFormat(AudioTrackFormat);
 }
 
@@ -578,5 +1873,97 @@ bool FBlackmagicMediaPlayer::IsHardwareReady() const
 	return EventCallback && EventCallback->GetMediaState() == EMediaState::Playing;
 }
 
+/* FBlackmagicMediaPlayer implementation
+*****************************************************************************/
+
+void FBlackmagicMediaPlayer::ReleaseWarmChannels()
+{
+	BlackmagicMediaPlayerHelpers::ReleaseWarmChannels([](const BlackmagicMediaPlayerHelpers::FWarmChannel&) { return true; });
+
+	FScopeLock Lock(&BlackmagicMediaPlayerHelpers::WarmChannelsLock);
+	if (BlackmagicMediaPlayerHelpers::WarmChannelsTickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(BlackmagicMediaPlayerHelpers::WarmChannelsTickerHandle);
+		BlackmagicMediaPlayerHelpers::WarmChannelsTickerHandle.Reset();
+	}
+}
+
+int32 FBlackmagicMediaPlayer::ApplySettings(const TSharedRef<const FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>& InSettings)
+{
+	if (InSettings->Source == FObjectKey())
+	{
+		return 0;
+	}
+
+	FScopeLock Lock(&BlackmagicMediaPlayerHelpers::PlayersLock);
+
+	int32 NumUpdatedPlayers = 0;
+	for (FBlackmagicMediaPlayer* Player : BlackmagicMediaPlayerHelpers::Players)
+	{
+		if (Player->EventCallback && Player->Settings.IsValid() && Player->Settings->Source == InSettings->Source)
+		{
+			Player->UpdateSettings(InSettings);
+			++NumUpdatedPlayers;
+		}
+	}
+	return NumUpdatedPlayers;
+}
+
+void FBlackmagicMediaPlayer::OnPixelTapSubscribersChanged(int32 InDeviceIndex)
+{
+	FScopeLock Lock(&BlackmagicMediaPlayerHelpers::PlayersLock);
+	for (FBlackmagicMediaPlayer* Player : BlackmagicMediaPlayerHelpers::Players)
+	{
+		if (Player->EventCallback->GetDeviceIndex() == InDeviceIndex)
+		{
+			Player->EventCallback->OnPixelTapSubscribersChanged();
+		}
+	}
+}
+
+void FBlackmagicMediaPlayer::UpdateSettings(const TSharedRef<const FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>& InSettings)
+{
+	if (Settings->RequiresReopen(*InSettings))
+	{
+		UE_LOG(LogBlackmagicMedia, Log, TEXT("Some settings of '%s' will only be used once the player is reopened."), *OpenUrl);
+	}
+
+	// Keep the input settings the player was opened with
+	TSharedRef<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe> NewSettings = MakeShared<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>(*Settings);
+	NewSettings->MaxNumAudioFrameBuffer = InSettings->MaxNumAudioFrameBuffer;
+	NewSettings->MaxNumVideoFrameBuffer = InSettings->MaxNumVideoFrameBuffer;
+	NewSettings->DuplicateFrameDetection = InSettings->DuplicateFrameDetection;
+	NewSettings->bLogDropFrame = InSettings->bLogDropFrame;
+	NewSettings->bEncodeTimecodeInTexel = InSettings->bEncodeTimecodeInTexel;
+	Settings = NewSettings;
+
+	bVerifyFrameDropCount = NewSettings->bLogDropFrame;
+	EventCallback->ApplySettings(NewSettings->MaxNumAudioFrameBuffer, NewSettings->MaxNumVideoFrameBuffer, BlackmagicMediaPlayerHelpers::IsEncodingTimecodeInTexel(*NewSettings), BlackmagicMediaPlayerHelpers::GetDuplicateFrameDetection(*NewSettings));
+}
+
+/* Console commands
+*****************************************************************************/
+
+static FAutoConsoleCommand BlackmagicWriteOutputRawDataCmd(
+	TEXT("Blackmagic.WriteOutputRawData"),
+	TEXT("Write the next raw frame buffer of every opened Blackmagic input to a file."),
+	FConsoleCommandDelegate::CreateStatic(&BlackmagicMediaPlayerHelpers::FBlackmagicMediaPlayerEventCallback::DumpInputs)
+	);
+
+static FAutoConsoleCommand BlackmagicRecordInputCmd(
+	TEXT("Blackmagic.RecordInput"),
+	TEXT("Record the next N frames (default 1) of every opened Blackmagic input to an indexed .bmrec file in the Saved/Blackmagic folder."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaPlayerHelpers::FBlackmagicMediaPlayerEventCallback::RecordInputs)
+	);
+
+/* Benchmark
+*****************************************************************************/
+
+static FAutoConsoleCommand BlackmagicBenchmarkIngestCmd(
+	TEXT("Blackmagic.BenchmarkIngest"),
+	TEXT("Benchmark the per frame work of the Blackmagic player for every pixel format, field mode, timecode and audio combination. Arguments: [Iterations=100000] [FramesPerBatch=0]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaPlayerHelpers::FBlackmagicMediaPlayerEventCallback::RunBenchmark)
+	);
+
 #undef LOCTEXT_NAMESPACE
 
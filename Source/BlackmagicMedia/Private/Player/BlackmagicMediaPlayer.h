@@ -4,12 +4,16 @@
 
 #include "MediaIOCorePlayerBase.h"
 
+#include "BlackmagicMediaCardIngest.h"
 #include "MediaIOCoreAudioSampleBase.h"
 #include "MediaIOCoreTextureSampleBase.h"
 #include "MediaObjectPool.h"
 #include "MediaShaders.h"
 
+#include "Async/Future.h"
+
 class IMediaEventSink;
+struct FBlackmagicMediaSourceSettings;
 
 enum class EMediaTextureSampleFormat;
 
@@ -20,7 +24,76 @@ namespace BlackmagicMediaPlayerHelpers
 
 class FBlackmagicMediaTextureSample : public FMediaIOCoreTextureSampleBase
 {
+	using Super = FMediaIOCoreTextureSampleBase;
+
+public:
+	/**
+	 * Show the frame of another sample at a new time, without copying it.
+	 * Used when the input sends the same frame again.
+	 */
+	void InitializeRepeat(const TSharedRef<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>& InSample, FTimespan InTime, const TOptional<FTimecode>& InTimecode)
+	{
+		// Never chain the repeats, a long still would keep every sample alive
+		RepeatedSample = InSample->RepeatedSample.IsValid() ? InSample->RepeatedSample : TSharedPtr<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe>(InSample);
+		RepeatTime = InTime;
+		RepeatTimecode = InTimecode;
+	}
+
+	bool IsRepeat() const { return RepeatedSample.IsValid(); }
+
+	/**
+	 * Show a frame already copied in a block of the arena of a card, instead of copying it again in the sample.
+	 * The block is given back to the arena with the sample.
+	 */
+	bool InitializeFromArena(const TSharedRef<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe>& InArena, uint8* InBlock, uint32 InStride, uint32 InWidth, uint32 InHeight, EMediaTextureSampleFormat InSampleFormat, FTimespan InTime, const FFrameRate& InFrameRate, const TOptional<FTimecode>& InTimecode, bool bInIsSRGBInput)
+	{
+		// The base keeps the properties of the frame, the pixels stay in the block
+		if (!Super::Initialize(InBlock, 0, InStride, InWidth, InHeight, InSampleFormat, InTime, InFrameRate, InTimecode, bInIsSRGBInput))
+		{
+			return false;
+		}
+
+		Arena = InArena;
+		ArenaBlock = InBlock;
+		return true;
+	}
+
+public:
+	//~ IMediaTextureSample interface
+
+	virtual const void* GetBuffer() override { return RepeatedSample.IsValid() ? RepeatedSample->GetBuffer() : ArenaBlock != nullptr ? ArenaBlock : Super::GetBuffer(); }
+	virtual FIntPoint GetDim() const override { return RepeatedSample.IsValid() ? RepeatedSample->GetDim() : Super::GetDim(); }
+	virtual FIntPoint GetOutputDim() const override { return RepeatedSample.IsValid() ? RepeatedSample->GetOutputDim() : Super::GetOutputDim(); }
+	virtual EMediaTextureSampleFormat GetFormat() const override { return RepeatedSample.IsValid() ? RepeatedSample->GetFormat() : Super::GetFormat(); }
+	virtual uint32 GetStride() const override { return RepeatedSample.IsValid() ? RepeatedSample->GetStride() : Super::GetStride(); }
+	virtual bool IsOutputSrgb() const override { return RepeatedSample.IsValid() ? RepeatedSample->IsOutputSrgb() : Super::IsOutputSrgb(); }
+	virtual FTimespan GetTime() const override { return RepeatedSample.IsValid() ? RepeatTime : Super::GetTime(); }
+	virtual TOptional<FTimecode> GetTimecode() const override { return RepeatedSample.IsValid() ? RepeatTimecode : Super::GetTimecode(); }
 	virtual const FMatrix& GetYUVToRGBMatrix() const override { return MediaShaders::YuvToRgbRec709Full; }
+
+	//~ IMediaPoolable interface
+
+	virtual void ShutdownPoolable() override
+	{
+		RepeatedSample.Reset();
+		if (ArenaBlock != nullptr)
+		{
+			Arena->Release(ArenaBlock);
+			ArenaBlock = nullptr;
+			Arena.Reset();
+		}
+		Super::ShutdownPoolable();
+	}
+
+private:
+	/** Sample holding the frame when this sample repeats it */
+	TSharedPtr<FBlackmagicMediaTextureSample, ESPMode::ThreadSafe> RepeatedSample;
+	FTimespan RepeatTime;
+	TOptional<FTimecode> RepeatTimecode;
+
+	/** Block of the card arena holding the frame, when it was copied there */
+	TSharedPtr<FBlackmagicMediaFrameArena, ESPMode::ThreadSafe> Arena;
+	uint8* ArenaBlock = nullptr;
 };
 
 class FBlackmagicMediaAudioSamplePool : public TMediaObjectPool<FMediaIOCoreAudioSampleBase> { };
@@ -36,6 +109,8 @@ class FBlackmagicMediaTextureSamplePool : public TMediaObjectPool<FBlackmagicMed
  * Depending on whether the media source enables time code synchronization,
  * the player's current play time (CurrentTime) is derived either from the
  * time codes embedded in frames or from the Engine's global time code.
+ * With time code synchronization, the frames older than the Engine's time code
+ * are discarded when received, and removed first when the queue is full.
  */
 class FBlackmagicMediaPlayer : public FMediaIOCorePlayerBase
 {
@@ -75,6 +150,29 @@ public:
 	/** Is Hardware initialized */
 	virtual bool IsHardwareReady() const override;
 
+	/** Completes once the last opening or closing of the input channel requested by this player is done. Invalid when there's nothing to wait for. */
+	TSharedFuture<void> GetChannelOperation() const { return ChannelOperation; }
+
+public:
+	/**
+	 * Give the settings that don't require to reopen the input to the players of this process opened from the source of the snapshot.
+	 * Players opened from other sources on the same connection are left alone. The players keep their other settings until they are reopened.
+	 * @return The number of players updated
+	 */
+	static int32 ApplySettings(const TSharedRef<const FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>& InSettings);
+
+	/**
+	 * Close the channels that closed players keep opened for Blackmagic.WarmChannelGracePeriod seconds.
+	 * Called before the library shuts down.
+	 */
+	static void ReleaseWarmChannels();
+
+	/** Resolve again the optional stages of the opened inputs of the device, once a pixel tap subscription was added or removed. */
+	static void OnPixelTapSubscribersChanged(int32 InDeviceIndex);
+
+private:
+	void UpdateSettings(const TSharedRef<const FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>& InSettings);
+
 private:
 
 	friend BlackmagicMediaPlayerHelpers::FBlackmagicMediaPlayerEventCallback;
@@ -86,4 +184,10 @@ private:
 
 	/** Log warning about the amount of audio/video frame can't could not be cached . */
 	bool bVerifyFrameDropCount;
+
+	/** Settings the player was opened with, and the updates applied since */
+	TSharedPtr<const FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe> Settings;
+
+	/** Driver calls of the player, run by FBlackmagicMediaChannelTasks */
+	TSharedFuture<void> ChannelOperation;
 };
@@ -0,0 +1,502 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaProxy.h"
+
+#include "BlackmagicMediaPrivate.h"
+
+#include "BlackmagicMediaJobs.h"
+#include "Engine/Texture2D.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "MediaIOCoreTextureSampleBase.h"
+#include "Misc/ScopeLock.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+#include <emmintrin.h>
+#endif
+
+
+namespace BlackmagicMediaProxyHelpers
+{
+	/** Lines of the first level reduced by a task */
+	static const uint32 LinesPerTask = 32;
+
+	/** Proxy frames allocated before falling back to a new frame per reduction */
+	static const int32 MaxPooledFrames = 4;
+
+	/** Stage of the Blackmagic jobs */
+	static const FName JobStage(TEXT("Proxy"));
+
+	FORCEINLINE uint8 Average(uint8 InA, uint8 InB)
+	{
+		return uint8((uint32(InA) + uint32(InB) + 1) >> 1);
+	}
+
+	/**
+	 * Reduce two UYVY lines to one UYVY line of half the width.
+	 * Lines are averaged first, then horizontal neighbours; both round up like _mm_avg_epu8.
+	 */
+	void ReduceLineUYVY(const uint8* InLine0, const uint8* InLine1, uint8* OutLine, uint32 InNumOutputMacroPixels)
+	{
+		uint32 MacroPixel = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+		const __m128i LowByteMask = _mm_set1_epi16(0x00FF);
+		const __m128i LowWordMask = _mm_set1_epi32(0xFFFF);
+		const __m128i OneWord = _mm_set1_epi16(1);
+		const __m128i OneDword = _mm_set1_epi32(1);
+
+		// 4 input macro pixels per line give 2 output macro pixels
+		for (; MacroPixel + 2 <= InNumOutputMacroPixels; MacroPixel += 2)
+		{
+			const __m128i Line0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InLine0 + MacroPixel * 8));
+			const __m128i Line1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InLine1 + MacroPixel * 8));
+			const __m128i Vertical = _mm_avg_epu8(Line0, Line1);
+
+			// Y0..Y7 in 16 bits lanes, neighbours summed in the low half of 32 bits lanes
+			const __m128i Luma = _mm_srli_epi16(Vertical, 8);
+			const __m128i LumaSum = _mm_and_si128(_mm_add_epi32(Luma, _mm_srli_epi32(Luma, 16)), LowWordMask);
+			const __m128i LumaAverage = _mm_srli_epi32(_mm_add_epi32(LumaSum, OneDword), 1);
+			const __m128i Luma16 = _mm_packs_epi32(LumaAverage, LumaAverage);
+
+			// Cb0 Cr0 Cb1 Cr1.. in 16 bits lanes, the chroma of the next macro pixel is 2 lanes further
+			const __m128i Chroma = _mm_and_si128(Vertical, LowByteMask);
+			const __m128i ChromaSum = _mm_add_epi16(Chroma, _mm_srli_si128(Chroma, 4));
+			const __m128i ChromaAverage = _mm_srli_epi16(_mm_add_epi16(ChromaSum, OneWord), 1);
+			const __m128i Chroma16 = _mm_shuffle_epi32(ChromaAverage, _MM_SHUFFLE(3, 1, 2, 0));
+
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(OutLine + MacroPixel * 4), _mm_or_si128(Chroma16, _mm_slli_epi16(Luma16, 8)));
+		}
+#endif
+
+		for (; MacroPixel < InNumOutputMacroPixels; ++MacroPixel)
+		{
+			const uint8* Source0 = InLine0 + MacroPixel * 8;
+			const uint8* Source1 = InLine1 + MacroPixel * 8;
+			uint8 Vertical[8];
+			for (int32 Index = 0; Index < 8; ++Index)
+			{
+				Vertical[Index] = Average(Source0[Index], Source1[Index]);
+			}
+
+			uint8* Output = OutLine + MacroPixel * 4;
+			Output[0] = Average(Vertical[0], Vertical[4]);
+			Output[1] = Average(Vertical[1], Vertical[3]);
+			Output[2] = Average(Vertical[2], Vertical[6]);
+			Output[3] = Average(Vertical[5], Vertical[7]);
+		}
+	}
+
+	/** 4 samples of 10 bits summed, to one sample of 8 bits */
+	FORCEINLINE uint8 ToByte(uint32 InSum)
+	{
+		return (uint8)FMath::Min<uint32>((InSum + 8) >> 4, 255);
+	}
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+	FORCEINLINE void Transpose(__m128i& InOutRow0, __m128i& InOutRow1, __m128i& InOutRow2, __m128i& InOutRow3)
+	{
+		const __m128i Temp0 = _mm_unpacklo_epi32(InOutRow0, InOutRow1);
+		const __m128i Temp1 = _mm_unpacklo_epi32(InOutRow2, InOutRow3);
+		const __m128i Temp2 = _mm_unpackhi_epi32(InOutRow0, InOutRow1);
+		const __m128i Temp3 = _mm_unpackhi_epi32(InOutRow2, InOutRow3);
+		InOutRow0 = _mm_unpacklo_epi64(Temp0, Temp1);
+		InOutRow1 = _mm_unpackhi_epi64(Temp0, Temp1);
+		InOutRow2 = _mm_unpacklo_epi64(Temp2, Temp3);
+		InOutRow3 = _mm_unpackhi_epi64(Temp2, Temp3);
+	}
+
+	FORCEINLINE __m128i ToByte(__m128i InSum)
+	{
+		const __m128i Rounded = _mm_srli_epi32(_mm_add_epi32(InSum, _mm_set1_epi32(8)), 4);
+		return _mm_min_epi16(Rounded, _mm_set1_epi32(255));
+	}
+
+	FORCEINLINE __m128i PackMacroPixel(__m128i InBlue, __m128i InLuma0, __m128i InRed, __m128i InLuma1)
+	{
+		return _mm_or_si128(_mm_or_si128(ToByte(InBlue), _mm_slli_epi32(ToByte(InLuma0), 8)), _mm_or_si128(_mm_slli_epi32(ToByte(InRed), 16), _mm_slli_epi32(ToByte(InLuma1), 24)));
+	}
+#endif
+
+	/**
+	 * Reduce two v210 lines to one UYVY line of half the width.
+	 * Each group of 12 input pixels (two v210 blocks, 8 words) gives 3 output macro pixels.
+	 *
+	 * Components by word and position in the word:
+	 *   word  0: Cb0  Y0   Cr0		word 4: Cb6  Y6   Cr6
+	 *   word  1: Y1   Cb2  Y2		word 5: Y7   Cb8  Y8
+	 *   word  2: Cr2  Y3   Cb4		word 6: Cr8  Y9   Cb10
+	 *   word  3: Y4   Cr4  Y5		word 7: Y10  Cr10 Y11
+	 */
+	void ReduceLineV210(const uint8* InLine0, const uint8* InLine1, uint8* OutLine, uint32 InNumGroups)
+	{
+		uint32 Group = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+		// Positions 0 and 2 of the words of both lines are summed together, they have one spare bit each
+		const __m128i EvenMask = _mm_set1_epi32(0x3FF003FF);
+		const __m128i OddMask = _mm_set1_epi32(0x3FF);
+		const __m128i SumMask = _mm_set1_epi32(0x7FF);
+
+		// 4 groups at a time, transposed so every lane holds a group
+		for (; Group + 4 <= InNumGroups; Group += 4)
+		{
+			__m128i Even[8];
+			__m128i Odd[8];
+			for (int32 Index = 0; Index < 8; ++Index)
+			{
+				const __m128i Words0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InLine0 + Group * 32) + Index);
+				const __m128i Words1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InLine1 + Group * 32) + Index);
+				Even[Index] = _mm_add_epi32(_mm_and_si128(Words0, EvenMask), _mm_and_si128(Words1, EvenMask));
+				Odd[Index] = _mm_add_epi32(_mm_and_si128(_mm_srli_epi32(Words0, 10), OddMask), _mm_and_si128(_mm_srli_epi32(Words1, 10), OddMask));
+			}
+
+			// Vectors 0 2 4 6 hold the first block of each group, 1 3 5 7 the second one
+			__m128i E[8] = { Even[0], Even[2], Even[4], Even[6], Even[1], Even[3], Even[5], Even[7] };
+			__m128i O[8] = { Odd[0], Odd[2], Odd[4], Odd[6], Odd[1], Odd[3], Odd[5], Odd[7] };
+			Transpose(E[0], E[1], E[2], E[3]);
+			Transpose(E[4], E[5], E[6], E[7]);
+			Transpose(O[0], O[1], O[2], O[3]);
+			Transpose(O[4], O[5], O[6], O[7]);
+
+			auto C0 = [&](int32 Word) { return _mm_and_si128(E[Word], SumMask); };
+			auto C1 = [&](int32 Word) { return O[Word]; };
+			auto C2 = [&](int32 Word) { return _mm_srli_epi32(E[Word], 20); };
+
+			__m128i Output0 = PackMacroPixel(_mm_add_epi32(C0(0), C1(1)), _mm_add_epi32(C1(0), C0(1)), _mm_add_epi32(C2(0), C0(2)), _mm_add_epi32(C2(1), C1(2)));
+			__m128i Output1 = PackMacroPixel(_mm_add_epi32(C2(2), C0(4)), _mm_add_epi32(C0(3), C2(3)), _mm_add_epi32(C1(3), C2(4)), _mm_add_epi32(C1(4), C0(5)));
+			__m128i Output2 = PackMacroPixel(_mm_add_epi32(C1(5), C2(6)), _mm_add_epi32(C2(5), C1(6)), _mm_add_epi32(C0(6), C1(7)), _mm_add_epi32(C0(7), C2(7)));
+			__m128i Output3 = _mm_setzero_si128();
+			Transpose(Output0, Output1, Output2, Output3);
+
+			// 12 bytes per group, the extra bytes of a store are overwritten by the next one
+			uint8* Output = OutLine + Group * 12;
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Output), Output0);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Output + 12), Output1);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(Output + 24), Output2);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(Output + 36), Output3);
+			*reinterpret_cast<int32*>(Output + 44) = _mm_cvtsi128_si32(_mm_srli_si128(Output3, 8));
+		}
+#endif
+
+		for (; Group < InNumGroups; ++Group)
+		{
+			const uint32* Words0 = reinterpret_cast<const uint32*>(InLine0 + Group * 32);
+			const uint32* Words1 = reinterpret_cast<const uint32*>(InLine1 + Group * 32);
+			auto C = [&](int32 Word, int32 Position) { return ((Words0[Word] >> (Position * 10)) & 0x3FF) + ((Words1[Word] >> (Position * 10)) & 0x3FF); };
+
+			const uint32 Components[3][4] =
+			{
+				{ C(0, 0) + C(1, 1), C(0, 1) + C(1, 0), C(0, 2) + C(2, 0), C(1, 2) + C(2, 1) },
+				{ C(2, 2) + C(4, 0), C(3, 0) + C(3, 2), C(3, 1) + C(4, 2), C(4, 1) + C(5, 0) },
+				{ C(5, 1) + C(6, 2), C(5, 2) + C(6, 1), C(6, 0) + C(7, 1), C(7, 0) + C(7, 2) },
+			};
+
+			uint8* Output = OutLine + Group * 12;
+			for (int32 MacroPixel = 0; MacroPixel < 3; ++MacroPixel)
+			{
+				for (int32 Index = 0; Index < 4; ++Index)
+				{
+					Output[MacroPixel * 4 + Index] = ToByte(Components[MacroPixel][Index]);
+				}
+			}
+		}
+	}
+
+	void SetLevelSize(FBlackmagicMediaProxyLevel& OutLevel, uint32 InWidth, uint32 InHeight)
+	{
+		OutLevel.Width = InWidth;
+		OutLevel.Height = InHeight;
+		OutLevel.Pitch = InWidth * 2;
+
+		// Keep the allocation of the previous frame
+		OutLevel.Buffer.SetNumUninitialized(OutLevel.Pitch * InHeight, false);
+	}
+
+	void ReduceLevel(const FBlackmagicMediaProxyLevel& InSource, FBlackmagicMediaProxyLevel& OutLevel)
+	{
+		SetLevelSize(OutLevel, (InSource.Width / 4) * 2, InSource.Height / 2);
+		for (uint32 Line = 0; Line < OutLevel.Height; ++Line)
+		{
+			const uint8* Source = InSource.Buffer.GetData() + Line * 2 * InSource.Pitch;
+			ReduceLineUYVY(Source, Source + InSource.Pitch, OutLevel.Buffer.GetData() + Line * OutLevel.Pitch, OutLevel.Width / 2);
+		}
+	}
+
+	/** Registry of the generators of the players of this process, in the order they were created. A device can have several. */
+	FCriticalSection RegistryLock;
+	TArray<FBlackmagicMediaProxyGenerator*> Generators;
+}
+
+/* FBlackmagicMediaProxyFrame
+*****************************************************************************/
+
+void FBlackmagicMediaProxyFrame::ConvertToBGRA(int32 InLevel, TArray<FColor>& OutPixels) const
+{
+	check(InLevel >= 0 && InLevel < BlackmagicMediaProxy::NumLevels);
+	const FBlackmagicMediaProxyLevel& Level = Levels[InLevel];
+
+	OutPixels.SetNumUninitialized(Level.Width * Level.Height, false);
+	for (uint32 Line = 0; Line < Level.Height; ++Line)
+	{
+		const uint8* Source = Level.Buffer.GetData() + Line * Level.Pitch;
+		FColor* Destination = OutPixels.GetData() + Line * Level.Width;
+		for (uint32 Pixel = 0; Pixel < Level.Width; ++Pixel)
+		{
+			const uint8* MacroPixel = Source + (Pixel / 2) * 4;
+
+			// Rec. 709 video range, 8 bits fixed point
+			const int32 Luma = 298 * (int32(MacroPixel[(Pixel & 1) ? 3 : 1]) - 16) + 128;
+			const int32 Blue = int32(MacroPixel[0]) - 128;
+			const int32 Red = int32(MacroPixel[2]) - 128;
+			Destination[Pixel].R = (uint8)FMath::Clamp((Luma + 459 * Red) >> 8, 0, 255);
+			Destination[Pixel].G = (uint8)FMath::Clamp((Luma - 55 * Blue - 136 * Red) >> 8, 0, 255);
+			Destination[Pixel].B = (uint8)FMath::Clamp((Luma + 541 * Blue) >> 8, 0, 255);
+			Destination[Pixel].A = 255;
+		}
+	}
+}
+
+/* FBlackmagicMediaProxyGenerator
+*****************************************************************************/
+
+FBlackmagicMediaProxyGenerator::FBlackmagicMediaProxyGenerator(int32 InDeviceIndex, int32 InFrameDivider)
+	: DeviceIndex(InDeviceIndex)
+	, FrameDivider(FMath::Max(InFrameDivider, 1))
+	, NumSubmittedFrames(0)
+	, bIsWorkerBusy(false)
+{
+	FScopeLock Lock(&BlackmagicMediaProxyHelpers::RegistryLock);
+	BlackmagicMediaProxyHelpers::Generators.Add(this);
+}
+
+FBlackmagicMediaProxyGenerator::~FBlackmagicMediaProxyGenerator()
+{
+	{
+		FScopeLock Lock(&BlackmagicMediaProxyHelpers::RegistryLock);
+		BlackmagicMediaProxyHelpers::Generators.RemoveSingle(this);
+	}
+
+	if (WorkerResult.IsValid())
+	{
+		WorkerResult.Wait();
+	}
+}
+
+void FBlackmagicMediaProxyGenerator::Submit(const TSharedRef<FMediaIOCoreTextureSampleBase, ESPMode::ThreadSafe>& InSample, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, bool bInIsField, int64 InFrameNumber)
+{
+	if ((NumSubmittedFrames++ % FrameDivider) != 0 || bIsWorkerBusy)
+	{
+		return;
+	}
+
+	TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> Frame = AcquireFrame();
+	Frame->FrameNumber = InFrameNumber;
+	Frame->Timecode = InSample->GetTimecode();
+
+	bIsWorkerBusy = true;
+	WorkerResult = FBlackmagicMediaJobs::Launch(EBlackmagicJobPriority::Analysis, BlackmagicMediaProxyHelpers::JobStage, [this, InSample, Frame, InPixelFormat, InWidth, InHeight, bInIsField]()
+	{
+		if (Generate(reinterpret_cast<const uint8*>(InSample->GetBuffer()), InPixelFormat, InWidth, InHeight, InSample->GetStride(), bInIsField, *Frame))
+		{
+			Publish(Frame);
+		}
+		bIsWorkerBusy = false;
+	});
+}
+
+TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> FBlackmagicMediaProxyGenerator::AcquireFrame()
+{
+	for (const TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>& Frame : FramePool)
+	{
+		if (Frame.IsUnique())
+		{
+			return Frame;
+		}
+	}
+
+	TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> NewFrame = MakeShared<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>();
+	if (FramePool.Num() < BlackmagicMediaProxyHelpers::MaxPooledFrames)
+	{
+		FramePool.Add(NewFrame);
+	}
+	return NewFrame;
+}
+
+void FBlackmagicMediaProxyGenerator::Publish(const TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>& InFrame)
+{
+	FScopeLock Lock(&LatestLock);
+	LatestFrame = InFrame;
+}
+
+FBlackmagicMediaProxyFramePtr FBlackmagicMediaProxyGenerator::GetLatestFrame() const
+{
+	FScopeLock Lock(&LatestLock);
+	return LatestFrame;
+}
+
+FBlackmagicMediaProxyFramePtr FBlackmagicMediaProxyGenerator::GetLatestFrame(int32 InDeviceIndex)
+{
+	FScopeLock Lock(&BlackmagicMediaProxyHelpers::RegistryLock);
+
+	// The oldest generator of the device, the next one takes over once it is destroyed
+	for (const FBlackmagicMediaProxyGenerator* Generator : BlackmagicMediaProxyHelpers::Generators)
+	{
+		if (Generator->DeviceIndex == InDeviceIndex)
+		{
+			FBlackmagicMediaProxyFramePtr Frame = Generator->GetLatestFrame();
+			if (Frame.IsValid())
+			{
+				return Frame;
+			}
+		}
+	}
+	return FBlackmagicMediaProxyFramePtr();
+}
+
+bool FBlackmagicMediaProxyGenerator::Generate(const uint8* InBuffer, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, uint32 InPitch, bool bInIsField, FBlackmagicMediaProxyFrame& OutFrame)
+{
+	using namespace BlackmagicMediaProxyHelpers;
+
+	if (InPixelFormat != EBlackmagicRecordingPixelFormat::UYVY && InPixelFormat != EBlackmagicRecordingPixelFormat::V210)
+	{
+		return false;
+	}
+
+	// A field already has half the lines of the picture
+	const bool bIsV210 = InPixelFormat == EBlackmagicRecordingPixelFormat::V210;
+	const uint32 LineStep = bInIsField ? 1 : 2;
+	const uint32 Width = bIsV210 ? (InWidth / 12) * 6 : (InWidth / 4) * 2;
+	const uint32 Height = InHeight / LineStep;
+	if (Width == 0 || Height == 0)
+	{
+		return false;
+	}
+
+	FBlackmagicMediaProxyLevel& FirstLevel = OutFrame.Levels[0];
+	SetLevelSize(FirstLevel, Width, Height);
+
+	// The first level reads the whole input, it is split between the workers
+	const int32 NumTasks = FMath::DivideAndRoundUp(Height, LinesPerTask);
+	FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Analysis, JobStage, NumTasks, [&](int32 TaskIndex)
+	{
+		const uint32 FirstLine = TaskIndex * LinesPerTask;
+		const uint32 LastLine = FMath::Min(FirstLine + LinesPerTask, Height);
+		for (uint32 Line = FirstLine; Line < LastLine; ++Line)
+		{
+			const uint8* Source0 = InBuffer + uint64(Line) * LineStep * InPitch;
+			const uint8* Source1 = bInIsField ? Source0 : Source0 + InPitch;
+			uint8* Destination = FirstLevel.Buffer.GetData() + Line * FirstLevel.Pitch;
+			if (bIsV210)
+			{
+				ReduceLineV210(Source0, Source1, Destination, Width / 6);
+			}
+			else
+			{
+				ReduceLineUYVY(Source0, Source1, Destination, Width / 2);
+			}
+		}
+	});
+
+	for (int32 Level = 1; Level < BlackmagicMediaProxy::NumLevels; ++Level)
+	{
+		ReduceLevel(OutFrame.Levels[Level - 1], OutFrame.Levels[Level]);
+	}
+
+	return true;
+}
+
+/* FBlackmagicMediaProxyTexture
+*****************************************************************************/
+
+FBlackmagicMediaProxyTexture::FBlackmagicMediaProxyTexture()
+	: Texture(nullptr)
+	, UploadedLevel(INDEX_NONE)
+{
+}
+
+UTexture2D* FBlackmagicMediaProxyTexture::Update(const FBlackmagicMediaProxyFramePtr& InFrame, int32 InLevel)
+{
+	check(IsInGameThread());
+
+	if (!InFrame.IsValid() || (InFrame == UploadedFrame && InLevel == UploadedLevel))
+	{
+		return Texture;
+	}
+
+	const FBlackmagicMediaProxyLevel& Level = InFrame->Levels[InLevel];
+	if (Level.Width == 0 || Level.Height == 0)
+	{
+		return Texture;
+	}
+
+	if (Texture == nullptr || Texture->GetSizeX() != (int32)Level.Width || Texture->GetSizeY() != (int32)Level.Height)
+	{
+		Texture = UTexture2D::CreateTransient(Level.Width, Level.Height, PF_B8G8R8A8);
+		Texture->SRGB = true;
+		Texture->UpdateResource();
+	}
+
+	TArray<FColor>* Pixels = new TArray<FColor>();
+	InFrame->ConvertToBGRA(InLevel, *Pixels);
+
+	FUpdateTextureRegion2D* Region = new FUpdateTextureRegion2D(0, 0, 0, 0, Level.Width, Level.Height);
+	Texture->UpdateTextureRegions(0, 1, Region, Level.Width * sizeof(FColor), sizeof(FColor), reinterpret_cast<uint8*>(Pixels->GetData()), [Pixels](uint8*, const FUpdateTextureRegion2D* InRegions)
+	{
+		delete Pixels;
+		delete InRegions;
+	});
+
+	UploadedFrame = InFrame;
+	UploadedLevel = InLevel;
+	return Texture;
+}
+
+void FBlackmagicMediaProxyTexture::AddReferencedObjects(FReferenceCollector& Collector)
+{
+	Collector.AddReferencedObject(Texture);
+}
+
+/* Benchmark
+*****************************************************************************/
+
+namespace BlackmagicMediaProxyHelpers
+{
+	void RunBenchmark(const TArray<FString>& Args)
+	{
+		const uint32 Width = Args.IsValidIndex(0) ? FCString::Atoi(*Args[0]) : 3840;
+		const uint32 Height = Args.IsValidIndex(1) ? FCString::Atoi(*Args[1]) : 2160;
+		const bool bIsV210 = Args.IsValidIndex(2) && FCString::Atoi(*Args[2]) == 10;
+		const int32 NumIterations = Args.IsValidIndex(3) ? FMath::Max(FCString::Atoi(*Args[3]), 1) : 60;
+
+		const uint32 Pitch = bIsV210 ? Align(FMath::DivideAndRoundUp<uint32>(Width, 6) * 16, 128) : Width * 2;
+		TArray<uint8> Buffer;
+		Buffer.SetNumUninitialized(Pitch * Height);
+		FRandomStream Random(0);
+		for (uint8& Value : Buffer)
+		{
+			Value = (uint8)Random.RandHelper(256);
+		}
+
+		const EBlackmagicRecordingPixelFormat PixelFormat = bIsV210 ? EBlackmagicRecordingPixelFormat::V210 : EBlackmagicRecordingPixelFormat::UYVY;
+		FBlackmagicMediaProxyFrame Frame;
+		FBlackmagicMediaProxyGenerator::Generate(Buffer.GetData(), PixelFormat, Width, Height, Pitch, false, Frame);
+
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			FBlackmagicMediaProxyGenerator::Generate(Buffer.GetData(), PixelFormat, Width, Height, Pitch, false, Frame);
+		}
+		const double Milliseconds = (FPlatformTime::Seconds() - StartTime) * 1000.0 / NumIterations;
+
+		UE_LOG(LogBlackmagicMedia, Display, TEXT("Proxy pyramid of %dx%d %s: %.3f ms per frame (%.2f GB/s read), 1/8 proxy is %dx%d."),
+			Width, Height, bIsV210 ? TEXT("v210") : TEXT("UYVY"), Milliseconds, (Pitch * Height) / (Milliseconds * 1.0e6), Frame.Levels[2].Width, Frame.Levels[2].Height);
+	}
+}
+
+static FAutoConsoleCommand BlackmagicBenchmarkProxyCmd(
+	TEXT("Blackmagic.BenchmarkProxy"),
+	TEXT("Benchmark the proxy pyramid generation. Arguments: [Width=3840] [Height=2160] [BitDepth=8] [Iterations=60]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaProxyHelpers::RunBenchmark)
+	);
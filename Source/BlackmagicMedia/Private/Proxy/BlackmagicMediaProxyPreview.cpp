@@ -0,0 +1,417 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaProxy.h"
+
+#include "Blackmagic.h"
+#include "BlackmagicMediaBroker.h"
+#include "BlackmagicMediaChannelTasks.h"
+#include "BlackmagicMediaJobs.h"
+#include "BlackmagicMediaPrivate.h"
+#include "BlackmagicMediaSource.h"
+
+#include "CoreGlobals.h"
+#include "HAL/CriticalSection.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/Atomic.h"
+
+
+namespace BlackmagicMediaProxyPreviewHelpers
+{
+	static TAutoConsoleVariable<float> CVarPreviewInterval(
+		TEXT("Blackmagic.PreviewInterval"),
+		0.5f,
+		TEXT("Seconds between two proxies of the Blackmagic inputs previewed without a player, like the live thumbnails of the editor."),
+		ECVF_Default);
+
+	/** Proxy frames allocated by a preview channel */
+	static const int32 MaxPooledFrames = 2;
+
+	static const FName ReduceJobStage(TEXT("ProxyPreview"));
+
+	/** Video only channel of an input, shared by all the previews of the input */
+	class FPreviewChannel : public BlackmagicDesign::IInputEventCallback
+	{
+	public:
+		FPreviewChannel(const BlackmagicDesign::FChannelInfo& InChannelInfo, const BlackmagicDesign::FInputChannelOptions& InChannelOptions)
+			: NumSubscribers(0)
+			, RefCounter(0)
+			, ChannelInfo(InChannelInfo)
+			, ChannelOptions(InChannelOptions)
+			, NextProxyTime(0.0)
+			, bIsReducing(false)
+		{
+		}
+
+		/** Open the channel on a background thread */
+		void Initialize()
+		{
+			AddRef();
+
+			BlackmagicDesign::ReferencePtr<BlackmagicDesign::IInputEventCallback> SelfRef(this);
+			FBlackmagicMediaChannelTasks::Enqueue([this, SelfRef]()
+			{
+				const BlackmagicDesign::FUniqueIdentifier Identifier = BlackmagicMediaBackend::RegisterCallbackForChannel(ChannelInfo, ChannelOptions, SelfRef);
+				if (!Identifier.IsValid())
+				{
+					UE_LOG(LogBlackmagicMedia, Verbose, TEXT("The preview of the input %d could not be opened."), ChannelInfo.DeviceIndex);
+				}
+
+				FScopeLock Lock(&CallbackLock);
+				BlackmagicIdendifier = Identifier;
+			});
+		}
+
+		/** Close the channel on a background thread. The channel is released once closed. */
+		void Uninitialize()
+		{
+			// Enqueued after the opening, the identifier is known when it runs
+			FBlackmagicMediaChannelTasks::Enqueue([this]()
+			{
+				BlackmagicDesign::FUniqueIdentifier Identifier;
+				{
+					FScopeLock Lock(&CallbackLock);
+					Identifier = BlackmagicIdendifier;
+					BlackmagicIdendifier = BlackmagicDesign::FUniqueIdentifier();
+				}
+
+				if (Identifier.IsValid())
+				{
+					BlackmagicMediaBackend::UnregisterCallbackForChannel(ChannelInfo, Identifier);
+				}
+
+				Release();
+			});
+		}
+
+		bool Matches(const BlackmagicDesign::FChannelInfo& InChannelInfo, const BlackmagicDesign::FInputChannelOptions& InChannelOptions) const
+		{
+			return ChannelInfo.DeviceIndex == InChannelInfo.DeviceIndex
+				&& ChannelOptions.FormatInfo.DisplayMode == InChannelOptions.FormatInfo.DisplayMode
+				&& ChannelOptions.PixelFormat == InChannelOptions.PixelFormat;
+		}
+
+		FBlackmagicMediaProxyFramePtr GetLatestFrame() const
+		{
+			FScopeLock Lock(&CallbackLock);
+			return LatestFrame;
+		}
+
+	public:
+		/** Only used under the lock of the registry */
+		int32 NumSubscribers;
+
+	private:
+		virtual void AddRef() override
+		{
+			++RefCounter;
+		}
+
+		virtual void Release() override
+		{
+			--RefCounter;
+			if (RefCounter == 0)
+			{
+				delete this;
+			}
+		}
+
+		virtual void OnInitializationCompleted(bool bSuccess) override
+		{
+		}
+
+		virtual void OnShutdownCompleted() override
+		{
+		}
+
+		virtual void OnFrameReceived(const BlackmagicDesign::IInputEventCallback::FFrameReceivedInfo& InFrameInfo) override
+		{
+			if (InFrameInfo.VideoBuffer == nullptr)
+			{
+				return;
+			}
+
+			const double CurrentTime = FPlatformTime::Seconds();
+			if (CurrentTime < NextProxyTime)
+			{
+				return;
+			}
+			NextProxyTime = CurrentTime + FMath::Max(CVarPreviewInterval.GetValueOnAnyThread(), 0.f);
+
+			// A player already reduces the frames of the input
+			if (FBlackmagicMediaProxyGenerator::GetLatestFrame(ChannelInfo.DeviceIndex).IsValid())
+			{
+				return;
+			}
+
+			// The previous proxy is still being reduced
+			if (bIsReducing)
+			{
+				return;
+			}
+
+			// Only one field is copied, every other line of the frame, and reduced by the job workers: a preview doesn't need
+			// the vertical resolution, and the thread of the device only pays for the copy.
+			const uint32 FieldHeight = InFrameInfo.VideoHeight / 2;
+			const uint32 Pitch = InFrameInfo.VideoPitch;
+			if (FieldHeight == 0)
+			{
+				return;
+			}
+
+			FieldBuffer.SetNumUninitialized(FieldHeight * Pitch, false);
+			const uint8* VideoBuffer = reinterpret_cast<const uint8*>(InFrameInfo.VideoBuffer);
+			for (uint32 Line = 0; Line < FieldHeight; ++Line)
+			{
+				FMemory::Memcpy(FieldBuffer.GetData() + uint64(Line) * Pitch, VideoBuffer + uint64(Line) * 2 * Pitch, Pitch);
+			}
+
+			const EBlackmagicRecordingPixelFormat PixelFormat = InFrameInfo.PixelFormat == BlackmagicDesign::EPixelFormat::pf_8Bits ? EBlackmagicRecordingPixelFormat::UYVY : EBlackmagicRecordingPixelFormat::V210;
+			TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> Frame = AcquireFrame();
+			const uint32 Width = InFrameInfo.VideoWidth;
+			const int64 FrameNumber = InFrameInfo.FrameNumber;
+
+			// The job holds the channel, FieldBuffer is only written again once it is done
+			bIsReducing = true;
+			AddRef();
+			FBlackmagicMediaJobs::Launch(EBlackmagicJobPriority::Analysis, ReduceJobStage, [this, Frame, PixelFormat, Width, FieldHeight, Pitch, FrameNumber]()
+			{
+				if (FBlackmagicMediaProxyGenerator::Generate(FieldBuffer.GetData(), PixelFormat, Width, FieldHeight, Pitch, true, *Frame))
+				{
+					Frame->FrameNumber = FrameNumber;
+					Frame->Timecode.Reset();
+
+					FScopeLock Lock(&CallbackLock);
+					LatestFrame = Frame;
+				}
+				bIsReducing = false;
+				Release();
+			});
+		}
+
+		virtual void OnFrameFormatChanged(const BlackmagicDesign::FFormatInfo& NewFormat) override
+		{
+		}
+
+		virtual void OnInterlacedOddFieldEvent() override
+		{
+		}
+
+		/** Frames are reused once no preview references them anymore. Only used by the thread of the device. */
+		TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> AcquireFrame()
+		{
+			for (const TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>& Frame : FramePool)
+			{
+				if (Frame.IsUnique())
+				{
+					return Frame;
+				}
+			}
+
+			TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> NewFrame = MakeShared<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>();
+			if (FramePool.Num() < MaxPooledFrames)
+			{
+				FramePool.Add(NewFrame);
+			}
+			return NewFrame;
+		}
+
+	private:
+		TAtomic<int32> RefCounter;
+
+		BlackmagicDesign::FChannelInfo ChannelInfo;
+		BlackmagicDesign::FInputChannelOptions ChannelOptions;
+		BlackmagicDesign::FUniqueIdentifier BlackmagicIdendifier;
+
+		double NextProxyTime;
+		TArray<TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>> FramePool;
+
+		/** Field copied from the last frame, read by the reduce job */
+		TArray<uint8> FieldBuffer;
+		TAtomic<bool> bIsReducing;
+
+		mutable FCriticalSection CallbackLock;
+		FBlackmagicMediaProxyFramePtr LatestFrame;
+	};
+
+	struct FSubscription
+	{
+		int32 SubscriptionId;
+		int32 DeviceIndex;
+		BlackmagicDesign::FInputChannelOptions ChannelOptions;
+
+		/** Null while the device is held by a player or a warm channel, only the proxies of the player are used */
+		FPreviewChannel* Channel;
+	};
+
+	/** Previews of this process */
+	FCriticalSection RegistryLock;
+	TArray<FSubscription> Subscriptions;
+	TArray<FPreviewChannel*> Channels;
+	int32 NextSubscriptionId = 1;
+
+	/** Number of players and warm channels that hold each device */
+	TMap<int32, int32> DeviceSuspensions;
+
+	/** Add a subscriber to the channel of these options, opened if needed. Under RegistryLock. */
+	FPreviewChannel* AcquireChannel(int32 InDeviceIndex, const BlackmagicDesign::FInputChannelOptions& InChannelOptions)
+	{
+		BlackmagicDesign::FChannelInfo ChannelInfo;
+		ChannelInfo.DeviceIndex = InDeviceIndex;
+
+		FPreviewChannel* Channel = nullptr;
+		for (FPreviewChannel* Candidate : Channels)
+		{
+			if (Candidate->Matches(ChannelInfo, InChannelOptions))
+			{
+				Channel = Candidate;
+				break;
+			}
+		}
+
+		if (Channel == nullptr)
+		{
+			Channel = new FPreviewChannel(ChannelInfo, InChannelOptions);
+			Channel->Initialize();
+			Channels.Add(Channel);
+		}
+
+		++Channel->NumSubscribers;
+		return Channel;
+	}
+
+	/** Remove a subscriber, the channel is closed once nobody subscribes to it. Under RegistryLock. */
+	void ReleaseChannel(FPreviewChannel* InChannel)
+	{
+		if (--InChannel->NumSubscribers == 0)
+		{
+			Channels.RemoveSingleSwap(InChannel);
+			InChannel->Uninitialize();
+		}
+	}
+}
+
+int32 FBlackmagicMediaProxyPreview::Subscribe(const FBlackmagicMediaSourceSettings& InSettings)
+{
+	using namespace BlackmagicMediaProxyPreviewHelpers;
+
+	if (!FBlackmagic::IsInitialized() || !FBlackmagic::CanUseBlackmagicCard())
+	{
+		return INDEX_NONE;
+	}
+
+	BlackmagicDesign::FChannelInfo ChannelInfo;
+	ChannelInfo.DeviceIndex = InSettings.DeviceIndex;
+
+	// Like a player of the source, without the audio and the timecode, and after the players when the device calls back
+	BlackmagicDesign::FInputChannelOptions ChannelOptions;
+	ChannelOptions.CallbackPriority = 1;
+	ChannelOptions.bReadVideo = true;
+	ChannelOptions.FormatInfo.DisplayMode = InSettings.VideoFormat;
+	ChannelOptions.PixelFormat = InSettings.ColorFormat == EBlackmagicMediaSourceColorFormat::YUV8 ? BlackmagicDesign::EPixelFormat::pf_8Bits : BlackmagicDesign::EPixelFormat::pf_10Bits;
+	ChannelOptions.TimecodeFormat = BlackmagicDesign::ETimecodeFormat::TCF_None;
+	ChannelOptions.bReadAudio = false;
+
+	FScopeLock Lock(&RegistryLock);
+
+	// A player may have opened the input in another mode, a preview never competes with it for the device
+	FSubscription& Subscription = Subscriptions.AddDefaulted_GetRef();
+	Subscription.SubscriptionId = NextSubscriptionId++;
+	Subscription.DeviceIndex = ChannelInfo.DeviceIndex;
+	Subscription.ChannelOptions = ChannelOptions;
+	Subscription.Channel = DeviceSuspensions.Contains(ChannelInfo.DeviceIndex) ? nullptr : AcquireChannel(ChannelInfo.DeviceIndex, ChannelOptions);
+	return Subscription.SubscriptionId;
+}
+
+void FBlackmagicMediaProxyPreview::Unsubscribe(int32 InSubscriptionId)
+{
+	using namespace BlackmagicMediaProxyPreviewHelpers;
+
+	FScopeLock Lock(&RegistryLock);
+	const int32 Index = Subscriptions.IndexOfByPredicate([InSubscriptionId](const FSubscription& Subscription) { return Subscription.SubscriptionId == InSubscriptionId; });
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	FPreviewChannel* Channel = Subscriptions[Index].Channel;
+	Subscriptions.RemoveAtSwap(Index);
+	if (Channel)
+	{
+		ReleaseChannel(Channel);
+	}
+}
+
+void FBlackmagicMediaProxyPreview::SuspendDevice(int32 InDeviceIndex)
+{
+	using namespace BlackmagicMediaProxyPreviewHelpers;
+
+	FScopeLock Lock(&RegistryLock);
+	if (DeviceSuspensions.FindOrAdd(InDeviceIndex)++ > 0)
+	{
+		return;
+	}
+
+	for (FSubscription& Subscription : Subscriptions)
+	{
+		if (Subscription.DeviceIndex == InDeviceIndex && Subscription.Channel)
+		{
+			ReleaseChannel(Subscription.Channel);
+			Subscription.Channel = nullptr;
+		}
+	}
+}
+
+void FBlackmagicMediaProxyPreview::ResumeDevice(int32 InDeviceIndex)
+{
+	using namespace BlackmagicMediaProxyPreviewHelpers;
+
+	FScopeLock Lock(&RegistryLock);
+	int32* NumSuspensions = DeviceSuspensions.Find(InDeviceIndex);
+	if (NumSuspensions == nullptr || --(*NumSuspensions) > 0)
+	{
+		return;
+	}
+	DeviceSuspensions.Remove(InDeviceIndex);
+
+	// The warm channels are released when the module shuts down, the previews stay closed
+	if (GIsRequestingExit || !FBlackmagic::IsInitialized() || !FBlackmagic::CanUseBlackmagicCard())
+	{
+		return;
+	}
+
+	for (FSubscription& Subscription : Subscriptions)
+	{
+		if (Subscription.DeviceIndex == InDeviceIndex && Subscription.Channel == nullptr)
+		{
+			Subscription.Channel = AcquireChannel(InDeviceIndex, Subscription.ChannelOptions);
+		}
+	}
+}
+
+FBlackmagicMediaProxyFramePtr FBlackmagicMediaProxyPreview::GetLatestFrame(int32 InSubscriptionId)
+{
+	using namespace BlackmagicMediaProxyPreviewHelpers;
+
+	int32 DeviceIndex = INDEX_NONE;
+	FBlackmagicMediaProxyFramePtr Frame;
+	{
+		FScopeLock Lock(&RegistryLock);
+		const FSubscription* Subscription = Subscriptions.FindByPredicate([InSubscriptionId](const FSubscription& Candidate) { return Candidate.SubscriptionId == InSubscriptionId; });
+		if (Subscription == nullptr)
+		{
+			return FBlackmagicMediaProxyFramePtr();
+		}
+
+		DeviceIndex = Subscription->DeviceIndex;
+		if (Subscription->Channel)
+		{
+			Frame = Subscription->Channel->GetLatestFrame();
+		}
+	}
+
+	// The proxies of a player are more recent
+	FBlackmagicMediaProxyFramePtr PlayerFrame = FBlackmagicMediaProxyGenerator::GetLatestFrame(DeviceIndex);
+	return PlayerFrame.IsValid() ? PlayerFrame : Frame;
+}
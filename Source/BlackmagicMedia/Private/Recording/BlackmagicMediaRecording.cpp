@@ -0,0 +1,504 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaRecording.h"
+
+#include "BlackmagicMediaPrivate.h"
+#include "BlackmagicMediaRecordingCodec.h"
+
+#include "Algo/BinarySearch.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+
+
+namespace BlackmagicMediaRecordingHelpers
+{
+	static const uint8 ZeroPage[BlackmagicMediaRecording::PageAlignment] = { 0 };
+
+	uint64 AlignUp(uint64 InValue, uint64 InAlignment)
+	{
+		return (InValue + InAlignment - 1) & ~(InAlignment - 1);
+	}
+}
+
+/* FBlackmagicRecordingTimecode
+*****************************************************************************/
+
+FBlackmagicRecordingTimecode FBlackmagicRecordingTimecode::FromTimecode(const FTimecode& InTimecode)
+{
+	FBlackmagicRecordingTimecode Result;
+	FMemory::Memzero(Result);
+	Result.Hours = (uint8)InTimecode.Hours;
+	Result.Minutes = (uint8)InTimecode.Minutes;
+	Result.Seconds = (uint8)InTimecode.Seconds;
+	Result.Frames = (uint8)InTimecode.Frames;
+	Result.bDropFrame = InTimecode.bDropFrameFormat ? 1 : 0;
+	return Result;
+}
+
+/* FBlackmagicRecordingWriter
+*****************************************************************************/
+
+FBlackmagicRecordingWriter::FBlackmagicRecordingWriter()
+	: FileHandle(nullptr)
+	, EncodeBuffers(MakeUnique<BlackmagicMediaRecordingCodec::FEncodeBuffers>())
+{
+}
+
+FBlackmagicRecordingWriter::~FBlackmagicRecordingWriter()
+{
+	Close();
+}
+
+bool FBlackmagicRecordingWriter::Open(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader)
+{
+	check(FileHandle == nullptr);
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(InFilename));
+
+	FileHandle = PlatformFile.OpenWrite(*InFilename);
+	if (FileHandle == nullptr)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't create the recording file '%s'."), *InFilename);
+		return false;
+	}
+
+	Filename = InFilename;
+	Header = InHeader;
+	Header.Magic = BlackmagicMediaRecording::FileMagic;
+	Header.Version = BlackmagicMediaRecording::FileVersion;
+	Header.HeaderSize = sizeof(FBlackmagicRecordingFileHeader);
+	Header.Alignment = BlackmagicMediaRecording::PageAlignment;
+	Index.Reset();
+
+	if (Header.Codec != EBlackmagicRecordingCodec::None && !BlackmagicMediaRecordingCodec::IsPixelFormatSupported(Header.PixelFormat))
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The pixel format of the recording '%s' can't be compressed. The frames will be recorded uncompressed."), *InFilename);
+		Header.Codec = EBlackmagicRecordingCodec::None;
+	}
+
+	const bool bSuccess = FileHandle->Write(reinterpret_cast<const uint8*>(&Header), sizeof(FBlackmagicRecordingFileHeader))
+		&& WritePadding(Header.Alignment - sizeof(FBlackmagicRecordingFileHeader));
+	if (!bSuccess)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't write the header of the recording file '%s'."), *InFilename);
+		delete FileHandle;
+		FileHandle = nullptr;
+	}
+	return bSuccess;
+}
+
+EBlackmagicRecordingWriteResult FBlackmagicRecordingWriter::WriteFrame(const FBlackmagicRecordingFrame& InFrame)
+{
+	if (FileHandle == nullptr)
+	{
+		return EBlackmagicRecordingWriteResult::Failed;
+	}
+
+	if (InFrame.VideoBuffer == nullptr)
+	{
+		return EBlackmagicRecordingWriteResult::Rejected;
+	}
+
+	if (Index.Num() > 0 && InFrame.FrameNumber <= Index.Last().FrameNumber)
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("Recording '%s' received frame %lld out of order. It was not recorded."), *Filename, InFrame.FrameNumber);
+		return EBlackmagicRecordingWriteResult::Rejected;
+	}
+
+	FBlackmagicRecordingIndexEntry Entry;
+	FMemory::Memzero(Entry);
+	Entry.FrameNumber = InFrame.FrameNumber;
+
+	const void* VideoPayload = InFrame.VideoBuffer;
+	uint64 VideoPayloadSize = InFrame.VideoSize;
+	if (Header.Codec == EBlackmagicRecordingCodec::Lossless)
+	{
+		if (InFrame.VideoSize < uint64(Header.Pitch) * Header.Height
+			|| !BlackmagicMediaRecordingCodec::Encode(InFrame.VideoBuffer, Header.PixelFormat, Header.Width, Header.Height, Header.Pitch, CompressedVideo, *EncodeBuffers))
+		{
+			UE_LOG(LogBlackmagicMedia, Warning, TEXT("Recording '%s' can't compress frame %lld. It was not recorded."), *Filename, InFrame.FrameNumber);
+			return EBlackmagicRecordingWriteResult::Rejected;
+		}
+		VideoPayload = CompressedVideo.GetData();
+		VideoPayloadSize = CompressedVideo.Num();
+	}
+	Entry.VideoSize = VideoPayloadSize;
+
+	if (!WriteChunk(BlackmagicMediaRecording::ChunkType_Video, InFrame.FrameNumber, VideoPayload, VideoPayloadSize, true, Entry.VideoOffset))
+	{
+		return EBlackmagicRecordingWriteResult::Failed;
+	}
+
+	if (InFrame.AudioBuffer && InFrame.AudioSize > 0)
+	{
+		if (!WriteChunk(BlackmagicMediaRecording::ChunkType_Audio, InFrame.FrameNumber, InFrame.AudioBuffer, InFrame.AudioSize, false, Entry.AudioOffset))
+		{
+			return EBlackmagicRecordingWriteResult::Failed;
+		}
+		Entry.AudioSize = InFrame.AudioSize;
+		Entry.Flags |= FBlackmagicRecordingIndexEntry::HasAudio;
+	}
+
+	if (InFrame.Timecode.IsSet())
+	{
+		uint64 TimecodeOffset = 0;
+		Entry.Timecode = FBlackmagicRecordingTimecode::FromTimecode(InFrame.Timecode.GetValue());
+		if (!WriteChunk(BlackmagicMediaRecording::ChunkType_Timecode, InFrame.FrameNumber, &Entry.Timecode, sizeof(FBlackmagicRecordingTimecode), false, TimecodeOffset))
+		{
+			return EBlackmagicRecordingWriteResult::Failed;
+		}
+		Entry.Flags |= FBlackmagicRecordingIndexEntry::HasTimecode;
+	}
+
+	Index.Add(Entry);
+	return EBlackmagicRecordingWriteResult::Written;
+}
+
+bool FBlackmagicRecordingWriter::WriteVanc(uint32 InLineNumber, const void* InData, uint32 InSize)
+{
+	if (FileHandle == nullptr || Index.Num() == 0 || InData == nullptr)
+	{
+		return false;
+	}
+
+	FBlackmagicRecordingIndexEntry& Entry = Index.Last();
+
+	TArray<uint8> Payload;
+	Payload.SetNumUninitialized(sizeof(uint32) + InSize);
+	FMemory::Memcpy(Payload.GetData(), &InLineNumber, sizeof(uint32));
+	FMemory::Memcpy(Payload.GetData() + sizeof(uint32), InData, InSize);
+
+	uint64 VancOffset = 0;
+	if (!WriteChunk(BlackmagicMediaRecording::ChunkType_Vanc, Entry.FrameNumber, Payload.GetData(), Payload.Num(), false, VancOffset))
+	{
+		return false;
+	}
+
+	Entry.Flags |= FBlackmagicRecordingIndexEntry::HasVanc;
+	return true;
+}
+
+void FBlackmagicRecordingWriter::Close()
+{
+	if (FileHandle == nullptr)
+	{
+		return;
+	}
+
+	uint64 IndexOffset = 0;
+	const bool bIndexWritten = WriteChunk(BlackmagicMediaRecording::ChunkType_Index, INDEX_NONE, Index.GetData(), Index.Num() * sizeof(FBlackmagicRecordingIndexEntry), false, IndexOffset);
+	if (bIndexWritten)
+	{
+		FBlackmagicRecordingFileTrailer Trailer;
+		Trailer.IndexOffset = IndexOffset;
+		Trailer.IndexCount = Index.Num();
+		Trailer.Magic = BlackmagicMediaRecording::TrailerMagic;
+		Trailer.Version = BlackmagicMediaRecording::FileVersion;
+		FileHandle->Write(reinterpret_cast<const uint8*>(&Trailer), sizeof(FBlackmagicRecordingFileTrailer));
+	}
+	else
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("Can't write the index of the recording file '%s'. The index will be rebuilt when the file is read."), *Filename);
+	}
+
+	FileHandle->Flush();
+	delete FileHandle;
+	FileHandle = nullptr;
+
+	UE_LOG(LogBlackmagicMedia, Log, TEXT("Recorded %d frames to '%s'."), Index.Num(), *Filename);
+	Index.Reset();
+}
+
+bool FBlackmagicRecordingWriter::WriteChunk(uint32 InType, int64 InFrameNumber, const void* InPayload, uint64 InPayloadSize, bool bAlignPayload, uint64& OutPayloadOffset)
+{
+	const uint64 ChunkHeaderSize = sizeof(FBlackmagicRecordingChunkHeader);
+	uint64 Position = FileHandle->Tell();
+
+	if (bAlignPayload)
+	{
+		// The payload needs to start on a page boundary. The gap is filled with a padding chunk so the file can always be walked.
+		uint64 ChunkPosition = BlackmagicMediaRecordingHelpers::AlignUp(Position + ChunkHeaderSize, Header.Alignment) - ChunkHeaderSize;
+		if (ChunkPosition != Position && ChunkPosition - Position < ChunkHeaderSize)
+		{
+			ChunkPosition += Header.Alignment;
+		}
+
+		if (ChunkPosition != Position)
+		{
+			FBlackmagicRecordingChunkHeader PaddingHeader;
+			FMemory::Memzero(PaddingHeader);
+			PaddingHeader.Type = BlackmagicMediaRecording::ChunkType_Padding;
+			PaddingHeader.PayloadSize = ChunkPosition - Position - ChunkHeaderSize;
+			PaddingHeader.FrameNumber = InFrameNumber;
+			if (!FileHandle->Write(reinterpret_cast<const uint8*>(&PaddingHeader), ChunkHeaderSize) || !WritePadding(PaddingHeader.PayloadSize))
+			{
+				return false;
+			}
+			Position = ChunkPosition;
+		}
+	}
+
+	FBlackmagicRecordingChunkHeader ChunkHeader;
+	FMemory::Memzero(ChunkHeader);
+	ChunkHeader.Type = InType;
+	ChunkHeader.PayloadSize = InPayloadSize;
+	ChunkHeader.FrameNumber = InFrameNumber;
+
+	if (!FileHandle->Write(reinterpret_cast<const uint8*>(&ChunkHeader), ChunkHeaderSize))
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't write to the recording file '%s'. Is the disk full?"), *Filename);
+		return false;
+	}
+
+	OutPayloadOffset = Position + ChunkHeaderSize;
+	if (InPayloadSize > 0 && !FileHandle->Write(reinterpret_cast<const uint8*>(InPayload), InPayloadSize))
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't write to the recording file '%s'. Is the disk full?"), *Filename);
+		return false;
+	}
+
+	return true;
+}
+
+bool FBlackmagicRecordingWriter::WritePadding(uint64 InSize)
+{
+	while (InSize > 0)
+	{
+		const uint64 ToWrite = FMath::Min<uint64>(InSize, sizeof(BlackmagicMediaRecordingHelpers::ZeroPage));
+		if (!FileHandle->Write(BlackmagicMediaRecordingHelpers::ZeroPage, ToWrite))
+		{
+			return false;
+		}
+		InSize -= ToWrite;
+	}
+	return true;
+}
+
+/* FBlackmagicRecordingReader
+*****************************************************************************/
+
+FBlackmagicRecordingReader::FBlackmagicRecordingReader()
+	: FileHandle(nullptr)
+{
+}
+
+FBlackmagicRecordingReader::~FBlackmagicRecordingReader()
+{
+	Close();
+}
+
+bool FBlackmagicRecordingReader::Open(const FString& InFilename)
+{
+	Close();
+
+	FileHandle = FPlatformFileManager::Get().GetPlatformFile().OpenRead(*InFilename);
+	if (FileHandle == nullptr)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't open the recording file '%s'."), *InFilename);
+		return false;
+	}
+
+	if (!ReadAt(0, &Header, sizeof(FBlackmagicRecordingFileHeader))
+		|| Header.Magic != BlackmagicMediaRecording::FileMagic
+		|| Header.Version < BlackmagicMediaRecording::MinFileVersion
+		|| Header.Version > BlackmagicMediaRecording::FileVersion
+		|| Header.Alignment == 0)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("'%s' is not a valid Blackmagic recording."), *InFilename);
+		Close();
+		return false;
+	}
+
+	if (!ReadIndexFromTrailer())
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The recording '%s' has no index. It was probably interrupted, the index will be rebuilt."), *InFilename);
+		if (!RebuildIndex())
+		{
+			Close();
+			return false;
+		}
+	}
+
+	TimecodeToEntry.Reset();
+	TimecodeToEntry.Reserve(Index.Num());
+	for (int32 EntryIndex = 0; EntryIndex < Index.Num(); ++EntryIndex)
+	{
+		if (Index[EntryIndex].Flags & FBlackmagicRecordingIndexEntry::HasTimecode)
+		{
+			const uint32 PackedTimecode = Index[EntryIndex].Timecode.Pack();
+			if (!TimecodeToEntry.Contains(PackedTimecode))
+			{
+				TimecodeToEntry.Add(PackedTimecode, EntryIndex);
+			}
+		}
+	}
+
+	return true;
+}
+
+void FBlackmagicRecordingReader::Close()
+{
+	if (FileHandle)
+	{
+		delete FileHandle;
+		FileHandle = nullptr;
+	}
+	Index.Reset();
+	TimecodeToEntry.Reset();
+}
+
+int32 FBlackmagicRecordingReader::FindFrame(int64 InFrameNumber) const
+{
+	return Algo::BinarySearchBy(Index, InFrameNumber, &FBlackmagicRecordingIndexEntry::FrameNumber);
+}
+
+int32 FBlackmagicRecordingReader::FindFrameByTimecode(const FTimecode& InTimecode) const
+{
+	const int32* Found = TimecodeToEntry.Find(FBlackmagicRecordingTimecode::FromTimecode(InTimecode).Pack());
+	return Found ? *Found : INDEX_NONE;
+}
+
+bool FBlackmagicRecordingReader::ReadVideo(int32 InEntryIndex, TArray<uint8>& OutBuffer) const
+{
+	if (!Index.IsValidIndex(InEntryIndex))
+	{
+		return false;
+	}
+
+	OutBuffer.SetNumUninitialized(Index[InEntryIndex].VideoSize);
+	return ReadVideo(InEntryIndex, OutBuffer.GetData(), OutBuffer.Num());
+}
+
+bool FBlackmagicRecordingReader::ReadVideo(int32 InEntryIndex, void* OutBuffer, uint64 InBufferSize) const
+{
+	if (!Index.IsValidIndex(InEntryIndex) || InBufferSize < Index[InEntryIndex].VideoSize)
+	{
+		return false;
+	}
+
+	return ReadAt(Index[InEntryIndex].VideoOffset, OutBuffer, Index[InEntryIndex].VideoSize);
+}
+
+bool FBlackmagicRecordingReader::ReadDecodedVideo(int32 InEntryIndex, TArray<uint8>& OutBuffer) const
+{
+	TArray<uint8> CompressedVideo;
+	return ReadDecodedVideo(InEntryIndex, OutBuffer, CompressedVideo);
+}
+
+bool FBlackmagicRecordingReader::ReadDecodedVideo(int32 InEntryIndex, TArray<uint8>& OutBuffer, TArray<uint8>& InOutCompressed) const
+{
+	if (Header.Codec == EBlackmagicRecordingCodec::None)
+	{
+		return ReadVideo(InEntryIndex, OutBuffer);
+	}
+
+	if (Header.Codec != EBlackmagicRecordingCodec::Lossless || !ReadVideo(InEntryIndex, InOutCompressed))
+	{
+		return false;
+	}
+
+	OutBuffer.SetNumUninitialized(uint64(Header.Pitch) * Header.Height);
+	return BlackmagicMediaRecordingCodec::Decode(InOutCompressed.GetData(), InOutCompressed.Num(), OutBuffer.GetData(), OutBuffer.Num());
+}
+
+bool FBlackmagicRecordingReader::ReadAudio(int32 InEntryIndex, TArray<uint8>& OutBuffer) const
+{
+	if (!Index.IsValidIndex(InEntryIndex) || (Index[InEntryIndex].Flags & FBlackmagicRecordingIndexEntry::HasAudio) == 0)
+	{
+		OutBuffer.Reset();
+		return false;
+	}
+
+	OutBuffer.SetNumUninitialized(Index[InEntryIndex].AudioSize);
+	return ReadAt(Index[InEntryIndex].AudioOffset, OutBuffer.GetData(), OutBuffer.Num());
+}
+
+bool FBlackmagicRecordingReader::ReadIndexFromTrailer()
+{
+	const int64 FileSize = FileHandle->Size();
+	if (FileSize < int64(Header.Alignment + sizeof(FBlackmagicRecordingFileTrailer)))
+	{
+		return false;
+	}
+
+	FBlackmagicRecordingFileTrailer Trailer;
+	if (!ReadAt(FileSize - sizeof(FBlackmagicRecordingFileTrailer), &Trailer, sizeof(FBlackmagicRecordingFileTrailer)) || Trailer.Magic != BlackmagicMediaRecording::TrailerMagic)
+	{
+		return false;
+	}
+
+	// The index is written between the last frame and the trailer. A count that doesn't fit there is a corrupted trailer,
+	// checked before the multiplication so it can't overflow, and before anything is allocated.
+	const uint64 TrailerOffset = uint64(FileSize) - sizeof(FBlackmagicRecordingFileTrailer);
+	if (Trailer.IndexOffset < Header.Alignment || Trailer.IndexOffset > TrailerOffset
+		|| Trailer.IndexCount > (TrailerOffset - Trailer.IndexOffset) / sizeof(FBlackmagicRecordingIndexEntry)
+		|| Trailer.IndexCount > uint64(MAX_int32))
+	{
+		return false;
+	}
+
+	const uint64 IndexSize = Trailer.IndexCount * sizeof(FBlackmagicRecordingIndexEntry);
+
+	Index.SetNumUninitialized(int32(Trailer.IndexCount));
+	return ReadAt(Trailer.IndexOffset, Index.GetData(), IndexSize);
+}
+
+bool FBlackmagicRecordingReader::RebuildIndex()
+{
+	Index.Reset();
+
+	const uint64 FileSize = FileHandle->Size();
+	uint64 Position = Header.Alignment;
+	FBlackmagicRecordingChunkHeader ChunkHeader;
+	while (Position + sizeof(FBlackmagicRecordingChunkHeader) <= FileSize && ReadAt(Position, &ChunkHeader, sizeof(FBlackmagicRecordingChunkHeader)))
+	{
+		const uint64 PayloadOffset = Position + sizeof(FBlackmagicRecordingChunkHeader);
+		if (PayloadOffset + ChunkHeader.PayloadSize > FileSize)
+		{
+			// Truncated chunk, the frame is incomplete
+			break;
+		}
+
+		if (ChunkHeader.Type == BlackmagicMediaRecording::ChunkType_Video)
+		{
+			FBlackmagicRecordingIndexEntry& Entry = Index.AddZeroed_GetRef();
+			Entry.FrameNumber = ChunkHeader.FrameNumber;
+			Entry.VideoOffset = PayloadOffset;
+			Entry.VideoSize = ChunkHeader.PayloadSize;
+		}
+		else if (Index.Num() > 0 && Index.Last().FrameNumber == ChunkHeader.FrameNumber)
+		{
+			FBlackmagicRecordingIndexEntry& Entry = Index.Last();
+			if (ChunkHeader.Type == BlackmagicMediaRecording::ChunkType_Audio)
+			{
+				Entry.AudioOffset = PayloadOffset;
+				Entry.AudioSize = (uint32)ChunkHeader.PayloadSize;
+				Entry.Flags |= FBlackmagicRecordingIndexEntry::HasAudio;
+			}
+			else if (ChunkHeader.Type == BlackmagicMediaRecording::ChunkType_Timecode && ChunkHeader.PayloadSize == sizeof(FBlackmagicRecordingTimecode))
+			{
+				if (ReadAt(PayloadOffset, &Entry.Timecode, sizeof(FBlackmagicRecordingTimecode)))
+				{
+					Entry.Flags |= FBlackmagicRecordingIndexEntry::HasTimecode;
+				}
+			}
+			else if (ChunkHeader.Type == BlackmagicMediaRecording::ChunkType_Vanc)
+			{
+				Entry.Flags |= FBlackmagicRecordingIndexEntry::HasVanc;
+			}
+		}
+
+		Position = PayloadOffset + ChunkHeader.PayloadSize;
+	}
+
+	return true;
+}
+
+bool FBlackmagicRecordingReader::ReadAt(uint64 InOffset, void* OutBuffer, uint64 InSize) const
+{
+	FScopeLock Lock(&FileLock);
+	return FileHandle->Seek(InOffset) && FileHandle->Read(reinterpret_cast<uint8*>(OutBuffer), InSize);
+}
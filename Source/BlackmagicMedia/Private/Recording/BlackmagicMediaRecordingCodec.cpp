@@ -0,0 +1,682 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaRecordingCodec.h"
+
+#include "BlackmagicMediaPrivate.h"
+
+#include "BlackmagicMediaJobs.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Templates/Atomic.h"
+
+
+namespace BlackmagicMediaRecordingCodecHelpers
+{
+	static const uint32 RiceBlockSize = 32;
+	static const uint32 RiceEscape = 16;
+	static const uint32 RiceParameterBits = 4;
+	static const uint32 MinLinesPerStripe = 16;
+
+	/** Stages of the Blackmagic jobs */
+	static const FName EncodeJobStage(TEXT("RecordingEncode"));
+	static const FName DecodeJobStage(TEXT("RecordingDecode"));
+
+	struct FLineLayout
+	{
+		/** Number of Cb Y Cr Y components in a line */
+		uint32 NumComponents;
+		uint32 BitDepth;
+		/** Number of bytes of active video in a line */
+		uint32 PackedSize;
+	};
+
+	bool GetLineLayout(EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InPitch, FLineLayout& OutLayout)
+	{
+		switch (InPixelFormat)
+		{
+		case EBlackmagicRecordingPixelFormat::UYVY:
+			OutLayout.NumComponents = InWidth * 2;
+			OutLayout.BitDepth = 8;
+			OutLayout.PackedSize = InWidth * 2;
+			break;
+		case EBlackmagicRecordingPixelFormat::V210:
+		{
+			// 6 pixels are packed in 4 words of 3 components
+			const uint32 NumWords = FMath::DivideAndRoundUp<uint32>(InWidth, 6) * 4;
+			OutLayout.NumComponents = NumWords * 3;
+			OutLayout.BitDepth = 10;
+			OutLayout.PackedSize = NumWords * 4;
+			break;
+		}
+		default:
+			return false;
+		}
+
+		return InWidth > 0 && OutLayout.PackedSize <= InPitch;
+	}
+
+	void UnpackLine(const uint8* InLine, EBlackmagicRecordingPixelFormat InPixelFormat, const FLineLayout& InLayout, uint16* OutComponents)
+	{
+		if (InPixelFormat == EBlackmagicRecordingPixelFormat::UYVY)
+		{
+			for (uint32 Index = 0; Index < InLayout.NumComponents; ++Index)
+			{
+				OutComponents[Index] = InLine[Index];
+			}
+		}
+		else
+		{
+			const uint32* Words = reinterpret_cast<const uint32*>(InLine);
+			const uint32 NumWords = InLayout.NumComponents / 3;
+			for (uint32 Index = 0; Index < NumWords; ++Index)
+			{
+				const uint32 Word = Words[Index];
+				OutComponents[Index * 3 + 0] = uint16(Word & 0x3FF);
+				OutComponents[Index * 3 + 1] = uint16((Word >> 10) & 0x3FF);
+				OutComponents[Index * 3 + 2] = uint16((Word >> 20) & 0x3FF);
+			}
+		}
+	}
+
+	void PackLine(const uint16* InComponents, EBlackmagicRecordingPixelFormat InPixelFormat, const FLineLayout& InLayout, uint8* OutLine)
+	{
+		if (InPixelFormat == EBlackmagicRecordingPixelFormat::UYVY)
+		{
+			for (uint32 Index = 0; Index < InLayout.NumComponents; ++Index)
+			{
+				OutLine[Index] = uint8(InComponents[Index]);
+			}
+		}
+		else
+		{
+			uint32* Words = reinterpret_cast<uint32*>(OutLine);
+			const uint32 NumWords = InLayout.NumComponents / 3;
+			for (uint32 Index = 0; Index < NumWords; ++Index)
+			{
+				Words[Index] = uint32(InComponents[Index * 3 + 0]) | (uint32(InComponents[Index * 3 + 1]) << 10) | (uint32(InComponents[Index * 3 + 2]) << 20);
+			}
+		}
+	}
+
+	/** Median edge detector, written as a clamp of the gradient so it compiles without branches. */
+	FORCEINLINE int32 PredictMED(int32 A, int32 B, int32 C)
+	{
+		return FMath::Clamp(A + B - C, FMath::Min(A, B), FMath::Max(A, B));
+	}
+
+	/**
+	 * Prediction of a component from its neighbors of the same kind.
+	 * Luma repeats every 2 components and each chroma every 4 components in a Cb Y Cr Y line.
+	 */
+	FORCEINLINE int32 Predict(const uint16* InCurrent, const uint16* InAbove, uint32 InIndex, int32 InHalf)
+	{
+		const uint32 Period = (InIndex & 1) ? 2 : 4;
+		if (InAbove == nullptr)
+		{
+			return InIndex >= Period ? InCurrent[InIndex - Period] : InHalf;
+		}
+
+		const int32 Above = InAbove[InIndex];
+		if (InIndex < Period)
+		{
+			return Above;
+		}
+		return PredictMED(InCurrent[InIndex - Period], Above, InAbove[InIndex - Period]);
+	}
+
+	/**
+	 * Wrap the prediction error to the bit depth and fold it to an unsigned value (0, -1, 1, -2, ...).
+	 * InSignShift is 32 minus the bit depth, used to sign extend the wrapped error.
+	 */
+	FORCEINLINE uint16 ToResidual(int32 InValue, int32 InPrediction, int32 InSignShift)
+	{
+		const int32 Signed = int32(uint32(InValue - InPrediction) << InSignShift) >> InSignShift;
+		return uint16((Signed << 1) ^ (Signed >> 31));
+	}
+
+	FORCEINLINE uint16 FromResidual(uint32 InResidual, int32 InPrediction, int32 InMask)
+	{
+		const int32 Signed = int32(InResidual >> 1) ^ -int32(InResidual & 1);
+		return uint16((InPrediction + Signed) & InMask);
+	}
+
+	/** Compute the residuals of a line. InAbove is null for the first line of a stripe. */
+	void ComputeResiduals(const uint16* InCurrent, const uint16* InAbove, const FLineLayout& InLayout, uint16* OutResiduals)
+	{
+		const int32 Half = 1 << (InLayout.BitDepth - 1);
+		const int32 SignShift = 32 - InLayout.BitDepth;
+		const uint32 NumComponents = InLayout.NumComponents;
+		const uint32 NumHeadComponents = FMath::Min<uint32>(4, NumComponents);
+
+		for (uint32 Index = 0; Index < NumHeadComponents; ++Index)
+		{
+			OutResiduals[Index] = ToResidual(InCurrent[Index], Predict(InCurrent, InAbove, Index, Half), SignShift);
+		}
+
+		// Past the first Cb Y Cr Y group, every neighbor exists. Work on a group at a time so the loop has no branch on the component kind.
+		const uint32 NumGroupComponents = NumComponents & ~3u;
+		if (InAbove)
+		{
+			for (uint32 Index = 4; Index < NumGroupComponents; Index += 4)
+			{
+				OutResiduals[Index + 0] = ToResidual(InCurrent[Index + 0], PredictMED(InCurrent[Index - 4], InAbove[Index + 0], InAbove[Index - 4]), SignShift);
+				OutResiduals[Index + 1] = ToResidual(InCurrent[Index + 1], PredictMED(InCurrent[Index - 1], InAbove[Index + 1], InAbove[Index - 1]), SignShift);
+				OutResiduals[Index + 2] = ToResidual(InCurrent[Index + 2], PredictMED(InCurrent[Index - 2], InAbove[Index + 2], InAbove[Index - 2]), SignShift);
+				OutResiduals[Index + 3] = ToResidual(InCurrent[Index + 3], PredictMED(InCurrent[Index + 1], InAbove[Index + 3], InAbove[Index + 1]), SignShift);
+			}
+		}
+		else
+		{
+			for (uint32 Index = 4; Index < NumGroupComponents; Index += 4)
+			{
+				OutResiduals[Index + 0] = ToResidual(InCurrent[Index + 0], InCurrent[Index - 4], SignShift);
+				OutResiduals[Index + 1] = ToResidual(InCurrent[Index + 1], InCurrent[Index - 1], SignShift);
+				OutResiduals[Index + 2] = ToResidual(InCurrent[Index + 2], InCurrent[Index - 2], SignShift);
+				OutResiduals[Index + 3] = ToResidual(InCurrent[Index + 3], InCurrent[Index + 1], SignShift);
+			}
+		}
+
+		for (uint32 Index = FMath::Max(NumGroupComponents, NumHeadComponents); Index < NumComponents; ++Index)
+		{
+			OutResiduals[Index] = ToResidual(InCurrent[Index], Predict(InCurrent, InAbove, Index, Half), SignShift);
+		}
+	}
+
+	/** Rebuild a line from its residuals. Serial since every component depends on the previous ones. */
+	void ApplyResiduals(const uint16* InResiduals, const uint16* InAbove, const FLineLayout& InLayout, uint16* OutCurrent)
+	{
+		const int32 Mask = (1 << InLayout.BitDepth) - 1;
+		const int32 Half = 1 << (InLayout.BitDepth - 1);
+		for (uint32 Index = 0; Index < InLayout.NumComponents; ++Index)
+		{
+			OutCurrent[Index] = FromResidual(InResiduals[Index], Predict(OutCurrent, InAbove, Index, Half), Mask);
+		}
+	}
+
+	/** Write bits in a fixed size buffer. Stop writing when the buffer is full. */
+	class FBitWriter
+	{
+	public:
+		FBitWriter(uint8* InBuffer, uint64 InCapacity)
+			: Start(InBuffer)
+			, Cursor(InBuffer)
+			, End(InBuffer + InCapacity)
+			, Accumulator(0)
+			, NumBits(0)
+		{ }
+
+		/** Write the lower InNumBits (up to 32) of InValue. The other bits must be zero. */
+		FORCEINLINE void Write(uint32 InValue, uint32 InNumBits)
+		{
+			Accumulator |= uint64(InValue) << NumBits;
+			NumBits += InNumBits;
+			if (NumBits >= 32)
+			{
+				if (Cursor + sizeof(uint32) <= End)
+				{
+					const uint32 Word = uint32(Accumulator);
+					FMemory::Memcpy(Cursor, &Word, sizeof(uint32));
+				}
+				Cursor += sizeof(uint32);
+				Accumulator >>= 32;
+				NumBits -= 32;
+			}
+		}
+
+		void Flush()
+		{
+			while (NumBits > 0)
+			{
+				if (Cursor < End)
+				{
+					*Cursor = uint8(Accumulator);
+				}
+				++Cursor;
+				Accumulator >>= 8;
+				NumBits = NumBits > 8 ? NumBits - 8 : 0;
+			}
+		}
+
+		bool IsFull() const { return Cursor > End; }
+		uint64 GetNumBytes() const { return Cursor - Start; }
+
+	private:
+		uint8* Start;
+		uint8* Cursor;
+		uint8* End;
+		uint64 Accumulator;
+		uint32 NumBits;
+	};
+
+	class FBitReader
+	{
+	public:
+		FBitReader(const uint8* InData, uint64 InSize)
+			: Data(InData)
+			, End(InData + InSize)
+			, Accumulator(0)
+			, NumBits(0)
+			, TotalBits(InSize * 8)
+			, ConsumedBits(0)
+		{ }
+
+		FORCEINLINE uint32 Read(uint32 InNumBits)
+		{
+			if (InNumBits == 0)
+			{
+				return 0;
+			}
+			Refill();
+			const uint32 Value = uint32(Accumulator & ((uint64(1) << InNumBits) - 1));
+			Consume(InNumBits);
+			return Value;
+		}
+
+		/** Count the ones up to InMax, consuming the terminating zero if found. */
+		FORCEINLINE uint32 ReadUnary(uint32 InMax)
+		{
+			Refill();
+			const uint32 NumOnes = (uint32)FMath::CountTrailingZeros64(~Accumulator);
+			if (NumOnes >= InMax)
+			{
+				Consume(InMax);
+				return InMax;
+			}
+			Consume(NumOnes + 1);
+			return NumOnes;
+		}
+
+		/** @return true if more bits were read than the stream contains */
+		bool IsOverrun() const { return ConsumedBits > TotalBits; }
+
+	private:
+		FORCEINLINE void Consume(uint32 InNumBits)
+		{
+			Accumulator >>= InNumBits;
+			NumBits -= InNumBits;
+			ConsumedBits += InNumBits;
+		}
+
+		FORCEINLINE void Refill()
+		{
+			while (NumBits <= 56)
+			{
+				const uint64 Byte = Data < End ? *Data++ : 0;
+				Accumulator |= Byte << NumBits;
+				NumBits += 8;
+			}
+		}
+
+	private:
+		const uint8* Data;
+		const uint8* End;
+		uint64 Accumulator;
+		uint32 NumBits;
+		uint64 TotalBits;
+		uint64 ConsumedBits;
+	};
+
+	void WriteResiduals(FBitWriter& InWriter, const uint16* InResiduals, uint32 InNumResiduals, uint32 InBitDepth)
+	{
+		for (uint32 BlockStart = 0; BlockStart < InNumResiduals; BlockStart += RiceBlockSize)
+		{
+			const uint32 BlockSize = FMath::Min(RiceBlockSize, InNumResiduals - BlockStart);
+			const uint16* Block = InResiduals + BlockStart;
+
+			uint32 Sum = 0;
+			for (uint32 Index = 0; Index < BlockSize; ++Index)
+			{
+				Sum += Block[Index];
+			}
+
+			uint32 K = 0;
+			while ((BlockSize << K) < Sum && K < InBitDepth)
+			{
+				++K;
+			}
+			InWriter.Write(K, RiceParameterBits);
+
+			for (uint32 Index = 0; Index < BlockSize; ++Index)
+			{
+				const uint32 Value = Block[Index];
+				const uint32 Quotient = Value >> K;
+				if (Quotient < RiceEscape)
+				{
+					// Unary quotient, terminating zero and remainder in a single write. At most 16 + 1 + 10 bits.
+					const uint32 Remainder = Value & ((1u << K) - 1);
+					InWriter.Write(((1u << Quotient) - 1) | (Remainder << (Quotient + 1)), Quotient + 1 + K);
+				}
+				else
+				{
+					InWriter.Write(((1u << RiceEscape) - 1) | (Value << RiceEscape), RiceEscape + InBitDepth);
+				}
+			}
+		}
+	}
+
+	void ReadResiduals(FBitReader& InReader, uint16* OutResiduals, uint32 InNumResiduals, uint32 InBitDepth)
+	{
+		for (uint32 BlockStart = 0; BlockStart < InNumResiduals; BlockStart += RiceBlockSize)
+		{
+			const uint32 BlockSize = FMath::Min(RiceBlockSize, InNumResiduals - BlockStart);
+			const uint32 K = FMath::Min(InReader.Read(RiceParameterBits), InBitDepth);
+
+			for (uint32 Index = 0; Index < BlockSize; ++Index)
+			{
+				const uint32 Quotient = InReader.ReadUnary(RiceEscape);
+				if (Quotient < RiceEscape)
+				{
+					OutResiduals[BlockStart + Index] = uint16((Quotient << K) | InReader.Read(K));
+				}
+				else
+				{
+					OutResiduals[BlockStart + Index] = uint16(InReader.Read(InBitDepth));
+				}
+			}
+		}
+	}
+
+	void EncodeStripe(const uint8* InBuffer, EBlackmagicRecordingPixelFormat InPixelFormat, const FLineLayout& InLayout, uint32 InPitch, uint32 InFirstLine, uint32 InNumLines, TArray<uint16>& Components, TArray<uint8>& OutStripe, bool& bOutIsRaw)
+	{
+		const uint32 RawSize = InNumLines * InLayout.PackedSize;
+		OutStripe.SetNumUninitialized(RawSize, false);
+		Components.SetNumUninitialized(InLayout.NumComponents * 3, false);
+		uint16* Current = Components.GetData();
+		uint16* Above = Current + InLayout.NumComponents;
+		uint16* Residuals = Above + InLayout.NumComponents;
+
+		FBitWriter Writer(OutStripe.GetData(), RawSize);
+		for (uint32 Line = 0; Line < InNumLines && !Writer.IsFull(); ++Line)
+		{
+			UnpackLine(InBuffer + uint64(InFirstLine + Line) * InPitch, InPixelFormat, InLayout, Current);
+			ComputeResiduals(Current, Line > 0 ? Above : nullptr, InLayout, Residuals);
+			WriteResiduals(Writer, Residuals, InLayout.NumComponents, InLayout.BitDepth);
+			Swap(Current, Above);
+		}
+		Writer.Flush();
+
+		bOutIsRaw = Writer.GetNumBytes() >= RawSize;
+		if (!bOutIsRaw)
+		{
+			OutStripe.SetNum(Writer.GetNumBytes(), false);
+		}
+		else
+		{
+			for (uint32 Line = 0; Line < InNumLines; ++Line)
+			{
+				FMemory::Memcpy(OutStripe.GetData() + Line * InLayout.PackedSize, InBuffer + uint64(InFirstLine + Line) * InPitch, InLayout.PackedSize);
+			}
+		}
+	}
+
+	bool DecodeStripe(const uint8* InStripe, uint32 InStripeSize, bool bInIsRaw, EBlackmagicRecordingPixelFormat InPixelFormat, const FLineLayout& InLayout, uint32 InPitch, uint32 InFirstLine, uint32 InNumLines, uint8* OutBuffer)
+	{
+		if (bInIsRaw)
+		{
+			if (InStripeSize != InNumLines * InLayout.PackedSize)
+			{
+				return false;
+			}
+			for (uint32 Line = 0; Line < InNumLines; ++Line)
+			{
+				uint8* OutLine = OutBuffer + uint64(InFirstLine + Line) * InPitch;
+				FMemory::Memcpy(OutLine, InStripe + Line * InLayout.PackedSize, InLayout.PackedSize);
+				FMemory::Memzero(OutLine + InLayout.PackedSize, InPitch - InLayout.PackedSize);
+			}
+			return true;
+		}
+
+		TArray<uint16> Components;
+		Components.SetNumUninitialized(InLayout.NumComponents * 3);
+		uint16* Current = Components.GetData();
+		uint16* Above = Current + InLayout.NumComponents;
+		uint16* Residuals = Above + InLayout.NumComponents;
+
+		FBitReader Reader(InStripe, InStripeSize);
+		for (uint32 Line = 0; Line < InNumLines; ++Line)
+		{
+			ReadResiduals(Reader, Residuals, InLayout.NumComponents, InLayout.BitDepth);
+			ApplyResiduals(Residuals, Line > 0 ? Above : nullptr, InLayout, Current);
+
+			uint8* OutLine = OutBuffer + uint64(InFirstLine + Line) * InPitch;
+			PackLine(Current, InPixelFormat, InLayout, OutLine);
+			FMemory::Memzero(OutLine + InLayout.PackedSize, InPitch - InLayout.PackedSize);
+			Swap(Current, Above);
+		}
+
+		return !Reader.IsOverrun();
+	}
+}
+
+bool BlackmagicMediaRecordingCodec::IsPixelFormatSupported(EBlackmagicRecordingPixelFormat InPixelFormat)
+{
+	return InPixelFormat == EBlackmagicRecordingPixelFormat::UYVY || InPixelFormat == EBlackmagicRecordingPixelFormat::V210;
+}
+
+bool BlackmagicMediaRecordingCodec::Encode(const void* InBuffer, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, uint32 InPitch, TArray<uint8>& OutCompressed, FEncodeBuffers& InOutBuffers, uint32 InNumStripes)
+{
+	using namespace BlackmagicMediaRecordingCodecHelpers;
+
+	FLineLayout Layout;
+	if (InBuffer == nullptr || InHeight == 0 || !GetLineLayout(InPixelFormat, InWidth, InPitch, Layout))
+	{
+		return false;
+	}
+
+	uint32 NumStripes = InNumStripes;
+	if (NumStripes == 0)
+	{
+		// A few stripes per worker to balance the load between busy and idle cores
+		NumStripes = (FBlackmagicMediaJobs::GetNumWorkers() + 1) * 2;
+	}
+	NumStripes = FMath::Clamp<uint32>(NumStripes, 1, FMath::Max<uint32>(InHeight / MinLinesPerStripe, 1));
+	const uint32 LinesPerStripe = FMath::DivideAndRoundUp(InHeight, NumStripes);
+	NumStripes = FMath::DivideAndRoundUp(InHeight, LinesPerStripe);
+
+	// The stripe buffers keep their allocation when the number of stripes changes
+	TArray<TArray<uint8>>& Stripes = InOutBuffers.Stripes;
+	TArray<TArray<uint16>>& Components = InOutBuffers.Components;
+	TArray<bool>& StripesIsRaw = InOutBuffers.StripesIsRaw;
+	if (Stripes.Num() < int32(NumStripes))
+	{
+		Stripes.SetNum(NumStripes);
+		Components.SetNum(NumStripes);
+	}
+	StripesIsRaw.SetNumZeroed(NumStripes, false);
+
+	// Recordings are written behind the inputs, their encode doesn't delay the copy of the frames
+	const uint8* Buffer = reinterpret_cast<const uint8*>(InBuffer);
+	FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Analysis, EncodeJobStage, NumStripes, [&](int32 StripeIndex)
+	{
+		const uint32 FirstLine = StripeIndex * LinesPerStripe;
+		const uint32 NumLines = FMath::Min(LinesPerStripe, InHeight - FirstLine);
+		bool bIsRaw = false;
+		EncodeStripe(Buffer, InPixelFormat, Layout, InPitch, FirstLine, NumLines, Components[StripeIndex], Stripes[StripeIndex], bIsRaw);
+		StripesIsRaw[StripeIndex] = bIsRaw;
+	});
+
+	FCompressedFrameHeader Header;
+	Header.Magic = FrameMagic;
+	Header.Version = FrameVersion;
+	Header.PixelFormat = InPixelFormat;
+	Header.Width = InWidth;
+	Header.Height = InHeight;
+	Header.Pitch = InPitch;
+	Header.NumStripes = NumStripes;
+	Header.LinesPerStripe = LinesPerStripe;
+
+	uint64 TotalSize = sizeof(FCompressedFrameHeader) + NumStripes * sizeof(uint32);
+	for (uint32 StripeIndex = 0; StripeIndex < NumStripes; ++StripeIndex)
+	{
+		TotalSize += Stripes[StripeIndex].Num();
+	}
+
+	OutCompressed.SetNumUninitialized(TotalSize, false);
+	uint8* Output = OutCompressed.GetData();
+	FMemory::Memcpy(Output, &Header, sizeof(FCompressedFrameHeader));
+	uint32* StripeTable = reinterpret_cast<uint32*>(Output + sizeof(FCompressedFrameHeader));
+	uint8* StripeData = Output + sizeof(FCompressedFrameHeader) + NumStripes * sizeof(uint32);
+	for (uint32 StripeIndex = 0; StripeIndex < NumStripes; ++StripeIndex)
+	{
+		const TArray<uint8>& Stripe = Stripes[StripeIndex];
+		StripeTable[StripeIndex] = uint32(Stripe.Num()) | (StripesIsRaw[StripeIndex] ? StripeRawFlag : 0);
+		FMemory::Memcpy(StripeData, Stripe.GetData(), Stripe.Num());
+		StripeData += Stripe.Num();
+	}
+
+	return true;
+}
+
+bool BlackmagicMediaRecordingCodec::GetFrameInfo(const uint8* InCompressed, uint64 InCompressedSize, FCompressedFrameHeader& OutHeader)
+{
+	if (InCompressed == nullptr || InCompressedSize < sizeof(FCompressedFrameHeader))
+	{
+		return false;
+	}
+
+	FMemory::Memcpy(&OutHeader, InCompressed, sizeof(FCompressedFrameHeader));
+	return OutHeader.Magic == FrameMagic
+		&& OutHeader.Version <= FrameVersion
+		&& OutHeader.NumStripes > 0
+		&& OutHeader.LinesPerStripe > 0
+		&& InCompressedSize >= sizeof(FCompressedFrameHeader) + OutHeader.NumStripes * sizeof(uint32);
+}
+
+bool BlackmagicMediaRecordingCodec::Decode(const uint8* InCompressed, uint64 InCompressedSize, void* OutBuffer, uint64 InBufferSize)
+{
+	using namespace BlackmagicMediaRecordingCodecHelpers;
+
+	FCompressedFrameHeader Header;
+	FLineLayout Layout;
+	if (!GetFrameInfo(InCompressed, InCompressedSize, Header) || !GetLineLayout(Header.PixelFormat, Header.Width, Header.Pitch, Layout))
+	{
+		return false;
+	}
+
+	if (InBufferSize < uint64(Header.Pitch) * Header.Height || uint64(Header.NumStripes) * Header.LinesPerStripe < Header.Height)
+	{
+		return false;
+	}
+
+	const uint32* StripeTable = reinterpret_cast<const uint32*>(InCompressed + sizeof(FCompressedFrameHeader));
+	TArray<uint64> StripeOffsets;
+	StripeOffsets.SetNumUninitialized(Header.NumStripes);
+	uint64 Offset = sizeof(FCompressedFrameHeader) + Header.NumStripes * sizeof(uint32);
+	for (uint32 StripeIndex = 0; StripeIndex < Header.NumStripes; ++StripeIndex)
+	{
+		StripeOffsets[StripeIndex] = Offset;
+		Offset += StripeTable[StripeIndex] & ~StripeRawFlag;
+	}
+	if (Offset > InCompressedSize)
+	{
+		return false;
+	}
+
+	TAtomic<bool> bSuccess(true);
+	uint8* Buffer = reinterpret_cast<uint8*>(OutBuffer);
+	FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Analysis, DecodeJobStage, Header.NumStripes, [&](int32 StripeIndex)
+	{
+		const uint32 FirstLine = StripeIndex * Header.LinesPerStripe;
+		if (FirstLine >= Header.Height)
+		{
+			return;
+		}
+		const uint32 NumLines = FMath::Min(Header.LinesPerStripe, Header.Height - FirstLine);
+		const uint32 StripeSize = StripeTable[StripeIndex] & ~StripeRawFlag;
+		const bool bIsRaw = (StripeTable[StripeIndex] & StripeRawFlag) != 0;
+		if (!DecodeStripe(InCompressed + StripeOffsets[StripeIndex], StripeSize, bIsRaw, Header.PixelFormat, Layout, Header.Pitch, FirstLine, NumLines, Buffer))
+		{
+			bSuccess = false;
+		}
+	});
+
+	return bSuccess;
+}
+
+/* Benchmark
+*****************************************************************************/
+
+namespace BlackmagicMediaRecordingCodecHelpers
+{
+	/** Synthetic picture with gradients, hard edges and sensor noise, closer to a camera feed than a flat pattern. */
+	void BuildBenchmarkFrame(EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, uint32 InPitch, TArray<uint8>& OutBuffer)
+	{
+		FLineLayout Layout;
+		verify(GetLineLayout(InPixelFormat, InWidth, InPitch, Layout));
+
+		OutBuffer.SetNumZeroed(uint64(InPitch) * InHeight);
+		FRandomStream Random(0x42);
+		const int32 MaxValue = (1 << Layout.BitDepth) - 1;
+		const int32 Scale = 1 << (Layout.BitDepth - 8);
+
+		TArray<uint16> Components;
+		Components.SetNumUninitialized(Layout.NumComponents);
+		for (uint32 Line = 0; Line < InHeight; ++Line)
+		{
+			for (uint32 Index = 0; Index < Layout.NumComponents; ++Index)
+			{
+				const uint32 X = Index / 2;
+				const bool bIsLuma = (Index & 1) != 0;
+				const int32 Edge = ((X / 97 + Line / 61) & 1) ? 40 : 0;
+				const int32 Base = bIsLuma ? 16 + ((X + Line) * 200 / (InWidth + InHeight)) + Edge : 128 + ((Index & 2) ? Edge / 4 : -Edge / 4);
+				const int32 Noise = Random.RandRange(-2, 2);
+				Components[Index] = uint16(FMath::Clamp((Base + Noise) * Scale, 0, MaxValue));
+			}
+			PackLine(Components.GetData(), InPixelFormat, Layout, OutBuffer.GetData() + uint64(Line) * InPitch);
+		}
+	}
+
+	void RunBenchmark(const TArray<FString>& Args)
+	{
+		const uint32 Width = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 6) : 3840;
+		const uint32 Height = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 2160;
+		const EBlackmagicRecordingPixelFormat PixelFormat = (Args.Num() > 2 && FCString::Atoi(*Args[2]) == 8) ? EBlackmagicRecordingPixelFormat::UYVY : EBlackmagicRecordingPixelFormat::V210;
+		const int32 NumIterations = Args.Num() > 3 ? FMath::Max(FCString::Atoi(*Args[3]), 1) : 60;
+		const double TargetFrameRate = 60.0;
+
+		// v210 lines are aligned on 128 bytes by the Blackmagic SDK
+		const uint32 Pitch = PixelFormat == EBlackmagicRecordingPixelFormat::UYVY ? Width * 2 : Align(FMath::DivideAndRoundUp<uint32>(Width, 6) * 16, 128);
+
+		TArray<uint8> Source;
+		BuildBenchmarkFrame(PixelFormat, Width, Height, Pitch, Source);
+
+		TArray<uint8> Compressed;
+		FEncodeBuffers EncodeBuffers;
+		TArray<uint8> Decompressed;
+		Decompressed.SetNumUninitialized(Source.Num());
+
+		// Warm up the workers and the allocator
+		Encode(Source.GetData(), PixelFormat, Width, Height, Pitch, Compressed, EncodeBuffers);
+
+		const double EncodeStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			Encode(Source.GetData(), PixelFormat, Width, Height, Pitch, Compressed, EncodeBuffers);
+		}
+		const double EncodeTime = (FPlatformTime::Seconds() - EncodeStart) / NumIterations;
+
+		bool bDecoded = true;
+		const double DecodeStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < NumIterations; ++Iteration)
+		{
+			bDecoded = Decode(Compressed.GetData(), Compressed.Num(), Decompressed.GetData(), Decompressed.Num()) && bDecoded;
+		}
+		const double DecodeTime = (FPlatformTime::Seconds() - DecodeStart) / NumIterations;
+
+		const bool bIsLossless = bDecoded && FMemory::Memcmp(Source.GetData(), Decompressed.GetData(), Source.Num()) == 0;
+		const double Ratio = double(Source.Num()) / double(FMath::Max(Compressed.Num(), 1));
+		const int32 NumThreads = FBlackmagicMediaJobs::GetNumWorkers() + 1;
+
+		UE_LOG(LogBlackmagicMedia, Display, TEXT("Blackmagic recording codec %dx%d %s on %d threads:"), Width, Height, PixelFormat == EBlackmagicRecordingPixelFormat::UYVY ? TEXT("UYVY") : TEXT("v210"), NumThreads);
+		UE_LOG(LogBlackmagicMedia, Display, TEXT("  Encode %.2f ms (%.1f fps, %.0f MB/s), decode %.2f ms (%.1f fps)."), EncodeTime * 1000.0, 1.0 / EncodeTime, Source.Num() / EncodeTime / (1024.0 * 1024.0), DecodeTime * 1000.0, 1.0 / DecodeTime);
+		UE_LOG(LogBlackmagicMedia, Display, TEXT("  Compression ratio %.2f:1 (%d -> %d bytes). Round trip is %s."), Ratio, Source.Num(), Compressed.Num(), bIsLossless ? TEXT("lossless") : TEXT("CORRUPTED"));
+		UE_LOG(LogBlackmagicMedia, Display, TEXT("  Real-time encode at %.0f fps: %s."), TargetFrameRate, EncodeTime <= 1.0 / TargetFrameRate ? TEXT("yes") : TEXT("no"));
+	}
+}
+
+static FAutoConsoleCommand BlackmagicBenchmarkRecordingCodecCmd(
+	TEXT("Blackmagic.BenchmarkRecordingCodec"),
+	TEXT("Benchmark the lossless recording codec. Arguments: [Width=3840] [Height=2160] [BitDepth=10] [Iterations=60]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BlackmagicMediaRecordingCodecHelpers::RunBenchmark)
+	);
@@ -0,0 +1,60 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicMediaRecording.h"
+
+/**
+ * Lossless intra-frame codec for the recording container, tuned for UYVY and v210.
+ *
+ * Every line is unpacked to its Cb Y Cr Y component sequence, predicted with the median edge detector
+ * (left and above samples of the same component) and the residuals are written with an adaptive Rice coder.
+ * The frame is cut in independent stripes that are encoded and decoded in parallel.
+ * Every frame can be decoded on its own.
+ */
+namespace BlackmagicMediaRecordingCodec
+{
+	static const uint32 FrameMagic = BlackmagicMediaRecording::MakeFourCC('B', 'M', 'C', 'X');
+	static const uint32 FrameVersion = 1;
+
+	struct FCompressedFrameHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		EBlackmagicRecordingPixelFormat PixelFormat;
+		uint32 Width;
+		uint32 Height;
+		uint32 Pitch;
+		uint32 NumStripes;
+		uint32 LinesPerStripe;
+	};
+	static_assert(sizeof(FCompressedFrameHeader) == 32, "The compressed frame header is part of the file format.");
+
+	/** Stripe is stored uncompressed when the entropy coder can't make it smaller */
+	static const uint32 StripeRawFlag = 0x80000000u;
+
+	/** @return true if the pixel format can be compressed */
+	bool IsPixelFormatSupported(EBlackmagicRecordingPixelFormat InPixelFormat);
+
+	/** Buffers of the stripes, kept by the encoder of a recording from one frame to the next */
+	struct FEncodeBuffers
+	{
+		TArray<TArray<uint8>> Stripes;
+		TArray<TArray<uint16>> Components;
+		TArray<bool> StripesIsRaw;
+	};
+
+	/**
+	 * Compress one frame. The stripes are encoded by the Blackmagic job workers, with the Analysis priority.
+	 * @param InOutBuffers	Reused for every frame, they only grow
+	 * @param InNumStripes	Number of independent stripes. 0 to pick one based on the number of worker threads.
+	 */
+	bool Encode(const void* InBuffer, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, uint32 InPitch, TArray<uint8>& OutCompressed, FEncodeBuffers& InOutBuffers, uint32 InNumStripes = 0);
+
+	/** Decompress one frame. OutBuffer must be at least Pitch * Height bytes. Line padding is set to zero. */
+	bool Decode(const uint8* InCompressed, uint64 InCompressedSize, void* OutBuffer, uint64 InBufferSize);
+
+	/** Read the header of a compressed frame. */
+	bool GetFrameInfo(const uint8* InCompressed, uint64 InCompressedSize, FCompressedFrameHeader& OutHeader);
+}
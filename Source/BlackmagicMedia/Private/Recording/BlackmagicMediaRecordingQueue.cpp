@@ -0,0 +1,294 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaRecordingQueue.h"
+
+#include "BlackmagicMediaPrivate.h"
+
+#include "Containers/Queue.h"
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+#include "Stats/Stats2.h"
+
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic Recording Pending frames"), STAT_Blackmagic_Recording_PendingFrames, STATGROUP_Media);
+
+
+namespace BlackmagicMediaRecordingQueueHelpers
+{
+	/** What the recording thread does for a recording */
+	struct FOperation
+	{
+		enum class EType : uint8
+		{
+			Open,
+			Write,
+			Close,
+		};
+
+		EType Type = EType::Write;
+		TSharedPtr<FBlackmagicRecordingQueue, ESPMode::ThreadSafe> Recording;
+		TUniquePtr<FBlackmagicRecordingQueue::FPendingFrame> Frame;
+	};
+
+	void Execute(FOperation& InOperation)
+	{
+		switch (InOperation.Type)
+		{
+		case FOperation::EType::Open:
+			InOperation.Recording->OpenFile();
+			break;
+		case FOperation::EType::Write:
+			InOperation.Recording->WriteFrame(MoveTemp(InOperation.Frame));
+			break;
+		case FOperation::EType::Close:
+			InOperation.Recording->CloseFile();
+			break;
+		}
+	}
+
+	class FRecordingThread : public FRunnable
+	{
+	public:
+		FRecordingThread()
+			: WakeUpEvent(FPlatformProcess::GetSynchEventFromPool(false))
+			, Thread(nullptr)
+			, bStopRequested(false)
+		{
+			Thread = FRunnableThread::Create(this, TEXT("BlackmagicRecording"), 0, TPri_BelowNormal);
+		}
+
+		virtual ~FRecordingThread()
+		{
+			if (Thread)
+			{
+				Thread->Kill(true);
+				delete Thread;
+				Thread = nullptr;
+			}
+			FPlatformProcess::ReturnSynchEventToPool(WakeUpEvent);
+		}
+
+		void Enqueue(FOperation&& InOperation)
+		{
+			Operations.Enqueue(MoveTemp(InOperation));
+			WakeUpEvent->Trigger();
+		}
+
+	private:
+		//~ FRunnable interface
+		virtual uint32 Run() override
+		{
+			while (!bStopRequested)
+			{
+				Drain();
+				WakeUpEvent->Wait();
+			}
+
+			// The recordings still waiting are written before the thread stops
+			Drain();
+			return 0;
+		}
+
+		virtual void Stop() override
+		{
+			bStopRequested = true;
+			WakeUpEvent->Trigger();
+		}
+
+		void Drain()
+		{
+			FOperation Operation;
+			while (Operations.Dequeue(Operation))
+			{
+				Execute(Operation);
+			}
+		}
+
+	private:
+		/** Enqueued by the callbacks of every input */
+		TQueue<FOperation, EQueueMode::Mpsc> Operations;
+		FEvent* WakeUpEvent;
+		FRunnableThread* Thread;
+		TAtomic<bool> bStopRequested;
+	};
+
+	static FCriticalSection RecordingThreadLock;
+	static TUniquePtr<FRecordingThread> RecordingThread;
+	static bool bIsShutDown = false;
+
+	/** Run the operation on the recording thread, started the first time it is used. Runs it now once the thread is shut down. */
+	void Enqueue(FOperation&& InOperation)
+	{
+		{
+			FScopeLock Lock(&RecordingThreadLock);
+			if (!RecordingThread.IsValid() && !bIsShutDown)
+			{
+				RecordingThread = MakeUnique<FRecordingThread>();
+			}
+
+			if (RecordingThread.IsValid())
+			{
+				RecordingThread->Enqueue(MoveTemp(InOperation));
+				return;
+			}
+		}
+
+		Execute(InOperation);
+	}
+}
+
+
+TSharedRef<FBlackmagicRecordingQueue, ESPMode::ThreadSafe> FBlackmagicRecordingQueue::Open(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader, int32 InMaxPendingFrames)
+{
+	using namespace BlackmagicMediaRecordingQueueHelpers;
+
+	TSharedRef<FBlackmagicRecordingQueue, ESPMode::ThreadSafe> Recording = MakeShared<FBlackmagicRecordingQueue, ESPMode::ThreadSafe>(InFilename, InHeader, InMaxPendingFrames);
+
+	FOperation Operation;
+	Operation.Type = FOperation::EType::Open;
+	Operation.Recording = Recording;
+	Enqueue(MoveTemp(Operation));
+
+	return Recording;
+}
+
+void FBlackmagicRecordingQueue::Shutdown()
+{
+	using namespace BlackmagicMediaRecordingQueueHelpers;
+
+	TUniquePtr<FRecordingThread> StoppedThread;
+	{
+		FScopeLock Lock(&RecordingThreadLock);
+		bIsShutDown = true;
+		StoppedThread = MoveTemp(RecordingThread);
+	}
+
+	// Joins the thread once it wrote what was queued
+	StoppedThread.Reset();
+}
+
+FBlackmagicRecordingQueue::FBlackmagicRecordingQueue(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader, int32 InMaxPendingFrames)
+	: Filename(InFilename)
+	, Header(InHeader)
+	, NumAllocatedFrames(0)
+	, MaxPendingFrames(FMath::Max(InMaxPendingFrames, 1))
+	, bHasFailed(false)
+	, bIsClosed(false)
+	, NumSkippedFrames(0)
+{
+}
+
+bool FBlackmagicRecordingQueue::Submit(const FBlackmagicRecordingFrame& InFrame)
+{
+	using namespace BlackmagicMediaRecordingQueueHelpers;
+
+	if (bHasFailed || bIsClosed || InFrame.VideoBuffer == nullptr)
+	{
+		return false;
+	}
+
+	TUniquePtr<FPendingFrame> Frame;
+	{
+		FScopeLock Lock(&FramesLock);
+		if (FreeFrames.Num() > 0)
+		{
+			Frame = FreeFrames.Pop(false);
+		}
+		else if (NumAllocatedFrames < MaxPendingFrames)
+		{
+			Frame = MakeUnique<FPendingFrame>();
+			++NumAllocatedFrames;
+		}
+	}
+
+	if (!Frame.IsValid())
+	{
+		++NumSkippedFrames;
+		return false;
+	}
+
+	// The buffers keep their size, a recording only allocates for its first frames
+	Frame->FrameNumber = InFrame.FrameNumber;
+	Frame->Timecode = InFrame.Timecode;
+	Frame->Video.SetNumUninitialized(InFrame.VideoSize, false);
+	FMemory::Memcpy(Frame->Video.GetData(), InFrame.VideoBuffer, InFrame.VideoSize);
+	Frame->Audio.SetNumUninitialized(InFrame.AudioBuffer ? InFrame.AudioSize : 0, false);
+	if (Frame->Audio.Num() > 0)
+	{
+		FMemory::Memcpy(Frame->Audio.GetData(), InFrame.AudioBuffer, InFrame.AudioSize);
+	}
+	INC_DWORD_STAT(STAT_Blackmagic_Recording_PendingFrames);
+
+	FOperation Operation;
+	Operation.Type = FOperation::EType::Write;
+	Operation.Recording = AsShared();
+	Operation.Frame = MoveTemp(Frame);
+	Enqueue(MoveTemp(Operation));
+	return true;
+}
+
+void FBlackmagicRecordingQueue::Close()
+{
+	using namespace BlackmagicMediaRecordingQueueHelpers;
+
+	bool bExpected = false;
+	if (!bIsClosed.CompareExchange(bExpected, true))
+	{
+		return;
+	}
+
+	FOperation Operation;
+	Operation.Type = FOperation::EType::Close;
+	Operation.Recording = AsShared();
+	Enqueue(MoveTemp(Operation));
+}
+
+void FBlackmagicRecordingQueue::OpenFile()
+{
+	if (!Writer.Open(Filename, Header))
+	{
+		bHasFailed = true;
+	}
+}
+
+void FBlackmagicRecordingQueue::WriteFrame(TUniquePtr<FPendingFrame> InFrame)
+{
+	if (!bHasFailed)
+	{
+		FBlackmagicRecordingFrame Frame;
+		Frame.FrameNumber = InFrame->FrameNumber;
+		Frame.Timecode = InFrame->Timecode;
+		Frame.VideoBuffer = InFrame->Video.GetData();
+		Frame.VideoSize = InFrame->Video.Num();
+		Frame.AudioBuffer = InFrame->Audio.Num() > 0 ? InFrame->Audio.GetData() : nullptr;
+		Frame.AudioSize = InFrame->Audio.Num();
+		if (Writer.WriteFrame(Frame) == EBlackmagicRecordingWriteResult::Failed)
+		{
+			// The frames submitted after are dropped, the file is closed with the frames written so far
+			UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't write frame %lld to the recording file '%s'. The recording is stopped."), Frame.FrameNumber, *Filename);
+			bHasFailed = true;
+			Writer.Close();
+		}
+	}
+
+	DEC_DWORD_STAT(STAT_Blackmagic_Recording_PendingFrames);
+
+	FScopeLock Lock(&FramesLock);
+	FreeFrames.Add(MoveTemp(InFrame));
+}
+
+void FBlackmagicRecordingQueue::CloseFile()
+{
+	Writer.Close();
+
+	if (NumSkippedFrames > 0)
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("%d frames were not recorded to '%s', the disk or the compression was too slow. See Blackmagic.RecordInput.MaxPendingFrames."), int32(NumSkippedFrames), *Filename);
+	}
+
+	FScopeLock Lock(&FramesLock);
+	FreeFrames.Empty();
+}
@@ -0,0 +1,73 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicMediaRecording.h"
+#include "HAL/CriticalSection.h"
+#include "Templates/Atomic.h"
+
+/**
+ * Recording fed by the callback of an input. The thread that receives the frames never waits for the disk or the codec:
+ * the frames are copied in the buffers of a bounded pool and written, compressed when asked, by the recording thread.
+ * When the writes fall behind and every buffer is waiting, the new frames are not recorded.
+ * The recording thread is shared by all the recordings of the process.
+ */
+class FBlackmagicRecordingQueue : public TSharedFromThis<FBlackmagicRecordingQueue, ESPMode::ThreadSafe>
+{
+public:
+	/**
+	 * Create the file on the recording thread.
+	 * @param InMaxPendingFrames	Frames copied and waiting to be written, at most
+	 */
+	static TSharedRef<FBlackmagicRecordingQueue, ESPMode::ThreadSafe> Open(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader, int32 InMaxPendingFrames);
+
+	/** Write the frames of every recording and stop the recording thread. The recordings opened after write on the calling thread. */
+	static void Shutdown();
+
+public:
+	FBlackmagicRecordingQueue(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader, int32 InMaxPendingFrames);
+
+	/**
+	 * Copy the frame and queue its write. Doesn't wait.
+	 * @return false when the frame was not recorded: the file can't be written or every buffer is waiting
+	 */
+	bool Submit(const FBlackmagicRecordingFrame& InFrame);
+
+	/** Write the frames already submitted, then the index, and close the file. Doesn't wait. */
+	void Close();
+
+	const FString& GetFilename() const { return Filename; }
+
+public:
+	/** Frame copied by Submit */
+	struct FPendingFrame
+	{
+		int64 FrameNumber = 0;
+		TOptional<FTimecode> Timecode;
+		TArray<uint8> Video;
+		TArray<uint8> Audio;
+	};
+
+	/** Called by the recording thread */
+	void OpenFile();
+	void WriteFrame(TUniquePtr<FPendingFrame> InFrame);
+	void CloseFile();
+
+private:
+	FString Filename;
+	FBlackmagicRecordingFileHeader Header;
+
+	/** Only used by the recording thread */
+	FBlackmagicRecordingWriter Writer;
+
+	/** Buffers of the frames that are not waiting to be written */
+	FCriticalSection FramesLock;
+	TArray<TUniquePtr<FPendingFrame>> FreeFrames;
+	int32 NumAllocatedFrames;
+	int32 MaxPendingFrames;
+
+	TAtomic<bool> bHasFailed;
+	TAtomic<bool> bIsClosed;
+	TAtomic<int32> NumSkippedFrames;
+};
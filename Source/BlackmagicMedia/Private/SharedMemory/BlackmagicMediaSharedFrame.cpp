@@ -0,0 +1,346 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaSharedFrame.h"
+
+#include "BlackmagicMediaPrivate.h"
+
+#include "HAL/PlatformMisc.h"
+#include "HAL/PlatformProcess.h"
+
+
+namespace BlackmagicMediaSharedFrameHelpers
+{
+	/** Read a value written by another process. The barrier orders the following reads after it. */
+	FORCEINLINE int64 ReadShared(const volatile int64* InValue)
+	{
+		const int64 Value = *InValue;
+		FPlatformMisc::MemoryBarrier();
+		return Value;
+	}
+
+	FORCEINLINE uint8* GetSlot(FBlackmagicSharedFrameRingHeader* InRingHeader, uint32 InNumSlots, uint64 InSlotStride, int64 InSequence)
+	{
+		return reinterpret_cast<uint8*>(InRingHeader) + BlackmagicMediaSharedFrame::PageAlignment + (InSequence % InNumSlots) * InSlotStride;
+	}
+
+	FORCEINLINE const uint8* GetSlot(const FBlackmagicSharedFrameRingHeader* InRingHeader, uint32 InNumSlots, uint64 InSlotStride, int64 InSequence)
+	{
+		return GetSlot(const_cast<FBlackmagicSharedFrameRingHeader*>(InRingHeader), InNumSlots, InSlotStride, InSequence);
+	}
+
+	FORCEINLINE uint64 GetRegionSize(uint32 InNumSlots, uint64 InSlotStride)
+	{
+		return BlackmagicMediaSharedFrame::PageAlignment + InNumSlots * InSlotStride;
+	}
+}
+
+/* FBlackmagicSharedFrameWriter
+*****************************************************************************/
+
+FBlackmagicSharedFrameWriter::FBlackmagicSharedFrameWriter()
+	: Region(nullptr)
+	, RingHeader(nullptr)
+	, NextSequence(0)
+{
+}
+
+FBlackmagicSharedFrameWriter::~FBlackmagicSharedFrameWriter()
+{
+	Close();
+}
+
+bool FBlackmagicSharedFrameWriter::Open(const FString& InName, uint32 InNumSlots, uint64 InSlotCapacity)
+{
+	Close();
+
+	const uint32 NumSlots = FMath::Clamp(InNumSlots, BlackmagicMediaSharedFrame::MinNumSlots, BlackmagicMediaSharedFrame::MaxNumSlots);
+	const uint64 SlotStride = BlackmagicMediaSharedFrame::PageAlignment + Align(InSlotCapacity, (uint64)BlackmagicMediaSharedFrame::PageAlignment);
+	const uint64 RegionSize = BlackmagicMediaSharedFrameHelpers::GetRegionSize(NumSlots, SlotStride);
+
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(InName, true, FPlatformMemory::ESharedMemoryAccess::Read | FPlatformMemory::ESharedMemoryAccess::Write, RegionSize);
+	if (Region == nullptr)
+	{
+		UE_LOG(LogBlackmagicMedia, Error, TEXT("Can't create the shared memory region '%s' (%llu bytes)."), *InName, RegionSize);
+		return false;
+	}
+
+	Name = InName;
+	NextSequence = 0;
+	RingHeader = reinterpret_cast<FBlackmagicSharedFrameRingHeader*>(Region->GetAddress());
+
+	// A reader may still have the region of a previous producer mapped. Invalidate every slot before changing the layout.
+	FPlatformAtomics::InterlockedExchange(&RingHeader->NumPublished, 0);
+	FMemory::Memzero(RingHeader, BlackmagicMediaSharedFrame::PageAlignment);
+	RingHeader->Magic = BlackmagicMediaSharedFrame::RingMagic;
+	RingHeader->Version = BlackmagicMediaSharedFrame::RingVersion;
+	RingHeader->HeaderSize = BlackmagicMediaSharedFrame::PageAlignment;
+	RingHeader->NumSlots = NumSlots;
+	RingHeader->SlotStride = SlotStride;
+	RingHeader->SlotCapacity = SlotStride - BlackmagicMediaSharedFrame::PageAlignment;
+	RingHeader->ProducerProcessId = FPlatformProcess::GetCurrentProcessId();
+
+	for (uint32 SlotIndex = 0; SlotIndex < NumSlots; ++SlotIndex)
+	{
+		FMemory::Memzero(BlackmagicMediaSharedFrameHelpers::GetSlot(RingHeader, NumSlots, SlotStride, SlotIndex), sizeof(FBlackmagicSharedFrameSlotHeader));
+	}
+	FPlatformMisc::MemoryBarrier();
+
+	UE_LOG(LogBlackmagicMedia, Log, TEXT("Exporting frames to the shared memory region '%s' (%u slots of %llu bytes)."), *Name, NumSlots, RingHeader->SlotCapacity);
+	return true;
+}
+
+void FBlackmagicSharedFrameWriter::Close()
+{
+	if (Region)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		Region = nullptr;
+		RingHeader = nullptr;
+	}
+}
+
+bool FBlackmagicSharedFrameWriter::Publish(const FBlackmagicSharedFrame& InFrame)
+{
+	if (RingHeader == nullptr || InFrame.VideoBuffer == nullptr || InFrame.VideoSize > RingHeader->SlotCapacity)
+	{
+		return false;
+	}
+
+	const int64 Sequence = NextSequence++;
+	uint8* Slot = BlackmagicMediaSharedFrameHelpers::GetSlot(RingHeader, RingHeader->NumSlots, RingHeader->SlotStride, Sequence);
+	FBlackmagicSharedFrameSlotHeader* SlotHeader = reinterpret_cast<FBlackmagicSharedFrameSlotHeader*>(Slot);
+
+	// Readers that are still using the previous frame of that slot will see the odd sequence and discard it
+	FPlatformAtomics::InterlockedExchange(&SlotHeader->Sequence, Sequence * 2 + 1);
+
+	FMemory::Memcpy(Slot + BlackmagicMediaSharedFrame::PageAlignment, InFrame.VideoBuffer, InFrame.VideoSize);
+
+	SlotHeader->FrameNumber = InFrame.FrameNumber;
+	SlotHeader->VideoSize = InFrame.VideoSize;
+	SlotHeader->PixelFormat = InFrame.PixelFormat;
+	SlotHeader->Width = InFrame.Width;
+	SlotHeader->Height = InFrame.Height;
+	SlotHeader->Pitch = InFrame.Pitch;
+	SlotHeader->FrameRateNumerator = InFrame.FrameRate.Numerator;
+	SlotHeader->FrameRateDenominator = InFrame.FrameRate.Denominator;
+	SlotHeader->Flags = InFrame.bIsInterlaced ? FBlackmagicSharedFrameSlotHeader::IsInterlaced : 0;
+	if (InFrame.Timecode.IsSet())
+	{
+		SlotHeader->Timecode = FBlackmagicRecordingTimecode::FromTimecode(InFrame.Timecode.GetValue());
+		SlotHeader->Flags |= FBlackmagicSharedFrameSlotHeader::HasTimecode;
+	}
+
+	FPlatformAtomics::InterlockedExchange(&SlotHeader->Sequence, BlackmagicMediaSharedFrame::PublishedSlotSequence(Sequence));
+	FPlatformAtomics::InterlockedExchange(&RingHeader->NumPublished, Sequence + 1);
+	return true;
+}
+
+/* FBlackmagicSharedFrameReader
+*****************************************************************************/
+
+FBlackmagicSharedFrameReader::FBlackmagicSharedFrameReader()
+	: Region(nullptr)
+	, RingHeader(nullptr)
+	, NumSlots(0)
+	, SlotStride(0)
+	, SlotCapacity(0)
+	, LastAcquiredSequence(INDEX_NONE)
+	, NumSkippedFrames(0)
+{
+}
+
+FBlackmagicSharedFrameReader::~FBlackmagicSharedFrameReader()
+{
+	Close();
+}
+
+bool FBlackmagicSharedFrameReader::Open(const FString& InName)
+{
+	Close();
+
+	// Map the header first to know the size of the ring
+	FPlatformMemory::FSharedMemoryRegion* HeaderRegion = FPlatformMemory::MapNamedSharedMemoryRegion(InName, false, FPlatformMemory::ESharedMemoryAccess::Read, BlackmagicMediaSharedFrame::PageAlignment);
+	if (HeaderRegion == nullptr)
+	{
+		return false;
+	}
+
+	const FBlackmagicSharedFrameRingHeader Header = *reinterpret_cast<const FBlackmagicSharedFrameRingHeader*>(HeaderRegion->GetAddress());
+	FPlatformMemory::UnmapNamedSharedMemoryRegion(HeaderRegion);
+
+	if (Header.Magic != BlackmagicMediaSharedFrame::RingMagic
+		|| Header.Version != BlackmagicMediaSharedFrame::RingVersion
+		|| Header.HeaderSize != BlackmagicMediaSharedFrame::PageAlignment
+		|| Header.NumSlots < BlackmagicMediaSharedFrame::MinNumSlots
+		|| Header.NumSlots > BlackmagicMediaSharedFrame::MaxNumSlots
+		|| Header.SlotStride <= BlackmagicMediaSharedFrame::PageAlignment
+		|| Header.SlotCapacity != Header.SlotStride - BlackmagicMediaSharedFrame::PageAlignment)
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("The shared memory region '%s' is not a Blackmagic frame ring."), *InName);
+		return false;
+	}
+
+	Region = FPlatformMemory::MapNamedSharedMemoryRegion(InName, false, FPlatformMemory::ESharedMemoryAccess::Read, BlackmagicMediaSharedFrameHelpers::GetRegionSize(Header.NumSlots, Header.SlotStride));
+	if (Region == nullptr)
+	{
+		UE_LOG(LogBlackmagicMedia, Warning, TEXT("Can't map the shared memory region '%s'."), *InName);
+		return false;
+	}
+
+	Name = InName;
+	RingHeader = reinterpret_cast<const FBlackmagicSharedFrameRingHeader*>(Region->GetAddress());
+	NumSlots = Header.NumSlots;
+	SlotStride = Header.SlotStride;
+	SlotCapacity = Header.SlotCapacity;
+	LastAcquiredSequence = INDEX_NONE;
+	NumSkippedFrames = 0;
+	return true;
+}
+
+void FBlackmagicSharedFrameReader::Close()
+{
+	if (Region)
+	{
+		FPlatformMemory::UnmapNamedSharedMemoryRegion(Region);
+		Region = nullptr;
+		RingHeader = nullptr;
+		NumSlots = 0;
+		SlotStride = 0;
+		SlotCapacity = 0;
+	}
+}
+
+bool FBlackmagicSharedFrameReader::CheckLayout()
+{
+	if (RingHeader == nullptr)
+	{
+		return false;
+	}
+
+	// A restarted producer clears and rewrites the header while this reader still has the previous mapping.
+	// The mapping only covers the layout validated in Open, so any change means the ring must be mapped again.
+	const volatile FBlackmagicSharedFrameRingHeader* LiveHeader = RingHeader;
+	if (LiveHeader->Magic != BlackmagicMediaSharedFrame::RingMagic || LiveHeader->NumSlots != NumSlots || LiveHeader->SlotStride != SlotStride)
+	{
+		UE_LOG(LogBlackmagicMedia, Log, TEXT("The producer of the shared memory region '%s' restarted. The region will be mapped again."), *Name);
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool FBlackmagicSharedFrameReader::AcquireLatest(FBlackmagicSharedFrame& OutFrame, int64& OutSequence)
+{
+	if (!CheckLayout())
+	{
+		return false;
+	}
+
+	const int64 NumPublished = BlackmagicMediaSharedFrameHelpers::ReadShared(&RingHeader->NumPublished);
+	const int64 Sequence = NumPublished - 1;
+	if (Sequence < 0 || Sequence == LastAcquiredSequence)
+	{
+		return false;
+	}
+
+	if (Sequence < LastAcquiredSequence)
+	{
+		// The producer restarted
+		LastAcquiredSequence = INDEX_NONE;
+	}
+
+	if (!ReadSlot(Sequence, OutFrame))
+	{
+		return false;
+	}
+
+	if (LastAcquiredSequence != INDEX_NONE)
+	{
+		NumSkippedFrames += Sequence - LastAcquiredSequence - 1;
+	}
+	LastAcquiredSequence = Sequence;
+	OutSequence = Sequence;
+	return true;
+}
+
+bool FBlackmagicSharedFrameReader::AcquireFrameNumber(int64 InFrameNumber, FBlackmagicSharedFrame& OutFrame, int64& OutSequence)
+{
+	if (!CheckLayout())
+	{
+		return false;
+	}
+
+	// Frame numbers only go up, walk the ring from the newest frame
+	const int64 NumPublished = BlackmagicMediaSharedFrameHelpers::ReadShared(&RingHeader->NumPublished);
+	const int64 OldestSequence = FMath::Max<int64>(NumPublished - int64(NumSlots), 0);
+	for (int64 Sequence = NumPublished - 1; Sequence >= OldestSequence; --Sequence)
+	{
+		if (!ReadSlot(Sequence, OutFrame) || OutFrame.FrameNumber < InFrameNumber)
+		{
+			return false;
+		}
+
+		if (OutFrame.FrameNumber == InFrameNumber)
+		{
+			OutSequence = Sequence;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool FBlackmagicSharedFrameReader::IsStillValid(int64 InSequence) const
+{
+	if (RingHeader == nullptr)
+	{
+		return false;
+	}
+
+	FPlatformMisc::MemoryBarrier();
+	const FBlackmagicSharedFrameSlotHeader* SlotHeader = reinterpret_cast<const FBlackmagicSharedFrameSlotHeader*>(BlackmagicMediaSharedFrameHelpers::GetSlot(RingHeader, NumSlots, SlotStride, InSequence));
+	return BlackmagicMediaSharedFrameHelpers::ReadShared(&SlotHeader->Sequence) == BlackmagicMediaSharedFrame::PublishedSlotSequence(InSequence);
+}
+
+bool FBlackmagicSharedFrameReader::CopyLatest(FBlackmagicSharedFrame& OutFrame, TArray<uint8>& OutBuffer)
+{
+	int64 Sequence = 0;
+	if (!AcquireLatest(OutFrame, Sequence))
+	{
+		return false;
+	}
+
+	OutBuffer.SetNumUninitialized(OutFrame.VideoSize);
+	FMemory::Memcpy(OutBuffer.GetData(), OutFrame.VideoBuffer, OutFrame.VideoSize);
+	OutFrame.VideoBuffer = OutBuffer.GetData();
+	return IsStillValid(Sequence);
+}
+
+bool FBlackmagicSharedFrameReader::ReadSlot(int64 InSequence, FBlackmagicSharedFrame& OutFrame) const
+{
+	const uint8* Slot = BlackmagicMediaSharedFrameHelpers::GetSlot(RingHeader, NumSlots, SlotStride, InSequence);
+	const FBlackmagicSharedFrameSlotHeader* SlotHeader = reinterpret_cast<const FBlackmagicSharedFrameSlotHeader*>(Slot);
+	if (BlackmagicMediaSharedFrameHelpers::ReadShared(&SlotHeader->Sequence) != BlackmagicMediaSharedFrame::PublishedSlotSequence(InSequence))
+	{
+		return false;
+	}
+
+	OutFrame.FrameNumber = SlotHeader->FrameNumber;
+	OutFrame.PixelFormat = SlotHeader->PixelFormat;
+	OutFrame.Width = SlotHeader->Width;
+	OutFrame.Height = SlotHeader->Height;
+	OutFrame.Pitch = SlotHeader->Pitch;
+	OutFrame.FrameRate = FFrameRate(SlotHeader->FrameRateNumerator, SlotHeader->FrameRateDenominator);
+	OutFrame.bIsInterlaced = (SlotHeader->Flags & FBlackmagicSharedFrameSlotHeader::IsInterlaced) != 0;
+	OutFrame.Timecode.Reset();
+	if (SlotHeader->Flags & FBlackmagicSharedFrameSlotHeader::HasTimecode)
+	{
+		OutFrame.Timecode = SlotHeader->Timecode.ToTimecode();
+	}
+	OutFrame.VideoBuffer = Slot + BlackmagicMediaSharedFrame::PageAlignment;
+	OutFrame.VideoSize = FMath::Min(SlotHeader->VideoSize, SlotCapacity);
+
+	// The header fields are only meaningful if the producer didn't start to reuse the slot while they were read
+	return IsStillValid(InSequence);
+}
@@ -20,7 +20,48 @@ enum class EBlackmagicMediaTimecodeFormat : uint8
 };
 
 /**
- * Implementation of IMediaIOCoreDeviceProvider for Blackmagic
+ * A video mode of a device, as found by the last scan.
+ */
+struct FBlackmagicDeviceMode
+{
+	FMediaIOMode Mode;
+	bool bIs2K = false;
+	bool bIs4K = false;
+};
+
+/**
+ * What a device can do, as found by the last scan.
+ */
+struct FBlackmagicDeviceCapabilities
+{
+	FMediaIODevice Device;
+	bool bIsSupported = false;
+	bool bCanDoCapture = false;
+	bool bCanDoPlayback = false;
+	bool bCanDoDualLink = false;
+	bool bCanDoQuadLink = false;
+	bool bCanDoQuadSquareLink = false;
+	bool bHasGenlockReferenceInput = false;
+	bool bSupportExternalKeying = false;
+
+	/** The sub-devices of a card share its group, each one is a device of its own */
+	int32 NumberOfSubDevices = 1;
+	int32 SubDeviceIndex = 0;
+	uint32 DeviceGroupId = 0;
+
+	/** Valid modes, only filled for supported devices */
+	TArray<FBlackmagicDeviceMode> InputModes;
+	TArray<FBlackmagicDeviceMode> OutputModes;
+};
+
+using FBlackmagicDeviceCapabilitiesListRef = TSharedRef<const TArray<FBlackmagicDeviceCapabilities>, ESPMode::ThreadSafe>;
+
+/**
+ * Implementation of IMediaIOCoreDeviceProvider for Blackmagic.
+ * The devices and their modes come from a cache filled in the background when the module starts, the hardware is never scanned by the callers.
+ * The saved scan is loaded in the background too: the lists never touch the disk.
+ * The cache is only scanned again on request: RequestScan, or the Blackmagic.ScanDevices command.
+ * Every scan is saved in Saved/Blackmagic. Without a card or a driver, the cache is the last saved scan.
  */
 class BLACKMAGICMEDIA_API FBlackmagicDeviceProvider : public IMediaIOCoreDeviceProvider
 {
@@ -28,6 +69,32 @@ public:
 	static FName GetProviderName();
 	static FName GetProtocolName();
 
+	/** The devices found by the last scan, or the saved ones. Never scans, loads nor waits: empty until the first scan or the load completes. */
+	static FBlackmagicDeviceCapabilitiesListRef GetCachedDevices();
+
+	/** Copy the cached capabilities of a device. Never scans nor waits. */
+	static bool FindCachedDevice(int32 InDeviceIdentifier, FBlackmagicDeviceCapabilities& OutCapabilities);
+
+	/** Query a device now, without the cache. Slow, the device is opened by the library. */
+	static bool ScanDevice(int32 InDeviceIdentifier, FBlackmagicDeviceCapabilities& OutCapabilities);
+
+	/** Start a scan in the background, unless one is already running */
+	static void RequestScan();
+
+	/** Wait for the running scan, if any, and for the load of the saved one */
+	static void WaitForScan();
+
+	/**
+	 * Wait until the cache can be used to validate: the saved scan is loaded and, in a game, the first scan completed.
+	 * Only waits the first time, for the callers that need the list rather than whatever was found so far.
+	 */
+	static void WaitForDevices();
+
+	static bool IsScanning();
+
+	/** Whether a scan completed since the module started */
+	static bool HasScanned();
+
 public:
 	virtual FName GetFName() override;
 
@@ -0,0 +1,25 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+
+/**
+ * Driver calls that open and close the channels of the devices.
+ * They can take tens of milliseconds, so they run on a background thread instead of the game and rendering threads.
+ * The tasks run one at a time in the order they were enqueued, a channel is always closed before it is opened again.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaChannelTasks
+{
+public:
+	/**
+	 * Run the task after the tasks enqueued before it.
+	 * The task owns what it uses: the callbacks it opens or closes hold a reference until it is done.
+	 * @return Completion of the task
+	 */
+	static TSharedFuture<void> Enqueue(TUniqueFunction<void()> InTask);
+
+	/** Wait for all the enqueued tasks. Called before the library shuts down. */
+	static void Flush();
+};
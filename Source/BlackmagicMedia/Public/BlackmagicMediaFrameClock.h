@@ -0,0 +1,70 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Estimates when the device captured or scanned out a frame, on the host clock, from the frame counter of the device.
+ * The library only tells when a callback runs, which includes the scheduling jitter of the host. The frames are one frame
+ * interval apart on the device clock, so the arrival times of the last frames are fitted to a line of the frame number.
+ * The line is moved down to the earliest arrival, the one that waited the least, and its slope follows the drift between
+ * the device and host clocks. A frame counter that goes back or jumps restarts the estimation.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaFrameClock
+{
+public:
+	/** Frames used for the fit */
+	static const int32 MaxNumPoints = 120;
+
+public:
+	FBlackmagicMediaFrameClock();
+
+	/** Forget the previous frames. @param InFrameInterval Seconds between two frames */
+	void Reset(double InFrameInterval);
+
+	/**
+	 * Add the arrival of a frame and estimate when the device handled it. The estimate is never later than the arrival.
+	 * @param InHostTime	Seconds, on the host clock, when the callback of the frame ran
+	 * @return Estimated seconds of the frame on the host clock
+	 */
+	double Correlate(int64 InFrameNumber, double InHostTime);
+
+	/** Estimate of a frame number that didn't arrive yet, from the current fit. Only valid after Correlate. */
+	double Predict(int64 InFrameNumber) const;
+
+	/** Average seconds between the estimates and the arrivals */
+	double GetAverageDelay() const { return AverageDelay; }
+
+	/** Seconds between two frames on the host clock, as measured */
+	double GetMeasuredFrameInterval() const { return Slope; }
+
+	bool IsValid() const { return NumPoints > 0; }
+
+private:
+	void Fit();
+
+private:
+	struct FPoint
+	{
+		double Frame;
+		double Time;
+	};
+
+	double FrameInterval;
+
+	/** Frames and times are relative to the first frame, to keep the precision */
+	int64 OriginFrame;
+	double OriginTime;
+	int64 LastFrame;
+	double LastTime;
+
+	FPoint Points[MaxNumPoints];
+	int32 FirstPoint;
+	int32 NumPoints;
+
+	/** Time = OriginTime + Offset + Slope * (Frame - OriginFrame) */
+	double Slope;
+	double Offset;
+	double AverageDelay;
+};
@@ -0,0 +1,55 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Templates/Function.h"
+
+/**
+ * Order in which the workers take the jobs. A worker always takes the most urgent job waiting, whatever its channel.
+ */
+enum class EBlackmagicJobPriority : uint8
+{
+	/** Work the clock of the engine waits for */
+	Genlock,
+	/** Frames sent to an output */
+	Output,
+	/** Frames of the inputs used by the program */
+	Input,
+	/** Monitoring and analysis: proxies, pixel taps, multiviewer */
+	Analysis,
+
+	Num,
+};
+
+/**
+ * Workers shared by every channel and every processing stage of the plugin.
+ * There is one worker per core left by the game and rendering threads, however many channels are opened, so the stages
+ * of a node with many inputs don't oversubscribe the machine. Every worker has its own queue of each priority; a worker
+ * without a job steals the most urgent job of the others. Within a priority, the jobs with the earliest deadline run first.
+ * The time spent by each stage and the jobs that completed after their deadline are reported by Blackmagic.Jobs.Stats.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaJobs
+{
+public:
+	/**
+	 * Run a job on a worker.
+	 * @param InStage		Name of the processing stage, for the statistics
+	 * @param InDeadline	FPlatformTime::Seconds the job is expected to complete by, 0 when it has no deadline. A late job still runs.
+	 * @return Completion of the job
+	 */
+	static TFuture<void> Launch(EBlackmagicJobPriority InPriority, FName InStage, TUniqueFunction<void()> InJob, double InDeadline = 0.0);
+
+	/**
+	 * Call InBody for every index from 0 to InNum - 1, split between the calling thread and the workers.
+	 * Returns once every index is done. Can be called from a job.
+	 */
+	static void ParallelFor(EBlackmagicJobPriority InPriority, FName InStage, int32 InNum, TFunctionRef<void(int32)> InBody);
+
+	/** Number of workers. The workers start the first time the jobs are used. */
+	static int32 GetNumWorkers();
+
+	/** Run the waiting jobs and stop the workers. The jobs launched after run on the calling thread. */
+	static void Shutdown();
+};
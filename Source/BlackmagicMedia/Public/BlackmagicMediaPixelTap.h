@@ -0,0 +1,113 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicMediaRecording.h"
+#include "Async/Future.h"
+#include "Templates/Atomic.h"
+
+class FMediaIOCoreTextureSampleBase;
+
+/**
+ * Pixel formats of the frames given to the CPU consumers.
+ */
+enum class EBlackmagicPixelTapFormat : uint8
+{
+	/** 8 bits luma, video range */
+	Gray8,
+	/** 8 bits R, G, B triplets, full range (Rec. 709) */
+	RGB8,
+	/** 8 bits 4:2:2 Cb Y0 Cr Y1, like the 8bit input */
+	UYVY,
+};
+
+/**
+ * An input frame converted for the CPU consumers. Never modified once delivered, subscribers share it by reference.
+ */
+struct BLACKMAGICMEDIA_API FBlackmagicPixelTapFrame
+{
+	EBlackmagicPixelTapFormat Format = EBlackmagicPixelTapFormat::UYVY;
+	uint32 Width = 0;
+	uint32 Height = 0;
+	uint32 Pitch = 0;
+	int64 FrameNumber = 0;
+	TOptional<FTimecode> Timecode;
+	TArray<uint8> Buffer;
+};
+
+using FBlackmagicPixelTapFramePtr = TSharedPtr<const FBlackmagicPixelTapFrame, ESPMode::ThreadSafe>;
+
+DECLARE_DELEGATE_OneParam(FOnBlackmagicPixelTapFrame, const FBlackmagicPixelTapFramePtr& /*Frame*/);
+
+/**
+ * Frames a consumer subscribes to.
+ */
+struct FBlackmagicPixelTapRequest
+{
+	/** Device of the input, as in the media source configuration */
+	int32 DeviceIndex = 0;
+
+	EBlackmagicPixelTapFormat Format = EBlackmagicPixelTapFormat::Gray8;
+
+	/** Size of the delivered frames, 0 keeps the size of the input. Frames are resampled to the nearest pixel, UYVY widths are even. */
+	FIntPoint Resolution = FIntPoint::ZeroValue;
+};
+
+/**
+ * CPU access to the frames of the inputs opened by the players of this process, for computer vision consumers.
+ * Every frame is converted once per requested format and resolution on a worker thread, and the result is shared by
+ * all the subscribers that asked for it. Each subscriber is called on its own worker; a subscriber that is still
+ * busy with a frame only gets the latest frame afterwards, the frames in between are skipped for it.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaPixelTap
+{
+public:
+	/**
+	 * Start receiving the frames of an input. The input doesn't need to be opened yet.
+	 * The delegate is called from a thread pool worker, never concurrently for the same subscription.
+	 * @return The subscription, to give to Unsubscribe
+	 */
+	static int32 Subscribe(const FBlackmagicPixelTapRequest& InRequest, const FOnBlackmagicPixelTapFrame& InDelegate);
+
+	/** Stop a subscription. Once it returns, the delegate is not called anymore. */
+	static void Unsubscribe(int32 InSubscriptionId);
+
+	/**
+	 * Convert a frame on the calling thread.
+	 * @param InResolution	Size of the converted frame, 0 keeps the size of the input
+	 * @return false if the pixel format can't be converted
+	 */
+	static bool Convert(const uint8* InBuffer, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, uint32 InPitch, EBlackmagicPixelTapFormat InFormat, FIntPoint InResolution, FBlackmagicPixelTapFrame& OutFrame);
+
+public:
+	/** Tap of the input of a player */
+	FBlackmagicMediaPixelTap(int32 InDeviceIndex);
+	~FBlackmagicMediaPixelTap();
+
+	FBlackmagicMediaPixelTap(const FBlackmagicMediaPixelTap&) = delete;
+	FBlackmagicMediaPixelTap& operator=(const FBlackmagicMediaPixelTap&) = delete;
+
+	/**
+	 * Convert the sample for the subscribers of the input, on a worker. The sample is kept alive until the worker is done with it.
+	 * Does nothing when nobody subscribed. A sample submitted while the worker is busy is skipped.
+	 * @param InWidth	Width in pixels
+	 */
+	void Submit(const TSharedRef<FMediaIOCoreTextureSampleBase, ESPMode::ThreadSafe>& InSample, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, int64 InFrameNumber);
+
+	/** Whether the input has subscribers. The player only submits its frames when it does, and is told when the subscriptions change. */
+	bool HasSubscribers() const;
+
+private:
+	TSharedPtr<FBlackmagicPixelTapFrame, ESPMode::ThreadSafe> AcquireFrame();
+
+private:
+	int32 DeviceIndex;
+	int32 NumSkippedFrames;
+
+	/** Frames are reused once no subscriber references them anymore. Only used by the worker. */
+	TArray<TSharedPtr<FBlackmagicPixelTapFrame, ESPMode::ThreadSafe>> FramePool;
+
+	TAtomic<bool> bIsWorkerBusy;
+	TFuture<void> WorkerResult;
+};
@@ -0,0 +1,104 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MediaIOCoreDefinitions.h"
+#include "UObject/Object.h"
+
+#include "BlackmagicMediaPresets.generated.h"
+
+/**
+ * A port of a preset.
+ */
+USTRUCT()
+struct BLACKMAGICMEDIA_API FBlackmagicMediaPresetPort
+{
+	GENERATED_BODY()
+
+	FBlackmagicMediaPresetPort();
+
+	/** Device of the port, as in the configuration of the sources and outputs. */
+	UPROPERTY(config)
+	int32 DeviceIndex;
+
+	UPROPERTY(config)
+	bool bIsInput;
+
+	/** Video format of the Blackmagic SDK, the mode identifier of the configuration. */
+	UPROPERTY(config)
+	int32 VideoFormat;
+
+	/** 10bit YUV instead of 8bit YUV. */
+	UPROPERTY(config)
+	bool b10Bit;
+
+	UPROPERTY(config)
+	EMediaIOTimecodeFormat TimecodeFormat;
+
+	/** Outputs only. */
+	UPROPERTY(config)
+	EMediaIOOutputType OutputType;
+
+	/** Outputs only. */
+	UPROPERTY(config)
+	EMediaIOReferenceType OutputReference;
+
+	/** Outputs only, the inputs detect it. */
+	UPROPERTY(config)
+	EMediaIOTransportType TransportType;
+
+	/** Outputs only. */
+	UPROPERTY(config)
+	EMediaIOQuadLinkTransportType QuadTransportType;
+};
+
+/**
+ * Named configuration of the ports of a show.
+ */
+USTRUCT()
+struct BLACKMAGICMEDIA_API FBlackmagicMediaPreset
+{
+	GENERATED_BODY()
+
+	UPROPERTY(config)
+	FName Name;
+
+	UPROPERTY(config)
+	TArray<FBlackmagicMediaPresetPort> Ports;
+};
+
+/**
+ * Presets of the Blackmagic ports, read from the [/Script/BlackmagicMedia.BlackmagicMediaPresets] section of DefaultBlackmagicMedia.ini.
+ * The presets are validated once against the devices, the first time one is used. The sources and the outputs that take their
+ * configuration from a valid preset are then validated without scanning the hardware again.
+ */
+UCLASS(config=BlackmagicMedia)
+class BLACKMAGICMEDIA_API UBlackmagicMediaPresets : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(config)
+	TArray<FBlackmagicMediaPreset> Presets;
+
+public:
+	/** Names of the presets, valid or not */
+	static TArray<FName> GetPresetNames();
+
+	/** Number of ports of a preset, 0 when the preset doesn't exist */
+	static int32 GetNumPorts(FName InPresetName);
+
+	/**
+	 * The configuration of a port, with the mode and the name of the device found by the validation.
+	 * @return false when the preset or the port doesn't exist or when the port isn't valid
+	 */
+	static bool GetPortConfiguration(FName InPresetName, int32 InPortIndex, FBlackmagicMediaPresetPort& OutPort, FMediaIOOutputConfiguration& OutConfiguration, FString& OutFailureReason);
+
+	/** Whether a configuration is the one of a valid port of a preset, already validated against the devices */
+	static bool IsValidatedConfiguration(const FMediaIOConfiguration& InConfiguration);
+	static bool IsValidatedConfiguration(const FMediaIOOutputConfiguration& InConfiguration);
+
+	/** Read the ini and validate the presets again, after the hardware or the ini changed */
+	static void Reload();
+};
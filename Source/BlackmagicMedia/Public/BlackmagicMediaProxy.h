@@ -0,0 +1,151 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicMediaRecording.h"
+#include "Async/Future.h"
+#include "Templates/Atomic.h"
+#include "UObject/GCObject.h"
+
+class FMediaIOCoreTextureSampleBase;
+class UTexture2D;
+struct FBlackmagicMediaSourceSettings;
+
+/**
+ * Reduced versions of the input frames, for previews and monitoring.
+ * Every level is 8 bits 4:2:2 UYVY, whatever the pixel format of the input.
+ */
+namespace BlackmagicMediaProxy
+{
+	/** Level 0 is 1/2 of the input resolution, level 1 is 1/4, level 2 is 1/8 and level 3 is 1/16 */
+	static const int32 NumLevels = 4;
+}
+
+struct FBlackmagicMediaProxyLevel
+{
+	uint32 Width = 0;
+	uint32 Height = 0;
+	uint32 Pitch = 0;
+	TArray<uint8> Buffer;
+};
+
+/**
+ * A set of reduced pictures of one input frame. Never modified once published, consumers share it by reference.
+ */
+struct BLACKMAGICMEDIA_API FBlackmagicMediaProxyFrame
+{
+	int64 FrameNumber = 0;
+	TOptional<FTimecode> Timecode;
+	FBlackmagicMediaProxyLevel Levels[BlackmagicMediaProxy::NumLevels];
+
+	/** Convert a level to 8 bits BGRA (Rec. 709, video range to full range). */
+	void ConvertToBGRA(int32 InLevel, TArray<FColor>& OutPixels) const;
+};
+
+using FBlackmagicMediaProxyFramePtr = TSharedPtr<const FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>;
+
+/**
+ * Produce the proxy pyramid of an input on a worker thread.
+ * Frames are submitted at the input rate, one every FrameDivider is reduced. A frame submitted while the worker is busy is skipped.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaProxyGenerator
+{
+public:
+	FBlackmagicMediaProxyGenerator(int32 InDeviceIndex, int32 InFrameDivider);
+	~FBlackmagicMediaProxyGenerator();
+
+	FBlackmagicMediaProxyGenerator(const FBlackmagicMediaProxyGenerator&) = delete;
+	FBlackmagicMediaProxyGenerator& operator=(const FBlackmagicMediaProxyGenerator&) = delete;
+
+	/**
+	 * Reduce the sample on the worker. The sample is kept alive until the worker is done with it.
+	 * @param bInIsField	The sample holds a single field, its lines are not reduced for the first level
+	 */
+	void Submit(const TSharedRef<FMediaIOCoreTextureSampleBase, ESPMode::ThreadSafe>& InSample, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, bool bInIsField, int64 InFrameNumber);
+
+	/** Most recent proxy of the input, may be null */
+	FBlackmagicMediaProxyFramePtr GetLatestFrame() const;
+
+	/**
+	 * Most recent proxy of the input of a device opened by a player of this process, may be null.
+	 * When several players generate proxies of the device, the oldest generator that produced a frame is used.
+	 */
+	static FBlackmagicMediaProxyFramePtr GetLatestFrame(int32 InDeviceIndex);
+
+	/**
+	 * Reduce a frame on the calling thread.
+	 * @return false if the pixel format can't be reduced
+	 */
+	static bool Generate(const uint8* InBuffer, EBlackmagicRecordingPixelFormat InPixelFormat, uint32 InWidth, uint32 InHeight, uint32 InPitch, bool bInIsField, FBlackmagicMediaProxyFrame& OutFrame);
+
+private:
+	TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> AcquireFrame();
+	void Publish(const TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>& InFrame);
+
+private:
+	int32 DeviceIndex;
+	int32 FrameDivider;
+	int64 NumSubmittedFrames;
+
+	/** Frames are reused once no consumer references them anymore */
+	TArray<TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>> FramePool;
+
+	mutable FCriticalSection LatestLock;
+	FBlackmagicMediaProxyFramePtr LatestFrame;
+
+	TAtomic<bool> bIsWorkerBusy;
+	TFuture<void> WorkerResult;
+};
+
+/**
+ * Low rate proxies of the inputs, for the previews of the editor, without a player.
+ * The subscribers of an input share one video only channel. Every Blackmagic.PreviewInterval seconds, one field of a frame
+ * is copied on the thread of the device and reduced by the job workers.
+ * A device held by a player or a warm channel of this process is never opened: its subscribers only get the proxies of the player.
+ * The previews of a device are suspended while a player holds it, and opened again once it is released.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaProxyPreview
+{
+public:
+	/**
+	 * Start previewing the input of a source. The channel is opened in the background.
+	 * @return The subscription, to give to Unsubscribe
+	 */
+	static int32 Subscribe(const FBlackmagicMediaSourceSettings& InSettings);
+
+	/** Stop a subscription. The channel is closed in the background once nobody subscribes to it. */
+	static void Unsubscribe(int32 InSubscriptionId);
+
+	/** Most recent proxy of the input of a subscription, may be null */
+	static FBlackmagicMediaProxyFramePtr GetLatestFrame(int32 InSubscriptionId);
+
+	/**
+	 * Close the preview channels of a device before a player opens it, and reopen them once every player released it.
+	 * Calls are counted per device. The channels are closed and opened through FBlackmagicMediaChannelTasks, in order with the player's.
+	 */
+	static void SuspendDevice(int32 InDeviceIndex);
+	static void ResumeDevice(int32 InDeviceIndex);
+};
+
+/**
+ * Small transient texture that shows a level of the proxies. Update from the game thread.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaProxyTexture : public FGCObject
+{
+public:
+	FBlackmagicMediaProxyTexture();
+
+	/** Upload the level if the frame changed, the texture is recreated when the size changes. */
+	UTexture2D* Update(const FBlackmagicMediaProxyFramePtr& InFrame, int32 InLevel);
+
+	UTexture2D* GetTexture() const { return Texture; }
+
+	//~ FGCObject interface
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
+
+private:
+	UTexture2D* Texture;
+	FBlackmagicMediaProxyFramePtr UploadedFrame;
+	int32 UploadedLevel;
+};
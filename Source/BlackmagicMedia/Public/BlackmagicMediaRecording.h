@@ -0,0 +1,306 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "Misc/FrameRate.h"
+#include "Misc/Optional.h"
+#include "Misc/Timecode.h"
+
+class IFileHandle;
+
+namespace BlackmagicMediaRecordingCodec
+{
+	struct FEncodeBuffers;
+}
+
+/**
+ * Blackmagic recording container (.bmrec).
+ *
+ * Layout:
+ *   [FBlackmagicRecordingFileHeader] padded to the page alignment
+ *   For each frame:
+ *     [Chunk 'PADD'] optional, so the next video payload starts on a page boundary
+ *     [Chunk 'VIDF']
+ *     [Chunk 'AUDF'] optional, interleaved PCM int32 samples
+ *     [Chunk 'TCOD'] optional, FBlackmagicRecordingTimecode
+ *     [Chunk 'VANC'] optional, one per ancillary line
+ *   [Chunk 'INDX'] array of FBlackmagicRecordingIndexEntry
+ *   [FBlackmagicRecordingFileTrailer]
+ *
+ * A file without a trailer (interrupted recording) can still be opened, the index is rebuilt by walking the chunks.
+ */
+namespace BlackmagicMediaRecording
+{
+	constexpr uint32 MakeFourCC(char A, char B, char C, char D)
+	{
+		return uint32(uint8(A)) | (uint32(uint8(B)) << 8) | (uint32(uint8(C)) << 16) | (uint32(uint8(D)) << 24);
+	}
+
+	static const uint32 FileMagic = MakeFourCC('B', 'M', 'R', 'C');
+	static const uint32 TrailerMagic = MakeFourCC('B', 'M', 'R', 'E');
+	/** Version 2 added the codec of the video chunks. Its bytes were reserved, and zero, in version 1: those files read as uncompressed. */
+	static const uint32 FileVersion = 2;
+	static const uint32 MinFileVersion = 1;
+	static const uint32 PageAlignment = 4096;
+
+	static const uint32 ChunkType_Video = MakeFourCC('V', 'I', 'D', 'F');
+	static const uint32 ChunkType_Audio = MakeFourCC('A', 'U', 'D', 'F');
+	static const uint32 ChunkType_Timecode = MakeFourCC('T', 'C', 'O', 'D');
+	static const uint32 ChunkType_Vanc = MakeFourCC('V', 'A', 'N', 'C');
+	static const uint32 ChunkType_Index = MakeFourCC('I', 'N', 'D', 'X');
+	static const uint32 ChunkType_Padding = MakeFourCC('P', 'A', 'D', 'D');
+
+	/** Default extension of the recording files. */
+	static const TCHAR* const FileExtension = TEXT(".bmrec");
+}
+
+/**
+ * Pixel layout of the video chunks.
+ */
+enum class EBlackmagicRecordingPixelFormat : uint32
+{
+	UYVY = 0,
+	V210 = 1,
+	BGRA = 2,
+};
+
+/**
+ * Compression of the video chunks.
+ */
+enum class EBlackmagicRecordingCodec : uint32
+{
+	/** Video chunks are the raw frame buffers */
+	None = 0,
+	/** Video chunks are compressed with the lossless stripe codec. Each frame can be decoded on its own. */
+	Lossless = 1,
+};
+
+/**
+ * Outcome of FBlackmagicRecordingWriter::WriteFrame.
+ */
+enum class EBlackmagicRecordingWriteResult : uint8
+{
+	Written,
+	/** The frame was not recorded (out of order, can't be compressed). The file is still valid and the next frames can be written. */
+	Rejected,
+	/** The file could not be written. The recording must be closed, its last chunks may be incomplete. */
+	Failed,
+};
+
+/**
+ * File header. Describe the format of every video and audio chunk of the file.
+ */
+struct FBlackmagicRecordingFileHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 HeaderSize;
+	uint32 Alignment;
+
+	int32 DisplayMode;
+	EBlackmagicRecordingPixelFormat PixelFormat;
+	uint32 Width;
+	uint32 Height;
+	uint32 Pitch;
+	uint32 FrameRateNumerator;
+	uint32 FrameRateDenominator;
+	uint32 bIsInterlaced;
+
+	uint32 NumberOfAudioChannels;
+	uint32 AudioSampleRate;
+	EBlackmagicRecordingCodec Codec;
+	uint32 Reserved;
+
+	FBlackmagicRecordingFileHeader()
+	{
+		FMemory::Memzero(*this);
+		Magic = BlackmagicMediaRecording::FileMagic;
+		Version = BlackmagicMediaRecording::FileVersion;
+		HeaderSize = sizeof(FBlackmagicRecordingFileHeader);
+		Alignment = BlackmagicMediaRecording::PageAlignment;
+	}
+
+	FFrameRate GetFrameRate() const { return FFrameRate(FrameRateNumerator, FrameRateDenominator); }
+};
+static_assert(sizeof(FBlackmagicRecordingFileHeader) == 64, "The recording header is part of the file format.");
+
+/**
+ * Header in front of every chunk. PayloadSize doesn't include the header.
+ */
+struct FBlackmagicRecordingChunkHeader
+{
+	uint32 Type;
+	uint32 Flags;
+	uint64 PayloadSize;
+	int64 FrameNumber;
+	uint64 Reserved;
+};
+static_assert(sizeof(FBlackmagicRecordingChunkHeader) == 32, "The recording chunk header is part of the file format.");
+
+/**
+ * Timecode sidecar record.
+ */
+struct FBlackmagicRecordingTimecode
+{
+	uint8 Hours;
+	uint8 Minutes;
+	uint8 Seconds;
+	uint8 Frames;
+	uint8 bDropFrame;
+	uint8 Reserved[3];
+
+	static FBlackmagicRecordingTimecode FromTimecode(const FTimecode& InTimecode);
+	FTimecode ToTimecode() const { return FTimecode(Hours, Minutes, Seconds, Frames, bDropFrame != 0); }
+	uint32 Pack() const { return (uint32(Hours) << 24) | (uint32(Minutes) << 16) | (uint32(Seconds) << 8) | uint32(Frames); }
+};
+static_assert(sizeof(FBlackmagicRecordingTimecode) == 8, "The recording timecode is part of the file format.");
+
+/**
+ * Seek index entry, one per recorded frame. Offsets point to the chunk payloads.
+ */
+struct FBlackmagicRecordingIndexEntry
+{
+	enum EFlags : uint32
+	{
+		HasTimecode = 1 << 0,
+		HasAudio = 1 << 1,
+		HasVanc = 1 << 2,
+	};
+
+	int64 FrameNumber;
+	uint64 VideoOffset;
+	uint64 VideoSize;
+	uint64 AudioOffset;
+	uint32 AudioSize;
+	uint32 Flags;
+	FBlackmagicRecordingTimecode Timecode;
+};
+static_assert(sizeof(FBlackmagicRecordingIndexEntry) == 48, "The recording index entry is part of the file format.");
+
+struct FBlackmagicRecordingFileTrailer
+{
+	uint64 IndexOffset;
+	uint64 IndexCount;
+	uint32 Magic;
+	uint32 Version;
+};
+static_assert(sizeof(FBlackmagicRecordingFileTrailer) == 24, "The recording trailer is part of the file format.");
+
+/**
+ * Frame to append to a recording. Buffers are only read during the call.
+ */
+struct FBlackmagicRecordingFrame
+{
+	int64 FrameNumber = 0;
+	TOptional<FTimecode> Timecode;
+
+	const void* VideoBuffer = nullptr;
+	uint32 VideoSize = 0;
+
+	const void* AudioBuffer = nullptr;
+	uint32 AudioSize = 0;
+};
+
+/**
+ * Write a recording container. Not thread safe, a writer is expected to be fed by a single thread.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicRecordingWriter
+{
+public:
+	FBlackmagicRecordingWriter();
+	~FBlackmagicRecordingWriter();
+
+	FBlackmagicRecordingWriter(const FBlackmagicRecordingWriter&) = delete;
+	FBlackmagicRecordingWriter& operator=(const FBlackmagicRecordingWriter&) = delete;
+
+	/** Create the file and write the header. */
+	bool Open(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader);
+
+	/** Append a frame (video, audio and timecode chunks) and add it to the index. */
+	EBlackmagicRecordingWriteResult WriteFrame(const FBlackmagicRecordingFrame& InFrame);
+
+	/** Append an ancillary data record for the last written frame. */
+	bool WriteVanc(uint32 InLineNumber, const void* InData, uint32 InSize);
+
+	/** Write the index, the trailer and close the file. */
+	void Close();
+
+	bool IsOpen() const { return FileHandle != nullptr; }
+	const FString& GetFilename() const { return Filename; }
+	int32 GetNumFrames() const { return Index.Num(); }
+	const FBlackmagicRecordingFileHeader& GetHeader() const { return Header; }
+
+private:
+	bool WriteChunk(uint32 InType, int64 InFrameNumber, const void* InPayload, uint64 InPayloadSize, bool bAlignPayload, uint64& OutPayloadOffset);
+	bool WritePadding(uint64 InSize);
+
+private:
+	IFileHandle* FileHandle;
+	FString Filename;
+	FBlackmagicRecordingFileHeader Header;
+	TArray<FBlackmagicRecordingIndexEntry> Index;
+
+	/** Compressed video of the frame being written, and the stripes of the encoder. Kept from one frame to the next. */
+	TArray<uint8> CompressedVideo;
+	TUniquePtr<BlackmagicMediaRecordingCodec::FEncodeBuffers> EncodeBuffers;
+};
+
+/**
+ * Read a recording container with random access by frame number or timecode.
+ * Once opened, the reads can be done from several threads: the file handle is shared, its seek and read are done under a lock.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicRecordingReader
+{
+public:
+	FBlackmagicRecordingReader();
+	~FBlackmagicRecordingReader();
+
+	FBlackmagicRecordingReader(const FBlackmagicRecordingReader&) = delete;
+	FBlackmagicRecordingReader& operator=(const FBlackmagicRecordingReader&) = delete;
+
+	/** Open the file, read the header and the seek index. */
+	bool Open(const FString& InFilename);
+	void Close();
+
+	bool IsOpen() const { return FileHandle != nullptr; }
+	const FBlackmagicRecordingFileHeader& GetHeader() const { return Header; }
+	int32 GetNumFrames() const { return Index.Num(); }
+	const FBlackmagicRecordingIndexEntry& GetEntry(int32 InEntryIndex) const { return Index[InEntryIndex]; }
+
+	/** @return the index entry of the frame, or INDEX_NONE */
+	int32 FindFrame(int64 InFrameNumber) const;
+
+	/** @return the index entry of the first frame with that timecode, or INDEX_NONE */
+	int32 FindFrameByTimecode(const FTimecode& InTimecode) const;
+
+	/** Read the video payload of an entry. */
+	bool ReadVideo(int32 InEntryIndex, TArray<uint8>& OutBuffer) const;
+	bool ReadVideo(int32 InEntryIndex, void* OutBuffer, uint64 InBufferSize) const;
+
+	/**
+	 * Read the video of an entry and decompress it if needed. OutBuffer receives Pitch * Height bytes.
+	 * @param InOutCompressed	Scratch buffer for the compressed payload, owned by the caller so a reader can be shared by several threads
+	 */
+	bool ReadDecodedVideo(int32 InEntryIndex, TArray<uint8>& OutBuffer, TArray<uint8>& InOutCompressed) const;
+	bool ReadDecodedVideo(int32 InEntryIndex, TArray<uint8>& OutBuffer) const;
+
+	/** Read the audio payload of an entry. */
+	bool ReadAudio(int32 InEntryIndex, TArray<uint8>& OutBuffer) const;
+
+private:
+	bool ReadIndexFromTrailer();
+	bool RebuildIndex();
+	bool ReadAt(uint64 InOffset, void* OutBuffer, uint64 InSize) const;
+
+private:
+	IFileHandle* FileHandle;
+
+	/** Held from the seek to the end of the read, the handle has a single position */
+	mutable FCriticalSection FileLock;
+
+	FBlackmagicRecordingFileHeader Header;
+	TArray<FBlackmagicRecordingIndexEntry> Index;
+	TMap<uint32, int32> TimecodeToEntry;
+};
@@ -0,0 +1,181 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicMediaRecording.h"
+
+/**
+ * Ring of video frames in a named shared memory region, to exchange frames with other processes of the same machine.
+ *
+ * Layout:
+ *   [FBlackmagicSharedFrameRingHeader] padded to the page alignment
+ *   NumSlots times:
+ *     [FBlackmagicSharedFrameSlotHeader] padded to the page alignment
+ *     [Video payload] SlotCapacity bytes
+ *
+ * There is a single producer. Frame N goes in slot N % NumSlots. The slot sequence is odd while the producer writes it
+ * and becomes 2 * N + 2 once it is published. A reader validates the sequence before and after using a slot;
+ * if it changed, the producer lapped the reader and the frame must be discarded. The producer never waits on readers.
+ */
+namespace BlackmagicMediaSharedFrame
+{
+	static const uint32 RingMagic = BlackmagicMediaRecording::MakeFourCC('B', 'M', 'S', 'F');
+	static const uint32 RingVersion = 1;
+	static const uint32 PageAlignment = BlackmagicMediaRecording::PageAlignment;
+
+	static const uint32 MinNumSlots = 2;
+	static const uint32 MaxNumSlots = 64;
+
+	/** Sequence of a slot that holds a published frame */
+	inline int64 PublishedSlotSequence(int64 InFrameSequence) { return InFrameSequence * 2 + 2; }
+}
+
+struct FBlackmagicSharedFrameRingHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint32 HeaderSize;
+	uint32 NumSlots;
+	uint64 SlotStride;
+	uint64 SlotCapacity;
+
+	/** Number of frames published since the ring was created. Written only by the producer. */
+	volatile int64 NumPublished;
+
+	uint32 ProducerProcessId;
+	uint32 Reserved[5];
+};
+static_assert(sizeof(FBlackmagicSharedFrameRingHeader) == 64, "The shared frame ring header is shared with other processes.");
+
+struct FBlackmagicSharedFrameSlotHeader
+{
+	enum EFlags : uint32
+	{
+		HasTimecode = 1 << 0,
+		IsInterlaced = 1 << 1,
+	};
+
+	/** Odd while the slot is being written, PublishedSlotSequence(FrameSequence) once published */
+	volatile int64 Sequence;
+
+	int64 FrameNumber;
+	uint64 VideoSize;
+	EBlackmagicRecordingPixelFormat PixelFormat;
+	uint32 Width;
+	uint32 Height;
+	uint32 Pitch;
+	uint32 FrameRateNumerator;
+	uint32 FrameRateDenominator;
+	FBlackmagicRecordingTimecode Timecode;
+	uint32 Flags;
+	uint32 Reserved;
+};
+static_assert(sizeof(FBlackmagicSharedFrameSlotHeader) == 64, "The shared frame slot header is shared with other processes.");
+
+/**
+ * Frame to publish, or frame read from the ring.
+ */
+struct FBlackmagicSharedFrame
+{
+	int64 FrameNumber = 0;
+	TOptional<FTimecode> Timecode;
+
+	EBlackmagicRecordingPixelFormat PixelFormat = EBlackmagicRecordingPixelFormat::UYVY;
+	uint32 Width = 0;
+	uint32 Height = 0;
+	uint32 Pitch = 0;
+	FFrameRate FrameRate;
+	bool bIsInterlaced = false;
+
+	const uint8* VideoBuffer = nullptr;
+	uint64 VideoSize = 0;
+};
+
+/**
+ * Producer side of a shared frame ring. Not thread safe, publish from a single thread.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicSharedFrameWriter
+{
+public:
+	FBlackmagicSharedFrameWriter();
+	~FBlackmagicSharedFrameWriter();
+
+	FBlackmagicSharedFrameWriter(const FBlackmagicSharedFrameWriter&) = delete;
+	FBlackmagicSharedFrameWriter& operator=(const FBlackmagicSharedFrameWriter&) = delete;
+
+	/** Create the shared memory region. */
+	bool Open(const FString& InName, uint32 InNumSlots, uint64 InSlotCapacity);
+	void Close();
+
+	/** Copy the frame in the next slot and publish it. Never blocks. */
+	bool Publish(const FBlackmagicSharedFrame& InFrame);
+
+	bool IsOpen() const { return RingHeader != nullptr; }
+	const FString& GetName() const { return Name; }
+	uint64 GetSlotCapacity() const { return RingHeader ? RingHeader->SlotCapacity : 0; }
+
+private:
+	FString Name;
+	FPlatformMemory::FSharedMemoryRegion* Region;
+	FBlackmagicSharedFrameRingHeader* RingHeader;
+	int64 NextSequence;
+};
+
+/**
+ * Consumer side of a shared frame ring. Frames are returned by pointer into the shared memory (zero-copy).
+ * The reader closes itself when the producer restarts with another layout; call Open again to follow it.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicSharedFrameReader
+{
+public:
+	FBlackmagicSharedFrameReader();
+	~FBlackmagicSharedFrameReader();
+
+	FBlackmagicSharedFrameReader(const FBlackmagicSharedFrameReader&) = delete;
+	FBlackmagicSharedFrameReader& operator=(const FBlackmagicSharedFrameReader&) = delete;
+
+	/** Map an existing shared memory region. Fails if the producer didn't create it yet. */
+	bool Open(const FString& InName);
+	void Close();
+
+	bool IsOpen() const { return RingHeader != nullptr; }
+	const FString& GetName() const { return Name; }
+
+	/**
+	 * Get the most recent published frame that wasn't acquired yet.
+	 * The frame points in the shared memory: call IsStillValid once done with it to know if the producer overwrote it in the meantime.
+	 * @return false if there is no new frame
+	 */
+	bool AcquireLatest(FBlackmagicSharedFrame& OutFrame, int64& OutSequence);
+
+	/** Get the published frame with that frame number, if it is still in the ring. */
+	bool AcquireFrameNumber(int64 InFrameNumber, FBlackmagicSharedFrame& OutFrame, int64& OutSequence);
+
+	/** @return true if the slot of the frame was not reused by the producer */
+	bool IsStillValid(int64 InSequence) const;
+
+	/** Copy the most recent frame in OutBuffer. OutFrame.VideoBuffer points to OutBuffer. */
+	bool CopyLatest(FBlackmagicSharedFrame& OutFrame, TArray<uint8>& OutBuffer);
+
+	/** Number of frames the producer published that this reader never acquired. */
+	int64 GetNumSkippedFrames() const { return NumSkippedFrames; }
+
+private:
+	/** Close the reader if the producer changed the layout of the ring since it was opened. */
+	bool CheckLayout();
+	bool ReadSlot(int64 InSequence, FBlackmagicSharedFrame& OutFrame) const;
+
+private:
+	FString Name;
+	FPlatformMemory::FSharedMemoryRegion* Region;
+	const FBlackmagicSharedFrameRingHeader* RingHeader;
+
+	/** Layout validated in Open. The live header is never used to address the mapping. */
+	uint32 NumSlots;
+	uint64 SlotStride;
+	uint64 SlotCapacity;
+
+	int64 LastAcquiredSequence;
+	int64 NumSkippedFrames;
+};
@@ -5,7 +5,9 @@
 #include "TimeSynchronizableMediaSource.h"
 
 #include "BlackmagicDeviceProvider.h"
+#include "IMediaOptions.h"
 #include "MediaIOCoreDefinitions.h"
+#include "UObject/ObjectKey.h"
 
 #include "BlackmagicMediaSource.generated.h"
 
@@ -30,6 +32,69 @@ enum class EBlackmagicMediaAudioChannel : uint8
 	Surround8,
 };
 
+/**
+ * How the input frames are compared to the previous frame to find repeated frames.
+ */
+UENUM()
+enum class EBlackmagicMediaDuplicateFrameDetection : uint8
+{
+	/** Every frame is copied. */
+	Disabled,
+	/** Hash a grid of 64x64 blocks of the frame. Cheap, but a change that falls between the blocks is missed. */
+	Sparse,
+	/** Hash every byte of the frame. */
+	Full,
+};
+
+/**
+ * Typed snapshot of the options of a Blackmagic media source, given to the player in one piece instead of one option at a time.
+ * @see UBlackmagicMediaSource::GetSettings
+ */
+struct BLACKMAGICMEDIA_API FBlackmagicMediaSourceSettings : public IMediaOptions::FDataContainer
+{
+	/** Layout of the snapshot. A player ignores a snapshot of another version and reads the options one at a time. */
+	static const uint32 CurrentVersion = 1;
+	uint32 Version = CurrentVersion;
+
+	/** Given by the media options that give a snapshot, with the key BlackmagicSettingsType, before the player reads the snapshot */
+	static const TCHAR* const TypeName;
+
+	/** Source the snapshot was taken from. Null when the options were read one at a time. */
+	FObjectKey Source;
+
+	/** Input settings. Changing one of them requires to reopen the player. */
+	int32 DeviceIndex = 0;
+	int32 VideoFormat = 0;
+	EMediaIOStandardType VideoStandard = EMediaIOStandardType::Progressive;
+	EMediaIOTimecodeFormat TimecodeFormat = EMediaIOTimecodeFormat::None;
+	bool bCaptureAudio = false;
+	EBlackmagicMediaAudioChannel AudioChannels = EBlackmagicMediaAudioChannel::Stereo2;
+	bool bCaptureVideo = true;
+	EBlackmagicMediaSourceColorFormat ColorFormat = EBlackmagicMediaSourceColorFormat::YUV8;
+	bool bIsSRGBInput = true;
+	bool bCaptureRegionOfInterest = false;
+	FIntPoint RegionOfInterestPosition = FIntPoint::ZeroValue;
+	FIntPoint RegionOfInterestSize = FIntPoint::ZeroValue;
+	bool bExportToSharedMemory = false;
+	FString SharedMemoryName;
+	int32 SharedMemoryNumSlots = 4;
+	bool bGenerateProxies = false;
+	int32 ProxyFrameDivider = 2;
+
+	/** Settings a running player takes without being reopened. */
+	int32 MaxNumAudioFrameBuffer = 8;
+	int32 MaxNumVideoFrameBuffer = 8;
+	EBlackmagicMediaDuplicateFrameDetection DuplicateFrameDetection = EBlackmagicMediaDuplicateFrameDetection::Disabled;
+	bool bLogDropFrame = false;
+	bool bEncodeTimecodeInTexel = false;
+
+	/** Read the options one at a time, for the media options that don't give a snapshot. */
+	static FBlackmagicMediaSourceSettings FromMediaOptions(const IMediaOptions& InOptions);
+
+	/** Whether a player opened with these settings needs to be reopened to use the other settings. */
+	bool RequiresReopen(const FBlackmagicMediaSourceSettings& InOther) const;
+};
+
 /**
  * Media source description for Blackmagic.
  */
@@ -87,6 +152,57 @@ public:
 	UPROPERTY(BlueprintReadOnly, EditAnywhere, AdvancedDisplay, Category="Video", meta=(EditCondition="bCaptureVideo", ClampMin="1", ClampMax="32"))
 	int32 MaxNumVideoFrameBuffer;
 
+	/**
+	 * Only copy a rectangle of the input frames in the video samples. The samples have the size of the rectangle.
+	 * The left edge is moved to a multiple of 2 pixels in 8bit and of 6 pixels in 10bit. The shared memory export, the recordings and the raw dumps keep the whole frame.
+	 */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Video", meta=(EditCondition="bCaptureVideo"))
+	bool bCaptureRegionOfInterest;
+
+	/** Top left corner of the rectangle, in pixels of the input. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Video", meta=(EditCondition="bCaptureRegionOfInterest", ClampMin="0"))
+	FIntPoint RegionOfInterestPosition;
+
+	/** Size of the rectangle, in pixels. The rectangle is clamped to the input. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Video", meta=(EditCondition="bCaptureRegionOfInterest", ClampMin="1"))
+	FIntPoint RegionOfInterestSize;
+
+	/**
+	 * Hash the progressive input frames and, when a frame is identical to the previous one, reuse the previous video sample
+	 * with the new time and timecode instead of copying the frame. Useful for sources that repeat frames, like slides or a paused playback.
+	 * @Note Ignored when the timecode is burned in the frames.
+	 */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Video", meta=(EditCondition="bCaptureVideo"))
+	EBlackmagicMediaDuplicateFrameDetection DuplicateFrameDetection;
+
+public:
+	/**
+	 * Publish every input frame in a named shared memory ring so other processes of this machine can read them without their own capture card.
+	 * Readers never slow down the input; a reader that falls behind loses frames.
+	 */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Export", meta=(EditCondition="bCaptureVideo"))
+	bool bExportToSharedMemory;
+
+	/** Name of the shared memory region. When empty, Blackmagic_Input_<DeviceIndex> is used. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Export", meta=(EditCondition="bExportToSharedMemory"))
+	FString SharedMemoryName;
+
+	/** Number of frames kept in the shared memory ring. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Export", meta=(EditCondition="bExportToSharedMemory", ClampMin="2", ClampMax="64"))
+	int32 SharedMemoryNumSlots;
+
+public:
+	/**
+	 * Reduce the input frames to 1/2, 1/4 and 1/8 of their resolution on a worker thread, for previews and monitoring.
+	 * @see FBlackmagicMediaProxyGenerator
+	 */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Proxy", meta=(EditCondition="bCaptureVideo"))
+	bool bGenerateProxies;
+
+	/** Reduce one input frame out of that many. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category="Proxy", meta=(EditCondition="bGenerateProxies", ClampMin="1", ClampMax="60"))
+	int32 ProxyFrameDivider;
+
 public:
 	/** Log a warning when there's a drop frame. */
 	UPROPERTY(EditAnywhere, Category="Debug")
@@ -99,12 +215,32 @@ public:
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category="Debug", meta = (DisplayName = "Burn Frame Timecode"))
 	bool bEncodeTimecodeInTexel;
 
+public:
+	/** Snapshot of the options of this source, as given to the players. */
+	TSharedRef<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe> GetSettings() const;
+
+	/**
+	 * Give the buffer sizes, the duplicate frame detection, the drop frame log and the timecode burn-in to the players
+	 * that play this source, without reopening them. The other settings are used the next time the players open the source.
+	 */
+	UFUNCTION(BlueprintCallable, Category="Blackmagic")
+	void ApplyToRunningPlayers() const;
+
+	/**
+	 * Take the configuration, the timecode and the color format of an input port of a preset.
+	 * @return false when the preset or the port doesn't exist or isn't valid, the source is then unchanged.
+	 * @see UBlackmagicMediaPresets
+	 */
+	UFUNCTION(BlueprintCallable, Category="Blackmagic")
+	bool ApplyPreset(FName PresetName, int32 PortIndex);
+
 public:
 	//~ IMediaOptions interface
 
 	virtual bool GetMediaOption(const FName& Key, bool DefaultValue) const override;
 	virtual int64 GetMediaOption(const FName& Key, int64 DefaultValue) const override;
 	virtual FString GetMediaOption(const FName& Key, const FString& DefaultValue) const override;
+	virtual TSharedPtr<IMediaOptions::FDataContainer, ESPMode::ThreadSafe> GetMediaOption(const FName& Key, const TSharedPtr<IMediaOptions::FDataContainer, ESPMode::ThreadSafe>& DefaultValue) const override;
 	virtual bool HasMediaOption(const FName& Key) const override;
 
 public:
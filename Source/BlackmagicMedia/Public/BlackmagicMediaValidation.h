@@ -0,0 +1,36 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MediaIOCoreDefinitions.h"
+
+struct FBlackmagicDeviceCapabilities;
+
+/**
+ * Checks a port configuration of a source or of an output against what its device can do.
+ * The static check uses the capabilities cached by FBlackmagicDeviceProvider: it is cheap, it can be called every frame and
+ * it never scans. The last scan is saved in Saved/Blackmagic, so it also works without a card or a driver. The live check
+ * queries the device again, for when the hardware may have changed since the last scan; it needs the library.
+ */
+class BLACKMAGICMEDIA_API FBlackmagicMediaValidation
+{
+public:
+	/** Validate an input. @param InName Name of the asset, for the failure reason */
+	static bool ValidateInput(const FMediaIOConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason);
+
+	/** Validate an output, its key and its reference. @param InName Name of the asset, for the failure reason */
+	static bool ValidateOutput(const FMediaIOOutputConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason);
+
+	/** Same as ValidateInput, against the device instead of the cache */
+	static bool ValidateInputLive(const FMediaIOConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason);
+
+	/** Same as ValidateOutput, against the device instead of the cache */
+	static bool ValidateOutputLive(const FMediaIOOutputConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason);
+
+	/** Whether the Validate of the sources and outputs queries the devices. Blackmagic.LiveValidation */
+	static bool IsLiveValidationEnabled();
+
+	/** Check a configuration against capabilities, whether they come from the cache or from the device */
+	static bool ValidateCapabilities(const FBlackmagicDeviceCapabilities& InCapabilities, const FMediaIOConfiguration& InConfiguration, const FString& InName, FString& OutFailureReason);
+};
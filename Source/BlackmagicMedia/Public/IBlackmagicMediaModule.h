@@ -7,6 +7,7 @@
 
 class IMediaEventSink;
 class IMediaPlayer;
+struct FBlackmagicMediaSourceSettings;
 
 /**
  * Interface for the Media module.
@@ -27,5 +28,11 @@ public:
 
 	/** @return true if the Blackmagic card can be used */
 	virtual bool CanBeUsed() const = 0;
+
+	/**
+	 * Give the settings that don't require to reopen the input to the players opened from the source of the snapshot.
+	 * @return The number of players updated
+	 */
+	virtual int32 ApplySourceSettings(const TSharedRef<const FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe>& InSettings) = 0;
 };
 
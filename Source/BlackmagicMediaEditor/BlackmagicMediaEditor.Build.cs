@@ -18,9 +18,11 @@ namespace UnrealBuildTool.Rules
 				new string[] {
 					"BlackmagicMedia",
 					"BlackmagicMediaOutput",
+					"Engine",
 					"MediaAssets",
 					"MediaIOEditor",
 					"Projects",
+					"Slate",
 					"SlateCore",
 				});
 
@@ -1,13 +1,21 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "CoreMinimal.h"
+#include "BlackmagicDeviceProvider.h"
+#include "BlackmagicMediaSource.h"
 #include "Brushes/SlateImageBrush.h"
+#include "Containers/Ticker.h"
+#include "Framework/Notifications/NotificationManager.h"
+#include "HAL/PlatformTime.h"
 #include "Interfaces/IPluginManager.h"
 #include "Modules/ModuleInterface.h"
 #include "Modules/ModuleManager.h"
 #include "Styling/SlateStyle.h"
 #include "Styling/SlateStyleRegistry.h"
 #include "Templates/UniquePtr.h"
+#include "ThumbnailRendering/BlackmagicMediaSourceThumbnailRenderer.h"
+#include "ThumbnailRendering/ThumbnailManager.h"
+#include "Widgets/Notifications/SNotificationList.h"
 
 #define LOCTEXT_NAMESPACE "BlackmagicMediaEditor"
 
@@ -23,10 +31,21 @@ public:
 	virtual void StartupModule() override
 	{
 		RegisterStyle();
+
+		UThumbnailManager::Get().RegisterCustomRenderer(UBlackmagicMediaSource::StaticClass(), UBlackmagicMediaSourceThumbnailRenderer::StaticClass());
+
+		DeviceScanTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FBlackmagicMediaEditorModule::TickDeviceScan), 0.25f);
 	}
 
 	virtual void ShutdownModule() override
 	{
+		FTicker::GetCoreTicker().RemoveTicker(DeviceScanTickerHandle);
+
+		if (UObjectInitialized())
+		{
+			UThumbnailManager::Get().UnregisterCustomRenderer(UBlackmagicMediaSource::StaticClass());
+		}
+
 		if (!UObjectInitialized() && !IsEngineExitRequested())
 		{
 			UnregisterStyle();
@@ -36,8 +55,55 @@ public:
 private:
 	TUniquePtr<FSlateStyleSet> StyleInstance;
 
+	/** Shown while a scan of the devices takes long enough to be noticed */
+	TWeakPtr<SNotificationItem> DeviceScanNotification;
+	FDelegateHandle DeviceScanTickerHandle;
+	double DeviceScanStartTime = 0.0;
+
 private:
 
+	bool TickDeviceScan(float InDeltaTime)
+	{
+		const double MinScanTimeForNotification = 0.5;
+
+		if (FBlackmagicDeviceProvider::IsScanning())
+		{
+			const double CurrentTime = FPlatformTime::Seconds();
+			if (DeviceScanStartTime == 0.0)
+			{
+				DeviceScanStartTime = CurrentTime;
+			}
+			else if (!DeviceScanNotification.IsValid() && CurrentTime - DeviceScanStartTime > MinScanTimeForNotification)
+			{
+				FNotificationInfo Info(LOCTEXT("ScanningDevices", "Scanning Blackmagic devices..."));
+				Info.bFireAndForget = false;
+				Info.ExpireDuration = 1.0f;
+				DeviceScanNotification = FSlateNotificationManager::Get().AddNotification(Info);
+
+				TSharedPtr<SNotificationItem> Notification = DeviceScanNotification.Pin();
+				if (Notification.IsValid())
+				{
+					Notification->SetCompletionState(SNotificationItem::CS_Pending);
+				}
+			}
+		}
+		else
+		{
+			DeviceScanStartTime = 0.0;
+
+			TSharedPtr<SNotificationItem> Notification = DeviceScanNotification.Pin();
+			if (Notification.IsValid())
+			{
+				Notification->SetText(FText::Format(LOCTEXT("ScannedDevices", "Found {0} Blackmagic devices"), FText::AsNumber(FBlackmagicDeviceProvider::GetCachedDevices()->Num())));
+				Notification->SetCompletionState(SNotificationItem::CS_Success);
+				Notification->ExpireAndFadeout();
+			}
+			DeviceScanNotification.Reset();
+		}
+
+		return true;
+	}
+
 	void RegisterStyle()
 	{
 #define IMAGE_BRUSH(RelativePath, ...) FSlateImageBrush(StyleInstance->RootToContentDir(RelativePath, TEXT(".png")), __VA_ARGS__)
@@ -0,0 +1,215 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaSourceThumbnailRenderer.h"
+
+#include "BlackmagicMediaProxy.h"
+#include "BlackmagicMediaSource.h"
+#include "CanvasItem.h"
+#include "CanvasTypes.h"
+#include "Containers/Ticker.h"
+#include "Engine/Texture2D.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+
+namespace BlackmagicMediaSourceThumbnailRendererHelpers
+{
+	static TAutoConsoleVariable<int32> CVarLiveThumbnails(
+		TEXT("Blackmagic.LiveThumbnails"),
+		0,
+		TEXT("Show the input of the Blackmagic media sources in their thumbnail. The input is opened while the thumbnail is drawn,\n")
+		TEXT("unless a player or a warm channel of the editor holds the device: the proxies of the player are shown instead.\n")
+		TEXT("0: Show the icon of the class (default)"),
+		ECVF_Default);
+
+	/** Seconds after the last draw of a thumbnail before its input is closed */
+	static const double PreviewTimeout = 5.0;
+
+	/** Size of a thumbnail drawn before the first proxy of its input */
+	static const uint32 DefaultThumbnailSize = 256;
+
+	bool IsLiveThumbnail(UObject* InObject)
+	{
+		UBlackmagicMediaSource* Source = Cast<UBlackmagicMediaSource>(InObject);
+		return Source && CVarLiveThumbnails.GetValueOnGameThread() != 0 && Source->GetSettings()->bCaptureVideo;
+	}
+
+	/** Smallest level at least as large as the thumbnail, or the first level */
+	int32 SelectLevel(const FBlackmagicMediaProxyFrame& InFrame, uint32 InWidth, uint32 InHeight)
+	{
+		int32 Result = INDEX_NONE;
+		for (int32 Level = BlackmagicMediaProxy::NumLevels - 1; Level >= 0; --Level)
+		{
+			const FBlackmagicMediaProxyLevel& Candidate = InFrame.Levels[Level];
+			if (Candidate.Width > 0 && Candidate.Height > 0)
+			{
+				Result = Level;
+				if (Candidate.Width >= InWidth && Candidate.Height >= InHeight)
+				{
+					break;
+				}
+			}
+		}
+		return Result;
+	}
+}
+
+
+/* UBlackmagicMediaSourceThumbnailRenderer structors
+ *****************************************************************************/
+
+UBlackmagicMediaSourceThumbnailRenderer::UBlackmagicMediaSourceThumbnailRenderer(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
+{
+}
+
+
+/* UThumbnailRenderer interface
+ *****************************************************************************/
+
+bool UBlackmagicMediaSourceThumbnailRenderer::CanVisualizeAsset(UObject* Object)
+{
+	// Only a query, the input is opened when the thumbnail is drawn
+	return BlackmagicMediaSourceThumbnailRendererHelpers::IsLiveThumbnail(Object);
+}
+
+
+void UBlackmagicMediaSourceThumbnailRenderer::GetThumbnailSize(UObject* Object, float Zoom, uint32& OutWidth, uint32& OutHeight) const
+{
+	OutWidth = 0;
+	OutHeight = 0;
+
+	const FPreview* Preview = Previews.Find(Cast<UBlackmagicMediaSource>(Object));
+	FBlackmagicMediaProxyFramePtr Frame = Preview ? FBlackmagicMediaProxyPreview::GetLatestFrame(Preview->SubscriptionId) : FBlackmagicMediaProxyFramePtr();
+	if (Frame.IsValid())
+	{
+		OutWidth = FMath::TruncToInt(Zoom * Frame->Levels[0].Width);
+		OutHeight = FMath::TruncToInt(Zoom * Frame->Levels[0].Height);
+	}
+	else if (BlackmagicMediaSourceThumbnailRendererHelpers::IsLiveThumbnail(Object))
+	{
+		OutWidth = FMath::TruncToInt(Zoom * BlackmagicMediaSourceThumbnailRendererHelpers::DefaultThumbnailSize);
+		OutHeight = OutWidth;
+	}
+}
+
+
+void UBlackmagicMediaSourceThumbnailRenderer::Draw(UObject* Object, int32 X, int32 Y, uint32 Width, uint32 Height, FRenderTarget* RenderTarget, FCanvas* Canvas)
+{
+	FPreview* Preview = FindOrAddPreview(Cast<UBlackmagicMediaSource>(Object));
+	if (Preview == nullptr)
+	{
+		return;
+	}
+
+	FBlackmagicMediaProxyFramePtr Frame = FBlackmagicMediaProxyPreview::GetLatestFrame(Preview->SubscriptionId);
+	if (!Frame.IsValid())
+	{
+		return;
+	}
+
+	const int32 Level = BlackmagicMediaSourceThumbnailRendererHelpers::SelectLevel(*Frame, Width, Height);
+	if (Level == INDEX_NONE)
+	{
+		return;
+	}
+
+	UTexture2D* Texture = Preview->Texture->Update(Frame, Level);
+	if (Texture && Texture->Resource)
+	{
+		FCanvasTileItem TileItem(FVector2D(X, Y), Texture->Resource, FVector2D(Width, Height), FLinearColor::White);
+		TileItem.BlendMode = SE_BLEND_Opaque;
+		Canvas->DrawItem(TileItem);
+	}
+}
+
+
+/* UObject interface
+ *****************************************************************************/
+
+void UBlackmagicMediaSourceThumbnailRenderer::BeginDestroy()
+{
+	RemoveAllPreviews();
+
+	Super::BeginDestroy();
+}
+
+
+/* UBlackmagicMediaSourceThumbnailRenderer implementation
+ *****************************************************************************/
+
+UBlackmagicMediaSourceThumbnailRenderer::FPreview* UBlackmagicMediaSourceThumbnailRenderer::FindOrAddPreview(UBlackmagicMediaSource* InSource)
+{
+	if (InSource == nullptr || BlackmagicMediaSourceThumbnailRendererHelpers::CVarLiveThumbnails.GetValueOnGameThread() == 0)
+	{
+		RemoveAllPreviews();
+		return nullptr;
+	}
+
+	TSharedRef<FBlackmagicMediaSourceSettings, ESPMode::ThreadSafe> Settings = InSource->GetSettings();
+	if (!Settings->bCaptureVideo)
+	{
+		return nullptr;
+	}
+
+	FPreview& Preview = Previews.FindOrAdd(InSource);
+	const bool bInputChanged = Preview.DeviceIndex != Settings->DeviceIndex || Preview.VideoFormat != Settings->VideoFormat || Preview.ColorFormat != (uint8)Settings->ColorFormat;
+	if (Preview.SubscriptionId == INDEX_NONE || bInputChanged)
+	{
+		FBlackmagicMediaProxyPreview::Unsubscribe(Preview.SubscriptionId);
+		Preview.SubscriptionId = FBlackmagicMediaProxyPreview::Subscribe(*Settings);
+		Preview.DeviceIndex = Settings->DeviceIndex;
+		Preview.VideoFormat = Settings->VideoFormat;
+		Preview.ColorFormat = (uint8)Settings->ColorFormat;
+	}
+
+	if (!Preview.Texture.IsValid())
+	{
+		Preview.Texture = MakeShared<FBlackmagicMediaProxyTexture>();
+	}
+	Preview.LastDrawTime = FPlatformTime::Seconds();
+
+	if (!TickerHandle.IsValid())
+	{
+		TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UBlackmagicMediaSourceThumbnailRenderer::Tick), 1.0f);
+	}
+
+	return &Preview;
+}
+
+
+bool UBlackmagicMediaSourceThumbnailRenderer::Tick(float InDeltaTime)
+{
+	const double ExpiredTime = FPlatformTime::Seconds() - BlackmagicMediaSourceThumbnailRendererHelpers::PreviewTimeout;
+	for (auto It = Previews.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid() || It.Value().LastDrawTime < ExpiredTime)
+		{
+			FBlackmagicMediaProxyPreview::Unsubscribe(It.Value().SubscriptionId);
+			It.RemoveCurrent();
+		}
+	}
+
+	if (Previews.Num() == 0)
+	{
+		TickerHandle.Reset();
+		return false;
+	}
+	return true;
+}
+
+
+void UBlackmagicMediaSourceThumbnailRenderer::RemoveAllPreviews()
+{
+	for (const auto& Pair : Previews)
+	{
+		FBlackmagicMediaProxyPreview::Unsubscribe(Pair.Value.SubscriptionId);
+	}
+	Previews.Reset();
+
+	if (TickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+	}
+}
@@ -0,0 +1,62 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ThumbnailRendering/ThumbnailRenderer.h"
+#include "UObject/WeakObjectPtr.h"
+#include "BlackmagicMediaSourceThumbnailRenderer.generated.h"
+
+class FBlackmagicMediaProxyTexture;
+class UBlackmagicMediaSource;
+
+
+/**
+ * Live thumbnail of a Blackmagic media source, from the low rate proxies of its input. Enabled with Blackmagic.LiveThumbnails.
+ * The input is previewed while its thumbnail is drawn, in real time or when hovered in the content browser.
+ * The thumbnail stays empty until the first proxy arrives.
+ */
+UCLASS()
+class UBlackmagicMediaSourceThumbnailRenderer
+	: public UThumbnailRenderer
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+
+	//~ UThumbnailRenderer Interface
+
+	virtual bool CanVisualizeAsset(UObject* Object) override;
+	virtual void GetThumbnailSize(UObject* Object, float Zoom, uint32& OutWidth, uint32& OutHeight) const override;
+	virtual void Draw(UObject* Object, int32 X, int32 Y, uint32 Width, uint32 Height, FRenderTarget* RenderTarget, FCanvas* Canvas) override;
+
+	//~ UObject Interface
+
+	virtual void BeginDestroy() override;
+
+private:
+	struct FPreview
+	{
+		int32 SubscriptionId = INDEX_NONE;
+
+		/** Settings of the source the subscription was made for */
+		int32 DeviceIndex = 0;
+		int32 VideoFormat = 0;
+		uint8 ColorFormat = 0;
+
+		double LastDrawTime = 0.0;
+		TSharedPtr<FBlackmagicMediaProxyTexture> Texture;
+	};
+
+	/** The preview of the source, subscribed again when the input of the source changed. Null when previews are disabled. */
+	FPreview* FindOrAddPreview(UBlackmagicMediaSource* InSource);
+
+	/** Stop the previews of the thumbnails that are not drawn anymore */
+	bool Tick(float InDeltaTime);
+
+	void RemoveAllPreviews();
+
+private:
+	TMap<TWeakObjectPtr<UBlackmagicMediaSource>, FPreview> Previews;
+	FDelegateHandle TickerHandle;
+};
@@ -4,8 +4,15 @@
 
 
 #include "BlackmagicLib.h"
+#include "BlackmagicMediaChannelTasks.h"
+#include "BlackmagicMediaFrameClock.h"
 #include "BlackmagicMediaOutput.h"
+#include "BlackmagicMediaMultiviewer.h"
+#include "BlackmagicMediaOutputCadence.h"
+#include "BlackmagicMediaOutputFileSink.h"
 #include "BlackmagicMediaOutputModule.h"
+#include "BlackmagicMediaOverlay.h"
+#include "Containers/Ticker.h"
 #include "Engine/RendererSettings.h"
 #include "HAL/Event.h"
 #include "HAL/IConsoleManager.h"
@@ -14,9 +21,15 @@
 #include "Misc/ScopeLock.h"
 #include "Modules/ModuleManager.h"
 #include "Slate/SceneViewport.h"
+#include "Stats/Stats2.h"
 #include "Widgets/SViewport.h"
 
 
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Blackmagic MediaCapture Send to scanout (ms)"), STAT_Blackmagic_MediaCapture_SendToScanout, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic MediaCapture Late frames"), STAT_Blackmagic_MediaCapture_LateFrames, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic MediaCapture Dropped frames"), STAT_Blackmagic_MediaCapture_DroppedFrames, STATGROUP_Media);
+
+
 bool bBlackmagicWritInputRawDataCmdEnable = false;
 static FAutoConsoleCommand BlackmagicWriteInputRawDataCmd(
 	TEXT("Blackmagic.WriteInputRawData"),
@@ -29,38 +42,128 @@ namespace BlackmagicMediaCaptureHelpers
 	class FBlackmagicMediaCaptureEventCallback : public BlackmagicDesign::IOutputEventCallback
 	{
 	public:
-		FBlackmagicMediaCaptureEventCallback(UBlackmagicMediaCapture* InOwner, const BlackmagicDesign::FChannelInfo& InChannelInfo)
+		FBlackmagicMediaCaptureEventCallback(UBlackmagicMediaCapture* InOwner, const BlackmagicDesign::FChannelInfo& InChannelInfo, const TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe>& InCompletions)
 			: RefCounter(0)
 			, Owner(InOwner)
 			, ChannelInfo(InChannelInfo)
 			, LastFramesDroppedCount(0)
+			, LastFramesLostCount(0)
+			, Completions(InCompletions)
+			, NumScanoutFrames(0)
 		{
 		}
 
-		bool Initialize(const BlackmagicDesign::FOutputChannelOptions& InChannelOptions)
+		/**
+		 * Open the port on a background thread. The capture goes to Capturing once the device is initialized, or to Error.
+		 * The cadence starts sending once the port is opened: until then every frame would be refused and reported as dropped.
+		 * @return Completion of the opening
+		 */
+		TSharedFuture<void> Initialize(const BlackmagicDesign::FOutputChannelOptions& InChannelOptions, const FString& InOutputName)
 		{
 			AddRef();
 
-			check(!BlackmagicIdendifier.IsValid());
+			const double FrameInterval = double(InChannelOptions.FormatInfo.FrameRateDenominator) / double(FMath::Max<uint32>(InChannelOptions.FormatInfo.FrameRateNumerator, 1));
+			ScanoutClock.Reset(FrameInterval);
+
+			// The reference keeps the callback alive until the port is opened, even if the capture is stopped before
 			BlackmagicDesign::ReferencePtr<BlackmagicDesign::IOutputEventCallback> SelfCallbackRef(this);
-			BlackmagicIdendifier = BlackmagicDesign::RegisterOutputChannel(ChannelInfo, InChannelOptions, SelfCallbackRef);
-			return BlackmagicIdendifier.IsValid();
+			return FBlackmagicMediaChannelTasks::Enqueue([this, SelfCallbackRef, InChannelOptions, InOutputName]()
+			{
+				const BlackmagicDesign::FUniqueIdentifier Identifier = BlackmagicDesign::RegisterOutputChannel(ChannelInfo, InChannelOptions, SelfCallbackRef);
+
+				{
+					FScopeLock Lock(&CallbackLock);
+					check(!BlackmagicIdendifier.IsValid());
+					BlackmagicIdendifier = Identifier;
+					if (!Identifier.IsValid())
+					{
+						UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The Blackmagic output port for '%s' could not be opened."), *InOutputName);
+						if (Owner != nullptr)
+						{
+							Owner->SetState(EMediaCaptureState::Error);
+						}
+					}
+				}
+
+				// A cadence already shut down by the capture isn't started again
+				if (Identifier.IsValid() && Cadence.IsValid())
+				{
+					Cadence->Start();
+				}
+			});
 		}
 
-		void Uninitialize()
+		/**
+		 * Stop calling the capture now and close the port on a background thread.
+		 * The callback is released once the port is closed.
+		 * @return Completion of the closing
+		 */
+		TSharedFuture<void> Uninitialize()
 		{
 			{
 				FScopeLock Lock(&CallbackLock);
-				BlackmagicDesign::UnregisterOutputChannel(ChannelInfo, BlackmagicIdendifier, true);
 				Owner = nullptr;
 			}
 
-			Release();
+			// Enqueued after the opening, the identifier is known when it runs
+			return FBlackmagicMediaChannelTasks::Enqueue([this]()
+			{
+				BlackmagicDesign::FUniqueIdentifier Identifier;
+				{
+					FScopeLock Lock(&CallbackLock);
+					Identifier = BlackmagicIdendifier;
+					BlackmagicIdendifier = BlackmagicDesign::FUniqueIdentifier();
+				}
+
+				if (Identifier.IsValid())
+				{
+					BlackmagicDesign::UnregisterOutputChannel(ChannelInfo, Identifier, true);
+				}
+
+				// The device doesn't complete any frame anymore
+				FSentFrame SentFrame;
+				while (SentFrames.Dequeue(SentFrame))
+				{
+					FBlackmagicOutputFrameCompletion Completion;
+					Completion.FrameIdentifier = SentFrame.FrameIdentifier;
+					Completion.Result = EBlackmagicOutputFrameResult::Flushed;
+					Completion.SendTime = SentFrame.SendTime;
+					Completions->Enqueue(Completion);
+				}
+
+				Release();
+			});
+		}
+
+		/** Tell the cadence when the device frees a buffer, and start it once the port is opened. Set before the port is opened. */
+		void SetCadence(const TSharedPtr<FBlackmagicMediaOutputCadence, ESPMode::ThreadSafe>& InCadence)
+		{
+			Cadence = InCadence;
 		}
 
-		bool SendVideoFrameData(BlackmagicDesign::FFrameDescriptor& InFrameDescriptor)
+		/**
+		 * Give a frame to the device. A frame that isn't accepted is completed as dropped right away.
+		 * The device completes the accepted frames in order, which tells what happened to each of them.
+		 * @param bIsRepeat Whether the frame was already sent by the cadence
+		 */
+		bool SendVideoFrameData(BlackmagicDesign::FFrameDescriptor& InFrameDescriptor, bool bIsRepeat = false)
 		{
-			return BlackmagicDesign::SendVideoFrameData(ChannelInfo, InFrameDescriptor);
+			const double SendTime = FPlatformTime::Seconds();
+			const bool bSent = BlackmagicDesign::SendVideoFrameData(ChannelInfo, InFrameDescriptor);
+			if (bSent)
+			{
+				// The device holds at least 3 frames, the completion of this one can't come before it's queued
+				SentFrames.Enqueue(FSentFrame{ InFrameDescriptor.FrameIdentifier, SendTime, bIsRepeat });
+			}
+			else
+			{
+				FBlackmagicOutputFrameCompletion Completion;
+				Completion.FrameIdentifier = InFrameDescriptor.FrameIdentifier;
+				Completion.Result = EBlackmagicOutputFrameResult::Dropped;
+				Completion.SendTime = SendTime;
+				Completions->Enqueue(Completion);
+			}
+			return bSent;
 		}
 
 	private:
@@ -102,25 +205,51 @@ namespace BlackmagicMediaCaptureHelpers
 		}
 
 
+		/** Called once per completed frame, with the totals of the device. What changed in the totals is the result of the oldest sent frame. */
 		virtual void OnOutputFrameCopied(const FFrameSentInfo& InFrameInfo)
 		{
-			FScopeLock Lock(&CallbackLock);
-			if (Owner != nullptr)
+			const double CompletionTime = FPlatformTime::Seconds();
+			const uint32 NumNewDroppedFrames = InFrameInfo.FramesDropped - LastFramesDroppedCount;
+			const uint32 NumNewLostFrames = InFrameInfo.FramesLost - LastFramesLostCount;
+			LastFramesDroppedCount = InFrameInfo.FramesDropped;
+			LastFramesLostCount = InFrameInfo.FramesLost;
+
+			FSentFrame SentFrame;
+			if (SentFrames.Dequeue(SentFrame))
 			{
-				if (Owner->WakeUpEvent)
+				FBlackmagicOutputFrameCompletion Completion;
+				Completion.FrameIdentifier = SentFrame.FrameIdentifier;
+				Completion.SendTime = SentFrame.SendTime;
+				if (NumNewDroppedFrames > 0)
 				{
-					Owner->WakeUpEvent->Trigger();
+					Completion.Result = EBlackmagicOutputFrameResult::Dropped;
 				}
-
-				if (Owner->bLogDropFrame)
+				else
 				{
-					const uint32 FrameDropCount = InFrameInfo.FramesDropped;
-					if (FrameDropCount > LastFramesDroppedCount)
+					// The lost frames are the repeats of the previous frame, they took the scanouts before this one
+					if (NumNewLostFrames > 0)
 					{
-						UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("Lost %d frames on Blackmagic device %d. Frame rate may be too slow."), FrameDropCount - LastFramesDroppedCount, ChannelInfo.DeviceIndex);
+						Completion.Result = EBlackmagicOutputFrameResult::DisplayedLate;
 					}
-					LastFramesDroppedCount = FrameDropCount;
+					else
+					{
+						Completion.Result = SentFrame.bIsRepeat ? EBlackmagicOutputFrameResult::Repeated : EBlackmagicOutputFrameResult::Displayed;
+					}
+					NumScanoutFrames += 1 + NumNewLostFrames;
+					Completion.ScanoutTime = ScanoutClock.Correlate(NumScanoutFrames, CompletionTime);
 				}
+				Completions->Enqueue(Completion);
+			}
+
+			if (Cadence.IsValid())
+			{
+				Cadence->OnFrameCompleted();
+			}
+
+			FScopeLock Lock(&CallbackLock);
+			if (Owner != nullptr && Owner->WakeUpEvent)
+			{
+				Owner->WakeUpEvent->Trigger();
 			}
 		}
 
@@ -155,6 +284,24 @@ namespace BlackmagicMediaCaptureHelpers
 		BlackmagicDesign::FChannelInfo ChannelInfo;
 		BlackmagicDesign::FUniqueIdentifier BlackmagicIdendifier;
 		uint32 LastFramesDroppedCount;
+		uint32 LastFramesLostCount;
+
+		struct FSentFrame
+		{
+			uint32 FrameIdentifier;
+			double SendTime;
+			bool bIsRepeat;
+		};
+
+		/** Frames given to the device and not completed yet. Filled by the rendering thread, emptied by the device thread, or once the port is closed. */
+		TQueue<FSentFrame, EQueueMode::Spsc> SentFrames;
+		TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe> Completions;
+
+		/** The completions are one scanout apart, the clock removes the delay of the callback */
+		FBlackmagicMediaFrameClock ScanoutClock;
+		int64 NumScanoutFrames;
+
+		TSharedPtr<FBlackmagicMediaOutputCadence, ESPMode::ThreadSafe> Cadence;
 	};
 }
 
@@ -175,6 +322,34 @@ namespace BlackmagicMediaCaptureDevice
 		Timecode.Frames = int32(float(InTimecode.Frames) / Divider);
 		return Timecode;
 	}
+
+	/**
+	 * Layout of the captured buffer. Width is in texels of the captured texture, YUV layouts pack several pixels per texel.
+	 * @param OutPixelWidth		Width in pixels
+	 * @param OutPitch			Size in bytes of a line
+	 */
+	EBlackmagicOverlayBufferLayout GetBufferLayout(EBlackmagicMediaOutputPixelFormat InPixelFormat, EMediaCaptureConversionOperation InConversionOperation, int32 InWidth, uint32& OutPixelWidth, uint32& OutPitch)
+	{
+		EBlackmagicOverlayBufferLayout Layout = EBlackmagicOverlayBufferLayout::BGRA;
+		OutPixelWidth = InWidth;
+		OutPitch = InWidth * 4;
+		switch (InPixelFormat)
+		{
+		case EBlackmagicMediaOutputPixelFormat::PF_8BIT_YUV:
+			if (InConversionOperation == EMediaCaptureConversionOperation::RGBA8_TO_YUV_8BIT)
+			{
+				Layout = EBlackmagicOverlayBufferLayout::UYVY;
+				OutPixelWidth = InWidth * 2;
+			}
+			break;
+		case EBlackmagicMediaOutputPixelFormat::PF_10BIT_YUV:
+			Layout = EBlackmagicOverlayBufferLayout::V210;
+			OutPixelWidth = InWidth * 6;
+			OutPitch = InWidth * 16;
+			break;
+		}
+		return Layout;
+	}
 }
 
 ///* UBlackmagicMediaCapture implementation
@@ -190,9 +365,21 @@ UBlackmagicMediaCapture::UBlackmagicMediaCapture(const FObjectInitializer& Objec
 	, FrameRate(30, 1)
 	, WakeUpEvent(nullptr)
 	, LastFrameDropCount_BlackmagicThread(0)
+	, FrameCompletions(MakeShared<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe>())
 {
 }
 
+void UBlackmagicMediaCapture::BeginDestroy()
+{
+	if (FrameCompletionsTickerHandle.IsValid())
+	{
+		FTicker::GetCoreTicker().RemoveTicker(FrameCompletionsTickerHandle);
+		FrameCompletionsTickerHandle.Reset();
+	}
+
+	Super::BeginDestroy();
+}
+
 bool UBlackmagicMediaCapture::ValidateMediaOutput() const
 {
 	UBlackmagicMediaOutput* BlackmagicMediaOutput = Cast<UBlackmagicMediaOutput>(MediaOutput);
@@ -246,12 +433,29 @@ void UBlackmagicMediaCapture::StopCaptureImpl(bool bAllowPendingFrameToBeProcess
 			// Prevent the rendering thread from copying while we are stopping the capture.
 			FScopeLock ScopeLock(&RenderThreadCriticalSection);
 
+			// Nothing is sent once the cadence stopped
+			if (Cadence.IsValid())
+			{
+				Cadence->Shutdown();
+				Cadence.Reset();
+			}
+
 			if (EventCallback)
 			{
-				EventCallback->Uninitialize();
+				ChannelOperation = EventCallback->Uninitialize();
 				EventCallback = nullptr;
 			}
 
+			// The index is written once the last frame is
+			if (FileSink.IsValid())
+			{
+				FileSink->Close();
+				FileSink.Reset();
+			}
+
+			OverlaySource.Reset();
+			Multiviewer.Reset();
+
 			if (WakeUpEvent)
 			{
 				FPlatformProcess::ReturnSynchEventToPool(WakeUpEvent);
@@ -304,13 +508,46 @@ void UBlackmagicMediaCapture::RestoreViewportTextureAlpha(TSharedPtr<FSceneViewp
 
 bool UBlackmagicMediaCapture::HasFinishedProcessing() const
 {
-	return Super::HasFinishedProcessing() || EventCallback == nullptr;
+	return Super::HasFinishedProcessing() || (EventCallback == nullptr && !FileSink.IsValid());
+}
+
+void UBlackmagicMediaCapture::SetMultiviewerTally(int32 TileIndex, EBlackmagicMultiviewerTally Tally)
+{
+	// The multiviewer is created and released on the game thread and its tallies are atomic, the rendering thread is not locked
+	check(IsInGameThread());
+	if (Multiviewer.IsValid())
+	{
+		Multiviewer->SetTally(TileIndex, Tally);
+	}
 }
 
 bool UBlackmagicMediaCapture::InitBlackmagic(UBlackmagicMediaOutput* InBlackmagicMediaOutput)
 {
 	check(InBlackmagicMediaOutput);
 
+	// Init general settings
+	bWaitForSyncEvent = InBlackmagicMediaOutput->bWaitForSyncEvent;
+	bEncodeTimecodeInTexel = InBlackmagicMediaOutput->bEncodeTimecodeInTexel;
+	bLogDropFrame = InBlackmagicMediaOutput->bLogDropFrame;
+	FrameRate = InBlackmagicMediaOutput->GetRequestedFrameRate();
+
+	OverlaySource.Reset();
+	if (InBlackmagicMediaOutput->bUseSharedMemoryOverlay && !InBlackmagicMediaOutput->OverlaySharedMemoryName.IsEmpty())
+	{
+		OverlaySource = MakeShared<FBlackmagicMediaOverlaySource>(InBlackmagicMediaOutput->OverlaySharedMemoryName, InBlackmagicMediaOutput->OverlayMode, InBlackmagicMediaOutput->OverlayMatching, InBlackmagicMediaOutput->OverlayFrameNumberOffset);
+	}
+
+	if (!FrameCompletionsTickerHandle.IsValid())
+	{
+		FrameCompletionsTickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateUObject(this, &UBlackmagicMediaCapture::DeliverFrameCompletions));
+	}
+
+	// No device is involved
+	if (InBlackmagicMediaOutput->bWriteToFile)
+	{
+		return InitFileSink(InBlackmagicMediaOutput);
+	}
+
 	IBlackmagicMediaModule& MediaModule = FModuleManager::LoadModuleChecked<IBlackmagicMediaModule>(TEXT("BlackmagicMedia"));
 	if (!MediaModule.CanBeUsed())
 	{
@@ -318,12 +555,6 @@ bool UBlackmagicMediaCapture::InitBlackmagic(UBlackmagicMediaOutput* InBlackmagi
 		return false;
 	}
 
-	// Init general settings
-	bWaitForSyncEvent = InBlackmagicMediaOutput->bWaitForSyncEvent;
-	bEncodeTimecodeInTexel = InBlackmagicMediaOutput->bEncodeTimecodeInTexel;
-	bLogDropFrame = InBlackmagicMediaOutput->bLogDropFrame;
-	FrameRate = InBlackmagicMediaOutput->GetRequestedFrameRate();
-
 	// Init Device options
 	BlackmagicDesign::FOutputChannelOptions ChannelOptions;
 	ChannelOptions.FormatInfo.DisplayMode = InBlackmagicMediaOutput->OutputConfiguration.MediaConfiguration.MediaMode.DeviceModeIdentifier;
@@ -400,18 +631,22 @@ bool UBlackmagicMediaCapture::InitBlackmagic(UBlackmagicMediaOutput* InBlackmagi
 	check(EventCallback == nullptr);
 	BlackmagicDesign::FChannelInfo ChannelInfo;
 	ChannelInfo.DeviceIndex = InBlackmagicMediaOutput->OutputConfiguration.MediaConfiguration.MediaConnection.Device.DeviceIdentifier;
-	EventCallback = new BlackmagicMediaCaptureHelpers::FBlackmagicMediaCaptureEventCallback(this, ChannelInfo);
+	EventCallback = new BlackmagicMediaCaptureHelpers::FBlackmagicMediaCaptureEventCallback(this, ChannelInfo, FrameCompletions);
 
-	bool bSuccess = EventCallback->Initialize(ChannelOptions);
-	if (!bSuccess)
+	Cadence.Reset();
+	if (InBlackmagicMediaOutput->bDecoupleFrameRate)
 	{
-		UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The Blackmagic output port for '%s' could not be opened."), *InBlackmagicMediaOutput->GetName());
-		EventCallback->Uninitialize();
-		EventCallback = nullptr;
-		return false;
+		// The cadence is stopped before the callback is released
+		BlackmagicMediaCaptureHelpers::FBlackmagicMediaCaptureEventCallback* Callback = EventCallback;
+		Cadence = MakeShared<FBlackmagicMediaOutputCadence, ESPMode::ThreadSafe>(FrameRate, ChannelOptions.NumberOfBuffers, InBlackmagicMediaOutput->MaxDecoupledFrames, FrameCompletions
+			, [Callback](BlackmagicDesign::FFrameDescriptor& InFrame, bool bInIsRepeat) { return Callback->SendVideoFrameData(InFrame, bInIsRepeat); });
+		EventCallback->SetCadence(Cadence);
 	}
 
-	if (bSuccess && bWaitForSyncEvent)
+	// A port that fails to open puts the capture in error
+	ChannelOperation = EventCallback->Initialize(ChannelOptions, InBlackmagicMediaOutput->GetName());
+
+	if (bWaitForSyncEvent)
 	{
 		const auto CVar = IConsoleManager::Get().FindTConsoleVariableDataInt(TEXT("r.VSync"));
 		bool bLockToVsync = CVar->GetValueOnGameThread() != 0;
@@ -424,6 +659,41 @@ bool UBlackmagicMediaCapture::InitBlackmagic(UBlackmagicMediaOutput* InBlackmagi
 		WakeUpEvent = FPlatformProcess::GetSynchEventFromPool(bIsManualReset);
 	}
 
+	Multiviewer.Reset();
+	if (InBlackmagicMediaOutput->bOutputMultiviewer)
+	{
+		// The program output doesn't depend on the multiviewer
+		Multiviewer = MakeShared<FBlackmagicMediaMultiviewer>(InBlackmagicMediaOutput);
+		if (!Multiviewer->Initialize())
+		{
+			UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The Blackmagic multiviewer port for '%s' could not be opened."), *InBlackmagicMediaOutput->GetName());
+			Multiviewer.Reset();
+		}
+	}
+
+	return true;
+}
+
+bool UBlackmagicMediaCapture::InitFileSink(UBlackmagicMediaOutput* InBlackmagicMediaOutput)
+{
+	// Frames are written as soon as they are rendered, there's no device to wait for
+	bWaitForSyncEvent = false;
+	Cadence.Reset();
+	Multiviewer.Reset();
+
+	const FMediaIOMode& Mode = InBlackmagicMediaOutput->OutputConfiguration.MediaConfiguration.MediaMode;
+	FBlackmagicRecordingFileHeader Header;
+	Header.DisplayMode = Mode.DeviceModeIdentifier;
+	Header.FrameRateNumerator = Mode.FrameRate.Numerator;
+	Header.FrameRateDenominator = Mode.FrameRate.Denominator;
+	Header.bIsInterlaced = Mode.Standard == EMediaIOStandardType::Interlaced ? 1 : 0;
+	Header.Codec = EBlackmagicRecordingCodec::None;
+
+	const bool bWriteTimecode = InBlackmagicMediaOutput->TimecodeFormat != EMediaIOTimecodeFormat::None;
+	check(!FileSink.IsValid());
+	FileSink = MakeShared<FBlackmagicMediaOutputFileSink>(InBlackmagicMediaOutput->GetOutputFilename(), Header, bWriteTimecode, FrameCompletions);
+
+	SetState(EMediaCaptureState::Capturing);
 	return true;
 }
 
@@ -431,10 +701,12 @@ void UBlackmagicMediaCapture::OnFrameCaptured_RenderingThread(const FCaptureBase
 {
 	// Prevent the rendering thread from copying while we are stopping the capture.
 	FScopeLock ScopeLock(&RenderThreadCriticalSection);
-	if (EventCallback)
+	if (EventCallback || FileSink.IsValid())
 	{
 		BlackmagicDesign::FTimecode Timecode = BlackmagicMediaCaptureDevice::ConvertToBlackmagicTimecode(InBaseData.SourceFrameTimecode, InBaseData.SourceFrameTimecodeFramerate.AsDecimal(), FrameRate.AsDecimal());
 
+		ApplyOverlay_RenderingThread(InBaseData, InBuffer, Width, Height);
+
 		if (bEncodeTimecodeInTexel)
 		{
 			switch (BlackmagicMediaOutputPixelFormat)
@@ -489,16 +761,36 @@ void UBlackmagicMediaCapture::OnFrameCaptured_RenderingThread(const FCaptureBase
 			bBlackmagicWritInputRawDataCmdEnable = false;
 		}
 
-		BlackmagicDesign::FFrameDescriptor Frame;
-		Frame.VideoBuffer = reinterpret_cast<uint8_t*>(InBuffer);
-		Frame.VideoWidth = Width;
-		Frame.VideoHeight = Height;
-		Frame.Timecode = Timecode;
-		Frame.FrameIdentifier = InBaseData.SourceFrameNumberRenderThread;
-		const bool bSent = EventCallback->SendVideoFrameData(Frame);
-		if (bLogDropFrame && !bSent)
+		SubmitMultiviewer_RenderingThread(InBaseData, InBuffer, Width, Height);
+
+		if (FileSink.IsValid())
+		{
+			uint32 PixelWidth = 0;
+			uint32 Pitch = 0;
+			const EBlackmagicOverlayBufferLayout Layout = BlackmagicMediaCaptureDevice::GetBufferLayout(BlackmagicMediaOutputPixelFormat, GetConversionOperation(), Width, PixelWidth, Pitch);
+			const FTimecode FileTimecode(Timecode.Hours, Timecode.Minutes, Timecode.Seconds, Timecode.Frames, InBaseData.SourceFrameTimecode.bDropFrameFormat);
+			if (!FileSink->Submit_RenderingThread(reinterpret_cast<const uint8*>(InBuffer), Layout, PixelWidth, Height, Pitch, FileTimecode, InBaseData.SourceFrameNumberRenderThread))
+			{
+				UE_LOG(LogBlackmagicMediaOutput, Error, TEXT("Can't write the output to '%s'."), *FileSink->GetFilename());
+				SetState(EMediaCaptureState::Error);
+			}
+		}
+		else if (Cadence.IsValid())
 		{
-			UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("Frame couldn't be sent to Blackmagic device. Engine might be running faster than output."));
+			uint32 PixelWidth = 0;
+			uint32 Pitch = 0;
+			BlackmagicMediaCaptureDevice::GetBufferLayout(BlackmagicMediaOutputPixelFormat, GetConversionOperation(), Width, PixelWidth, Pitch);
+			Cadence->Submit_RenderingThread(reinterpret_cast<const uint8*>(InBuffer), Width, Height, Pitch * Height, Timecode, InBaseData.SourceFrameNumberRenderThread);
+		}
+		else
+		{
+			BlackmagicDesign::FFrameDescriptor Frame;
+			Frame.VideoBuffer = reinterpret_cast<uint8_t*>(InBuffer);
+			Frame.VideoWidth = Width;
+			Frame.VideoHeight = Height;
+			Frame.Timecode = Timecode;
+			Frame.FrameIdentifier = InBaseData.SourceFrameNumberRenderThread;
+			EventCallback->SendVideoFrameData(Frame);
 		}
 
 		WaitForSync_RenderingThread();
@@ -509,6 +801,91 @@ void UBlackmagicMediaCapture::OnFrameCaptured_RenderingThread(const FCaptureBase
 	}
 }
 
+void UBlackmagicMediaCapture::ApplyOverlay_RenderingThread(const FCaptureBaseData& InBaseData, void* InBuffer, int32 Width, int32 Height)
+{
+	if (!OverlaySource.IsValid())
+	{
+		return;
+	}
+
+	uint32 PixelWidth = 0;
+	uint32 Pitch = 0;
+	const EBlackmagicOverlayBufferLayout Layout = BlackmagicMediaCaptureDevice::GetBufferLayout(BlackmagicMediaOutputPixelFormat, GetConversionOperation(), Width, PixelWidth, Pitch);
+
+	OverlaySource->Apply(reinterpret_cast<uint8*>(InBuffer), Layout, PixelWidth, Height, Pitch, InBaseData.SourceFrameNumberRenderThread);
+}
+
+void UBlackmagicMediaCapture::SubmitMultiviewer_RenderingThread(const FCaptureBaseData& InBaseData, void* InBuffer, int32 Width, int32 Height)
+{
+	if (!Multiviewer.IsValid())
+	{
+		return;
+	}
+
+	uint32 PixelWidth = 0;
+	uint32 Pitch = 0;
+	const EBlackmagicOverlayBufferLayout Layout = BlackmagicMediaCaptureDevice::GetBufferLayout(BlackmagicMediaOutputPixelFormat, GetConversionOperation(), Width, PixelWidth, Pitch);
+	const BlackmagicDesign::FTimecode Timecode = BlackmagicMediaCaptureDevice::ConvertToBlackmagicTimecode(InBaseData.SourceFrameTimecode, InBaseData.SourceFrameTimecodeFramerate.AsDecimal(), FrameRate.AsDecimal());
+
+	Multiviewer->Submit_RenderingThread(reinterpret_cast<const uint8*>(InBuffer), Layout, PixelWidth, Height, Pitch, InBaseData.SourceFrameTimecode, Timecode, InBaseData.SourceFrameNumberRenderThread);
+}
+
+bool UBlackmagicMediaCapture::DeliverFrameCompletions(float InDeltaTime)
+{
+	FrameCompletionBatch.Reset();
+
+	int32 NumDroppedFrames = 0;
+	uint32 FirstDroppedFrame = 0;
+	int32 NumMissedFrames = 0;
+	uint32 FirstMissedFrame = 0;
+	const bool bIsFrameRateDecoupled = Cadence.IsValid();
+	FBlackmagicOutputFrameCompletion Completion;
+	while (FrameCompletions->Dequeue(Completion))
+	{
+		switch (Completion.Result)
+		{
+		case EBlackmagicOutputFrameResult::DisplayedLate:
+			INC_DWORD_STAT(STAT_Blackmagic_MediaCapture_LateFrames);
+			// The cadence always has a frame to send, the device repeated one because the frame came too late
+			if (bIsFrameRateDecoupled && NumMissedFrames++ == 0)
+			{
+				FirstMissedFrame = Completion.FrameIdentifier;
+			}
+			// Falls through, a late frame was displayed
+		case EBlackmagicOutputFrameResult::Displayed:
+			SET_FLOAT_STAT(STAT_Blackmagic_MediaCapture_SendToScanout, (Completion.ScanoutTime - Completion.SendTime) * 1000.0);
+			break;
+		case EBlackmagicOutputFrameResult::Dropped:
+			INC_DWORD_STAT(STAT_Blackmagic_MediaCapture_DroppedFrames);
+			if (NumDroppedFrames++ == 0)
+			{
+				FirstDroppedFrame = Completion.FrameIdentifier;
+			}
+			break;
+		default:
+			break;
+		}
+		FrameCompletionBatch.Add(Completion);
+	}
+
+	if (FrameCompletionBatch.Num() > 0)
+	{
+		if (bLogDropFrame && NumDroppedFrames > 0)
+		{
+			UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("%d frames of '%s' didn't reach the Blackmagic output, starting with frame %u. The engine might be running faster than the output, or the frame rate may be too slow."), NumDroppedFrames, MediaOutput ? *MediaOutput->GetName() : *GetName(), FirstDroppedFrame);
+		}
+
+		if (bLogDropFrame && NumMissedFrames > 0)
+		{
+			UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The Blackmagic output of '%s' missed %d frames, starting with frame %u. The frames were sent too late to be scanned out."), MediaOutput ? *MediaOutput->GetName() : *GetName(), NumMissedFrames, FirstMissedFrame);
+		}
+
+		FramesCompletedDelegate.Broadcast(FrameCompletionBatch);
+	}
+
+	return true;
+}
+
 void UBlackmagicMediaCapture::WaitForSync_RenderingThread()
 {
 	if (bWaitForSyncEvent)
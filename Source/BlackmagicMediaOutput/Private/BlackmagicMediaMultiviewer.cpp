@@ -0,0 +1,772 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaMultiviewer.h"
+
+#include "BlackmagicMediaChannelTasks.h"
+#include "BlackmagicMediaJobs.h"
+#include "BlackmagicMediaOutputModule.h"
+#include "HAL/PlatformTime.h"
+
+
+namespace BlackmagicMediaMultiviewerHelpers
+{
+	/** Lines of the multiviewer composed by a task */
+	static const uint32 LinesPerTask = 32;
+
+	/** Stage of the Blackmagic jobs */
+	static const FName JobStage(TEXT("Multiviewer"));
+
+	/** Rec. 709 video range Y Cb Cr */
+	struct FColorYCbCr
+	{
+		uint8 Y;
+		uint8 Cb;
+		uint8 Cr;
+	};
+
+	static const FColorYCbCr Black = { 16, 128, 128 };
+	static const FColorYCbCr NoSignal = { 32, 128, 128 };
+	static const FColorYCbCr TallyOff = { 64, 128, 128 };
+	static const FColorYCbCr TallyPreview = { 173, 42, 26 };
+	static const FColorYCbCr TallyProgram = { 63, 102, 240 };
+	static const uint8 TextLuma = 235;
+
+	/** Rec. 709 video range coefficients, 12 bits fixed point, for 8 bits RGB */
+	static const int32 YR = 748, YG = 2516, YB = 254;
+	static const int32 CbR = -412, CbG = -1387, CbB = 1799;
+	static const int32 CrR = 1799, CrG = -1634, CrB = -165;
+
+	/** 5x7 glyphs, one row per byte, the most significant of the 5 bits is the left column */
+	struct FGlyph
+	{
+		TCHAR Character;
+		uint8 Rows[7];
+	};
+
+	static const int32 GlyphWidth = 5;
+	static const int32 GlyphHeight = 7;
+	static const int32 GlyphAdvance = 6;
+
+	static const FGlyph Glyphs[] =
+	{
+		{ '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+		{ '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+		{ '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+		{ '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+		{ '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+		{ '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+		{ '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+		{ '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+		{ '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+		{ 'A', { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 } },
+		{ 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+		{ 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+		{ 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+		{ 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+		{ 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+		{ 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+		{ 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+		{ 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+		{ 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+		{ 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+		{ 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+		{ 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+		{ 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+		{ 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+		{ 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+		{ 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+		{ 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+		{ 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+		{ 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+		{ 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+		{ 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+		{ 'Y', { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 } },
+		{ 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+		{ ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+		{ ';', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08 } },
+		{ '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+		{ '+', { 0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00 } },
+		{ '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+		{ '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+		{ '_', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F } },
+		{ '#', { 0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A } },
+	};
+
+	/** @return null for a space or a character without glyph */
+	const FGlyph* FindGlyph(TCHAR InCharacter)
+	{
+		const TCHAR Character = FChar::ToUpper(InCharacter);
+		for (const FGlyph& Glyph : Glyphs)
+		{
+			if (Glyph.Character == Character)
+			{
+				return &Glyph;
+			}
+		}
+		return nullptr;
+	}
+
+	FORCEINLINE uint32 PackMacroPixel(const FColorYCbCr& InColor)
+	{
+		return uint32(InColor.Cb) | (uint32(InColor.Y) << 8) | (uint32(InColor.Cr) << 16) | (uint32(InColor.Y) << 24);
+	}
+
+	/** Fill the intersection of the rectangles. X are rounded to macro pixels. */
+	void FillRect(uint8* InOutBuffer, uint32 InPitch, const FIntRect& InRect, const FIntRect& InClipRect, const FColorYCbCr& InColor)
+	{
+		const int32 MinX = FMath::Max(InRect.Min.X, InClipRect.Min.X) & ~1;
+		const int32 MaxX = Align(FMath::Min(InRect.Max.X, InClipRect.Max.X), 2);
+		const int32 MinY = FMath::Max(InRect.Min.Y, InClipRect.Min.Y);
+		const int32 MaxY = FMath::Min(InRect.Max.Y, InClipRect.Max.Y);
+
+		const uint32 Value = PackMacroPixel(InColor);
+		for (int32 Line = MinY; Line < MaxY; ++Line)
+		{
+			uint32* MacroPixels = reinterpret_cast<uint32*>(InOutBuffer + uint64(Line) * InPitch) + MinX / 2;
+			for (int32 Pixel = MinX; Pixel < MaxX; Pixel += 2)
+			{
+				*MacroPixels++ = Value;
+			}
+		}
+	}
+
+	FIntPoint GetTextSize(const FString& InText, int32 InScale)
+	{
+		return InText.Len() > 0 ? FIntPoint((InText.Len() * GlyphAdvance - 1) * InScale, GlyphHeight * InScale) : FIntPoint::ZeroValue;
+	}
+
+	/** Only the luma of the pixels of the glyphs is written, the box behind the text sets the chroma. */
+	void DrawText(uint8* InOutBuffer, uint32 InPitch, FIntPoint InPosition, int32 InScale, const FString& InText, const FIntRect& InClipRect)
+	{
+		for (int32 Index = 0; Index < InText.Len(); ++Index)
+		{
+			const FGlyph* Glyph = FindGlyph(InText[Index]);
+			if (Glyph == nullptr)
+			{
+				continue;
+			}
+
+			const int32 GlyphX = InPosition.X + Index * GlyphAdvance * InScale;
+			for (int32 Row = 0; Row < GlyphHeight * InScale; ++Row)
+			{
+				const int32 Line = InPosition.Y + Row;
+				if (Line < InClipRect.Min.Y || Line >= InClipRect.Max.Y)
+				{
+					continue;
+				}
+
+				uint8* Luma = InOutBuffer + uint64(Line) * InPitch + 1;
+				const uint8 Bits = Glyph->Rows[Row / InScale];
+				for (int32 Column = 0; Column < GlyphWidth * InScale; ++Column)
+				{
+					const int32 Pixel = GlyphX + Column;
+					if ((Bits & (0x10 >> (Column / InScale))) != 0 && Pixel >= InClipRect.Min.X && Pixel < InClipRect.Max.X)
+					{
+						Luma[Pixel * 2] = TextLuma;
+					}
+				}
+			}
+		}
+	}
+
+	/** Text in a black box, anchored by its bottom left or its bottom right corner */
+	void DrawLabel(uint8* InOutBuffer, uint32 InPitch, const FIntRect& InPictureRect, int32 InScale, const FString& InText, bool bInAlignRight)
+	{
+		const FIntPoint TextSize = GetTextSize(InText, InScale);
+		const int32 Padding = InScale * 2;
+		const int32 Margin = InScale * 2;
+
+		FIntRect Box;
+		Box.Min.X = bInAlignRight ? InPictureRect.Max.X - Margin - TextSize.X - Padding * 2 : InPictureRect.Min.X + Margin;
+		Box.Min.Y = InPictureRect.Max.Y - Margin - TextSize.Y - Padding * 2;
+		Box.Max = Box.Min + TextSize + FIntPoint(Padding * 2, Padding * 2);
+
+		FillRect(InOutBuffer, InPitch, Box, InPictureRect, Black);
+		DrawText(InOutBuffer, InPitch, Box.Min + FIntPoint(Padding, Padding), InScale, InText, InPictureRect);
+	}
+
+	/** Nearest neighbor, every output pixel gets its own luma and every macro pixel takes the chroma of its first pixel. */
+	void ScaleLine(const uint8* InSourceLine, const uint32* InColumnOffsets, uint32 InNumMacroPixels, uint8* OutLine)
+	{
+		for (uint32 MacroPixel = 0; MacroPixel < InNumMacroPixels; ++MacroPixel)
+		{
+			const uint32* Offsets = InColumnOffsets + MacroPixel * 3;
+			OutLine[0] = InSourceLine[Offsets[0]];
+			OutLine[1] = InSourceLine[Offsets[1]];
+			OutLine[2] = InSourceLine[Offsets[0] + 2];
+			OutLine[3] = InSourceLine[Offsets[2]];
+			OutLine += 4;
+		}
+	}
+
+	/** Smallest level at least as large as the picture, or the first level */
+	const FBlackmagicMediaProxyLevel* SelectLevel(const FBlackmagicMediaProxyFrame& InFrame, const FIntPoint& InPictureSize)
+	{
+		const FBlackmagicMediaProxyLevel* Result = nullptr;
+		for (int32 Level = BlackmagicMediaProxy::NumLevels - 1; Level >= 0; --Level)
+		{
+			const FBlackmagicMediaProxyLevel& Candidate = InFrame.Levels[Level];
+			if (Candidate.Width > 0 && Candidate.Height > 0)
+			{
+				Result = &Candidate;
+				if (int32(Candidate.Width) >= InPictureSize.X && int32(Candidate.Height) >= InPictureSize.Y)
+				{
+					break;
+				}
+			}
+		}
+		return Result;
+	}
+
+	/** Reduce a BGRA frame to the first proxy level. Used when the output is not converted to YUV by the GPU. */
+	void ReduceBGRA(const uint8* InBuffer, uint32 InWidth, uint32 InHeight, uint32 InPitch, FBlackmagicMediaProxyLevel& OutLevel)
+	{
+		OutLevel.Width = (InWidth / 4) * 2;
+		OutLevel.Height = InHeight / 2;
+		OutLevel.Pitch = OutLevel.Width * 2;
+		OutLevel.Buffer.SetNumUninitialized(OutLevel.Pitch * OutLevel.Height, false);
+
+		const int32 NumTasks = FMath::DivideAndRoundUp(OutLevel.Height, LinesPerTask);
+		FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Analysis, JobStage, NumTasks, [&](int32 TaskIndex)
+		{
+			const uint32 FirstLine = TaskIndex * LinesPerTask;
+			const uint32 LastLine = FMath::Min(FirstLine + LinesPerTask, OutLevel.Height);
+			for (uint32 Line = FirstLine; Line < LastLine; ++Line)
+			{
+				const uint8* Source0 = InBuffer + uint64(Line) * 2 * InPitch;
+				const uint8* Source1 = Source0 + InPitch;
+				uint8* Destination = OutLevel.Buffer.GetData() + Line * OutLevel.Pitch;
+				for (uint32 MacroPixel = 0; MacroPixel < OutLevel.Width / 2; ++MacroPixel)
+				{
+					// Sums of 2x2 input pixels for each output pixel
+					int32 Sums[2][3];
+					for (int32 Pixel = 0; Pixel < 2; ++Pixel)
+					{
+						const uint32 Offset = (MacroPixel * 4 + Pixel * 2) * 4;
+						for (int32 Channel = 0; Channel < 3; ++Channel)
+						{
+							Sums[Pixel][Channel] = Source0[Offset + Channel] + Source0[Offset + 4 + Channel] + Source1[Offset + Channel] + Source1[Offset + 4 + Channel];
+						}
+					}
+
+					const int32 B = Sums[0][0] + Sums[1][0], G = Sums[0][1] + Sums[1][1], R = Sums[0][2] + Sums[1][2];
+					Destination[0] = uint8(128 + ((CbR * R + CbG * G + CbB * B + (1 << 14)) >> 15));
+					Destination[1] = uint8(16 + ((YR * Sums[0][2] + YG * Sums[0][1] + YB * Sums[0][0] + (1 << 13)) >> 14));
+					Destination[2] = uint8(128 + ((CrR * R + CrG * G + CrB * B + (1 << 14)) >> 15));
+					Destination[3] = uint8(16 + ((YR * Sums[1][2] + YG * Sums[1][1] + YB * Sums[1][0] + (1 << 13)) >> 14));
+					Destination += 4;
+				}
+			}
+		});
+	}
+
+	/** Cells of the layout, in cells of a square grid */
+	void GetLayoutCells(EBlackmagicMultiviewerLayout InLayout, int32& OutGridSize, TArray<FIntRect>& OutCells)
+	{
+		switch (InLayout)
+		{
+		case EBlackmagicMultiviewerLayout::OneLargeFiveSmall:
+			OutGridSize = 3;
+			OutCells.Add(FIntRect(0, 0, 2, 2));
+			OutCells.Add(FIntRect(2, 0, 3, 1));
+			OutCells.Add(FIntRect(2, 1, 3, 2));
+			OutCells.Add(FIntRect(0, 2, 1, 3));
+			OutCells.Add(FIntRect(1, 2, 2, 3));
+			OutCells.Add(FIntRect(2, 2, 3, 3));
+			return;
+		case EBlackmagicMultiviewerLayout::Grid3x3:
+			OutGridSize = 3;
+			break;
+		case EBlackmagicMultiviewerLayout::Grid4x4:
+			OutGridSize = 4;
+			break;
+		case EBlackmagicMultiviewerLayout::Grid2x2:
+		default:
+			OutGridSize = 2;
+			break;
+		}
+
+		for (int32 Row = 0; Row < OutGridSize; ++Row)
+		{
+			for (int32 Column = 0; Column < OutGridSize; ++Column)
+			{
+				OutCells.Add(FIntRect(Column, Row, Column + 1, Row + 1));
+			}
+		}
+	}
+
+	EBlackmagicRecordingPixelFormat ToRecordingPixelFormat(EBlackmagicOverlayBufferLayout InLayout)
+	{
+		switch (InLayout)
+		{
+		case EBlackmagicOverlayBufferLayout::UYVY: return EBlackmagicRecordingPixelFormat::UYVY;
+		case EBlackmagicOverlayBufferLayout::V210: return EBlackmagicRecordingPixelFormat::V210;
+		case EBlackmagicOverlayBufferLayout::BGRA:
+		default:
+			return EBlackmagicRecordingPixelFormat::BGRA;
+		}
+	}
+
+	class FBlackmagicMultiviewerOutputCallback : public BlackmagicDesign::IOutputEventCallback
+	{
+	public:
+		FBlackmagicMultiviewerOutputCallback(const BlackmagicDesign::FChannelInfo& InChannelInfo, bool bInLogDropFrame)
+			: RefCounter(0)
+			, ChannelInfo(InChannelInfo)
+			, bLogDropFrame(bInLogDropFrame)
+			, LastFramesDroppedCount(0)
+		{
+		}
+
+		/** Open the port on a background thread. The identifier is only used by the channel tasks, which run one at a time. */
+		void Initialize(const BlackmagicDesign::FOutputChannelOptions& InChannelOptions)
+		{
+			AddRef();
+
+			BlackmagicDesign::ReferencePtr<BlackmagicDesign::IOutputEventCallback> SelfCallbackRef(this);
+			FBlackmagicMediaChannelTasks::Enqueue([this, SelfCallbackRef, InChannelOptions]()
+			{
+				BlackmagicIdendifier = BlackmagicDesign::RegisterOutputChannel(ChannelInfo, InChannelOptions, SelfCallbackRef);
+				if (!BlackmagicIdendifier.IsValid())
+				{
+					UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The multiviewer port of Blackmagic device %d could not be opened."), ChannelInfo.DeviceIndex);
+				}
+			});
+		}
+
+		/** Close the port on a background thread, the callback is released once it is closed */
+		void Uninitialize()
+		{
+			FBlackmagicMediaChannelTasks::Enqueue([this]()
+			{
+				if (BlackmagicIdendifier.IsValid())
+				{
+					BlackmagicDesign::UnregisterOutputChannel(ChannelInfo, BlackmagicIdendifier, true);
+				}
+				Release();
+			});
+		}
+
+	private:
+		virtual void AddRef() override
+		{
+			++RefCounter;
+		}
+
+		virtual void Release() override
+		{
+			--RefCounter;
+			if (RefCounter == 0)
+			{
+				delete this;
+			}
+		}
+
+		virtual void OnInitializationCompleted(bool bSuccess) override
+		{
+			if (!bSuccess)
+			{
+				UE_LOG(LogBlackmagicMediaOutput, Error, TEXT("The multiviewer port of Blackmagic device %d could not be initialized."), ChannelInfo.DeviceIndex);
+			}
+		}
+
+		virtual void OnShutdownCompleted() override
+		{
+		}
+
+		virtual void OnOutputFrameCopied(const FFrameSentInfo& InFrameInfo) override
+		{
+			if (bLogDropFrame)
+			{
+				const uint32 FrameDropCount = InFrameInfo.FramesDropped;
+				if (FrameDropCount > LastFramesDroppedCount)
+				{
+					UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("Lost %d multiviewer frames on Blackmagic device %d."), FrameDropCount - LastFramesDroppedCount, ChannelInfo.DeviceIndex);
+				}
+				LastFramesDroppedCount = FrameDropCount;
+			}
+		}
+
+		virtual void OnPlaybackStopped() override
+		{
+			UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The multiviewer playback stopped on Blackmagic device %d."), ChannelInfo.DeviceIndex);
+		}
+
+		virtual void OnInterlacedOddFieldEvent() override
+		{
+		}
+
+	private:
+		TAtomic<int32> RefCounter;
+		BlackmagicDesign::FChannelInfo ChannelInfo;
+		BlackmagicDesign::FUniqueIdentifier BlackmagicIdendifier;
+		bool bLogDropFrame;
+		uint32 LastFramesDroppedCount;
+	};
+}
+
+/* FBlackmagicMediaMultiviewer
+*****************************************************************************/
+
+FBlackmagicMediaMultiviewer::FBlackmagicMediaMultiviewer(const UBlackmagicMediaOutput* InMediaOutput)
+	: OutputCallback(nullptr)
+	, bBurnTimecode(InMediaOutput->bMultiviewerBurnTimecode)
+	, ProgramLayout(EBlackmagicOverlayBufferLayout::BGRA)
+	, ProgramWidth(0)
+	, ProgramHeight(0)
+	, ProgramPitch(0)
+	, ProgramFrame(MakeShared<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe>())
+	, FrameIdentifier(0)
+	, NumSkippedFrames(0)
+	, bIsWorkerBusy(false)
+{
+	const FMediaIOConfiguration& Configuration = InMediaOutput->MultiviewerConfiguration.MediaConfiguration;
+	FrameInterval = Configuration.MediaMode.FrameRate.AsInterval();
+	ChannelInfo.DeviceIndex = Configuration.MediaConnection.Device.DeviceIdentifier;
+
+	// The multiviewer is always 8 bits YUV, without key
+	ChannelOptions.FormatInfo.DisplayMode = Configuration.MediaMode.DeviceModeIdentifier;
+	ChannelOptions.FormatInfo.Width = Configuration.MediaMode.Resolution.X;
+	ChannelOptions.FormatInfo.Height = Configuration.MediaMode.Resolution.Y;
+	ChannelOptions.FormatInfo.FrameRateNumerator = Configuration.MediaMode.FrameRate.Numerator;
+	ChannelOptions.FormatInfo.FrameRateDenominator = Configuration.MediaMode.FrameRate.Denominator;
+	switch (Configuration.MediaMode.Standard)
+	{
+	case EMediaIOStandardType::Interlaced:
+		ChannelOptions.FormatInfo.FieldDominance = BlackmagicDesign::EFieldDominance::Interlaced;
+		break;
+	case EMediaIOStandardType::ProgressiveSegmentedFrame:
+		ChannelOptions.FormatInfo.FieldDominance = BlackmagicDesign::EFieldDominance::ProgressiveSegmentedFrame;
+		break;
+	case EMediaIOStandardType::Progressive:
+	default:
+		ChannelOptions.FormatInfo.FieldDominance = BlackmagicDesign::EFieldDominance::Progressive;
+		break;
+	}
+
+	switch (InMediaOutput->TimecodeFormat)
+	{
+	case EMediaIOTimecodeFormat::LTC:
+		ChannelOptions.TimecodeFormat = BlackmagicDesign::ETimecodeFormat::TCF_LTC;
+		break;
+	case EMediaIOTimecodeFormat::VITC:
+		ChannelOptions.TimecodeFormat = BlackmagicDesign::ETimecodeFormat::TCF_VITC1;
+		break;
+	case EMediaIOTimecodeFormat::None:
+	default:
+		ChannelOptions.TimecodeFormat = BlackmagicDesign::ETimecodeFormat::TCF_None;
+		break;
+	}
+
+	switch (Configuration.MediaConnection.TransportType)
+	{
+	case EMediaIOTransportType::DualLink:
+		ChannelOptions.LinkConfiguration = BlackmagicDesign::ELinkConfiguration::DualLink;
+		break;
+	case EMediaIOTransportType::QuadLink:
+		ChannelOptions.LinkConfiguration = Configuration.MediaConnection.QuadTransportType == EMediaIOQuadLinkTransportType::SquareDivision ? BlackmagicDesign::ELinkConfiguration::QuadLinkSqr : BlackmagicDesign::ELinkConfiguration::QuadLinkTSI;
+		break;
+	case EMediaIOTransportType::SingleLink:
+	case EMediaIOTransportType::HDMI:
+	default:
+		ChannelOptions.LinkConfiguration = BlackmagicDesign::ELinkConfiguration::SingleLink;
+		break;
+	}
+
+	ChannelOptions.PixelFormat = BlackmagicDesign::EPixelFormat::pf_8Bits;
+	ChannelOptions.bOutputKey = false;
+	ChannelOptions.NumberOfBuffers = FMath::Clamp(InMediaOutput->NumberOfBlackmagicBuffers, 3, 4);
+	ChannelOptions.bOutputVideo = true;
+	ChannelOptions.bOutputInterlacedFieldsTimecodeNeedToMatch = false;
+	ChannelOptions.bLogDropFrames = InMediaOutput->bLogDropFrame;
+
+	Width = (uint32(FMath::Max(Configuration.MediaMode.Resolution.X, 0)) / 2) * 2;
+	Height = uint32(FMath::Max(Configuration.MediaMode.Resolution.Y, 0));
+	Pitch = Width * 2;
+	Buffer.SetNumUninitialized(Pitch * Height);
+	BlackmagicMediaMultiviewerHelpers::FillRect(Buffer.GetData(), Pitch, FIntRect(0, 0, Width, Height), FIntRect(0, 0, Width, Height), BlackmagicMediaMultiviewerHelpers::Black);
+
+	BuildTiles(InMediaOutput->MultiviewerLayout, InMediaOutput->MultiviewerTiles);
+}
+
+FBlackmagicMediaMultiviewer::~FBlackmagicMediaMultiviewer()
+{
+	if (WorkerResult.IsValid())
+	{
+		WorkerResult.Wait();
+	}
+
+	if (OutputCallback)
+	{
+		OutputCallback->Uninitialize();
+		OutputCallback = nullptr;
+	}
+
+	if (NumSkippedFrames > 0)
+	{
+		UE_LOG(LogBlackmagicMediaOutput, Verbose, TEXT("The multiviewer of Blackmagic device %d skipped %d program frames while composing."), ChannelInfo.DeviceIndex, NumSkippedFrames);
+	}
+}
+
+bool FBlackmagicMediaMultiviewer::Initialize()
+{
+	check(OutputCallback == nullptr);
+	if (Width == 0 || Height == 0)
+	{
+		return false;
+	}
+
+	OutputCallback = new BlackmagicMediaMultiviewerHelpers::FBlackmagicMultiviewerOutputCallback(ChannelInfo, ChannelOptions.bLogDropFrames);
+	OutputCallback->Initialize(ChannelOptions);
+	return true;
+}
+
+void FBlackmagicMediaMultiviewer::BuildTiles(EBlackmagicMultiviewerLayout InLayout, const TArray<FBlackmagicMultiviewerTile>& InTiles)
+{
+	int32 GridSize = 1;
+	TArray<FIntRect> Cells;
+	BlackmagicMediaMultiviewerHelpers::GetLayoutCells(InLayout, GridSize, Cells);
+
+	check(Cells.Num() <= MaxTiles);
+	Tiles.SetNum(Cells.Num());
+	for (int32 Index = 0; Index < Cells.Num(); ++Index)
+	{
+		const FBlackmagicMultiviewerTile* Settings = InTiles.IsValidIndex(Index) ? &InTiles[Index] : nullptr;
+
+		FTile& Tile = Tiles[Index];
+		Tile.Source = Settings ? Settings->Source : EBlackmagicMultiviewerSource::None;
+		Tile.InputDeviceIndex = Settings ? Settings->InputDeviceIndex : INDEX_NONE;
+		Tile.Label = Settings ? Settings->Label : FString();
+		Tile.SourceWidth = 0;
+		Tile.SourceLevel = nullptr;
+		Tallies[Index] = (uint8)(Settings ? Settings->Tally : EBlackmagicMultiviewerTally::Off);
+
+		const FIntRect& Cell = Cells[Index];
+		Tile.Rect.Min.X = (Cell.Min.X * Width / GridSize) & ~1;
+		Tile.Rect.Max.X = (Cell.Max.X * Width / GridSize) & ~1;
+		Tile.Rect.Min.Y = Cell.Min.Y * Height / GridSize;
+		Tile.Rect.Max.Y = Cell.Max.Y * Height / GridSize;
+
+		const int32 BorderSize = Align(FMath::Max(Tile.Rect.Height() / 90, 2), 2);
+		Tile.PictureRect = Tile.Rect;
+		Tile.PictureRect.InflateRect(-BorderSize);
+		Tile.PictureRect.Max = Tile.PictureRect.Max.ComponentMax(Tile.PictureRect.Min);
+	}
+}
+
+void FBlackmagicMediaMultiviewer::SetTally(int32 InTileIndex, EBlackmagicMultiviewerTally InTally)
+{
+	if (InTileIndex >= 0 && InTileIndex < Tiles.Num())
+	{
+		Tallies[InTileIndex] = (uint8)InTally;
+	}
+}
+
+void FBlackmagicMediaMultiviewer::Submit_RenderingThread(const uint8* InBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, const FTimecode& InTimecode, const BlackmagicDesign::FTimecode& InOutputTimecode, uint32 InFrameIdentifier)
+{
+	if (OutputCallback == nullptr)
+	{
+		return;
+	}
+
+	if (bIsWorkerBusy)
+	{
+		++NumSkippedFrames;
+		return;
+	}
+
+	// The worker is idle, nothing reads the copy. The buffer is only valid during the call, the reduction is left to the worker.
+	const uint32 BufferSize = InPitch * InHeight;
+	ProgramBuffer.SetNumUninitialized(InBuffer ? BufferSize : 0, false);
+	if (ProgramBuffer.Num() > 0)
+	{
+		FMemory::Memcpy(ProgramBuffer.GetData(), InBuffer, BufferSize);
+	}
+	ProgramLayout = InLayout;
+	ProgramWidth = InWidth;
+	ProgramHeight = InHeight;
+	ProgramPitch = InPitch;
+
+	ProgramFrame->FrameNumber = InFrameIdentifier;
+	ProgramFrame->Timecode = InTimecode;
+	OutputTimecode = InOutputTimecode;
+	FrameIdentifier = InFrameIdentifier;
+
+	// The frame is expected to be sent before the next program frame comes
+	bIsWorkerBusy = true;
+	WorkerResult = FBlackmagicMediaJobs::Launch(EBlackmagicJobPriority::Analysis, BlackmagicMediaMultiviewerHelpers::JobStage, [this]()
+	{
+		ReduceProgram();
+		Compose();
+		Send();
+		bIsWorkerBusy = false;
+	}, FPlatformTime::Seconds() + FrameInterval);
+}
+
+void FBlackmagicMediaMultiviewer::ReduceProgram()
+{
+	bool bIsReduced = false;
+	if (ProgramBuffer.Num() > 0)
+	{
+		if (ProgramLayout == EBlackmagicOverlayBufferLayout::BGRA)
+		{
+			BlackmagicMediaMultiviewerHelpers::ReduceBGRA(ProgramBuffer.GetData(), ProgramWidth, ProgramHeight, ProgramPitch, ProgramFrame->Levels[0]);
+			for (int32 Level = 1; Level < BlackmagicMediaProxy::NumLevels; ++Level)
+			{
+				ProgramFrame->Levels[Level].Width = ProgramFrame->Levels[Level].Height = 0;
+			}
+			bIsReduced = ProgramFrame->Levels[0].Width > 0 && ProgramFrame->Levels[0].Height > 0;
+		}
+		else
+		{
+			bIsReduced = FBlackmagicMediaProxyGenerator::Generate(ProgramBuffer.GetData(), BlackmagicMediaMultiviewerHelpers::ToRecordingPixelFormat(ProgramLayout), ProgramWidth, ProgramHeight, ProgramPitch, false, *ProgramFrame);
+		}
+	}
+
+	if (!bIsReduced)
+	{
+		for (FBlackmagicMediaProxyLevel& Level : ProgramFrame->Levels)
+		{
+			Level.Width = Level.Height = 0;
+		}
+	}
+}
+
+void FBlackmagicMediaMultiviewer::Compose()
+{
+	using namespace BlackmagicMediaMultiviewerHelpers;
+
+	InputFrames.Reset();
+	for (FTile& Tile : Tiles)
+	{
+		FBlackmagicMediaProxyFramePtr Frame;
+		if (Tile.Source == EBlackmagicMultiviewerSource::Program)
+		{
+			Frame = ProgramFrame;
+		}
+		else if (Tile.Source == EBlackmagicMultiviewerSource::Input)
+		{
+			Frame = FBlackmagicMediaProxyGenerator::GetLatestFrame(Tile.InputDeviceIndex);
+		}
+
+		Tile.SourceLevel = Frame.IsValid() ? SelectLevel(*Frame, Tile.PictureRect.Size()) : nullptr;
+		Tile.Timecode = Frame.IsValid() ? Frame->Timecode : TOptional<FTimecode>();
+		if (Tile.SourceLevel == nullptr)
+		{
+			continue;
+		}
+		InputFrames.Add(Frame);
+
+		if (Tile.SourceWidth != Tile.SourceLevel->Width)
+		{
+			Tile.SourceWidth = Tile.SourceLevel->Width;
+
+			const uint32 PictureWidth = Tile.PictureRect.Width();
+			const uint32 NumMacroPixels = PictureWidth / 2;
+			Tile.ColumnOffsets.SetNumUninitialized(NumMacroPixels * 3);
+			for (uint32 MacroPixel = 0; MacroPixel < NumMacroPixels; ++MacroPixel)
+			{
+				// Center of the two output pixels in the source
+				const uint32 Pixel0 = uint32(((uint64(MacroPixel) * 4 + 1) * Tile.SourceWidth) / (PictureWidth * 2));
+				const uint32 Pixel1 = uint32(((uint64(MacroPixel) * 4 + 3) * Tile.SourceWidth) / (PictureWidth * 2));
+				Tile.ColumnOffsets[MacroPixel * 3 + 0] = (Pixel0 & ~1u) * 2;
+				Tile.ColumnOffsets[MacroPixel * 3 + 1] = Pixel0 * 2 + 1;
+				Tile.ColumnOffsets[MacroPixel * 3 + 2] = Pixel1 * 2 + 1;
+			}
+		}
+	}
+
+	const uint32 NoSignalValue = PackMacroPixel(NoSignal);
+	const uint32 BlackValue = PackMacroPixel(Black);
+	const int32 NumTasks = FMath::DivideAndRoundUp(Height, LinesPerTask);
+	FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Analysis, JobStage, NumTasks, [&](int32 TaskIndex)
+	{
+		const int32 FirstLine = TaskIndex * LinesPerTask;
+		const int32 LastLine = FMath::Min<int32>(FirstLine + LinesPerTask, Height);
+		for (const FTile& Tile : Tiles)
+		{
+			const int32 TileFirstLine = FMath::Max(FirstLine, Tile.PictureRect.Min.Y);
+			const int32 TileLastLine = FMath::Min(LastLine, Tile.PictureRect.Max.Y);
+			const uint32 NumMacroPixels = Tile.PictureRect.Width() / 2;
+			for (int32 Line = TileFirstLine; Line < TileLastLine; ++Line)
+			{
+				uint8* Destination = Buffer.GetData() + uint64(Line) * Pitch + Tile.PictureRect.Min.X * 2;
+				if (Tile.SourceLevel)
+				{
+					const uint32 PictureLine = Line - Tile.PictureRect.Min.Y;
+					const uint32 SourceLine = uint32(((uint64(PictureLine) * 2 + 1) * Tile.SourceLevel->Height) / (Tile.PictureRect.Height() * 2));
+					ScaleLine(Tile.SourceLevel->Buffer.GetData() + SourceLine * Tile.SourceLevel->Pitch, Tile.ColumnOffsets.GetData(), NumMacroPixels, Destination);
+				}
+				else
+				{
+					const uint32 Value = Tile.Source == EBlackmagicMultiviewerSource::None ? BlackValue : NoSignalValue;
+					uint32* MacroPixels = reinterpret_cast<uint32*>(Destination);
+					for (uint32 MacroPixel = 0; MacroPixel < NumMacroPixels; ++MacroPixel)
+					{
+						MacroPixels[MacroPixel] = Value;
+					}
+				}
+			}
+		}
+	});
+
+	for (int32 Index = 0; Index < Tiles.Num(); ++Index)
+	{
+		Decorate(Tiles[Index], (EBlackmagicMultiviewerTally)Tallies[Index].Load());
+	}
+}
+
+void FBlackmagicMediaMultiviewer::Decorate(const FTile& InTile, EBlackmagicMultiviewerTally InTally)
+{
+	using namespace BlackmagicMediaMultiviewerHelpers;
+
+	const FColorYCbCr& BorderColor = InTally == EBlackmagicMultiviewerTally::Program ? TallyProgram : (InTally == EBlackmagicMultiviewerTally::Preview ? TallyPreview : TallyOff);
+	const FIntRect& Rect = InTile.Rect;
+	const FIntRect& Picture = InTile.PictureRect;
+	FillRect(Buffer.GetData(), Pitch, FIntRect(Rect.Min.X, Rect.Min.Y, Rect.Max.X, Picture.Min.Y), Rect, BorderColor);
+	FillRect(Buffer.GetData(), Pitch, FIntRect(Rect.Min.X, Picture.Max.Y, Rect.Max.X, Rect.Max.Y), Rect, BorderColor);
+	FillRect(Buffer.GetData(), Pitch, FIntRect(Rect.Min.X, Picture.Min.Y, Picture.Min.X, Picture.Max.Y), Rect, BorderColor);
+	FillRect(Buffer.GetData(), Pitch, FIntRect(Picture.Max.X, Picture.Min.Y, Rect.Max.X, Picture.Max.Y), Rect, BorderColor);
+
+	if (InTile.Source == EBlackmagicMultiviewerSource::None)
+	{
+		return;
+	}
+
+	const int32 Scale = FMath::Max(Picture.Height() / 120, 1);
+	if (InTile.SourceLevel == nullptr)
+	{
+		static const FString NoSignalText = TEXT("NO SIGNAL");
+		const FIntPoint TextSize = GetTextSize(NoSignalText, Scale);
+		DrawText(Buffer.GetData(), Pitch, Picture.Min + (Picture.Size() - TextSize) / 2, Scale, NoSignalText, Picture);
+	}
+
+	if (!InTile.Label.IsEmpty())
+	{
+		DrawLabel(Buffer.GetData(), Pitch, Picture, Scale, InTile.Label, false);
+	}
+
+	if (bBurnTimecode && InTile.Timecode.IsSet())
+	{
+		DrawLabel(Buffer.GetData(), Pitch, Picture, Scale, InTile.Timecode.GetValue().ToString(), true);
+	}
+}
+
+void FBlackmagicMediaMultiviewer::Send()
+{
+	InputFrames.Reset();
+
+	BlackmagicDesign::FFrameDescriptor Frame;
+	Frame.VideoBuffer = Buffer.GetData();
+	Frame.VideoWidth = Width / 2; // In 32 bits texels, like the frames of the capture
+	Frame.VideoHeight = Height;
+	Frame.Timecode = OutputTimecode;
+	Frame.FrameIdentifier = FrameIdentifier;
+	if (!BlackmagicDesign::SendVideoFrameData(ChannelInfo, Frame))
+	{
+		UE_LOG(LogBlackmagicMediaOutput, Verbose, TEXT("The multiviewer frame %u couldn't be sent to Blackmagic device %d."), FrameIdentifier, ChannelInfo.DeviceIndex);
+	}
+}
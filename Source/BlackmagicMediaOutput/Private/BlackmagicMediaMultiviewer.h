@@ -0,0 +1,109 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "BlackmagicLib.h"
+#include "BlackmagicMediaOutput.h"
+#include "BlackmagicMediaOverlay.h"
+#include "BlackmagicMediaProxy.h"
+#include "Misc/Timecode.h"
+#include "Templates/Atomic.h"
+
+namespace BlackmagicMediaMultiviewerHelpers
+{
+	class FBlackmagicMultiviewerOutputCallback;
+}
+
+/**
+ * Monitoring feed composed on the CPU and sent on its own output port.
+ * Every tile is scaled from the closest proxy level of its input, or of the program, and decorated with a tally border,
+ * a label and the timecode. The frame is 8 bits UYVY. The rendering thread only copies the program frame: its reduction
+ * and the composition are a Blackmagic job of the analysis priority, split between the workers.
+ * A program frame that arrives while the previous one is composed is skipped.
+ */
+class FBlackmagicMediaMultiviewer
+{
+public:
+	FBlackmagicMediaMultiviewer(const UBlackmagicMediaOutput* InMediaOutput);
+	~FBlackmagicMediaMultiviewer();
+
+	FBlackmagicMediaMultiviewer(const FBlackmagicMediaMultiviewer&) = delete;
+	FBlackmagicMediaMultiviewer& operator=(const FBlackmagicMediaMultiviewer&) = delete;
+
+	/** Open the output port of the multiviewer. */
+	bool Initialize();
+
+	/**
+	 * Copy the program frame and compose a multiviewer frame with it on the job workers. Called from the rendering thread.
+	 * @param InWidth	Width in pixels
+	 */
+	void Submit_RenderingThread(const uint8* InBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, const FTimecode& InTimecode, const BlackmagicDesign::FTimecode& InOutputTimecode, uint32 InFrameIdentifier);
+
+	/** Can be called from any thread, the tally is used by the next composition */
+	void SetTally(int32 InTileIndex, EBlackmagicMultiviewerTally InTally);
+
+	/** Tiles of the largest layout */
+	static const int32 MaxTiles = 16;
+
+private:
+	struct FTile
+	{
+		EBlackmagicMultiviewerSource Source;
+		int32 InputDeviceIndex;
+		FString Label;
+
+		/** Area of the tile and area of the picture, inside the border. X and widths are even. */
+		FIntRect Rect;
+		FIntRect PictureRect;
+
+		/** Source offsets in bytes for every output macro pixel (Cb Cr, Y0, Y1), built for SourceWidth */
+		TArray<uint32> ColumnOffsets;
+		uint32 SourceWidth;
+
+		/** Filled before every composition */
+		const FBlackmagicMediaProxyLevel* SourceLevel;
+		TOptional<FTimecode> Timecode;
+	};
+
+	void BuildTiles(EBlackmagicMultiviewerLayout InLayout, const TArray<FBlackmagicMultiviewerTile>& InTiles);
+	void ReduceProgram();
+	void Compose();
+	void Decorate(const FTile& InTile, EBlackmagicMultiviewerTally InTally);
+	void Send();
+
+private:
+	BlackmagicDesign::FChannelInfo ChannelInfo;
+	BlackmagicDesign::FOutputChannelOptions ChannelOptions;
+	BlackmagicMediaMultiviewerHelpers::FBlackmagicMultiviewerOutputCallback* OutputCallback;
+	bool bBurnTimecode;
+	double FrameInterval;
+
+	uint32 Width;
+	uint32 Height;
+	uint32 Pitch;
+	TArray<uint8> Buffer;
+	TArray<FTile> Tiles;
+
+	TAtomic<uint8> Tallies[MaxTiles];
+
+	/** Copy of the program frame, only modified by the rendering thread while the worker is idle */
+	TArray<uint8> ProgramBuffer;
+	EBlackmagicOverlayBufferLayout ProgramLayout;
+	uint32 ProgramWidth;
+	uint32 ProgramHeight;
+	uint32 ProgramPitch;
+
+	/** Reduced by the worker from the copy of the program frame */
+	TSharedPtr<FBlackmagicMediaProxyFrame, ESPMode::ThreadSafe> ProgramFrame;
+	BlackmagicDesign::FTimecode OutputTimecode;
+	uint32 FrameIdentifier;
+
+	/** Inputs are kept alive while the tiles use them */
+	TArray<FBlackmagicMediaProxyFramePtr> InputFrames;
+
+	int32 NumSkippedFrames;
+	TAtomic<bool> bIsWorkerBusy;
+	TFuture<void> WorkerResult;
+};
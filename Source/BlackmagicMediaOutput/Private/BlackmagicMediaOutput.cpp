@@ -2,15 +2,28 @@
 
 #include "BlackmagicMediaOutput.h"
 
-#include "BlackmagicLib.h"
 #include "BlackmagicMediaCapture.h"
-#include "IBlackmagicMediaModule.h"
-#include "Modules/ModuleManager.h"
+#include "BlackmagicMediaOutputModule.h"
+#include "BlackmagicMediaPresets.h"
+#include "BlackmagicMediaRecording.h"
+#include "BlackmagicMediaValidation.h"
+#include "Misc/DateTime.h"
+#include "Misc/Paths.h"
 
 
 #define LOCTEXT_NAMESPACE "BlackmagicMediaOutput"
 
 
+/* FBlackmagicMultiviewerTile
+*****************************************************************************/
+
+FBlackmagicMultiviewerTile::FBlackmagicMultiviewerTile()
+	: Source(EBlackmagicMultiviewerSource::Input)
+	, InputDeviceIndex(0)
+	, Tally(EBlackmagicMultiviewerTally::Off)
+{
+}
+
 /* UBlackmagicMediaOutput
 *****************************************************************************/
 
@@ -21,7 +34,17 @@ UBlackmagicMediaOutput::UBlackmagicMediaOutput(const FObjectInitializer& ObjectI
 	, bInvertKeyOutput(false)
 	, NumberOfBlackmagicBuffers(3)
 	, bInterlacedFieldsTimecodeNeedToMatch(false)
+	, bDecoupleFrameRate(false)
+	, MaxDecoupledFrames(2)
 	, bWaitForSyncEvent(false)
+	, bWriteToFile(false)
+	, bUseSharedMemoryOverlay(false)
+	, OverlayMode(EBlackmagicMediaOverlayMode::Composite)
+	, OverlayMatching(EBlackmagicMediaOverlayMatching::Latest)
+	, OverlayFrameNumberOffset(0)
+	, bOutputMultiviewer(false)
+	, MultiviewerLayout(EBlackmagicMultiviewerLayout::Grid2x2)
+	, bMultiviewerBurnTimecode(true)
 	, bLogDropFrame(false)
 	, bEncodeTimecodeInTexel(false)
 {
@@ -34,54 +57,108 @@ bool UBlackmagicMediaOutput::Validate(FString& OutFailureReason) const
 		return false;
 	}
 
-	if (!OutputConfiguration.IsValid())
+	// A file only needs the size and the rate of the frames, the configuration is only complete with a device
+	if (bWriteToFile)
+	{
+		const FMediaIOMode& MediaMode = OutputConfiguration.MediaConfiguration.MediaMode;
+		if (MediaMode.Resolution.X <= 0 || MediaMode.Resolution.Y <= 0 || !MediaMode.FrameRate.IsValid())
+		{
+			OutFailureReason = FString::Printf(TEXT("The mode of '%s' is invalid, the file needs a resolution and a frame rate."), *GetName());
+			return false;
+		}
+	}
+	else if (!OutputConfiguration.IsValid())
 	{
 		OutFailureReason = FString::Printf(TEXT("The Configuration of '%s' is invalid."), *GetName());
 		return false;
 	}
 
-	IBlackmagicMediaModule& MediaModule = FModuleManager::LoadModuleChecked<IBlackmagicMediaModule>(TEXT("BlackmagicMedia"));
-	if (!MediaModule.IsInitialized())
+	// The ports of the presets were validated when the presets were loaded, a file doesn't need a device
+	const bool bLiveValidation = FBlackmagicMediaValidation::IsLiveValidationEnabled();
+	if (!bWriteToFile && (bLiveValidation || !UBlackmagicMediaPresets::IsValidatedConfiguration(OutputConfiguration)))
 	{
-		OutFailureReason = FString::Printf(TEXT("Can't validate MediaOutput '%s'. The Blackmagic library was not initialized."), *GetName());
-		return false;
+		const bool bIsValid = bLiveValidation
+			? FBlackmagicMediaValidation::ValidateOutputLive(OutputConfiguration, GetName(), OutFailureReason)
+			: FBlackmagicMediaValidation::ValidateOutput(OutputConfiguration, GetName(), OutFailureReason);
+		if (!bIsValid)
+		{
+			return false;
+		}
 	}
 
-	if (!MediaModule.CanBeUsed())
+	if (OutputConfiguration.OutputType == EMediaIOOutputType::FillAndKey && PixelFormat == EBlackmagicMediaOutputPixelFormat::PF_10BIT_YUV)
 	{
-		OutFailureReason = FString::Printf(TEXT("Can't validate MediaOutput '%s' because Blackmagic card cannot be used. Are you in a Commandlet? You may override this behavior by launching with -ForceBlackmagicUsage."), *GetName());
+		OutFailureReason = FString::Printf(TEXT("'%s', Blackmagic devices do not support 10bit key."), *GetName());
 		return false;
 	}
 
-	BlackmagicDesign::BlackmagicDeviceScanner Scanner;
-	BlackmagicDesign::BlackmagicDeviceScanner::DeviceInfo DeviceInfo;
-	if (!Scanner.GetDeviceInfo(OutputConfiguration.MediaConfiguration.MediaConnection.Device.DeviceIdentifier, DeviceInfo))
+	if (bUseSharedMemoryOverlay && OverlaySharedMemoryName.IsEmpty())
 	{
-		OutFailureReason = FString::Printf(TEXT("The MediaOutput '%s' use the device '%s' that doesn't exist on this machine."), *GetName(), *OutputConfiguration.MediaConfiguration.MediaConnection.Device.DeviceName.ToString());
+		OutFailureReason = FString::Printf(TEXT("'%s' uses a shared memory overlay but the name of the shared memory is empty."), *GetName());
 		return false;
 	}
 
-	if (!DeviceInfo.bIsSupported)
+	if (bOutputMultiviewer && !bWriteToFile)
 	{
-		OutFailureReason = FString::Printf(TEXT("The MediaOutput '%s' use the device '%s' that is not supported by the Blackmagic SDK."), *GetName(), *OutputConfiguration.MediaConfiguration.MediaConnection.Device.DeviceName.ToString());
-		return false;
+		if (!MultiviewerConfiguration.IsValid())
+		{
+			OutFailureReason = FString::Printf(TEXT("The Multiviewer Configuration of '%s' is invalid."), *GetName());
+			return false;
+		}
+
+		// A channel is opened per device, another port of the device of the program would take the channel of the program
+		if (MultiviewerConfiguration.MediaConfiguration.MediaConnection.Device.DeviceIdentifier == OutputConfiguration.MediaConfiguration.MediaConnection.Device.DeviceIdentifier)
+		{
+			OutFailureReason = FString::Printf(TEXT("'%s' sends the multiviewer on the device of the output. Use another device."), *GetName());
+			return false;
+		}
+
+		if (!UBlackmagicMediaPresets::IsValidatedConfiguration(MultiviewerConfiguration)
+			&& !FBlackmagicMediaValidation::ValidateOutput(MultiviewerConfiguration, GetName(), OutFailureReason))
+		{
+			return false;
+		}
 	}
 
-	if (!DeviceInfo.bCanDoPlayback)
+	return true;
+}
+
+bool UBlackmagicMediaOutput::ApplyPreset(FName PresetName, int32 PortIndex)
+{
+	FBlackmagicMediaPresetPort Port;
+	FMediaIOOutputConfiguration Configuration;
+	FString FailureReason;
+	if (!UBlackmagicMediaPresets::GetPortConfiguration(PresetName, PortIndex, Port, Configuration, FailureReason))
 	{
-		OutFailureReason = FString::Printf(TEXT("The MediaOutput '%s' use the device '%s' that can't do playback."), *GetName(), *OutputConfiguration.MediaConfiguration.MediaConnection.Device.DeviceName.ToString());
+		UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("Can't apply the preset to the MediaOutput '%s'. %s"), *GetName(), *FailureReason);
 		return false;
 	}
 
-	if (OutputConfiguration.OutputType == EMediaIOOutputType::FillAndKey && PixelFormat == EBlackmagicMediaOutputPixelFormat::PF_10BIT_YUV)
+	if (Port.bIsInput)
 	{
-		OutFailureReason = FString::Printf(TEXT("'%s', Blackmagic devices do not support 10bit key."), *GetName());
+		UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("Can't apply the preset to the MediaOutput '%s'. The port %d of the preset '%s' is an input."), *GetName(), PortIndex, *PresetName.ToString());
 		return false;
 	}
 
+	OutputConfiguration = Configuration;
+	TimecodeFormat = Port.TimecodeFormat;
+	PixelFormat = Port.b10Bit ? EBlackmagicMediaOutputPixelFormat::PF_10BIT_YUV : EBlackmagicMediaOutputPixelFormat::PF_8BIT_YUV;
+	if (TimecodeFormat == EMediaIOTimecodeFormat::None)
+	{
+		bEncodeTimecodeInTexel = false;
+	}
 	return true;
 }
 
+FString UBlackmagicMediaOutput::GetOutputFilename() const
+{
+	if (!OutputFilename.IsEmpty())
+	{
+		return OutputFilename;
+	}
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Blackmagic"), FString::Printf(TEXT("%s_%s%s"), *GetName(), *FDateTime::Now().ToString(), BlackmagicMediaRecording::FileExtension));
+}
+
 FFrameRate UBlackmagicMediaOutput::GetRequestedFrameRate() const
 {
 	return OutputConfiguration.MediaConfiguration.MediaMode.FrameRate;
@@ -162,6 +239,15 @@ bool UBlackmagicMediaOutput::CanEditChange(const UProperty* InProperty) const
 		return (PixelFormat == EBlackmagicMediaOutputPixelFormat::PF_8BIT_YUV && OutputConfiguration.OutputType == EMediaIOOutputType::FillAndKey);
 	}
 
+	// The device isn't used when writing to a file
+	if (InProperty->GetFName() == GET_MEMBER_NAME_CHECKED(UBlackmagicMediaOutput, bWaitForSyncEvent)
+		|| InProperty->GetFName() == GET_MEMBER_NAME_CHECKED(UBlackmagicMediaOutput, bDecoupleFrameRate)
+		|| InProperty->GetFName() == GET_MEMBER_NAME_CHECKED(UBlackmagicMediaOutput, NumberOfBlackmagicBuffers)
+		|| InProperty->GetFName() == GET_MEMBER_NAME_CHECKED(UBlackmagicMediaOutput, bOutputMultiviewer))
+	{
+		return !bWriteToFile;
+	}
+
 	if (InProperty->GetFName() == GET_MEMBER_NAME_CHECKED(UBlackmagicMediaOutput, bInterlacedFieldsTimecodeNeedToMatch))
 	{
 		bool bValid = false;
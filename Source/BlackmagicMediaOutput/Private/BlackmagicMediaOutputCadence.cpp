@@ -0,0 +1,194 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaOutputCadence.h"
+
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/ScopeLock.h"
+#include "Stats/Stats2.h"
+
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic MediaCapture Repeated frames"), STAT_Blackmagic_MediaCapture_RepeatedFrames, STATGROUP_Media);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Blackmagic MediaCapture Skipped frames"), STAT_Blackmagic_MediaCapture_SkippedFrames, STATGROUP_Media);
+
+
+FBlackmagicMediaOutputCadence::FBlackmagicMediaOutputCadence(const FFrameRate& InFrameRate, uint32 InNumDeviceBuffers, uint32 InMaxQueuedFrames, const TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe>& InCompletions, FSendFrame InSendFrame)
+	: FrameInterval(InFrameRate.AsInterval())
+	, NumDeviceBuffers(FMath::Max<uint32>(InNumDeviceBuffers, 1))
+	, MaxQueuedFrames(FMath::Max<uint32>(InMaxQueuedFrames, 1))
+	, Completions(InCompletions)
+	, SendFrame(MoveTemp(InSendFrame))
+	, NumFramesInFlight(0)
+	, WakeUpEvent(FPlatformProcess::GetSynchEventFromPool(false))
+	, Thread(nullptr)
+	, bIsShutDown(false)
+	, bStopRequested(false)
+{
+}
+
+FBlackmagicMediaOutputCadence::~FBlackmagicMediaOutputCadence()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(WakeUpEvent);
+}
+
+void FBlackmagicMediaOutputCadence::Start()
+{
+	FScopeLock Lock(&ThreadLock);
+	if (Thread == nullptr && !bIsShutDown)
+	{
+		bStopRequested = false;
+		Thread = FRunnableThread::Create(this, TEXT("BlackmagicOutputCadence"), 0, TPri_TimeCritical);
+	}
+}
+
+void FBlackmagicMediaOutputCadence::Shutdown()
+{
+	{
+		FScopeLock Lock(&ThreadLock);
+		bIsShutDown = true;
+		if (Thread)
+		{
+			Thread->Kill(true);
+			delete Thread;
+			Thread = nullptr;
+		}
+	}
+
+	// The queued frames will never be sent
+	FScopeLock Lock(&FramesLock);
+	for (const FFramePtr& Frame : QueuedFrames)
+	{
+		FBlackmagicOutputFrameCompletion Completion;
+		Completion.FrameIdentifier = Frame->FrameIdentifier;
+		Completion.Result = EBlackmagicOutputFrameResult::Flushed;
+		Completions->Enqueue(Completion);
+	}
+	QueuedFrames.Reset();
+	LastSentFrame.Reset();
+}
+
+void FBlackmagicMediaOutputCadence::Submit_RenderingThread(const uint8* InBuffer, int32 InWidth, int32 InHeight, uint32 InSize, const BlackmagicDesign::FTimecode& InTimecode, uint32 InFrameIdentifier)
+{
+	// Held by this function, no other call takes the frame while it is filled
+	FFramePtr Frame;
+	{
+		FScopeLock Lock(&FramesLock);
+		Frame = AcquireFrame();
+	}
+
+	Frame->Buffer.SetNumUninitialized(InSize, false);
+	FMemory::Memcpy(Frame->Buffer.GetData(), InBuffer, InSize);
+	Frame->Width = InWidth;
+	Frame->Height = InHeight;
+	Frame->Timecode = InTimecode;
+	Frame->FrameIdentifier = InFrameIdentifier;
+
+	{
+		FScopeLock Lock(&FramesLock);
+
+		// The engine is faster than the output, the oldest frames give way
+		while (QueuedFrames.Num() >= (int32)MaxQueuedFrames)
+		{
+			FBlackmagicOutputFrameCompletion Completion;
+			Completion.FrameIdentifier = QueuedFrames[0]->FrameIdentifier;
+			Completion.Result = EBlackmagicOutputFrameResult::Skipped;
+			Completion.SendTime = FPlatformTime::Seconds();
+			Completions->Enqueue(Completion);
+			QueuedFrames.RemoveAt(0, 1, false);
+			INC_DWORD_STAT(STAT_Blackmagic_MediaCapture_SkippedFrames);
+		}
+
+		QueuedFrames.Add(Frame);
+	}
+
+	WakeUpEvent->Trigger();
+}
+
+void FBlackmagicMediaOutputCadence::OnFrameCompleted()
+{
+	if (NumFramesInFlight > 0)
+	{
+		--NumFramesInFlight;
+	}
+	WakeUpEvent->Trigger();
+}
+
+uint32 FBlackmagicMediaOutputCadence::Run()
+{
+	const uint32 WaitMilliseconds = FMath::Max<uint32>(uint32(FrameInterval * 1000.0), 1);
+
+	while (!bStopRequested)
+	{
+		WakeUpEvent->Wait(WaitMilliseconds);
+
+		// Every buffer freed by the device gets the next engine frame, or the last one again
+		while (!bStopRequested && NumFramesInFlight < (int32)NumDeviceBuffers)
+		{
+			FFramePtr Frame;
+			{
+				FScopeLock Lock(&FramesLock);
+				if (QueuedFrames.Num() > 0)
+				{
+					Frame = QueuedFrames[0];
+					QueuedFrames.RemoveAt(0, 1, false);
+				}
+			}
+
+			const bool bIsRepeat = !Frame.IsValid();
+			if (bIsRepeat)
+			{
+				if (!LastSentFrame.IsValid())
+				{
+					break;
+				}
+				Frame = LastSentFrame;
+				INC_DWORD_STAT(STAT_Blackmagic_MediaCapture_RepeatedFrames);
+			}
+
+			BlackmagicDesign::FFrameDescriptor Descriptor;
+			Descriptor.VideoBuffer = Frame->Buffer.GetData();
+			Descriptor.VideoWidth = Frame->Width;
+			Descriptor.VideoHeight = Frame->Height;
+			Descriptor.Timecode = Frame->Timecode;
+			Descriptor.FrameIdentifier = Frame->FrameIdentifier;
+
+			// A repeat gives the same buffer to the device again
+			LastSentFrame = Frame;
+			if (!SendFrame(Descriptor, bIsRepeat))
+			{
+				break;
+			}
+			++NumFramesInFlight;
+		}
+	}
+
+	return 0;
+}
+
+void FBlackmagicMediaOutputCadence::Stop()
+{
+	bStopRequested = true;
+	WakeUpEvent->Trigger();
+}
+
+FBlackmagicMediaOutputCadence::FFramePtr FBlackmagicMediaOutputCadence::AcquireFrame()
+{
+	for (const FFramePtr& Frame : FramePool)
+	{
+		// Only referenced by the pool: not queued and not the last frame sent
+		if (Frame.IsUnique())
+		{
+			return Frame;
+		}
+	}
+
+	FFramePtr NewFrame = MakeShared<FFrame, ESPMode::ThreadSafe>();
+	if (FramePool.Num() < (int32)MaxQueuedFrames + 2)
+	{
+		FramePool.Add(NewFrame);
+	}
+	return NewFrame;
+}
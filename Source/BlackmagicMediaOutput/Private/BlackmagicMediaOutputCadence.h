@@ -0,0 +1,93 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicLib.h"
+#include "BlackmagicMediaCapture.h"
+#include "HAL/Runnable.h"
+#include "Misc/FrameRate.h"
+#include "Templates/Atomic.h"
+#include "Templates/Function.h"
+
+class FEvent;
+class FRunnableThread;
+
+/**
+ * Feeds an output port at the frame rate of the output, whatever the rate of the engine.
+ * The engine frames are queued, and a thread sends one frame every time the device frees a buffer. When no new frame is
+ * waiting, the last frame is sent again: the same buffer is given to the device, it isn't copied. When more frames than
+ * the queue holds are waiting, the oldest are skipped. Repeats and skips are reported as frame completions, so the output
+ * only reports a drop when the device really missed a frame.
+ */
+class FBlackmagicMediaOutputCadence : public FRunnable
+{
+public:
+	/** Give a frame to the device. @param bIsRepeat Whether the frame was already sent */
+	using FSendFrame = TFunction<bool(BlackmagicDesign::FFrameDescriptor& /*Frame*/, bool /*bIsRepeat*/)>;
+
+	/**
+	 * @param InNumDeviceBuffers	Frames the device holds, the number of frames in flight
+	 * @param InMaxQueuedFrames		Engine frames that can wait to be sent
+	 */
+	FBlackmagicMediaOutputCadence(const FFrameRate& InFrameRate, uint32 InNumDeviceBuffers, uint32 InMaxQueuedFrames, const TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe>& InCompletions, FSendFrame InSendFrame);
+	virtual ~FBlackmagicMediaOutputCadence();
+
+	FBlackmagicMediaOutputCadence(const FBlackmagicMediaOutputCadence&) = delete;
+	FBlackmagicMediaOutputCadence& operator=(const FBlackmagicMediaOutputCadence&) = delete;
+
+	/** Start the sending thread, once the port is opened. Does nothing once the cadence was shut down. Can be called from any thread. */
+	void Start();
+
+	/** Stop the sending thread. No frame is sent once it returns, and the thread can't be started again. */
+	void Shutdown();
+
+	/** Queue an engine frame. The buffer is copied, it only lives for the call. Called from the rendering thread. */
+	void Submit_RenderingThread(const uint8* InBuffer, int32 InWidth, int32 InHeight, uint32 InSize, const BlackmagicDesign::FTimecode& InTimecode, uint32 InFrameIdentifier);
+
+	/** The device freed a buffer. Called from the device thread. */
+	void OnFrameCompleted();
+
+private:
+	struct FFrame
+	{
+		TArray<uint8> Buffer;
+		int32 Width = 0;
+		int32 Height = 0;
+		BlackmagicDesign::FTimecode Timecode;
+		uint32 FrameIdentifier = 0;
+	};
+	using FFramePtr = TSharedPtr<FFrame, ESPMode::ThreadSafe>;
+
+	//~ FRunnable interface
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+	/** A frame of the pool that is neither queued nor being sent. Called under FramesLock. */
+	FFramePtr AcquireFrame();
+
+private:
+	double FrameInterval;
+	uint32 NumDeviceBuffers;
+	uint32 MaxQueuedFrames;
+	TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe> Completions;
+	FSendFrame SendFrame;
+
+	FCriticalSection FramesLock;
+	TArray<FFramePtr> FramePool;
+	TArray<FFramePtr> QueuedFrames;
+
+	/** Only used by the sending thread */
+	FFramePtr LastSentFrame;
+
+	/** Frames given to the device and not completed yet */
+	TAtomic<int32> NumFramesInFlight;
+
+	FEvent* WakeUpEvent;
+
+	/** The port is opened on a background thread, it can start the cadence while it is shut down */
+	FCriticalSection ThreadLock;
+	FRunnableThread* Thread;
+	bool bIsShutDown;
+	TAtomic<bool> bStopRequested;
+};
@@ -0,0 +1,188 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaOutputFileSink.h"
+
+#include "Async/Async.h"
+#include "BlackmagicMediaOutputModule.h"
+#include "HAL/PlatformTime.h"
+#include "Stats/Stats2.h"
+
+
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Blackmagic MediaCapture File write (ms)"), STAT_Blackmagic_MediaCapture_FileWrite, STATGROUP_Media);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Blackmagic MediaCapture File wait (ms)"), STAT_Blackmagic_MediaCapture_FileWait, STATGROUP_Media);
+
+
+namespace BlackmagicMediaOutputFileSinkHelpers
+{
+	EBlackmagicRecordingPixelFormat ToRecordingPixelFormat(EBlackmagicOverlayBufferLayout InLayout)
+	{
+		switch (InLayout)
+		{
+		case EBlackmagicOverlayBufferLayout::UYVY:
+			return EBlackmagicRecordingPixelFormat::UYVY;
+		case EBlackmagicOverlayBufferLayout::V210:
+			return EBlackmagicRecordingPixelFormat::V210;
+		case EBlackmagicOverlayBufferLayout::BGRA:
+		default:
+			return EBlackmagicRecordingPixelFormat::BGRA;
+		}
+	}
+}
+
+
+FBlackmagicMediaOutputFileSink::FBlackmagicMediaOutputFileSink(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader, bool bInWriteTimecode, const TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe>& InCompletions)
+	: Filename(InFilename)
+	, Header(InHeader)
+	, bWriteTimecode(bInWriteTimecode)
+	, Completions(InCompletions)
+	, NextFrameIndex(0)
+	, NextFrameNumber(0)
+	, bIsOpen(false)
+	, bOpenFailed(false)
+	, bWriteFailed(false)
+{
+}
+
+FBlackmagicMediaOutputFileSink::~FBlackmagicMediaOutputFileSink()
+{
+	Close();
+}
+
+void FBlackmagicMediaOutputFileSink::Close()
+{
+	if (!bIsOpen)
+	{
+		return;
+	}
+
+	WaitForPendingWrite();
+	Writer.Close();
+	bIsOpen = false;
+
+	for (FPendingFrame& Frame : Frames)
+	{
+		Frame.Buffer.Empty();
+	}
+}
+
+bool FBlackmagicMediaOutputFileSink::Submit_RenderingThread(const uint8* InBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, const FTimecode& InTimecode, uint32 InFrameIdentifier)
+{
+	if (bWriteFailed)
+	{
+		return false;
+	}
+
+	if (!bIsOpen)
+	{
+		// The file is only created once, a stopped sink doesn't create it again
+		if (bOpenFailed || NextFrameNumber > 0 || !Open(InLayout, InWidth, InHeight, InPitch))
+		{
+			bOpenFailed = true;
+			return false;
+		}
+	}
+
+	const bool bIsSameLayout = Header.PixelFormat == BlackmagicMediaOutputFileSinkHelpers::ToRecordingPixelFormat(InLayout)
+		&& Header.Width == InWidth && Header.Height == InHeight && Header.Pitch == InPitch;
+	if (!bIsSameLayout)
+	{
+		UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("A frame of '%s' doesn't have the size of the first frame. It was not written."), *Filename);
+
+		FBlackmagicOutputFrameCompletion Completion;
+		Completion.FrameIdentifier = InFrameIdentifier;
+		Completion.Result = EBlackmagicOutputFrameResult::Dropped;
+		Completion.SendTime = FPlatformTime::Seconds();
+		Completions->Enqueue(Completion);
+		return true;
+	}
+
+	// The other buffer may still be written, this one is free
+	FPendingFrame& Frame = Frames[NextFrameIndex];
+	const uint32 FrameSize = InPitch * InHeight;
+	Frame.Buffer.SetNumUninitialized(FrameSize, false);
+	FMemory::Memcpy(Frame.Buffer.GetData(), InBuffer, FrameSize);
+	Frame.Timecode = bWriteTimecode ? TOptional<FTimecode>(InTimecode) : TOptional<FTimecode>();
+	Frame.FrameNumber = NextFrameNumber++;
+	Frame.FrameIdentifier = InFrameIdentifier;
+	Frame.SubmitTime = FPlatformTime::Seconds();
+
+	// The frames are written in order, one at a time
+	WaitForPendingWrite();
+	if (bWriteFailed)
+	{
+		FBlackmagicOutputFrameCompletion Completion;
+		Completion.FrameIdentifier = InFrameIdentifier;
+		Completion.Result = EBlackmagicOutputFrameResult::Dropped;
+		Completion.SendTime = Frame.SubmitTime;
+		Completions->Enqueue(Completion);
+		return false;
+	}
+
+	PendingWrite = Async<void>(EAsyncExecution::ThreadPool, [this, &Frame]()
+	{
+		WriteFrame(Frame);
+	});
+
+	NextFrameIndex = (NextFrameIndex + 1) % UE_ARRAY_COUNT(Frames);
+	return true;
+}
+
+bool FBlackmagicMediaOutputFileSink::Open(EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch)
+{
+	Header.PixelFormat = BlackmagicMediaOutputFileSinkHelpers::ToRecordingPixelFormat(InLayout);
+	Header.Width = InWidth;
+	Header.Height = InHeight;
+	Header.Pitch = InPitch;
+
+	bIsOpen = Writer.Open(Filename, Header);
+	if (bIsOpen)
+	{
+		UE_LOG(LogBlackmagicMediaOutput, Log, TEXT("Writing the Blackmagic output to '%s'."), *Filename);
+		for (FPendingFrame& Frame : Frames)
+		{
+			Frame.Buffer.Reset(InPitch * InHeight);
+		}
+	}
+	return bIsOpen;
+}
+
+void FBlackmagicMediaOutputFileSink::WaitForPendingWrite()
+{
+	if (PendingWrite.IsValid())
+	{
+		const double WaitStartTime = FPlatformTime::Seconds();
+		PendingWrite.Wait();
+		PendingWrite.Reset();
+		SET_FLOAT_STAT(STAT_Blackmagic_MediaCapture_FileWait, (FPlatformTime::Seconds() - WaitStartTime) * 1000.0);
+	}
+}
+
+void FBlackmagicMediaOutputFileSink::WriteFrame(const FPendingFrame& InFrame)
+{
+	FBlackmagicRecordingFrame RecordingFrame;
+	RecordingFrame.FrameNumber = InFrame.FrameNumber;
+	RecordingFrame.Timecode = InFrame.Timecode;
+	RecordingFrame.VideoBuffer = InFrame.Buffer.GetData();
+	RecordingFrame.VideoSize = InFrame.Buffer.Num();
+
+	const double WriteStartTime = FPlatformTime::Seconds();
+	const EBlackmagicRecordingWriteResult WriteResult = Writer.WriteFrame(RecordingFrame);
+	const double WriteEndTime = FPlatformTime::Seconds();
+	SET_FLOAT_STAT(STAT_Blackmagic_MediaCapture_FileWrite, (WriteEndTime - WriteStartTime) * 1000.0);
+
+	FBlackmagicOutputFrameCompletion Completion;
+	Completion.FrameIdentifier = InFrame.FrameIdentifier;
+	Completion.SendTime = InFrame.SubmitTime;
+	if (WriteResult == EBlackmagicRecordingWriteResult::Written)
+	{
+		Completion.Result = EBlackmagicOutputFrameResult::Displayed;
+		Completion.ScanoutTime = WriteEndTime;
+	}
+	else
+	{
+		Completion.Result = EBlackmagicOutputFrameResult::Dropped;
+		UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("Frame %lld could not be written to '%s'."), InFrame.FrameNumber, *Filename);
+		bWriteFailed = WriteResult == EBlackmagicRecordingWriteResult::Failed;
+	}
+	Completions->Enqueue(Completion);
+}
@@ -0,0 +1,88 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "BlackmagicMediaCapture.h"
+#include "BlackmagicMediaOverlay.h"
+#include "BlackmagicMediaRecording.h"
+#include "Misc/Timecode.h"
+#include "Templates/Atomic.h"
+
+/**
+ * Write the frames of an output to a recording file instead of a device, for offline renders.
+ * The file is created with the first frame, once the layout of the frames is known.
+ * Frames are written in the order they are rendered, none is skipped: the engine renders as fast as the disk writes.
+ * The writes are double buffered. While a thread pool worker writes a frame, the rendering thread fills the other
+ * buffer with the next one, and only waits when the write of the previous frame is not done.
+ * Every written frame is reported as a displayed frame completion. A write that fails, a full disk for example,
+ * fails the next submit: the capture goes to Error instead of dropping the rest of the render.
+ */
+class FBlackmagicMediaOutputFileSink
+{
+public:
+	/**
+	 * @param InHeader			Format of the output. The layout of the frames is filled by the first frame.
+	 * @param bInWriteTimecode	Whether the timecode of the frames is written with them
+	 */
+	FBlackmagicMediaOutputFileSink(const FString& InFilename, const FBlackmagicRecordingFileHeader& InHeader, bool bInWriteTimecode, const TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe>& InCompletions);
+	~FBlackmagicMediaOutputFileSink();
+
+	FBlackmagicMediaOutputFileSink(const FBlackmagicMediaOutputFileSink&) = delete;
+	FBlackmagicMediaOutputFileSink& operator=(const FBlackmagicMediaOutputFileSink&) = delete;
+
+	/** Wait for the last write, then write the index of the file. */
+	void Close();
+
+	/**
+	 * Copy a frame and write it in the background. Every frame needs the layout of the first one. Called from the rendering thread.
+	 * @param InWidth	Width in pixels
+	 * @param InPitch	Size in bytes of a line
+	 * @return false when the file can't be created or a frame could not be written
+	 */
+	bool Submit_RenderingThread(const uint8* InBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, const FTimecode& InTimecode, uint32 InFrameIdentifier);
+
+	const FString& GetFilename() const { return Filename; }
+
+private:
+	struct FPendingFrame
+	{
+		TArray<uint8> Buffer;
+		TOptional<FTimecode> Timecode;
+		int64 FrameNumber = 0;
+		uint32 FrameIdentifier = 0;
+		double SubmitTime = 0.0;
+	};
+
+	/** Create the file for frames of this layout. */
+	bool Open(EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch);
+
+	/** Wait for the frame being written, if any. */
+	void WaitForPendingWrite();
+
+	/** Write a frame and report its completion. Called from the thread pool. */
+	void WriteFrame(const FPendingFrame& InFrame);
+
+private:
+	FString Filename;
+	FBlackmagicRecordingFileHeader Header;
+	bool bWriteTimecode;
+	TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe> Completions;
+
+	/** Used by one write at a time */
+	FBlackmagicRecordingWriter Writer;
+
+	/** One buffer is filled while the other is written */
+	FPendingFrame Frames[2];
+	int32 NextFrameIndex;
+	int64 NextFrameNumber;
+
+	/** The write of the last submitted frame */
+	TFuture<void> PendingWrite;
+	bool bIsOpen;
+	bool bOpenFailed;
+
+	/** Set by the write of a frame, read by the rendering thread once the write is done */
+	TAtomic<bool> bWriteFailed;
+};
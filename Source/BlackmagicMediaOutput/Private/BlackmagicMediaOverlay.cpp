@@ -0,0 +1,368 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "BlackmagicMediaOverlay.h"
+
+#include "BlackmagicMediaJobs.h"
+#include "BlackmagicMediaOutputModule.h"
+#include "HAL/PlatformTime.h"
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+#include <emmintrin.h>
+#endif
+
+
+namespace BlackmagicMediaOverlayHelpers
+{
+	static const uint32 LinesPerTask = 16;
+	static const double ReopenInterval = 1.0;
+	static const double TornWarningInterval = 5.0;
+
+	/** Stage of the Blackmagic jobs */
+	static const FName JobStage(TEXT("Overlay"));
+
+	/** Rec. 709 video range coefficients, 12 bits fixed point, for 8 bits RGB */
+	static const int32 YR = 748, YG = 2516, YB = 254;
+	static const int32 CbR = -412, CbG = -1387, CbB = 1799;
+	static const int32 CrR = 1799, CrG = -1634, CrB = -165;
+
+	uint32 GetBitDepth(EBlackmagicOverlayBufferLayout InLayout)
+	{
+		return InLayout == EBlackmagicOverlayBufferLayout::V210 ? 10 : 8;
+	}
+
+	uint32 GetNumComponents(EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth)
+	{
+		switch (InLayout)
+		{
+		case EBlackmagicOverlayBufferLayout::BGRA: return InWidth * 4;
+		case EBlackmagicOverlayBufferLayout::UYVY: return InWidth * 2;
+		case EBlackmagicOverlayBufferLayout::V210:
+		default:
+			return FMath::DivideAndRoundUp<uint32>(InWidth, 6) * 12;
+		}
+	}
+
+	/** Weight of the destination: 65535 when the overlay is transparent, 0 when it is opaque. */
+	FORCEINLINE uint16 ToWeight(uint32 InAlpha)
+	{
+		return uint16((255 - InAlpha) * 257);
+	}
+
+	void LoadLine(EBlackmagicOverlayBufferLayout InLayout, const uint8* InLine, uint32 InNumComponents, uint16* OutComponents)
+	{
+		if (InLayout == EBlackmagicOverlayBufferLayout::V210)
+		{
+			const uint32* Words = reinterpret_cast<const uint32*>(InLine);
+			for (uint32 Index = 0; Index < InNumComponents; Index += 3)
+			{
+				const uint32 Word = *Words++;
+				OutComponents[Index + 0] = uint16(Word & 0x3FF);
+				OutComponents[Index + 1] = uint16((Word >> 10) & 0x3FF);
+				OutComponents[Index + 2] = uint16((Word >> 20) & 0x3FF);
+			}
+		}
+		else
+		{
+			for (uint32 Index = 0; Index < InNumComponents; ++Index)
+			{
+				OutComponents[Index] = InLine[Index];
+			}
+		}
+	}
+
+	void StoreLine(EBlackmagicOverlayBufferLayout InLayout, const uint16* InComponents, uint32 InNumComponents, uint8* OutLine)
+	{
+		if (InLayout == EBlackmagicOverlayBufferLayout::V210)
+		{
+			uint32* Words = reinterpret_cast<uint32*>(OutLine);
+			for (uint32 Index = 0; Index < InNumComponents; Index += 3)
+			{
+				*Words++ = uint32(InComponents[Index]) | (uint32(InComponents[Index + 1]) << 10) | (uint32(InComponents[Index + 2]) << 20);
+			}
+		}
+		else
+		{
+			for (uint32 Index = 0; Index < InNumComponents; ++Index)
+			{
+				OutLine[Index] = uint8(InComponents[Index]);
+			}
+		}
+	}
+
+	/** Convert one overlay line to premultiplied components in the output layout, and the weight of every destination component. */
+	void BuildOverlayLine(EBlackmagicOverlayBufferLayout InLayout, const uint8* InOverlay, uint32 InWidth, uint32 InNumComponents, uint16* OutPremultiplied, uint16* OutWeight)
+	{
+		if (InLayout == EBlackmagicOverlayBufferLayout::BGRA)
+		{
+			for (uint32 Pixel = 0; Pixel < InWidth; ++Pixel)
+			{
+				const uint8* Source = InOverlay + Pixel * 4;
+				const uint16 Weight = ToWeight(Source[3]);
+				for (uint32 Channel = 0; Channel < 4; ++Channel)
+				{
+					OutPremultiplied[Pixel * 4 + Channel] = Source[Channel];
+					OutWeight[Pixel * 4 + Channel] = Weight;
+				}
+			}
+			return;
+		}
+
+		// 8 bits: scale 1, 10 bits: scale 4. Offsets of premultiplied video range are scaled by alpha.
+		const int32 ScaleShift = GetBitDepth(InLayout) - 8;
+		const int32 FixedShift = 12 - ScaleShift;
+		const int32 Rounding = 1 << (FixedShift - 1);
+
+		for (uint32 Pixel = 0; Pixel < InWidth; Pixel += 2)
+		{
+			const uint8* Source0 = InOverlay + Pixel * 4;
+			const uint8* Source1 = Pixel + 1 < InWidth ? Source0 + 4 : Source0;
+
+			const int32 B0 = Source0[0], G0 = Source0[1], R0 = Source0[2], A0 = Source0[3];
+			const int32 B1 = Source1[0], G1 = Source1[1], R1 = Source1[2], A1 = Source1[3];
+			const int32 B = B0 + B1, G = G0 + G1, R = R0 + R1, A = A0 + A1;
+
+			const int32 Y0 = ((16 * A0 << ScaleShift) + 127) / 255 + ((YR * R0 + YG * G0 + YB * B0 + Rounding) >> FixedShift);
+			const int32 Y1 = ((16 * A1 << ScaleShift) + 127) / 255 + ((YR * R1 + YG * G1 + YB * B1 + Rounding) >> FixedShift);
+			const int32 Cb = ((128 * A << ScaleShift) + 255) / 510 + ((CbR * R + CbG * G + CbB * B + (Rounding << 1)) >> (FixedShift + 1));
+			const int32 Cr = ((128 * A << ScaleShift) + 255) / 510 + ((CrR * R + CrG * G + CrB * B + (Rounding << 1)) >> (FixedShift + 1));
+			const uint16 WeightC = ToWeight((A + 1) >> 1);
+
+			const uint32 Index = Pixel * 2;
+			OutPremultiplied[Index + 0] = uint16(FMath::Max(Cb, 0));
+			OutPremultiplied[Index + 1] = uint16(FMath::Max(Y0, 0));
+			OutPremultiplied[Index + 2] = uint16(FMath::Max(Cr, 0));
+			OutPremultiplied[Index + 3] = uint16(FMath::Max(Y1, 0));
+			OutWeight[Index + 0] = WeightC;
+			OutWeight[Index + 1] = ToWeight(A0);
+			OutWeight[Index + 2] = WeightC;
+			OutWeight[Index + 3] = ToWeight(A1);
+		}
+
+		// v210 padding at the end of the line is left untouched
+		for (uint32 Index = FMath::DivideAndRoundUp<uint32>(InWidth, 2) * 4; Index < InNumComponents; ++Index)
+		{
+			OutPremultiplied[Index] = 0;
+			OutWeight[Index] = 0xFFFF;
+		}
+	}
+
+	/**
+	 * Destination = Overlay + Destination * Weight / 65535, for 8 or 10 bits components.
+	 * The destination is moved to the top bits so the high half of the 16 bits multiply keeps all the precision.
+	 */
+	void BlendLine(uint16* InOutDestination, const uint16* InPremultiplied, const uint16* InWeight, uint32 InNumComponents, uint32 InBitDepth)
+	{
+		const int32 Shift = 16 - InBitDepth;
+		const int32 MaxValue = (1 << InBitDepth) - 1;
+		uint32 Index = 0;
+
+#if PLATFORM_ENABLE_VECTORINTRINSICS
+		const __m128i ShiftCount = _mm_cvtsi32_si128(Shift);
+		const __m128i RoundingValue = _mm_set1_epi16(int16(1 << (Shift - 1)));
+		const __m128i MaxValues = _mm_set1_epi16(int16(MaxValue));
+		for (; Index + 8 <= InNumComponents; Index += 8)
+		{
+			const __m128i Destination = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InOutDestination + Index));
+			const __m128i Premultiplied = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InPremultiplied + Index));
+			const __m128i Weight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(InWeight + Index));
+
+			__m128i Result = _mm_mulhi_epu16(_mm_sll_epi16(Destination, ShiftCount), Weight);
+			Result = _mm_srl_epi16(_mm_add_epi16(Result, RoundingValue), ShiftCount);
+			Result = _mm_min_epi16(_mm_adds_epu16(Result, Premultiplied), MaxValues);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(InOutDestination + Index), Result);
+		}
+#endif
+
+		for (; Index < InNumComponents; ++Index)
+		{
+			const uint32 Scaled = ((uint32(InOutDestination[Index]) << Shift) * InWeight[Index]) >> 16;
+			const uint32 Result = ((Scaled + (1 << (Shift - 1))) >> Shift) + InPremultiplied[Index];
+			InOutDestination[Index] = uint16(FMath::Min<uint32>(Result, MaxValue));
+		}
+	}
+}
+
+/* FBlackmagicMediaOverlayCompositor
+*****************************************************************************/
+
+void FBlackmagicMediaOverlayCompositor::AlphaOver(uint8* InOutBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, const uint8* InOverlay, uint32 InOverlayPitch)
+{
+	using namespace BlackmagicMediaOverlayHelpers;
+
+	if (InOutBuffer == nullptr || InOverlay == nullptr || InWidth == 0 || InHeight == 0)
+	{
+		return;
+	}
+
+	const uint32 NumComponents = GetNumComponents(InLayout, InWidth);
+	const uint32 BitDepth = GetBitDepth(InLayout);
+	const uint32 NumTasks = FMath::DivideAndRoundUp(InHeight, LinesPerTask);
+	const uint32 ScratchPerTask = NumComponents * 3;
+	if (Scratch.Num() < int32(ScratchPerTask * NumTasks))
+	{
+		Scratch.SetNumUninitialized(ScratchPerTask * NumTasks);
+	}
+
+	FBlackmagicMediaJobs::ParallelFor(EBlackmagicJobPriority::Output, JobStage, NumTasks, [&](int32 TaskIndex)
+	{
+		uint16* Destination = Scratch.GetData() + TaskIndex * ScratchPerTask;
+		uint16* Premultiplied = Destination + NumComponents;
+		uint16* Weight = Premultiplied + NumComponents;
+
+		const uint32 FirstLine = TaskIndex * LinesPerTask;
+		const uint32 LastLine = FMath::Min(FirstLine + LinesPerTask, InHeight);
+		for (uint32 Line = FirstLine; Line < LastLine; ++Line)
+		{
+			uint8* OutputLine = InOutBuffer + uint64(Line) * InPitch;
+			BuildOverlayLine(InLayout, InOverlay + uint64(Line) * InOverlayPitch, InWidth, NumComponents, Premultiplied, Weight);
+			LoadLine(InLayout, OutputLine, NumComponents, Destination);
+			BlendLine(Destination, Premultiplied, Weight, NumComponents, BitDepth);
+			StoreLine(InLayout, Destination, NumComponents, OutputLine);
+		}
+	});
+}
+
+/* FBlackmagicMediaOverlaySource
+*****************************************************************************/
+
+FBlackmagicMediaOverlaySource::FBlackmagicMediaOverlaySource(const FString& InSharedMemoryName, EBlackmagicMediaOverlayMode InMode, EBlackmagicMediaOverlayMatching InMatching, int32 InFrameNumberOffset)
+	: SharedMemoryName(InSharedMemoryName)
+	, Mode(InMode)
+	, Matching(InMatching)
+	, FrameNumberOffset(InFrameNumberOffset)
+	, LastOpenTime(-BlackmagicMediaOverlayHelpers::ReopenInterval)
+	, NumMissedFrames(0)
+	, NumTornFrames(0)
+	, LastTornWarningTime(-BlackmagicMediaOverlayHelpers::TornWarningInterval)
+	, bHasWarnedIncompatibleFormat(false)
+{
+}
+
+bool FBlackmagicMediaOverlaySource::OpenReader()
+{
+	if (Reader.IsOpen())
+	{
+		return true;
+	}
+
+	const double CurrentTime = FPlatformTime::Seconds();
+	if (CurrentTime - LastOpenTime < BlackmagicMediaOverlayHelpers::ReopenInterval)
+	{
+		return false;
+	}
+	LastOpenTime = CurrentTime;
+
+	if (!Reader.Open(SharedMemoryName))
+	{
+		return false;
+	}
+
+	UE_LOG(LogBlackmagicMediaOutput, Log, TEXT("Reading overlay frames from the shared memory region '%s'."), *SharedMemoryName);
+	return true;
+}
+
+bool FBlackmagicMediaOverlaySource::IsFrameCompatible(const FBlackmagicSharedFrame& InFrame, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight) const
+{
+	if (InFrame.Width != InWidth || InFrame.Height != InHeight || uint64(InFrame.Pitch) * InFrame.Height > InFrame.VideoSize)
+	{
+		return false;
+	}
+
+	if (Mode == EBlackmagicMediaOverlayMode::Composite)
+	{
+		return InFrame.PixelFormat == EBlackmagicRecordingPixelFormat::BGRA;
+	}
+
+	switch (InLayout)
+	{
+	case EBlackmagicOverlayBufferLayout::BGRA: return InFrame.PixelFormat == EBlackmagicRecordingPixelFormat::BGRA;
+	case EBlackmagicOverlayBufferLayout::UYVY: return InFrame.PixelFormat == EBlackmagicRecordingPixelFormat::UYVY;
+	case EBlackmagicOverlayBufferLayout::V210: return InFrame.PixelFormat == EBlackmagicRecordingPixelFormat::V210;
+	}
+	return false;
+}
+
+bool FBlackmagicMediaOverlaySource::Apply(uint8* InOutBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, int64 InFrameNumber)
+{
+	using namespace BlackmagicMediaOverlayHelpers;
+
+	if (!OpenReader())
+	{
+		return false;
+	}
+
+	FBlackmagicSharedFrame Frame;
+	int64 Sequence = 0;
+	bool bFound = false;
+	if (Matching == EBlackmagicMediaOverlayMatching::FrameNumber)
+	{
+		bFound = Reader.AcquireFrameNumber(InFrameNumber + FrameNumberOffset, Frame, Sequence);
+	}
+	else
+	{
+		bFound = Reader.AcquireLatest(Frame, Sequence);
+	}
+
+	// When the producer is slower than the engine, the last external frame is used again
+	const bool bCanReuseLastFrame = Matching == EBlackmagicMediaOverlayMatching::Latest && LastFrame.VideoBuffer != nullptr && IsFrameCompatible(LastFrame, InLayout, InWidth, InHeight);
+
+	if (bFound)
+	{
+		if (!IsFrameCompatible(Frame, InLayout, InWidth, InHeight))
+		{
+			if (!bHasWarnedIncompatibleFormat)
+			{
+				bHasWarnedIncompatibleFormat = true;
+				UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The overlay frames of '%s' are %dx%d and don't have the expected size (%dx%d) or pixel format. They are ignored."), *SharedMemoryName, Frame.Width, Frame.Height, InWidth, InHeight);
+			}
+			return false;
+		}
+
+		// The producer never waits: the frame is copied, and only used if the producer didn't write its slot during the copy
+		const uint64 FrameSize = uint64(Frame.Pitch) * Frame.Height;
+		CopyBuffer.SetNumUninitialized(FrameSize);
+		FMemory::Memcpy(CopyBuffer.GetData(), Frame.VideoBuffer, FrameSize);
+
+		if (Reader.IsStillValid(Sequence))
+		{
+			Swap(FrameBuffer, CopyBuffer);
+			LastFrame = Frame;
+			LastFrame.VideoBuffer = FrameBuffer.GetData();
+			LastFrame.VideoSize = FrameSize;
+		}
+		else
+		{
+			++NumTornFrames;
+			bFound = false;
+
+			const double CurrentTime = FPlatformTime::Seconds();
+			if (CurrentTime - LastTornWarningTime >= TornWarningInterval)
+			{
+				LastTornWarningTime = CurrentTime;
+				UE_LOG(LogBlackmagicMediaOutput, Warning, TEXT("The overlay frame %lld of '%s' was overwritten while it was copied (%d torn frames). Increase the number of slots of the producer."), Frame.FrameNumber, *SharedMemoryName, NumTornFrames);
+			}
+		}
+	}
+
+	if (!bFound && !bCanReuseLastFrame)
+	{
+		++NumMissedFrames;
+		UE_LOG(LogBlackmagicMediaOutput, Verbose, TEXT("No overlay frame for frame %lld in '%s' (%d missed)."), InFrameNumber, *SharedMemoryName, NumMissedFrames);
+		return false;
+	}
+
+	if (Mode == EBlackmagicMediaOverlayMode::Composite)
+	{
+		Compositor.AlphaOver(InOutBuffer, InLayout, InWidth, InHeight, InPitch, LastFrame.VideoBuffer, LastFrame.Pitch);
+	}
+	else
+	{
+		const uint32 LineSize = FMath::Min(InPitch, LastFrame.Pitch);
+		for (uint32 Line = 0; Line < InHeight; ++Line)
+		{
+			FMemory::Memcpy(InOutBuffer + uint64(Line) * InPitch, LastFrame.VideoBuffer + uint64(Line) * LastFrame.Pitch, LineSize);
+		}
+	}
+
+	return true;
+}
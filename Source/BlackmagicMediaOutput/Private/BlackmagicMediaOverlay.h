@@ -0,0 +1,92 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "BlackmagicMediaOutput.h"
+#include "BlackmagicMediaSharedFrame.h"
+
+/**
+ * Layout of the buffer sent to the Blackmagic device.
+ */
+enum class EBlackmagicOverlayBufferLayout : uint8
+{
+	/** 8 bits B G R A, one pixel per texel */
+	BGRA,
+	/** 8 bits 4:2:2 Cb Y Cr Y, two pixels per BGRA texel */
+	UYVY,
+	/** 10 bits 4:2:2 packed in 32 bits words, six pixels per 16 bytes */
+	V210,
+};
+
+/**
+ * Composite an 8 bits BGRA overlay with premultiplied alpha over the packed output buffer (alpha-over).
+ * The overlay is converted to the buffer layout line by line (Rec. 709, video range for the YUV layouts)
+ * and blended with SSE2 on 16 bits components. Lines are processed in parallel.
+ */
+class FBlackmagicMediaOverlayCompositor
+{
+public:
+	/**
+	 * @param InOutBuffer		Output buffer, modified in place
+	 * @param InLayout			Layout of the output buffer
+	 * @param InWidth			Width in pixels of the output and of the overlay
+	 * @param InPitch			Size in bytes of a line of the output buffer
+	 * @param InOverlay			BGRA premultiplied overlay
+	 * @param InOverlayPitch	Size in bytes of a line of the overlay
+	 */
+	void AlphaOver(uint8* InOutBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, const uint8* InOverlay, uint32 InOverlayPitch);
+
+private:
+	/** Per task line of components: destination, premultiplied overlay and blend weight */
+	TArray<uint16> Scratch;
+};
+
+/**
+ * Frames written by another process in a shared memory ring, added to the output of a capture.
+ * Only used from the rendering thread.
+ */
+class FBlackmagicMediaOverlaySource
+{
+public:
+	FBlackmagicMediaOverlaySource(const FString& InSharedMemoryName, EBlackmagicMediaOverlayMode InMode, EBlackmagicMediaOverlayMatching InMatching, int32 InFrameNumberOffset);
+
+	/**
+	 * Find the external frame that goes with the engine frame and composite it over the buffer, or copy it in the buffer.
+	 * The frame is copied out of the ring first. A frame torn by the producer is skipped, or replaced by the last one when matching the latest frame.
+	 * @return true if the buffer was modified
+	 */
+	bool Apply(uint8* InOutBuffer, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight, uint32 InPitch, int64 InFrameNumber);
+
+private:
+	bool OpenReader();
+	bool IsFrameCompatible(const FBlackmagicSharedFrame& InFrame, EBlackmagicOverlayBufferLayout InLayout, uint32 InWidth, uint32 InHeight) const;
+
+private:
+	FString SharedMemoryName;
+	EBlackmagicMediaOverlayMode Mode;
+	EBlackmagicMediaOverlayMatching Matching;
+	int32 FrameNumberOffset;
+
+	FBlackmagicSharedFrameReader Reader;
+	FBlackmagicMediaOverlayCompositor Compositor;
+
+	/** The producer may start after the capture, the region is opened again periodically */
+	double LastOpenTime;
+
+	/** Copy of the last external frame that was not torn, and the buffer the next one is copied in */
+	TArray<uint8> FrameBuffer;
+	TArray<uint8> CopyBuffer;
+
+	/** Description of the frame in FrameBuffer, its VideoBuffer is null until a frame was copied */
+	FBlackmagicSharedFrame LastFrame;
+
+	/** Engine frames sent without their external frame */
+	int32 NumMissedFrames;
+
+	/** External frames the producer overwrote while they were copied. The warning is logged at most every TornWarningInterval. */
+	int32 NumTornFrames;
+	double LastTornWarningTime;
+
+	bool bHasWarnedIncompatibleFormat;
+};
@@ -3,12 +3,18 @@
 #pragma once
 
 #include "MediaCapture.h"
+#include "Async/Future.h"
+#include "Containers/Queue.h"
 #include "HAL/CriticalSection.h"
 #include "MediaIOCoreEncodeTime.h"
 #include "Misc/FrameRate.h"
 #include "BlackmagicMediaOutput.h"
 #include "BlackmagicMediaCapture.generated.h"
 
+class FBlackmagicMediaMultiviewer;
+class FBlackmagicMediaOutputCadence;
+class FBlackmagicMediaOutputFileSink;
+class FBlackmagicMediaOverlaySource;
 class FEvent;
 
 
@@ -18,6 +24,47 @@ namespace BlackmagicMediaCaptureHelpers
 }
 
 
+/**
+ * What happened to a frame sent to the output.
+ */
+enum class EBlackmagicOutputFrameResult : uint8
+{
+	/** Scanned out on time */
+	Displayed,
+	/** Scanned out, after the previous frame was repeated */
+	DisplayedLate,
+	/** Never scanned out, the device or the port had no room for it */
+	Dropped,
+	/** Still queued when the output was stopped */
+	Flushed,
+	/** Scanned out again because no new frame was ready, when the frame rate of the engine is decoupled from the output */
+	Repeated,
+	/** Never sent because newer frames were waiting, when the frame rate of the engine is decoupled from the output */
+	Skipped,
+};
+
+/**
+ * Completion of a frame sent to the output.
+ */
+struct FBlackmagicOutputFrameCompletion
+{
+	/** FFrameDescriptor::FrameIdentifier of the frame, the render thread frame number of the engine */
+	uint32 FrameIdentifier = 0;
+
+	EBlackmagicOutputFrameResult Result = EBlackmagicOutputFrameResult::Displayed;
+
+	/** FPlatformTime::Seconds when the frame was given to the device */
+	double SendTime = 0.0;
+
+	/** Estimated FPlatformTime::Seconds of the scanout, 0 when the frame wasn't scanned out */
+	double ScanoutTime = 0.0;
+};
+
+using FBlackmagicOutputFrameCompletionQueue = TQueue<FBlackmagicOutputFrameCompletion, EQueueMode::Mpsc>;
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnBlackmagicOutputFramesCompleted, const TArray<FBlackmagicOutputFrameCompletion>& /*Completions*/);
+
+
 /**
  * Output Media for Blackmagic streams.
  * The output format could be any of EBlackmagicMediaOutputPixelFormat.
@@ -27,9 +74,28 @@ class BLACKMAGICMEDIAOUTPUT_API UBlackmagicMediaCapture : public UMediaCapture
 {
 	GENERATED_UCLASS_BODY()
 
+	//~ UObject interface
+public:
+	virtual void BeginDestroy() override;
+
 	//~ UMediaCapture interface
 public:
 	virtual bool HasFinishedProcessing() const override;
+
+public:
+	/** Change the border of a tile of the multiviewer. */
+	UFUNCTION(BlueprintCallable, Category = "Blackmagic|Multiviewer")
+	void SetMultiviewerTally(int32 TileIndex, EBlackmagicMultiviewerTally Tally);
+
+	/** Completes once the last opening or closing of the output port requested by this capture is done. Invalid when there's nothing to wait for. */
+	TSharedFuture<void> GetChannelOperation() const { return ChannelOperation; }
+
+	/**
+	 * Called on the game thread with the frames completed since the last call, in the order they were sent.
+	 * Frames still in the device when the capture stops are reported as flushed once the port is closed.
+	 */
+	FOnBlackmagicOutputFramesCompleted& OnFramesCompleted() { return FramesCompletedDelegate; }
+
 protected:
 	virtual bool ValidateMediaOutput() const override;
 	virtual bool CaptureSceneViewportImpl(TSharedPtr<FSceneViewport>& InSceneViewport) override;
@@ -46,8 +112,12 @@ private:
 
 private:
 	bool InitBlackmagic(UBlackmagicMediaOutput* InMediaOutput);
+	bool InitFileSink(UBlackmagicMediaOutput* InMediaOutput);
 	void WaitForSync_RenderingThread();
+	void ApplyOverlay_RenderingThread(const FCaptureBaseData& InBaseData, void* InBuffer, int32 Width, int32 Height);
+	void SubmitMultiviewer_RenderingThread(const FCaptureBaseData& InBaseData, void* InBuffer, int32 Width, int32 Height);
 	void ApplyViewportTextureAlpha(TSharedPtr<FSceneViewport> InSceneViewport);
+	bool DeliverFrameCompletions(float InDeltaTime);
 	void RestoreViewportTextureAlpha(TSharedPtr<FSceneViewport> InSceneViewport);
 
 private:
@@ -72,9 +142,30 @@ private:
 	/** Critical section for synchronizing access to the OutputChannel */
 	FCriticalSection RenderThreadCriticalSection;
 
+	/** Frames of another process added to the output */
+	TSharedPtr<FBlackmagicMediaOverlaySource> OverlaySource;
+
+	/** Monitoring feed sent on another port */
+	TSharedPtr<FBlackmagicMediaMultiviewer> Multiviewer;
+
+	/** Sends the frames at the rate of the output when the engine rate is decoupled */
+	TSharedPtr<FBlackmagicMediaOutputCadence, ESPMode::ThreadSafe> Cadence;
+
+	/** Writes the frames to a file instead of the device */
+	TSharedPtr<FBlackmagicMediaOutputFileSink> FileSink;
+
 	/** Event to wakeup When waiting for sync */
 	FEvent* WakeUpEvent;
 
+	/** Driver calls of the capture, run by FBlackmagicMediaChannelTasks */
+	TSharedFuture<void> ChannelOperation;
+
 	/** Last frame drop count to detect count */
 	uint64 LastFrameDropCount_BlackmagicThread;
+
+	/** Filled by the event callback, emptied by the game thread */
+	TSharedRef<FBlackmagicOutputFrameCompletionQueue, ESPMode::ThreadSafe> FrameCompletions;
+	TArray<FBlackmagicOutputFrameCompletion> FrameCompletionBatch;
+	FOnBlackmagicOutputFramesCompleted FramesCompletedDelegate;
+	FDelegateHandle FrameCompletionsTickerHandle;
 };
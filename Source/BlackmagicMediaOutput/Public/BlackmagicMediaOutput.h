@@ -19,6 +19,94 @@ enum class EBlackmagicMediaOutputPixelFormat : uint8
 	PF_10BIT_YUV UMETA(DisplayName = "10bit YUV"),
 };
 
+/**
+ * How frames read from the overlay shared memory ring are used.
+ */
+UENUM()
+enum class EBlackmagicMediaOverlayMode : uint8
+{
+	/** Alpha-over the external frame (8bit BGRA, premultiplied alpha) on the engine frame. */
+	Composite,
+	/** Send the external frame instead of the engine frame. It needs to be in the output pixel format. */
+	Replace,
+};
+
+/**
+ * Which frame of the overlay shared memory ring goes with an engine frame.
+ */
+UENUM()
+enum class EBlackmagicMediaOverlayMatching : uint8
+{
+	/** Use the most recent external frame. */
+	Latest,
+	/** Use the external frame with the same frame number as the engine frame (plus the offset). The frame is skipped when it is not available. */
+	FrameNumber,
+};
+
+/**
+ * Arrangement of the tiles of the multiviewer.
+ */
+UENUM()
+enum class EBlackmagicMultiviewerLayout : uint8
+{
+	Grid2x2 UMETA(DisplayName = "2x2"),
+	Grid3x3 UMETA(DisplayName = "3x3"),
+	Grid4x4 UMETA(DisplayName = "4x4"),
+	/** The first tile takes 2x2 cells of a 3x3 grid, the 5 other tiles are around it. */
+	OneLargeFiveSmall UMETA(DisplayName = "1 + 5"),
+};
+
+/**
+ * What a tile of the multiviewer shows.
+ */
+UENUM()
+enum class EBlackmagicMultiviewerSource : uint8
+{
+	/** The frames sent by this output. */
+	Program,
+	/** The proxies of an input opened in this process by a Blackmagic media source that generates proxies. */
+	Input,
+	/** Nothing, the tile stays black. */
+	None,
+};
+
+/**
+ * Color of the border of a tile of the multiviewer.
+ */
+UENUM(BlueprintType)
+enum class EBlackmagicMultiviewerTally : uint8
+{
+	Off,
+	Preview,
+	Program,
+};
+
+/**
+ * A tile of the multiviewer.
+ */
+USTRUCT()
+struct BLACKMAGICMEDIAOUTPUT_API FBlackmagicMultiviewerTile
+{
+	GENERATED_BODY()
+
+	FBlackmagicMultiviewerTile();
+
+	UPROPERTY(EditAnywhere, Category = "Multiviewer")
+	EBlackmagicMultiviewerSource Source;
+
+	/** Device of the input, as in the configuration of its media source. */
+	UPROPERTY(EditAnywhere, Category = "Multiviewer")
+	int32 InputDeviceIndex;
+
+	/** Burned at the bottom left of the tile. */
+	UPROPERTY(EditAnywhere, Category = "Multiviewer")
+	FString Label;
+
+	/** Tally when the capture starts. It can be changed while capturing with UBlackmagicMediaCapture::SetMultiviewerTally. */
+	UPROPERTY(EditAnywhere, Category = "Multiviewer")
+	EBlackmagicMultiviewerTally Tally;
+};
+
 /**
  * Output information for a MediaCapture.
  * @note	'Frame Buffer Pixel Format' must be set to at least 8 bits of alpha to enabled the Key.
@@ -63,10 +151,83 @@ public:
 	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "Output")
 	bool bInterlacedFieldsTimecodeNeedToMatch;
 	
+	/**
+	 * Send frames at the rate of the output, whatever the rate of the engine. When the engine is slower, the last frame is
+	 * repeated without being copied again. When it is faster, or renders in bursts, the oldest waiting frames are skipped.
+	 * A frame is only reported as dropped when the output really missed it.
+	 */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "Output")
+	bool bDecoupleFrameRate;
+
+	/** Engine frames that can wait to be sent. More frames absorb longer bursts and add latency. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "Output", meta = (EditCondition = "bDecoupleFrameRate", ClampMin = 1, ClampMax = 8))
+	int32 MaxDecoupledFrames;
+
 	/** Try to maintain a the engine "Genlock" with the VSync signal. */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, Category = "Synchronization")
 	bool bWaitForSyncEvent;
 
+public:
+	/**
+	 * Write the output frames to a recording file instead of sending them to the device, for offline renders. No device is needed.
+	 * The frames are converted and their timecode is burned exactly as for the device, and they are written as fast as the engine
+	 * renders them, none is skipped. Use a fixed frame rate for the engine to render faster or slower than real time.
+	 * The multiviewer isn't sent and the engine doesn't wait for the sync event of the device.
+	 */
+	UPROPERTY(EditAnywhere, Category = "File")
+	bool bWriteToFile;
+
+	/** Path of the recording. When empty, the file is created in Saved/Blackmagic with the name of the output and the date. */
+	UPROPERTY(EditAnywhere, Category = "File", meta = (EditCondition = "bWriteToFile"))
+	FString OutputFilename;
+
+public:
+	/**
+	 * Read frames written by another process of this machine in a shared memory ring and add them to the output.
+	 * Used to add external graphics without a hardware keyer or a round trip through the GPU.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Overlay")
+	bool bUseSharedMemoryOverlay;
+
+	/** Name of the shared memory region written by the external process. */
+	UPROPERTY(EditAnywhere, Category = "Overlay", meta = (EditCondition = "bUseSharedMemoryOverlay"))
+	FString OverlaySharedMemoryName;
+
+	/** Whether the external frame is composited on the engine frame or replaces it. */
+	UPROPERTY(EditAnywhere, Category = "Overlay", meta = (EditCondition = "bUseSharedMemoryOverlay"))
+	EBlackmagicMediaOverlayMode OverlayMode;
+
+	/** How the external frame is matched to the engine frame. */
+	UPROPERTY(EditAnywhere, Category = "Overlay", meta = (EditCondition = "bUseSharedMemoryOverlay"))
+	EBlackmagicMediaOverlayMatching OverlayMatching;
+
+	/** Added to the engine frame number to find the external frame. */
+	UPROPERTY(EditAnywhere, AdvancedDisplay, Category = "Overlay", meta = (EditCondition = "bUseSharedMemoryOverlay"))
+	int32 OverlayFrameNumberOffset;
+
+public:
+	/**
+	 * Compose a monitoring feed from the proxies of the inputs and from the frames of this output, and send it on another port.
+	 * The feed is composed on the CPU in 8bit YUV, the GPU is not involved.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Multiviewer")
+	bool bOutputMultiviewer;
+
+	/** The device, port and video settings of the multiviewer. It needs to be a different port than the output. */
+	UPROPERTY(EditAnywhere, Category = "Multiviewer", meta = (EditCondition = "bOutputMultiviewer"))
+	FMediaIOOutputConfiguration MultiviewerConfiguration;
+
+	UPROPERTY(EditAnywhere, Category = "Multiviewer", meta = (EditCondition = "bOutputMultiviewer"))
+	EBlackmagicMultiviewerLayout MultiviewerLayout;
+
+	/** Tiles in reading order. Tiles that are not listed stay black. */
+	UPROPERTY(EditAnywhere, Category = "Multiviewer", meta = (EditCondition = "bOutputMultiviewer"))
+	TArray<FBlackmagicMultiviewerTile> MultiviewerTiles;
+
+	/** Burn the timecode of every tile at its bottom right. */
+	UPROPERTY(EditAnywhere, Category = "Multiviewer", meta = (EditCondition = "bOutputMultiviewer"))
+	bool bMultiviewerBurnTimecode;
+
 public:
 
 	/** Log a warning when there's a drop frame. */
@@ -78,8 +239,23 @@ public:
 	bool bEncodeTimecodeInTexel;
 
 public:
+	/**
+	 * Check the configuration against the devices found by the last scan, or against the devices themselves with Blackmagic.LiveValidation.
+	 * A configuration taken from a preset is not checked against the devices again.
+	 */
 	bool Validate(FString& FailureReason) const;
 
+	/**
+	 * Take the configuration, the timecode and the pixel format of an output port of a preset.
+	 * @return false when the preset or the port doesn't exist or isn't valid, the output is then unchanged.
+	 * @see UBlackmagicMediaPresets
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Blackmagic")
+	bool ApplyPreset(FName PresetName, int32 PortIndex);
+
+	/** Path of the recording when the output writes to a file. */
+	FString GetOutputFilename() const;
+
 	FFrameRate GetRequestedFrameRate() const;
 	virtual FIntPoint GetRequestedSize() const override;
 	virtual EPixelFormat GetRequestedPixelFormat() const override;